@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "arrange.h"
+
+/*
+ * The solver works in a canonical space where outputs are packed in rows
+ * towards the top edge, the other edges are mirrored/transposed into it.
+ * Rows are filled left to right and every output is dropped onto the
+ * skyline of the rows above it, like in tetris. Each output thus either
+ * rests on one above it or continues the row next to its left neighbour,
+ * so the result is always connected and never overlaps, even when sizes
+ * differ. A uniform video wall comes out as a plain grid.
+ *
+ * Pinned outputs keep their position, the rest is packed as a block
+ * against the right edge of the rightmost pinned output.
+ */
+
+struct wlay_arrange_segment {
+    int32_t x0;
+    int32_t x1;
+    int32_t bottom;
+};
+
+struct wlay_arrange_sort {
+    const struct wlay_arrange *a;
+    const struct wlay_arrange_item *items;
+    bool keep_order;
+};
+
+
+static bool wlay_arrange_transposed(enum wlay_arrange_edge edge)
+{
+    return edge == WLAY_ARRANGE_LEFT || edge == WLAY_ARRANGE_RIGHT;
+}
+
+
+static bool wlay_arrange_mirrored(enum wlay_arrange_edge edge)
+{
+    return edge == WLAY_ARRANGE_BOTTOM || edge == WLAY_ARRANGE_RIGHT;
+}
+
+
+static struct wlay_rect wlay_arrange_to_canonical(struct wlay_rect r,
+                                                  enum wlay_arrange_edge edge)
+{
+    if (wlay_arrange_transposed(edge)) {
+        r = (struct wlay_rect){ .x = r.y, .y = r.x, .w = r.h, .h = r.w };
+    }
+    if (wlay_arrange_mirrored(edge)) {
+        r.y = -(r.y + r.h);
+    }
+    return r;
+}
+
+
+static struct wlay_rect wlay_arrange_from_canonical(struct wlay_rect r,
+                                                    enum wlay_arrange_edge edge)
+{
+    if (wlay_arrange_mirrored(edge)) {
+        r.y = -(r.y + r.h);
+    }
+    if (wlay_arrange_transposed(edge)) {
+        r = (struct wlay_rect){ .x = r.y, .y = r.x, .w = r.h, .h = r.w };
+    }
+    return r;
+}
+
+
+static int compare_order(const void *pa, const void *pb, void *data)
+{
+    const struct wlay_arrange_sort *sort = data;
+    size_t ia = *(const size_t *)pa;
+    size_t ib = *(const size_t *)pb;
+    if (sort->keep_order) {
+        // Row bands absorb the few pixels of misalignment left by dragging
+        int32_t band_a = sort->a->band[ia];
+        int32_t band_b = sort->a->band[ib];
+        if (band_a != band_b) {
+            return band_a < band_b ? -1 : 1;
+        }
+        int32_t xa = sort->a->placed[ia].x;
+        int32_t xb = sort->a->placed[ib].x;
+        if (xa != xb) {
+            return xa < xb ? -1 : 1;
+        }
+    } else {
+        const char *na = sort->items[ia].name ? sort->items[ia].name : "";
+        const char *nb = sort->items[ib].name ? sort->items[ib].name : "";
+        int cmp = strverscmp(na, nb);
+        if (cmp != 0) {
+            return cmp;
+        }
+    }
+    return (ia > ib) - (ia < ib);
+}
+
+
+static bool wlay_arrange_skyline_query(struct wlay_arrange *a,
+                                       int32_t x0, int32_t x1, int32_t *bottom)
+{
+    bool found = false;
+    for (size_t i = 0; i < a->skyline_count; i++) {
+        struct wlay_arrange_segment *s = &a->skyline[i];
+        if (s->x0 >= x1) {
+            break;
+        }
+        if (s->x1 <= x0) {
+            continue;
+        }
+        if (!found || s->bottom > *bottom) {
+            *bottom = s->bottom;
+        }
+        found = true;
+    }
+    return found;
+}
+
+
+static void wlay_arrange_skyline_set(struct wlay_arrange *a,
+                                     int32_t x0, int32_t x1, int32_t bottom)
+{
+    struct wlay_arrange_segment *sk = a->skyline;
+    size_t n = a->skyline_count;
+    size_t i = 0;
+    while (i < n && sk[i].x1 <= x0) {
+        i++;
+    }
+    size_t j = i;
+    while (j < n && sk[j].x0 < x1) {
+        j++;
+    }
+
+    // Segments i..j-1 are covered, keep whatever sticks out on both sides
+    struct wlay_arrange_segment left = {0}, right = {0};
+    bool has_left = i < j && sk[i].x0 < x0;
+    bool has_right = i < j && sk[j - 1].x1 > x1;
+    if (has_left) {
+        left = (struct wlay_arrange_segment){ sk[i].x0, x0, sk[i].bottom };
+    }
+    if (has_right) {
+        right = (struct wlay_arrange_segment){ x1, sk[j - 1].x1, sk[j - 1].bottom };
+    }
+    size_t replaced = has_left + 1 + has_right;
+    memmove(&sk[i + replaced], &sk[j], (n - j) * sizeof(*sk));
+    a->skyline_count = n - (j - i) + replaced;
+
+    if (has_left) {
+        sk[i++] = left;
+    }
+    sk[i++] = (struct wlay_arrange_segment){ x0, x1, bottom };
+    if (has_right) {
+        sk[i++] = right;
+    }
+}
+
+
+static void wlay_arrange_reserve(struct wlay_arrange *a, size_t count)
+{
+    if (count <= a->capacity) {
+        return;
+    }
+    size_t capacity = max(count, a->capacity * 2);
+    a->order = xrealloc(a->order, capacity * sizeof(*a->order));
+    a->band = xrealloc(a->band, capacity * sizeof(*a->band));
+    a->placed = xrealloc(a->placed, capacity * sizeof(*a->placed));
+    // Every placement splits at most one segment into three
+    a->skyline = xrealloc(a->skyline, (2 * capacity + 1) * sizeof(*a->skyline));
+    a->capacity = capacity;
+}
+
+
+void wlay_arrange_init(struct wlay_arrange *a)
+{
+    *a = (struct wlay_arrange){0};
+}
+
+
+void wlay_arrange_finish(struct wlay_arrange *a)
+{
+    xfree(a->order);
+    xfree(a->band);
+    xfree(a->placed);
+    xfree(a->skyline);
+    wlay_arrange_init(a);
+}
+
+
+void wlay_arrange(struct wlay_arrange *a,
+                  struct wlay_arrange_item *items, size_t count,
+                  const struct wlay_arrange_constraints *constraints)
+{
+    enum wlay_arrange_edge edge = constraints->edge;
+    wlay_arrange_reserve(a, count);
+
+    // Move everything into canonical space, find the anchor of the block
+    // and the row band height used for ordering
+    size_t free_count = 0;
+    int32_t origin_x = 0, origin_y = 0;
+    int32_t min_y = INT32_MAX, band_height = 1;
+    bool pinned = false;
+    for (size_t i = 0; i < count; i++) {
+        struct wlay_rect r = wlay_arrange_to_canonical(items[i].rect, edge);
+        a->placed[i] = r;
+        if (items[i].pinned) {
+            if (!pinned || r.x + r.w > origin_x ||
+                    (r.x + r.w == origin_x && r.y < origin_y)) {
+                origin_x = r.x + r.w;
+                origin_y = r.y;
+            }
+            pinned = true;
+            continue;
+        }
+        a->order[free_count++] = i;
+        min_y = min(min_y, r.y);
+        band_height = max(band_height, r.h);
+    }
+    for (size_t k = 0; k < free_count; k++) {
+        struct wlay_rect *r = &a->placed[a->order[k]];
+        a->band[a->order[k]] = (r->y + r->h / 2 - min_y) / band_height;
+    }
+
+    struct wlay_arrange_sort sort = {
+        .a = a,
+        .items = items,
+        .keep_order = constraints->keep_order,
+    };
+    qsort_r(a->order, free_count, sizeof(*a->order), compare_order, &sort);
+
+    size_t per_line = constraints->per_line;
+    if (per_line == 0) {
+        per_line = max((size_t)ceil(sqrt(free_count)), (size_t)1);
+    }
+
+    a->skyline_count = 0;
+    int32_t cursor_x = origin_x;
+    int32_t row_y = origin_y;
+    for (size_t k = 0; k < free_count; k++) {
+        struct wlay_rect *r = &a->placed[a->order[k]];
+        if (k % per_line == 0) {
+            cursor_x = origin_x;
+            row_y = origin_y;
+        }
+        int32_t bottom;
+        if (wlay_arrange_skyline_query(a, cursor_x, cursor_x + r->w, &bottom)) {
+            r->y = bottom;
+        } else {
+            // Nothing above, continue next to the left neighbour
+            r->y = row_y;
+        }
+        r->x = cursor_x;
+        wlay_arrange_skyline_set(a, r->x, r->x + r->w, r->y + r->h);
+        cursor_x += r->w;
+        row_y = r->y;
+    }
+
+    // Back to screen space. Without pins there is nothing to stay aligned
+    // with, so the block is moved to the origin.
+    int32_t shift_x = INT32_MAX, shift_y = INT32_MAX;
+    for (size_t k = 0; k < free_count; k++) {
+        size_t i = a->order[k];
+        struct wlay_rect r = wlay_arrange_from_canonical(a->placed[i], edge);
+        items[i].rect.x = r.x;
+        items[i].rect.y = r.y;
+        shift_x = min(shift_x, r.x);
+        shift_y = min(shift_y, r.y);
+    }
+    if (!pinned) {
+        for (size_t k = 0; k < free_count; k++) {
+            items[a->order[k]].rect.x -= shift_x;
+            items[a->order[k]].rect.y -= shift_y;
+        }
+    }
+}
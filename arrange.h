@@ -0,0 +1,50 @@
+#ifndef WLAY_ARRANGE_H
+#define WLAY_ARRANGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "validate.h"
+
+enum wlay_arrange_edge {
+    // Rows of outputs, packed towards the top/bottom edge
+    WLAY_ARRANGE_TOP,
+    WLAY_ARRANGE_BOTTOM,
+    // Columns of outputs, packed towards the left/right edge
+    WLAY_ARRANGE_LEFT,
+    WLAY_ARRANGE_RIGHT,
+};
+
+struct wlay_arrange_constraints {
+    enum wlay_arrange_edge edge;
+    // Outputs per row (or column), 0 picks a roughly square grid
+    int per_line;
+    // Keep the current reading order instead of sorting by name
+    bool keep_order;
+};
+
+struct wlay_arrange_item {
+    // Size is the input, position is both the input (ordering, pins) and
+    // the output
+    struct wlay_rect rect;
+    const char *name;
+    bool pinned;
+};
+
+struct wlay_arrange {
+    // Scratch space, reused between solves
+    size_t capacity;
+    size_t *order;
+    int32_t *band;
+    struct wlay_rect *placed;
+    struct wlay_arrange_segment *skyline;
+    size_t skyline_count;
+};
+
+void wlay_arrange_init(struct wlay_arrange *a);
+void wlay_arrange_finish(struct wlay_arrange *a);
+void wlay_arrange(struct wlay_arrange *a,
+                  struct wlay_arrange_item *items, size_t count,
+                  const struct wlay_arrange_constraints *constraints);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef WLAY_BACKEND_H
+#define WLAY_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WINDOW_WIDTH 1200
+#define WINDOW_HEIGHT 800
+
+struct wlay_state;
+struct nk_context;
+struct nk_image;
+
+struct wlay_backend {
+    const char *name;
+    // Opens the window and returns a nuklear context with the font loaded
+    struct nk_context *(*init)(struct wlay_state *wlay);
+    void (*destroy)(struct wlay_state *wlay);
+    bool (*should_close)(struct wlay_state *wlay);
+    // Collects input (possibly waiting for it) and starts a nuklear frame
+    void (*new_frame)(struct wlay_state *wlay);
+    // Optional, called right before the frame is built. Brings the cursor
+    // position new_frame collected up to date, see wlay_state.present.
+    void (*sample_input)(struct wlay_state *wlay);
+    // Presents the frame and clears the nuklear command buffer
+    void (*render)(struct wlay_state *wlay);
+    void (*get_size)(struct wlay_state *wlay, int *width, int *height);
+
+    // Optional, backends without them draw no thumbnails. Uploads opaque
+    // 0xAARRGGBB pixels into image, which is either zeroed or the result
+    // of an earlier upload that is replaced.
+    void (*image_upload)(struct wlay_state *wlay, struct nk_image *image,
+                         const uint32_t *pixels, int width, int height);
+    void (*image_destroy)(struct wlay_state *wlay, struct nk_image *image);
+    // Optional, false while nothing of the window can be seen
+    bool (*visible)(struct wlay_state *wlay);
+    // Optional, for backends that skip idle frames: the model changed or a
+    // result arrived, so the next frame has to be drawn
+    void (*wake)(struct wlay_state *wlay);
+};
+
+#ifdef WLAY_WITH_GL
+extern const struct wlay_backend wlay_backend_glfw;
+#endif
+#ifdef WLAY_WITH_SHM
+extern const struct wlay_backend wlay_backend_shm;
+#endif
+
+#ifdef WLAY_WITH_EGL
+// Offscreen OpenGL rendering, used by wlay-bench. Input is supplied by a
+// callback during new_frame and render records what it cost.
+struct wlay_egl_stats {
+    // Seconds spent converting, uploading and drawing the last frame
+    double convert;
+    double upload;
+    double draw;
+    unsigned int vertices;
+    unsigned int elements;
+    unsigned int draw_calls;
+};
+
+extern const struct wlay_backend wlay_backend_egl;
+void wlay_egl_set_input(void (*input)(struct nk_context *ctx, void *data), void *data);
+const struct wlay_egl_stats *wlay_egl_stats(void);
+#endif
+
+#endif
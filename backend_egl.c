@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <epoxy/egl.h>
+#include <epoxy/gl.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_RENDER
+#include "util.h"
+#include "wlay.h"
+#include "wlay_nuklear.h"
+#include "backend.h"
+
+// Same limits as the GLFW backend
+#define MAX_VERTEX_BUFFER 512 * 1024
+#define MAX_ELEMENT_BUFFER 128 * 1024
+
+struct wlay_egl_vertex {
+    float position[2];
+    float uv[2];
+    nk_byte col[4];
+};
+
+static struct {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    GLuint fbo, color;
+
+    GLuint prog, vert_shdr, frag_shdr;
+    GLuint vao, vbo, ebo, font_tex;
+    GLint uniform_tex, uniform_proj;
+    GLint attrib_pos, attrib_uv, attrib_col;
+
+    struct nk_context ctx;
+    struct nk_font_atlas atlas;
+    struct nk_draw_null_texture null;
+    struct nk_buffer cmds;
+    // nk_convert() output is staged in memory so that converting and
+    // uploading can be timed separately
+    void *vertices;
+    void *elements;
+
+    void (*input)(struct nk_context *ctx, void *data);
+    void *input_data;
+    struct wlay_egl_stats stats;
+} egl;
+
+
+static void wlay_egl_context_init(void)
+{
+    // Prefer Mesa's surfaceless platform, it needs neither a display server
+    // nor a GPU. Anything else gets a pbuffer.
+    egl.display = EGL_NO_DISPLAY;
+    if (epoxy_has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+        egl.display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                               EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (egl.display == EGL_NO_DISPLAY) {
+        egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (egl.display == EGL_NO_DISPLAY || !eglInitialize(egl.display, NULL, NULL)) {
+        fail("EGL failed to initialize");
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fail("EGL does not support OpenGL");
+    }
+
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(egl.display, config_attribs, &config, 1, &config_count) ||
+            config_count == 0) {
+        fail("No suitable EGL config");
+    }
+
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    egl.context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, context_attribs);
+    if (egl.context == EGL_NO_CONTEXT) {
+        fail("Failed to create an OpenGL 3.3 context");
+    }
+
+    egl.surface = EGL_NO_SURFACE;
+    if (!epoxy_has_egl_extension(egl.display, "EGL_KHR_surfaceless_context")) {
+        const EGLint pbuffer_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE,
+        };
+        egl.surface = eglCreatePbufferSurface(egl.display, config, pbuffer_attribs);
+    }
+    if (!eglMakeCurrent(egl.display, egl.surface, egl.surface, egl.context)) {
+        fail("Failed to make the EGL context current");
+    }
+
+    // Everything is drawn into an offscreen framebuffer of the window size
+    glGenRenderbuffers(1, &egl.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, egl.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glGenFramebuffers(1, &egl.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, egl.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, egl.color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fail("Offscreen framebuffer is incomplete");
+    }
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+
+static GLuint wlay_egl_shader(GLenum type, const GLchar *source)
+{
+    GLint status;
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        fail("Shader failed to compile");
+    }
+    return shader;
+}
+
+
+// Same pipeline as nuklear_glfw_gl3.h
+static void wlay_egl_device_init(void)
+{
+    static const GLchar *vertex_shader =
+        "#version 150\n"
+        "uniform mat4 ProjMtx;\n"
+        "in vec2 Position;\n"
+        "in vec2 TexCoord;\n"
+        "in vec4 Color;\n"
+        "out vec2 Frag_UV;\n"
+        "out vec4 Frag_Color;\n"
+        "void main() {\n"
+        "   Frag_UV = TexCoord;\n"
+        "   Frag_Color = Color;\n"
+        "   gl_Position = ProjMtx * vec4(Position.xy, 0, 1);\n"
+        "}\n";
+    static const GLchar *fragment_shader =
+        "#version 150\n"
+        "precision mediump float;\n"
+        "uniform sampler2D Texture;\n"
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "out vec4 Out_Color;\n"
+        "void main(){\n"
+        "   Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
+        "}\n";
+
+    GLint status;
+    egl.prog = glCreateProgram();
+    egl.vert_shdr = wlay_egl_shader(GL_VERTEX_SHADER, vertex_shader);
+    egl.frag_shdr = wlay_egl_shader(GL_FRAGMENT_SHADER, fragment_shader);
+    glAttachShader(egl.prog, egl.vert_shdr);
+    glAttachShader(egl.prog, egl.frag_shdr);
+    glLinkProgram(egl.prog);
+    glGetProgramiv(egl.prog, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        fail("Shader program failed to link");
+    }
+
+    egl.uniform_tex = glGetUniformLocation(egl.prog, "Texture");
+    egl.uniform_proj = glGetUniformLocation(egl.prog, "ProjMtx");
+    egl.attrib_pos = glGetAttribLocation(egl.prog, "Position");
+    egl.attrib_uv = glGetAttribLocation(egl.prog, "TexCoord");
+    egl.attrib_col = glGetAttribLocation(egl.prog, "Color");
+
+    GLsizei vs = sizeof(struct wlay_egl_vertex);
+    glGenBuffers(1, &egl.vbo);
+    glGenBuffers(1, &egl.ebo);
+    glGenVertexArrays(1, &egl.vao);
+    glBindVertexArray(egl.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, egl.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, egl.ebo);
+    glBufferData(GL_ARRAY_BUFFER, MAX_VERTEX_BUFFER, NULL, GL_STREAM_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_ELEMENT_BUFFER, NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray((GLuint)egl.attrib_pos);
+    glEnableVertexAttribArray((GLuint)egl.attrib_uv);
+    glEnableVertexAttribArray((GLuint)egl.attrib_col);
+    glVertexAttribPointer((GLuint)egl.attrib_pos, 2, GL_FLOAT, GL_FALSE, vs,
+                          (void *)offsetof(struct wlay_egl_vertex, position));
+    glVertexAttribPointer((GLuint)egl.attrib_uv, 2, GL_FLOAT, GL_FALSE, vs,
+                          (void *)offsetof(struct wlay_egl_vertex, uv));
+    glVertexAttribPointer((GLuint)egl.attrib_col, 4, GL_UNSIGNED_BYTE, GL_TRUE, vs,
+                          (void *)offsetof(struct wlay_egl_vertex, col));
+    glBindVertexArray(0);
+
+    nk_buffer_init(&egl.cmds, wlay_nk_allocator(WLAY_MEM_RENDER),
+                   NK_BUFFER_DEFAULT_INITIAL_SIZE);
+    egl.vertices = xmalloc(MAX_VERTEX_BUFFER);
+    egl.elements = xmalloc(MAX_ELEMENT_BUFFER);
+}
+
+
+static void wlay_egl_font_init(void)
+{
+    int width, height;
+    nk_font_atlas_init(&egl.atlas, wlay_nk_allocator(WLAY_MEM_RENDER));
+    nk_font_atlas_begin(&egl.atlas);
+    const void *image = nk_font_atlas_bake(&egl.atlas, &width, &height,
+                                           NK_FONT_ATLAS_RGBA32);
+    glGenTextures(1, &egl.font_tex);
+    glBindTexture(GL_TEXTURE_2D, egl.font_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, image);
+    nk_font_atlas_end(&egl.atlas, nk_handle_id((int)egl.font_tex), &egl.null);
+}
+
+
+static struct nk_context *wlay_egl_init(struct wlay_state *wlay)
+{
+    wlay_egl_context_init();
+    wlay_egl_device_init();
+    wlay_egl_font_init();
+    nk_init(&egl.ctx, wlay_nk_allocator(WLAY_MEM_GUI), &egl.atlas.default_font->handle);
+    return &egl.ctx;
+}
+
+
+static void wlay_egl_destroy(struct wlay_state *wlay)
+{
+    nk_font_atlas_clear(&egl.atlas);
+    nk_free(&egl.ctx);
+    nk_buffer_free(&egl.cmds);
+    xfree(egl.vertices);
+    xfree(egl.elements);
+
+    glDeleteProgram(egl.prog);
+    glDeleteShader(egl.vert_shdr);
+    glDeleteShader(egl.frag_shdr);
+    glDeleteTextures(1, &egl.font_tex);
+    glDeleteBuffers(1, &egl.vbo);
+    glDeleteBuffers(1, &egl.ebo);
+    glDeleteVertexArrays(1, &egl.vao);
+    glDeleteFramebuffers(1, &egl.fbo);
+    glDeleteRenderbuffers(1, &egl.color);
+
+    eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl.surface != EGL_NO_SURFACE) {
+        eglDestroySurface(egl.display, egl.surface);
+    }
+    eglDestroyContext(egl.display, egl.context);
+    eglTerminate(egl.display);
+    memset(&egl, 0, sizeof(egl));
+}
+
+
+static bool wlay_egl_should_close(struct wlay_state *wlay)
+{
+    // The caller decides how many frames to render
+    return false;
+}
+
+
+static void wlay_egl_new_frame(struct wlay_state *wlay)
+{
+    nk_input_begin(&egl.ctx);
+    if (egl.input != NULL) {
+        egl.input(&egl.ctx, egl.input_data);
+    }
+    nk_input_end(&egl.ctx);
+}
+
+
+static void wlay_egl_render(struct wlay_state *wlay)
+{
+    struct wlay_egl_stats *stats = &egl.stats;
+    double start = monotonic_time();
+
+    static const struct nk_draw_vertex_layout_element vertex_layout[] = {
+        {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, offsetof(struct wlay_egl_vertex, position)},
+        {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, offsetof(struct wlay_egl_vertex, uv)},
+        {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, offsetof(struct wlay_egl_vertex, col)},
+        {NK_VERTEX_LAYOUT_END}
+    };
+    struct nk_convert_config config;
+    memset(&config, 0, sizeof(config));
+    config.vertex_layout = vertex_layout;
+    config.vertex_size = sizeof(struct wlay_egl_vertex);
+    config.vertex_alignment = NK_ALIGNOF(struct wlay_egl_vertex);
+    config.null = egl.null;
+    config.circle_segment_count = 22;
+    config.curve_segment_count = 22;
+    config.arc_segment_count = 22;
+    config.global_alpha = 1.0f;
+    config.shape_AA = NK_ANTI_ALIASING_ON;
+    config.line_AA = NK_ANTI_ALIASING_ON;
+
+    struct nk_buffer vbuf, ebuf;
+    nk_buffer_clear(&egl.cmds);
+    nk_buffer_init_fixed(&vbuf, egl.vertices, MAX_VERTEX_BUFFER);
+    nk_buffer_init_fixed(&ebuf, egl.elements, MAX_ELEMENT_BUFFER);
+    nk_convert(&egl.ctx, &egl.cmds, &vbuf, &ebuf, &config);
+    stats->vertices = vbuf.needed / sizeof(struct wlay_egl_vertex);
+    stats->elements = ebuf.needed / sizeof(nk_draw_index);
+    double converted = monotonic_time();
+
+    glBindVertexArray(egl.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, egl.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, egl.ebo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vbuf.needed, egl.vertices);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, ebuf.needed, egl.elements);
+    double uploaded = monotonic_time();
+
+    GLfloat ortho[4][4] = {
+        {2.0f / WINDOW_WIDTH, 0.0f, 0.0f, 0.0f},
+        {0.0f, -2.0f / WINDOW_HEIGHT, 0.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f, 0.0f},
+        {-1.0f, 1.0f, 0.0f, 1.0f},
+    };
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(egl.prog);
+    glUniform1i(egl.uniform_tex, 0);
+    glUniformMatrix4fv(egl.uniform_proj, 1, GL_FALSE, &ortho[0][0]);
+
+    const struct nk_draw_command *cmd;
+    const nk_draw_index *offset = NULL;
+    stats->draw_calls = 0;
+    nk_draw_foreach(cmd, &egl.ctx, &egl.cmds) {
+        if (!cmd->elem_count) {
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, (GLuint)cmd->texture.id);
+        glScissor((GLint)cmd->clip_rect.x,
+                  (GLint)(WINDOW_HEIGHT - (cmd->clip_rect.y + cmd->clip_rect.h)),
+                  (GLint)cmd->clip_rect.w, (GLint)cmd->clip_rect.h);
+        glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT, offset);
+        offset += cmd->elem_count;
+        stats->draw_calls++;
+    }
+    glDisable(GL_SCISSOR_TEST);
+    // There is no swap to wait on, make the driver actually do the work
+    glFinish();
+    nk_clear(&egl.ctx);
+    double drawn = monotonic_time();
+
+    stats->convert = converted - start;
+    stats->upload = uploaded - converted;
+    stats->draw = drawn - uploaded;
+}
+
+
+static void wlay_egl_get_size(struct wlay_state *wlay, int *width, int *height)
+{
+    *width = WINDOW_WIDTH;
+    *height = WINDOW_HEIGHT;
+}
+
+
+void wlay_egl_set_input(void (*input)(struct nk_context *ctx, void *data), void *data)
+{
+    egl.input = input;
+    egl.input_data = data;
+}
+
+
+const struct wlay_egl_stats *wlay_egl_stats(void)
+{
+    return &egl.stats;
+}
+
+
+const struct wlay_backend wlay_backend_egl = {
+    .name = "egl",
+    .init = wlay_egl_init,
+    .destroy = wlay_egl_destroy,
+    .should_close = wlay_egl_should_close,
+    .new_frame = wlay_egl_new_frame,
+    .render = wlay_egl_render,
+    .get_size = wlay_egl_get_size,
+};
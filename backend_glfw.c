@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <epoxy/gl.h>
+#include <epoxy/glx.h>
+
+#include <GLFW/glfw3.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "wlay_nuklear.h"
+#include "backend.h"
+
+#define NK_GLFW_GL3_IMPLEMENTATION
+#include "nuklear_glfw_gl3.h"
+
+#define MAX_VERTEX_BUFFER 512 * 1024
+#define MAX_ELEMENT_BUFFER 128 * 1024
+// Latencies kept per drag for the percentiles
+#define DRAG_LATENCY_SAMPLES 4096
+
+static GLFWwindow *window;
+
+// Frame pacing and what it costs while dragging. Input events are
+// timestamped when glfwPollEvents() hands them to us, see
+// nk_glfw3_motion_time().
+static struct {
+    // Cursor event the frame being built shows, 0 if the cursor did not
+    // move since the last frame
+    double frame_input;
+    GLsync fences[WLAY_MAX_RENDER_AHEAD + 1];
+    int fence_count;
+
+    bool dragging;
+    uint64_t drag_frames;
+    size_t sample_count;
+    double samples[DRAG_LATENCY_SAMPLES];
+} present;
+
+
+static void error_callback(int e, const char *d)
+{
+    printf("Error %d: %s\n", e, d);
+}
+
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static void wlay_glfw_drag_report(void)
+{
+    size_t n = present.sample_count;
+    if (n == 0) {
+        return;
+    }
+    qsort(present.samples, n, sizeof(*present.samples), compare_double);
+    log_info("Drag of %llu frames, input to swap p50 %.2f ms, p90 %.2f ms, "
+             "p99 %.2f ms, max %.2f ms",
+             (unsigned long long)present.drag_frames,
+             present.samples[n / 2] * 1e3, present.samples[(n * 9) / 10] * 1e3,
+             present.samples[(n * 99) / 100] * 1e3, present.samples[n - 1] * 1e3);
+}
+
+
+static struct nk_context *wlay_glfw_init(struct wlay_state *wlay)
+{
+    int width = 0, height = 0;
+
+    /* GLFW */
+    glfwSetErrorCallback(error_callback);
+    if (!glfwInit()) {
+        fail("GLFW failed to initialize");
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_ALPHA_BITS, 0);
+    glfwWindowHint(GLFW_FOCUSED, GL_FALSE);
+    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "wlay", NULL, NULL);
+    glfwMakeContextCurrent(window);
+    glfwGetWindowSize(window, &width, &height);
+    // Drivers differ in what they default to
+    glfwSwapInterval(wlay->present.swap_interval);
+
+    /* OpenGL */
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    struct nk_context *ctx = nk_glfw3_init(window, NK_GLFW3_INSTALL_CALLBACKS);
+    /* Load Fonts: if none of these are loaded a default font will be used  */
+    /* Load Cursor: if you uncomment cursor loading please hide the cursor */
+    struct nk_font_atlas *atlas;
+    nk_glfw3_font_stash_begin(&atlas);
+    nk_glfw3_font_stash_end();
+    return ctx;
+}
+
+
+static void wlay_glfw_destroy(struct wlay_state *wlay)
+{
+    for (int i = 0; i < present.fence_count; i++) {
+        glDeleteSync(present.fences[i]);
+    }
+    nk_glfw3_shutdown();
+    glfwTerminate();
+}
+
+
+static bool wlay_glfw_should_close(struct wlay_state *wlay)
+{
+    return glfwWindowShouldClose(window);
+}
+
+
+static void wlay_glfw_new_frame(struct wlay_state *wlay)
+{
+    glfwPollEvents();
+    nk_glfw3_new_frame();
+    present.frame_input = nk_glfw3_motion_time();
+}
+
+
+static void wlay_glfw_sample_input(struct wlay_state *wlay)
+{
+    // Whatever the model and the control socket took since new_frame
+    // would otherwise add to the latency of the drag
+    if (!wlay->present.late_input || wlay->drag_head == NULL) {
+        return;
+    }
+    glfwPollEvents();
+    if (nk_glfw3_late_motion()) {
+        present.frame_input = nk_glfw3_motion_time();
+    }
+}
+
+
+// Keeps the GPU at most render_ahead frames behind, so that input is not
+// sampled long before it is drawn
+static void wlay_glfw_limit_render_ahead(int render_ahead)
+{
+    if (render_ahead < 0) {
+        return;
+    }
+    present.fences[present.fence_count++] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    while (present.fence_count > render_ahead) {
+        glClientWaitSync(present.fences[0], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(present.fences[0]);
+        present.fence_count--;
+        memmove(present.fences, present.fences + 1,
+                present.fence_count * sizeof(present.fences[0]));
+    }
+}
+
+
+static void wlay_glfw_render(struct wlay_state *wlay)
+{
+    nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+    glfwSwapBuffers(window);
+    wlay_glfw_limit_render_ahead(wlay->present.render_ahead);
+
+    // Drags are only measured with --low-latency
+    bool dragging = wlay->present.late_input && wlay->drag_head != NULL;
+    if (present.dragging && !dragging) {
+        wlay_glfw_drag_report();
+    }
+    if (dragging && !present.dragging) {
+        present.drag_frames = 0;
+        present.sample_count = 0;
+    }
+    present.dragging = dragging;
+    if (dragging) {
+        present.drag_frames++;
+        if (present.frame_input > 0 && present.sample_count < DRAG_LATENCY_SAMPLES) {
+            present.samples[present.sample_count++] = glfwGetTime() - present.frame_input;
+        }
+    }
+}
+
+
+static void wlay_glfw_get_size(struct wlay_state *wlay, int *width, int *height)
+{
+    glfwGetWindowSize(window, width, height);
+}
+
+
+static void wlay_glfw_image_upload(struct wlay_state *wlay, struct nk_image *image,
+                                   const uint32_t *pixels, int width, int height)
+{
+    GLuint texture = image->handle.id;
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // 0xAARRGGBB words are B, G, R, A bytes in memory
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    *image = nk_image_id((int)texture);
+    image->w = width;
+    image->h = height;
+}
+
+
+static void wlay_glfw_image_destroy(struct wlay_state *wlay, struct nk_image *image)
+{
+    GLuint texture = image->handle.id;
+    glDeleteTextures(1, &texture);
+    memset(image, 0, sizeof(*image));
+}
+
+
+static bool wlay_glfw_visible(struct wlay_state *wlay)
+{
+    return glfwGetWindowAttrib(window, GLFW_VISIBLE) &&
+        !glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+}
+
+
+const struct wlay_backend wlay_backend_glfw = {
+    .name = "gl",
+    .init = wlay_glfw_init,
+    .destroy = wlay_glfw_destroy,
+    .should_close = wlay_glfw_should_close,
+    .new_frame = wlay_glfw_new_frame,
+    .sample_input = wlay_glfw_sample_input,
+    .render = wlay_glfw_render,
+    .get_size = wlay_glfw_get_size,
+    .image_upload = wlay_glfw_image_upload,
+    .image_destroy = wlay_glfw_image_destroy,
+    .visible = wlay_glfw_visible,
+};
@@ -0,0 +1,963 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <linux/input-event-codes.h>
+#include <wayland-client.h>
+#include <wayland-cursor.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "wayland-xdg-shell-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_RENDER
+#include "util.h"
+#include "wlay.h"
+#include "backend.h"
+#include "raster.h"
+#include "ipc.h"
+#include "profile.h"
+#include "thumbnail.h"
+
+#define SHM_BUFFER_COUNT 2
+// Input events are queued between frames, anything beyond this is dropped
+#define SHM_EVENT_MAX 256
+// Same window as the GLFW backend, in milliseconds
+#define SHM_DOUBLE_CLICK_LO 20
+#define SHM_DOUBLE_CLICK_HI 200
+#define SHM_CURSOR_SIZE 24
+
+enum wlay_shm_event_type {
+    WLAY_SHM_EVENT_MOTION,
+    WLAY_SHM_EVENT_BUTTON,
+    WLAY_SHM_EVENT_SCROLL,
+    WLAY_SHM_EVENT_UNICODE,
+};
+
+struct wlay_shm_event {
+    enum wlay_shm_event_type type;
+    int x, y;
+    enum nk_buttons button;
+    bool down;
+    struct nk_vec2 scroll;
+    nk_rune unicode;
+};
+
+// Keys nuklear's keystate based input is fed from, see wlay_shm_input_keys()
+enum wlay_shm_key {
+    WLAY_SHM_KEY_DELETE,
+    WLAY_SHM_KEY_ENTER,
+    WLAY_SHM_KEY_TAB,
+    WLAY_SHM_KEY_BACKSPACE,
+    WLAY_SHM_KEY_UP,
+    WLAY_SHM_KEY_DOWN,
+    WLAY_SHM_KEY_LEFT,
+    WLAY_SHM_KEY_RIGHT,
+    WLAY_SHM_KEY_HOME,
+    WLAY_SHM_KEY_END,
+    WLAY_SHM_KEY_PAGE_DOWN,
+    WLAY_SHM_KEY_PAGE_UP,
+    WLAY_SHM_KEY_B,
+    WLAY_SHM_KEY_C,
+    WLAY_SHM_KEY_E,
+    WLAY_SHM_KEY_R,
+    WLAY_SHM_KEY_V,
+    WLAY_SHM_KEY_X,
+    WLAY_SHM_KEY_Z,
+    WLAY_SHM_KEY_COUNT,
+};
+
+static const xkb_keysym_t key_syms[WLAY_SHM_KEY_COUNT] = {
+    [WLAY_SHM_KEY_DELETE] = XKB_KEY_Delete,
+    [WLAY_SHM_KEY_ENTER] = XKB_KEY_Return,
+    [WLAY_SHM_KEY_TAB] = XKB_KEY_Tab,
+    [WLAY_SHM_KEY_BACKSPACE] = XKB_KEY_BackSpace,
+    [WLAY_SHM_KEY_UP] = XKB_KEY_Up,
+    [WLAY_SHM_KEY_DOWN] = XKB_KEY_Down,
+    [WLAY_SHM_KEY_LEFT] = XKB_KEY_Left,
+    [WLAY_SHM_KEY_RIGHT] = XKB_KEY_Right,
+    [WLAY_SHM_KEY_HOME] = XKB_KEY_Home,
+    [WLAY_SHM_KEY_END] = XKB_KEY_End,
+    [WLAY_SHM_KEY_PAGE_DOWN] = XKB_KEY_Page_Down,
+    [WLAY_SHM_KEY_PAGE_UP] = XKB_KEY_Page_Up,
+    [WLAY_SHM_KEY_B] = XKB_KEY_b,
+    [WLAY_SHM_KEY_C] = XKB_KEY_c,
+    [WLAY_SHM_KEY_E] = XKB_KEY_e,
+    [WLAY_SHM_KEY_R] = XKB_KEY_r,
+    [WLAY_SHM_KEY_V] = XKB_KEY_v,
+    [WLAY_SHM_KEY_X] = XKB_KEY_x,
+    [WLAY_SHM_KEY_Z] = XKB_KEY_z,
+};
+
+struct wlay_shm_buffer {
+    struct wl_buffer *buffer;
+    uint32_t *pixels;
+    size_t size;
+    int width, height;
+    bool busy;
+    // Whether the tile hashes describe the contents at all
+    bool valid;
+    // Tile hashes of the frame the buffer holds, see wlay_raster_hash_tiles()
+    uint32_t *tiles;
+};
+
+static struct {
+    struct wlay_state *wlay;
+    struct wl_registry *registry;
+    struct wl_compositor *compositor;
+    struct xdg_wm_base *wm_base;
+    struct wl_seat *seat;
+    struct wl_pointer *pointer;
+    struct wl_keyboard *keyboard;
+
+    struct wl_surface *surface;
+    struct xdg_surface *xdg_surface;
+    struct xdg_toplevel *toplevel;
+    struct wl_callback *frame;
+    bool configured;
+    bool should_close;
+    int width, height;
+
+    struct wlay_shm_buffer buffers[SHM_BUFFER_COUNT];
+    // Buffer last attached to the surface
+    struct wlay_shm_buffer *front;
+    // Tile hashes of the frame being rendered
+    uint32_t *tiles;
+    size_t tile_capacity;
+    // Set when the previous frame changed anything or input arrived, when
+    // neither is the case the next frame waits for events
+    bool redraw;
+
+    struct nk_context ctx;
+    struct nk_font_atlas atlas;
+    uint8_t *atlas_pixels;
+    struct wlay_raster raster;
+
+    struct wlay_shm_event events[SHM_EVENT_MAX];
+    int event_count;
+    struct nk_vec2 pointer_pos;
+    uint32_t last_click;
+    bool keys[WLAY_SHM_KEY_COUNT];
+    // Keys pressed since the last frame, so that a press and release in
+    // between two frames is not lost
+    bool keys_pressed[WLAY_SHM_KEY_COUNT];
+    bool shift, ctrl;
+
+    struct xkb_context *xkb_context;
+    struct xkb_keymap *xkb_keymap;
+    struct xkb_state *xkb_state;
+
+    struct wl_cursor_theme *cursor_theme;
+    struct wl_surface *cursor_surface;
+} shm;
+
+
+static void wlay_shm_queue(struct wlay_shm_event event)
+{
+    if (shm.event_count < SHM_EVENT_MAX) {
+        shm.events[shm.event_count++] = event;
+    }
+    shm.redraw = true;
+}
+
+
+static void handle_buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+    struct wlay_shm_buffer *buffer = data;
+    buffer->busy = false;
+}
+
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = handle_buffer_release,
+};
+
+
+static void wlay_shm_buffer_destroy(struct wlay_shm_buffer *buffer)
+{
+    if (buffer->buffer) {
+        wl_buffer_destroy(buffer->buffer);
+    }
+    if (buffer->pixels) {
+        munmap(buffer->pixels, buffer->size);
+    }
+    xfree(buffer->tiles);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+
+static void wlay_shm_buffer_create(struct wlay_shm_buffer *buffer, int width, int height)
+{
+    const int stride = width * 4;
+    buffer->size = (size_t)stride * height;
+    buffer->width = width;
+    buffer->height = height;
+
+    int fd = memfd_create("wlay-shm", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, buffer->size) < 0) {
+        fail("Failed to allocate a %dx%d shared memory buffer", width, height);
+    }
+    buffer->pixels = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buffer->pixels == MAP_FAILED) {
+        fail("Failed to map a %dx%d shared memory buffer", width, height);
+    }
+    struct wl_shm_pool *pool = wl_shm_create_pool(shm.wlay->wl.shm, fd, buffer->size);
+    buffer->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+                                               WL_SHM_FORMAT_XRGB8888);
+    wl_buffer_add_listener(buffer->buffer, &buffer_listener, buffer);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    const size_t tiles = (size_t)wlay_raster_tile_count(width) * wlay_raster_tile_count(height);
+    buffer->tiles = xmalloc(tiles * sizeof(*buffer->tiles));
+}
+
+
+// Returns a buffer the compositor is not reading from, of the current size
+static struct wlay_shm_buffer *wlay_shm_next_buffer(void)
+{
+    for (;;) {
+        for (int i = 0; i < SHM_BUFFER_COUNT; i++) {
+            struct wlay_shm_buffer *buffer = &shm.buffers[i];
+            if (buffer->busy || buffer == shm.front) {
+                continue;
+            }
+            if (buffer->width != shm.width || buffer->height != shm.height) {
+                wlay_shm_buffer_destroy(buffer);
+                wlay_shm_buffer_create(buffer, shm.width, shm.height);
+            }
+            return buffer;
+        }
+        if (wl_display_dispatch(shm.wlay->wl.display) < 0) {
+            fail("Wayland connection lost");
+        }
+    }
+}
+
+
+static void handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = handle_wm_base_ping,
+};
+
+
+static void handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+                                         uint32_t serial)
+{
+    xdg_surface_ack_configure(xdg_surface, serial);
+    shm.configured = true;
+    shm.redraw = true;
+}
+
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = handle_xdg_surface_configure,
+};
+
+
+static void handle_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+                                      int32_t width, int32_t height,
+                                      struct wl_array *states)
+{
+    // Zero means we get to pick
+    if (width > 0 && height > 0) {
+        shm.width = width;
+        shm.height = height;
+    }
+}
+
+
+static void handle_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+    shm.should_close = true;
+}
+
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+    .configure = handle_toplevel_configure,
+    .close = handle_toplevel_close,
+};
+
+
+static void handle_frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+    wl_callback_destroy(callback);
+    shm.frame = NULL;
+}
+
+
+static const struct wl_callback_listener frame_listener = {
+    .done = handle_frame_done,
+};
+
+
+static void handle_pointer_enter(void *data, struct wl_pointer *pointer,
+                                 uint32_t serial, struct wl_surface *surface,
+                                 wl_fixed_t x, wl_fixed_t y)
+{
+    struct wl_cursor *cursor = NULL;
+    if (shm.cursor_theme) {
+        cursor = wl_cursor_theme_get_cursor(shm.cursor_theme, "left_ptr");
+    }
+    if (cursor && cursor->image_count) {
+        struct wl_cursor_image *image = cursor->images[0];
+        wl_surface_attach(shm.cursor_surface, wl_cursor_image_get_buffer(image), 0, 0);
+        wl_surface_damage_buffer(shm.cursor_surface, 0, 0, image->width, image->height);
+        wl_surface_commit(shm.cursor_surface);
+        wl_pointer_set_cursor(pointer, serial, shm.cursor_surface,
+                              image->hotspot_x, image->hotspot_y);
+    }
+    shm.pointer_pos = nk_vec2(wl_fixed_to_double(x), wl_fixed_to_double(y));
+    wlay_shm_queue((struct wlay_shm_event){
+        .type = WLAY_SHM_EVENT_MOTION,
+        .x = shm.pointer_pos.x, .y = shm.pointer_pos.y,
+    });
+}
+
+
+static void handle_pointer_leave(void *data, struct wl_pointer *pointer,
+                                 uint32_t serial, struct wl_surface *surface)
+{
+}
+
+
+static void handle_pointer_motion(void *data, struct wl_pointer *pointer,
+                                  uint32_t time, wl_fixed_t x, wl_fixed_t y)
+{
+    shm.pointer_pos = nk_vec2(wl_fixed_to_double(x), wl_fixed_to_double(y));
+    wlay_shm_queue((struct wlay_shm_event){
+        .type = WLAY_SHM_EVENT_MOTION,
+        .x = shm.pointer_pos.x, .y = shm.pointer_pos.y,
+    });
+}
+
+
+static void handle_pointer_button(void *data, struct wl_pointer *pointer,
+                                  uint32_t serial, uint32_t time,
+                                  uint32_t button, uint32_t state)
+{
+    struct wlay_shm_event event = {
+        .type = WLAY_SHM_EVENT_BUTTON,
+        .x = shm.pointer_pos.x, .y = shm.pointer_pos.y,
+        .down = state == WL_POINTER_BUTTON_STATE_PRESSED,
+    };
+    switch (button) {
+    case BTN_LEFT:
+        event.button = NK_BUTTON_LEFT;
+        break;
+    case BTN_RIGHT:
+        event.button = NK_BUTTON_RIGHT;
+        break;
+    case BTN_MIDDLE:
+        event.button = NK_BUTTON_MIDDLE;
+        break;
+    default:
+        return;
+    }
+    wlay_shm_queue(event);
+
+    if (event.button != NK_BUTTON_LEFT) {
+        return;
+    }
+    struct wlay_shm_event double_click = event;
+    double_click.button = NK_BUTTON_DOUBLE;
+    if (event.down) {
+        uint32_t dt = time - shm.last_click;
+        shm.last_click = time;
+        if (dt < SHM_DOUBLE_CLICK_LO || dt > SHM_DOUBLE_CLICK_HI) {
+            return;
+        }
+    }
+    wlay_shm_queue(double_click);
+}
+
+
+static void handle_pointer_axis(void *data, struct wl_pointer *pointer,
+                                uint32_t time, uint32_t axis, wl_fixed_t value)
+{
+    // Wayland reports roughly 10 units per wheel step, GLFW (and so
+    // nuklear's defaults) one, with the opposite sign
+    float delta = -wl_fixed_to_double(value) / 10;
+    struct wlay_shm_event event = { .type = WLAY_SHM_EVENT_SCROLL };
+    if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+        event.scroll.y = delta;
+    } else {
+        event.scroll.x = delta;
+    }
+    wlay_shm_queue(event);
+}
+
+
+static const struct wl_pointer_listener pointer_listener = {
+    .enter = handle_pointer_enter,
+    .leave = handle_pointer_leave,
+    .motion = handle_pointer_motion,
+    .button = handle_pointer_button,
+    .axis = handle_pointer_axis,
+};
+
+
+static void handle_keyboard_keymap(void *data, struct wl_keyboard *keyboard,
+                                   uint32_t format, int32_t fd, uint32_t size)
+{
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+        close(fd);
+        return;
+    }
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    struct xkb_keymap *keymap = xkb_keymap_new_from_string(
+        shm.xkb_context, map, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS
+    );
+    munmap(map, size);
+    if (keymap == NULL) {
+        log_info("Failed to compile the keymap");
+        return;
+    }
+    xkb_state_unref(shm.xkb_state);
+    xkb_keymap_unref(shm.xkb_keymap);
+    shm.xkb_keymap = keymap;
+    shm.xkb_state = xkb_state_new(keymap);
+}
+
+
+static void handle_keyboard_enter(void *data, struct wl_keyboard *keyboard,
+                                  uint32_t serial, struct wl_surface *surface,
+                                  struct wl_array *keys)
+{
+}
+
+
+static void handle_keyboard_leave(void *data, struct wl_keyboard *keyboard,
+                                  uint32_t serial, struct wl_surface *surface)
+{
+    memset(shm.keys, 0, sizeof(shm.keys));
+    shm.shift = shm.ctrl = false;
+}
+
+
+static void handle_keyboard_key(void *data, struct wl_keyboard *keyboard,
+                                uint32_t serial, uint32_t time, uint32_t key,
+                                uint32_t state)
+{
+    if (shm.xkb_state == NULL) {
+        return;
+    }
+    const xkb_keycode_t keycode = key + 8;
+    const bool down = state == WL_KEYBOARD_KEY_STATE_PRESSED;
+    const xkb_keysym_t sym = xkb_keysym_to_lower(
+        xkb_state_key_get_one_sym(shm.xkb_state, keycode)
+    );
+    for (int i = 0; i < WLAY_SHM_KEY_COUNT; i++) {
+        if (key_syms[i] == sym) {
+            shm.keys[i] = down;
+            shm.keys_pressed[i] |= down;
+        }
+    }
+    if (down && !shm.ctrl) {
+        uint32_t unicode = xkb_state_key_get_utf32(shm.xkb_state, keycode);
+        if (unicode >= 0x20 && unicode != 0x7f) {
+            wlay_shm_queue((struct wlay_shm_event){
+                .type = WLAY_SHM_EVENT_UNICODE, .unicode = unicode,
+            });
+        }
+    }
+    shm.redraw = true;
+}
+
+
+static void handle_keyboard_modifiers(void *data, struct wl_keyboard *keyboard,
+                                      uint32_t serial, uint32_t depressed,
+                                      uint32_t latched, uint32_t locked,
+                                      uint32_t group)
+{
+    if (shm.xkb_state == NULL) {
+        return;
+    }
+    xkb_state_update_mask(shm.xkb_state, depressed, latched, locked, 0, 0, group);
+    shm.shift = xkb_state_mod_name_is_active(shm.xkb_state, XKB_MOD_NAME_SHIFT,
+                                             XKB_STATE_MODS_EFFECTIVE) > 0;
+    shm.ctrl = xkb_state_mod_name_is_active(shm.xkb_state, XKB_MOD_NAME_CTRL,
+                                            XKB_STATE_MODS_EFFECTIVE) > 0;
+    shm.redraw = true;
+}
+
+
+static void handle_keyboard_repeat_info(void *data, struct wl_keyboard *keyboard,
+                                        int32_t rate, int32_t delay)
+{
+}
+
+
+static const struct wl_keyboard_listener keyboard_listener = {
+    .keymap = handle_keyboard_keymap,
+    .enter = handle_keyboard_enter,
+    .leave = handle_keyboard_leave,
+    .key = handle_keyboard_key,
+    .modifiers = handle_keyboard_modifiers,
+    .repeat_info = handle_keyboard_repeat_info,
+};
+
+
+static void handle_seat_capabilities(void *data, struct wl_seat *seat, uint32_t caps)
+{
+    if ((caps & WL_SEAT_CAPABILITY_POINTER) && shm.pointer == NULL) {
+        shm.pointer = wl_seat_get_pointer(seat);
+        wl_pointer_add_listener(shm.pointer, &pointer_listener, NULL);
+    } else if (!(caps & WL_SEAT_CAPABILITY_POINTER) && shm.pointer) {
+        wl_pointer_destroy(shm.pointer);
+        shm.pointer = NULL;
+    }
+    if ((caps & WL_SEAT_CAPABILITY_KEYBOARD) && shm.keyboard == NULL) {
+        shm.keyboard = wl_seat_get_keyboard(seat);
+        wl_keyboard_add_listener(shm.keyboard, &keyboard_listener, NULL);
+    } else if (!(caps & WL_SEAT_CAPABILITY_KEYBOARD) && shm.keyboard) {
+        wl_keyboard_destroy(shm.keyboard);
+        shm.keyboard = NULL;
+    }
+}
+
+
+static void handle_seat_name(void *data, struct wl_seat *seat, const char *name)
+{
+}
+
+
+static const struct wl_seat_listener seat_listener = {
+    .capabilities = handle_seat_capabilities,
+    .name = handle_seat_name,
+};
+
+
+static void handle_global(void *data, struct wl_registry *registry,
+                          uint32_t name, const char *interface, uint32_t version)
+{
+    if (!strcmp(interface, wl_compositor_interface.name)) {
+        shm.compositor = wl_registry_bind(registry, name, &wl_compositor_interface,
+                                          min(version, 4u));
+    } else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+        shm.wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(shm.wm_base, &wm_base_listener, NULL);
+    } else if (!strcmp(interface, wl_seat_interface.name) && shm.seat == NULL) {
+        // Only the first seat drives the GUI
+        shm.seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+        wl_seat_add_listener(shm.seat, &seat_listener, NULL);
+    }
+}
+
+
+static void handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+}
+
+
+static const struct wl_registry_listener registry_listener = {
+    .global = handle_global,
+    .global_remove = handle_global_remove,
+};
+
+
+static void wlay_shm_font_init(void)
+{
+    int width, height;
+    nk_font_atlas_init(&shm.atlas, wlay_nk_allocator(WLAY_MEM_RENDER));
+    nk_font_atlas_begin(&shm.atlas);
+    const void *pixels = nk_font_atlas_bake(&shm.atlas, &width, &height,
+                                            NK_FONT_ATLAS_ALPHA8);
+    // The baked image is released by nk_font_atlas_end()
+    shm.atlas_pixels = xmalloc((size_t)width * height);
+    memcpy(shm.atlas_pixels, pixels, (size_t)width * height);
+    nk_font_atlas_end(&shm.atlas, nk_handle_ptr(NULL), NULL);
+
+    shm.raster.atlas = shm.atlas_pixels;
+    shm.raster.atlas_width = width;
+    shm.raster.atlas_height = height;
+}
+
+
+static struct nk_context *wlay_shm_init(struct wlay_state *wlay)
+{
+    shm.wlay = wlay;
+    shm.width = WINDOW_WIDTH;
+    shm.height = WINDOW_HEIGHT;
+    if (wlay->wl.shm == NULL) {
+        fail("Compositor does not support wl_shm");
+    }
+
+    shm.registry = wl_display_get_registry(wlay->wl.display);
+    wl_registry_add_listener(shm.registry, &registry_listener, NULL);
+    wl_display_roundtrip(wlay->wl.display);
+    if (shm.compositor == NULL || shm.wm_base == NULL) {
+        fail("Compositor does not support xdg-shell");
+    }
+
+    shm.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    shm.cursor_theme = wl_cursor_theme_load(NULL, SHM_CURSOR_SIZE, wlay->wl.shm);
+    shm.cursor_surface = wl_compositor_create_surface(shm.compositor);
+
+    shm.surface = wl_compositor_create_surface(shm.compositor);
+    shm.xdg_surface = xdg_wm_base_get_xdg_surface(shm.wm_base, shm.surface);
+    xdg_surface_add_listener(shm.xdg_surface, &xdg_surface_listener, NULL);
+    shm.toplevel = xdg_surface_get_toplevel(shm.xdg_surface);
+    xdg_toplevel_add_listener(shm.toplevel, &toplevel_listener, NULL);
+    xdg_toplevel_set_title(shm.toplevel, "wlay");
+    xdg_toplevel_set_app_id(shm.toplevel, "wlay");
+    wl_surface_commit(shm.surface);
+    while (!shm.configured) {
+        if (wl_display_dispatch(wlay->wl.display) < 0) {
+            fail("Wayland connection lost");
+        }
+    }
+
+    wlay_raster_init(&shm.raster);
+    wlay_shm_font_init();
+    nk_init(&shm.ctx, wlay_nk_allocator(WLAY_MEM_GUI), &shm.atlas.default_font->handle);
+    return &shm.ctx;
+}
+
+
+static void wlay_shm_destroy(struct wlay_state *wlay)
+{
+    nk_font_atlas_clear(&shm.atlas);
+    nk_free(&shm.ctx);
+    wlay_raster_finish(&shm.raster);
+    xfree(shm.atlas_pixels);
+    xfree(shm.tiles);
+
+    for (int i = 0; i < SHM_BUFFER_COUNT; i++) {
+        wlay_shm_buffer_destroy(&shm.buffers[i]);
+    }
+    if (shm.frame) {
+        wl_callback_destroy(shm.frame);
+    }
+    xdg_toplevel_destroy(shm.toplevel);
+    xdg_surface_destroy(shm.xdg_surface);
+    wl_surface_destroy(shm.surface);
+
+    if (shm.cursor_theme) {
+        wl_cursor_theme_destroy(shm.cursor_theme);
+    }
+    wl_surface_destroy(shm.cursor_surface);
+    xkb_state_unref(shm.xkb_state);
+    xkb_keymap_unref(shm.xkb_keymap);
+    xkb_context_unref(shm.xkb_context);
+
+    if (shm.pointer) {
+        wl_pointer_destroy(shm.pointer);
+    }
+    if (shm.keyboard) {
+        wl_keyboard_destroy(shm.keyboard);
+    }
+    if (shm.seat) {
+        wl_seat_destroy(shm.seat);
+    }
+    xdg_wm_base_destroy(shm.wm_base);
+    wl_compositor_destroy(shm.compositor);
+    wl_registry_destroy(shm.registry);
+    memset(&shm, 0, sizeof(shm));
+}
+
+
+static bool wlay_shm_should_close(struct wlay_state *wlay)
+{
+    return shm.should_close || wl_display_get_error(wlay->wl.display);
+}
+
+
+static bool wlay_shm_key(enum wlay_shm_key key)
+{
+    return shm.keys[key] || shm.keys_pressed[key];
+}
+
+
+// The same keys nk_glfw_keys maps for the GLFW backend
+static void wlay_shm_input_keys(struct nk_context *ctx)
+{
+    nk_input_key(ctx, NK_KEY_DEL, wlay_shm_key(WLAY_SHM_KEY_DELETE));
+    nk_input_key(ctx, NK_KEY_ENTER, wlay_shm_key(WLAY_SHM_KEY_ENTER));
+    nk_input_key(ctx, NK_KEY_TAB, wlay_shm_key(WLAY_SHM_KEY_TAB));
+    nk_input_key(ctx, NK_KEY_BACKSPACE, wlay_shm_key(WLAY_SHM_KEY_BACKSPACE));
+    nk_input_key(ctx, NK_KEY_UP, wlay_shm_key(WLAY_SHM_KEY_UP));
+    nk_input_key(ctx, NK_KEY_DOWN, wlay_shm_key(WLAY_SHM_KEY_DOWN));
+    nk_input_key(ctx, NK_KEY_TEXT_START, wlay_shm_key(WLAY_SHM_KEY_HOME));
+    nk_input_key(ctx, NK_KEY_TEXT_END, wlay_shm_key(WLAY_SHM_KEY_END));
+    nk_input_key(ctx, NK_KEY_SCROLL_START, wlay_shm_key(WLAY_SHM_KEY_HOME));
+    nk_input_key(ctx, NK_KEY_SCROLL_END, wlay_shm_key(WLAY_SHM_KEY_END));
+    nk_input_key(ctx, NK_KEY_SCROLL_DOWN, wlay_shm_key(WLAY_SHM_KEY_PAGE_DOWN));
+    nk_input_key(ctx, NK_KEY_SCROLL_UP, wlay_shm_key(WLAY_SHM_KEY_PAGE_UP));
+    nk_input_key(ctx, NK_KEY_SHIFT, shm.shift);
+
+    if (shm.ctrl) {
+        nk_input_key(ctx, NK_KEY_COPY, wlay_shm_key(WLAY_SHM_KEY_C));
+        nk_input_key(ctx, NK_KEY_PASTE, wlay_shm_key(WLAY_SHM_KEY_V));
+        nk_input_key(ctx, NK_KEY_CUT, wlay_shm_key(WLAY_SHM_KEY_X));
+        nk_input_key(ctx, NK_KEY_TEXT_UNDO, wlay_shm_key(WLAY_SHM_KEY_Z));
+        nk_input_key(ctx, NK_KEY_TEXT_REDO, wlay_shm_key(WLAY_SHM_KEY_R));
+        nk_input_key(ctx, NK_KEY_TEXT_WORD_LEFT, wlay_shm_key(WLAY_SHM_KEY_LEFT));
+        nk_input_key(ctx, NK_KEY_TEXT_WORD_RIGHT, wlay_shm_key(WLAY_SHM_KEY_RIGHT));
+        nk_input_key(ctx, NK_KEY_TEXT_LINE_START, wlay_shm_key(WLAY_SHM_KEY_B));
+        nk_input_key(ctx, NK_KEY_TEXT_LINE_END, wlay_shm_key(WLAY_SHM_KEY_E));
+    } else {
+        nk_input_key(ctx, NK_KEY_LEFT, wlay_shm_key(WLAY_SHM_KEY_LEFT));
+        nk_input_key(ctx, NK_KEY_RIGHT, wlay_shm_key(WLAY_SHM_KEY_RIGHT));
+        nk_input_key(ctx, NK_KEY_COPY, 0);
+        nk_input_key(ctx, NK_KEY_PASTE, 0);
+        nk_input_key(ctx, NK_KEY_CUT, 0);
+        nk_input_key(ctx, NK_KEY_SHIFT, 0);
+    }
+    memset(shm.keys_pressed, 0, sizeof(shm.keys_pressed));
+}
+
+
+// Like wl_display_dispatch(), but IPC clients and saved layouts are
+// serviced while waiting too. Their requests may change the model, so they
+// always redraw, as does a thumbnail capture becoming due. Compositors hold back the frame
+// callback of a hidden window, captures wait for it.
+static int wlay_shm_wait(struct wlay_state *wlay)
+{
+    struct wl_display *display = wlay->wl.display;
+    int ipc_fd = wlay_ipc_get_fd(wlay->ipc);
+    int profiles_fd = wlay_profiles_get_fd(wlay->profiles);
+    int timeout = shm.frame ? -1 : wlay_thumbnails_timeout(wlay->thumbnails);
+    if (ipc_fd < 0 && profiles_fd < 0 && timeout < 0) {
+        return wl_display_dispatch(display);
+    }
+
+    while (wl_display_prepare_read(display) != 0) {
+        wl_display_dispatch_pending(display);
+    }
+    wl_display_flush(display);
+    struct pollfd fds[] = {
+        { .fd = wl_display_get_fd(display), .events = POLLIN },
+        { .fd = ipc_fd, .events = POLLIN },
+        { .fd = profiles_fd, .events = POLLIN },
+    };
+    int ready = poll(fds, ARRAY_SIZE(fds), timeout);
+    if (ready < 0) {
+        wl_display_cancel_read(display);
+        return 0;
+    }
+    if (ready == 0) {
+        shm.redraw = true;
+    }
+    if (fds[0].revents & POLLIN) {
+        if (wl_display_read_events(display) < 0) {
+            return -1;
+        }
+    } else {
+        wl_display_cancel_read(display);
+    }
+    if (fds[1].revents & POLLIN) {
+        wlay_ipc_dispatch(wlay->ipc);
+        shm.redraw = true;
+    }
+    if (fds[2].revents & POLLIN) {
+        wlay_profiles_dispatch(wlay->profiles);
+        shm.redraw = true;
+    }
+    return wl_display_dispatch_pending(display);
+}
+
+
+static void wlay_shm_new_frame(struct wlay_state *wlay)
+{
+    struct wl_display *display = wlay->wl.display;
+    wl_display_flush(display);
+
+    // Nothing is animated, so when the last frame neither changed anything
+    // nor saw any input, sleep until the compositor has something for us.
+    // Once a frame was committed, wait for the compositor to want the next.
+    bool wait = !shm.redraw;
+    shm.redraw = false;
+    while (!shm.should_close && (wait || shm.frame)) {
+        if (wlay_shm_wait(wlay) < 0) {
+            shm.should_close = true;
+            break;
+        }
+        wait = !shm.redraw;
+    }
+    wl_display_dispatch_pending(display);
+
+    struct nk_context *ctx = &shm.ctx;
+    nk_input_begin(ctx);
+    for (int i = 0; i < shm.event_count; i++) {
+        const struct wlay_shm_event *event = &shm.events[i];
+        switch (event->type) {
+        case WLAY_SHM_EVENT_MOTION:
+            nk_input_motion(ctx, event->x, event->y);
+            break;
+        case WLAY_SHM_EVENT_BUTTON:
+            nk_input_button(ctx, event->button, event->x, event->y, event->down);
+            break;
+        case WLAY_SHM_EVENT_SCROLL:
+            nk_input_scroll(ctx, event->scroll);
+            break;
+        case WLAY_SHM_EVENT_UNICODE:
+            nk_input_unicode(ctx, event->unicode);
+            break;
+        }
+    }
+    shm.event_count = 0;
+    wlay_shm_input_keys(ctx);
+    nk_input_end(ctx);
+}
+
+
+// Calls fn for every horizontal run of tiles whose hashes differ between
+// a and b, or for all of them
+static void wlay_shm_tile_runs(const uint32_t *a, const uint32_t *b, bool all,
+                               void (*fn)(struct wlay_rect))
+{
+    const int columns = wlay_raster_tile_count(shm.width);
+    const int rows = wlay_raster_tile_count(shm.height);
+    for (int ty = 0; ty < rows; ty++) {
+        int tx = 0;
+        while (tx < columns) {
+            const int i = ty * columns + tx;
+            if (!all && a[i] == b[i]) {
+                tx++;
+                continue;
+            }
+            int end = tx + 1;
+            while (end < columns &&
+                    (all || a[ty * columns + end] != b[ty * columns + end])) {
+                end++;
+            }
+            fn((struct wlay_rect){
+                tx * WLAY_RASTER_TILE, ty * WLAY_RASTER_TILE,
+                (end - tx) * WLAY_RASTER_TILE, WLAY_RASTER_TILE,
+            });
+            tx = end;
+        }
+    }
+}
+
+
+static void wlay_shm_repaint(struct wlay_rect rect)
+{
+    const struct nk_color background = shm.ctx.style.window.background;
+    wlay_raster_draw(&shm.raster, &shm.ctx, rect, background);
+}
+
+
+static void wlay_shm_damage(struct wlay_rect rect)
+{
+    wl_surface_damage_buffer(shm.surface, rect.x, rect.y, rect.w, rect.h);
+}
+
+
+static void wlay_shm_render(struct wlay_state *wlay)
+{
+    const size_t tile_count =
+        (size_t)wlay_raster_tile_count(shm.width) * wlay_raster_tile_count(shm.height);
+    if (tile_count > shm.tile_capacity) {
+        shm.tile_capacity = tile_count;
+        shm.tiles = xrealloc(shm.tiles, tile_count * sizeof(*shm.tiles));
+    }
+    wlay_raster_hash_tiles(&shm.ctx, shm.width, shm.height, shm.tiles);
+
+    struct wlay_shm_buffer *front = shm.front;
+    const bool resized = front == NULL ||
+        front->width != shm.width || front->height != shm.height;
+    if (!resized && !memcmp(front->tiles, shm.tiles, tile_count * sizeof(*shm.tiles))) {
+        // Identical to what is on screen already
+        nk_clear(&shm.ctx);
+        return;
+    }
+    shm.redraw = true;
+
+    // Only repaint the tiles this buffer holds stale contents in, a freshly
+    // (re)allocated buffer holds nothing useful at all
+    struct wlay_shm_buffer *buffer = wlay_shm_next_buffer();
+    wlay_raster_target(&shm.raster, buffer->pixels, shm.width, shm.height, shm.width);
+    wlay_shm_tile_runs(buffer->tiles, shm.tiles, !buffer->valid, wlay_shm_repaint);
+    buffer->valid = true;
+    memcpy(buffer->tiles, shm.tiles, tile_count * sizeof(*shm.tiles));
+
+    // The compositor only needs to know what changed since the last commit
+    wlay_shm_tile_runs(resized ? shm.tiles : front->tiles, shm.tiles, resized,
+                       wlay_shm_damage);
+    wl_surface_attach(shm.surface, buffer->buffer, 0, 0);
+    shm.frame = wl_surface_frame(shm.surface);
+    wl_callback_add_listener(shm.frame, &frame_listener, NULL);
+    wl_surface_commit(shm.surface);
+    buffer->busy = true;
+    shm.front = buffer;
+
+    nk_clear(&shm.ctx);
+}
+
+
+static void wlay_shm_get_size(struct wlay_state *wlay, int *width, int *height)
+{
+    *width = shm.width;
+    *height = shm.height;
+}
+
+
+static void wlay_shm_image_upload(struct wlay_state *wlay, struct nk_image *image,
+                                  const uint32_t *pixels, int width, int height)
+{
+    struct wlay_raster_image *raster_image = image->handle.ptr;
+    if (raster_image == NULL) {
+        raster_image = xmalloc(sizeof(*raster_image));
+    }
+    const size_t size = (size_t)width * height * sizeof(*pixels);
+    uint32_t *copy = xrealloc((uint32_t *)raster_image->pixels, size);
+    memcpy(copy, pixels, size);
+    raster_image->pixels = copy;
+    raster_image->width = width;
+    raster_image->height = height;
+    raster_image->stride = width;
+    raster_image->serial++;
+
+    *image = nk_image_ptr(raster_image);
+    image->w = width;
+    image->h = height;
+    // The event loop does not know that anything changed otherwise
+    shm.redraw = true;
+}
+
+
+static void wlay_shm_image_destroy(struct wlay_state *wlay, struct nk_image *image)
+{
+    struct wlay_raster_image *raster_image = image->handle.ptr;
+    if (raster_image) {
+        xfree((uint32_t *)raster_image->pixels);
+        xfree(raster_image);
+    }
+    memset(image, 0, sizeof(*image));
+}
+
+
+// Compositor events are dispatched while waiting, and a new layout or the
+// result of applying one has to show up without any input
+static void wlay_shm_wake(struct wlay_state *wlay)
+{
+    shm.redraw = true;
+}
+
+
+const struct wlay_backend wlay_backend_shm = {
+    .name = "shm",
+    .init = wlay_shm_init,
+    .destroy = wlay_shm_destroy,
+    .should_close = wlay_shm_should_close,
+    .new_frame = wlay_shm_new_frame,
+    .render = wlay_shm_render,
+    .get_size = wlay_shm_get_size,
+    .image_upload = wlay_shm_image_upload,
+    .image_destroy = wlay_shm_image_destroy,
+    .wake = wlay_shm_wake,
+};
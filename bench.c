@@ -0,0 +1,392 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <wayland-client.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "backend.h"
+#include "gui.h"
+
+// Frames per repetition of the input script, see bench_input()
+#define BENCH_SCRIPT_PERIOD 200
+
+enum bench_phase {
+    BENCH_PHASE_GUI,
+    BENCH_PHASE_CONVERT,
+    BENCH_PHASE_UPLOAD,
+    BENCH_PHASE_DRAW,
+    BENCH_PHASE_TOTAL,
+    BENCH_PHASE_COUNT,
+};
+
+static const char *bench_phase_names[] = {
+    [BENCH_PHASE_GUI] = "gui",
+    [BENCH_PHASE_CONVERT] = "convert",
+    [BENCH_PHASE_UPLOAD] = "upload",
+    [BENCH_PHASE_DRAW] = "draw",
+    [BENCH_PHASE_TOTAL] = "total",
+};
+
+struct bench_frame {
+    double time[BENCH_PHASE_COUNT];
+    unsigned int vertices;
+    unsigned int elements;
+    unsigned int draw_calls;
+};
+
+struct bench {
+    struct wlay_state *wlay;
+    int frame;
+    struct nk_vec2 mouse;
+};
+
+static const struct {
+    int32_t width, height, refresh_rate;
+} bench_modes[] = {
+    { 3840, 2160, 60000 },
+    { 2560, 1440, 143912 },
+    { 2560, 1440, 59951 },
+    { 1920, 1080, 144001 },
+    { 1920, 1080, 60000 },
+    { 1920, 1080, 50000 },
+    { 1280, 720, 60000 },
+};
+
+
+static void bench_add_heads(struct wlay_state *wlay, int count)
+{
+    // A grid of outputs, every third one at 1440p, the last one disabled so
+    // that the Enable combo has something in it
+    int columns = (int)ceil(sqrt(count));
+    for (int i = 0; i < count; i++) {
+        struct wlay_head *head = xmalloc(sizeof(*head));
+        head->wlay = wlay;
+        wl_list_init(&head->modes);
+        wl_list_insert(wlay->wl.heads.prev, &head->link);
+        if (asprintf(&head->name, "BENCH-%d", i + 1) < 0 ||
+                asprintf(&head->description, "Synthetic output %d", i + 1) < 0) {
+            fail("Out of memory");
+        }
+        head->physical_width = 600;
+        head->physical_height = 340;
+        head->scale = wl_fixed_from_int(1);
+        head->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+        head->enabled = count == 1 || i != count - 1;
+
+        int current = i % 3 == 2 ? 2 : 4;
+        for (size_t m = 0; m < ARRAY_SIZE(bench_modes); m++) {
+            struct wlay_mode *mode = xmalloc(sizeof(*mode));
+            mode->head = head;
+            mode->width = bench_modes[m].width;
+            mode->height = bench_modes[m].height;
+            mode->refresh_rate = bench_modes[m].refresh_rate;
+            mode->preferred = m == 0;
+            wl_list_insert(head->modes.prev, &mode->link);
+            if ((int)m == current && head->enabled) {
+                head->current_mode = mode;
+            }
+        }
+        head->x = (i % columns) * 2560;
+        head->y = (i / columns) * 1440;
+    }
+    wlay_model_changed(wlay);
+}
+
+
+static void bench_remove_heads(struct wlay_state *wlay)
+{
+    struct wlay_head *head, *tmp_head;
+    wl_list_for_each_safe(head, tmp_head, &wlay->wl.heads, link) {
+        struct wlay_mode *mode, *tmp_mode;
+        wl_list_for_each_safe(mode, tmp_mode, &head->modes, link) {
+            wl_list_remove(&mode->link);
+            xfree(mode);
+        }
+        wl_list_remove(&head->link);
+        // From asprintf()
+        free(head->name);
+        free(head->description);
+        xfree(head->mode_labels);
+        xfree(head->mode_list);
+        wlay_mode_index_finish(&head->mode_index);
+        xfree(head);
+    }
+}
+
+
+static struct nk_vec2 bench_rect_center(struct nk_rect rect)
+{
+    return nk_vec2(rect.x + rect.w/2, rect.y + rect.h/2);
+}
+
+
+// Where the center of the given head is on the editor canvas
+static struct nk_vec2 bench_head_center(struct wlay_state *wlay, struct wlay_head *head)
+{
+    struct nk_rect canvas = wlay->gui->bounds.canvas;
+    float scale = wlay->gui->view.scale;
+    return nk_vec2(
+        canvas.x + canvas.w/2 + (head->x + head->w/2.f - wlay->gui->view.center.x)*scale,
+        canvas.y + canvas.h/2 + (head->y + head->h/2.f - wlay->gui->view.center.y)*scale
+    );
+}
+
+
+static struct wlay_head *bench_pick_head(struct wlay_state *wlay, int n)
+{
+    int enabled = 0;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        enabled += head->enabled;
+    }
+    if (enabled == 0) {
+        return NULL;
+    }
+    n %= enabled;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->enabled && n-- == 0) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+
+static void bench_move(struct bench *b, struct nk_context *ctx, struct nk_vec2 pos)
+{
+    b->mouse = pos;
+    nk_input_motion(ctx, pos.x, pos.y);
+}
+
+
+static void bench_button(struct bench *b, struct nk_context *ctx, bool down)
+{
+    nk_input_button(ctx, NK_BUTTON_LEFT, b->mouse.x, b->mouse.y, down);
+}
+
+
+// Opens the combo box at the given bounds, hovers over its entries and
+// closes it again by clicking the empty corner of the canvas
+static void bench_combo(struct bench *b, struct nk_context *ctx,
+                        struct nk_rect bounds, int step)
+{
+    struct nk_rect canvas = b->wlay->gui->bounds.canvas;
+    if (step == 0) {
+        bench_move(b, ctx, bench_rect_center(bounds));
+    } else if (step == 1 || step == 2) {
+        bench_button(b, ctx, step == 1);
+    } else if (step < 20) {
+        bench_move(b, ctx, nk_vec2(bounds.x + bounds.w/2, bounds.y + bounds.h + 10 + step*6));
+    } else if (step == 20) {
+        bench_move(b, ctx, nk_vec2(canvas.x + 2, canvas.y + 2));
+    } else if (step == 21 || step == 22) {
+        bench_button(b, ctx, step == 21);
+    }
+}
+
+
+// Scripted input: drag a head around, open the mode and Enable combos,
+// zoom in and out and go back to the fitted view
+static void bench_input(struct nk_context *ctx, void *data)
+{
+    struct bench *b = data;
+    struct wlay_state *wlay = b->wlay;
+    int step = b->frame % BENCH_SCRIPT_PERIOD;
+    int cycle = b->frame / BENCH_SCRIPT_PERIOD;
+
+    if (step == 10) {
+        struct wlay_head *head = bench_pick_head(wlay, cycle);
+        if (head != NULL) {
+            bench_move(b, ctx, bench_head_center(wlay, head));
+        }
+    } else if (step == 11) {
+        bench_button(b, ctx, true);
+    } else if (step > 11 && step < 60) {
+        bench_move(b, ctx, nk_vec2(b->mouse.x + 3, b->mouse.y + 1));
+    } else if (step == 60) {
+        bench_button(b, ctx, false);
+    } else if (step >= 70 && step < 100) {
+        bench_combo(b, ctx, wlay->gui->bounds.mode_combo, step - 70);
+    } else if (step >= 100 && step < 130) {
+        bench_combo(b, ctx, wlay->gui->bounds.enable_combo, step - 100);
+    } else if (step == 130) {
+        bench_move(b, ctx, bench_rect_center(wlay->gui->bounds.canvas));
+    } else if (step > 130 && step < 170) {
+        nk_input_scroll(ctx, nk_vec2(0, step < 150 ? 1 : -1));
+    } else if (step == BENCH_SCRIPT_PERIOD - 1) {
+        wlay->gui->view.auto_fit = true;
+    }
+}
+
+
+static int bench_compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+
+static double bench_percentile(const double *sorted, int count, double p)
+{
+    int i = (int)ceil(p * count) - 1;
+    return sorted[min(max(i, 0), count - 1)];
+}
+
+
+static void bench_report(const struct bench_frame *frames, int count, int heads)
+{
+    printf("%d frames, %d heads, %dx%d\n", count, heads, WINDOW_WIDTH, WINDOW_HEIGHT);
+    printf("%-8s %9s %9s %9s %9s %9s  (ms)\n", "phase", "mean", "p50", "p95", "p99", "max");
+    double *sorted = xmalloc(count * sizeof(*sorted));
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        double sum = 0;
+        for (int i = 0; i < count; i++) {
+            sorted[i] = frames[i].time[phase] * 1e3;
+            sum += sorted[i];
+        }
+        qsort(sorted, count, sizeof(*sorted), bench_compare_double);
+        printf("%-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", bench_phase_names[phase],
+               sum / count, bench_percentile(sorted, count, 0.5),
+               bench_percentile(sorted, count, 0.95),
+               bench_percentile(sorted, count, 0.99), sorted[count - 1]);
+    }
+    xfree(sorted);
+
+    unsigned long long vertices = 0, elements = 0, draw_calls = 0;
+    unsigned int max_vertices = 0, max_elements = 0;
+    for (int i = 0; i < count; i++) {
+        vertices += frames[i].vertices;
+        elements += frames[i].elements;
+        draw_calls += frames[i].draw_calls;
+        max_vertices = max(max_vertices, frames[i].vertices);
+        max_elements = max(max_elements, frames[i].elements);
+    }
+    printf("vertices   mean %llu max %u\n", vertices / count, max_vertices);
+    printf("elements   mean %llu max %u\n", elements / count, max_elements);
+    printf("draw calls mean %llu\n", draw_calls / count);
+}
+
+
+static void bench_write_csv(const char *path, const struct bench_frame *frames, int count)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fail("Failed to open %s", path);
+    }
+    fprintf(f, "frame");
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        fprintf(f, ",%s_ms", bench_phase_names[phase]);
+    }
+    fprintf(f, ",vertices,elements,draw_calls\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "%d", i);
+        for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+            fprintf(f, ",%.4f", frames[i].time[phase] * 1e3);
+        }
+        fprintf(f, ",%u,%u,%u\n", frames[i].vertices, frames[i].elements,
+                frames[i].draw_calls);
+    }
+    fclose(f);
+}
+
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--frames N] [--warmup N] [--heads N] [--csv FILE]\n", argv0);
+}
+
+
+int main(int argc, char **argv)
+{
+    int frame_count = 1000;
+    int warmup = 20;
+    int head_count = 8;
+    const char *csv_path = NULL;
+
+    static const struct option options[] = {
+        { "frames", required_argument, NULL, 'n' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "heads", required_argument, NULL, 'H' },
+        { "csv", required_argument, NULL, 'c' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:w:H:c:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            frame_count = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'H':
+            head_count = atoi(optarg);
+            break;
+        case 'c':
+            csv_path = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (frame_count <= 0 || warmup < 0 || head_count <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct wlay_state wlay;
+    memset(&wlay, 0, sizeof(wlay));
+    wlay.backend = &wlay_backend_egl;
+    wl_list_init(&wlay.wl.heads);
+    bench_add_heads(&wlay, head_count);
+    wlay_gui_init(&wlay);
+
+    struct bench b = { .wlay = &wlay };
+    wlay_egl_set_input(bench_input, &b);
+    struct bench_frame *frames = xmalloc(frame_count * sizeof(*frames));
+    for (b.frame = -warmup; b.frame < frame_count; b.frame++) {
+        // Warmup frames get no input, the script starts at frame 0
+        wlay.backend->new_frame(&wlay);
+        double start = monotonic_time();
+        wlay_gui(&wlay);
+        double built = monotonic_time();
+        wlay.backend->render(&wlay);
+        double end = monotonic_time();
+        // Nothing is ever applied
+        wlay.should_apply = false;
+
+        if (b.frame < 0) {
+            continue;
+        }
+        const struct wlay_egl_stats *stats = wlay_egl_stats();
+        struct bench_frame *frame = &frames[b.frame];
+        frame->time[BENCH_PHASE_GUI] = built - start;
+        frame->time[BENCH_PHASE_CONVERT] = stats->convert;
+        frame->time[BENCH_PHASE_UPLOAD] = stats->upload;
+        frame->time[BENCH_PHASE_DRAW] = stats->draw;
+        frame->time[BENCH_PHASE_TOTAL] = end - start;
+        frame->vertices = stats->vertices;
+        frame->elements = stats->elements;
+        frame->draw_calls = stats->draw_calls;
+    }
+
+    bench_report(frames, frame_count, head_count);
+    if (csv_path != NULL) {
+        bench_write_csv(csv_path, frames, frame_count);
+    }
+
+    xfree(frames);
+    wlay_gui_destroy(&wlay);
+    bench_remove_heads(&wlay);
+    return 0;
+}
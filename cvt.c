@@ -0,0 +1,183 @@
+#include <math.h>
+#include <string.h>
+
+#include "util.h"
+#include "cvt.h"
+
+// Constants of the VESA CVT 1.2 standard, times in microseconds
+#define CVT_CELL_GRAN 8
+#define CVT_MIN_V_PORCH 3
+#define CVT_MIN_V_BPORCH 6
+#define CVT_MIN_VSYNC_BP 550.0
+#define CVT_H_SYNC_PERCENT 8
+#define CVT_C_PRIME 30.0
+#define CVT_M_PRIME 300.0
+#define CVT_CLOCK_STEP 250
+
+#define CVT_RB_MIN_V_BLANK 460.0
+#define CVT_RB_H_SYNC 32
+#define CVT_RB_H_BLANK 160
+#define CVT_RB_V_FPORCH 3
+
+#define CVT_RB2_H_BLANK 80
+#define CVT_RB2_H_FPORCH 8
+#define CVT_RB2_VSYNC 8
+#define CVT_RB2_MIN_V_FPORCH 1
+#define CVT_RB2_CLOCK_STEP 1
+
+const char *wlay_cvt_type_names[WLAY_CVT_TYPE_COUNT] = {
+    [WLAY_CVT] = "CVT",
+    [WLAY_CVT_RB] = "CVT-RB",
+    [WLAY_CVT_RB2] = "CVT-RBv2",
+};
+
+
+// The vertical sync width encodes the aspect ratio in CVT v1
+static int32_t cvt_vsync_width(int32_t width, int32_t height)
+{
+    static const struct {
+        int32_t w, h, vsync;
+    } ratios[] = {
+        { 4, 3, 4 },
+        { 16, 9, 5 },
+        { 16, 10, 6 },
+        { 5, 4, 7 },
+        { 15, 9, 7 },
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(ratios); i++) {
+        if (height % ratios[i].h == 0 && height / ratios[i].h * ratios[i].w == width) {
+            return ratios[i].vsync;
+        }
+    }
+    return 10;
+}
+
+
+static void cvt_full_blanking(struct wlay_cvt_timing *timing, double refresh)
+{
+    int32_t vsync = cvt_vsync_width(timing->hdisplay, timing->vdisplay);
+    double h_period = (1e6 / refresh - CVT_MIN_VSYNC_BP) /
+        (timing->vdisplay + CVT_MIN_V_PORCH);
+
+    int32_t vsync_bp = CVT_MIN_VSYNC_BP / h_period + 1;
+    vsync_bp = max(vsync_bp, vsync + CVT_MIN_V_BPORCH);
+    timing->vsync_start = timing->vdisplay + CVT_MIN_V_PORCH;
+    timing->vsync_end = timing->vsync_start + vsync;
+    timing->vtotal = timing->vdisplay + vsync_bp + CVT_MIN_V_PORCH;
+
+    double duty_cycle = max(CVT_C_PRIME - CVT_M_PRIME * h_period / 1000.0, 20.0);
+    int32_t hblank = timing->hdisplay * duty_cycle / (100.0 - duty_cycle);
+    hblank -= hblank % (2 * CVT_CELL_GRAN);
+    timing->htotal = timing->hdisplay + hblank;
+    int32_t hsync = timing->htotal * CVT_H_SYNC_PERCENT / 100;
+    hsync -= hsync % CVT_CELL_GRAN;
+    timing->hsync_end = timing->hdisplay + hblank / 2;
+    timing->hsync_start = timing->hsync_end - hsync;
+
+    timing->pixel_clock = timing->htotal * 1000.0 / h_period;
+    timing->pixel_clock -= timing->pixel_clock % CVT_CLOCK_STEP;
+    timing->hsync_positive = false;
+    timing->vsync_positive = true;
+}
+
+
+static void cvt_reduced_blanking(struct wlay_cvt_timing *timing, double refresh)
+{
+    int32_t vsync = cvt_vsync_width(timing->hdisplay, timing->vdisplay);
+    double h_period = (1e6 / refresh - CVT_RB_MIN_V_BLANK) / timing->vdisplay;
+
+    int32_t vblank = CVT_RB_MIN_V_BLANK / h_period + 1;
+    vblank = max(vblank, CVT_RB_V_FPORCH + vsync + CVT_MIN_V_BPORCH);
+    timing->vsync_start = timing->vdisplay + CVT_RB_V_FPORCH;
+    timing->vsync_end = timing->vsync_start + vsync;
+    timing->vtotal = timing->vdisplay + vblank;
+
+    timing->htotal = timing->hdisplay + CVT_RB_H_BLANK;
+    timing->hsync_end = timing->hdisplay + CVT_RB_H_BLANK / 2;
+    timing->hsync_start = timing->hsync_end - CVT_RB_H_SYNC;
+
+    timing->pixel_clock = refresh * timing->htotal * timing->vtotal / 1000.0;
+    timing->pixel_clock -= timing->pixel_clock % CVT_CLOCK_STEP;
+    timing->hsync_positive = true;
+    timing->vsync_positive = false;
+}
+
+
+static void cvt_reduced_blanking_v2(struct wlay_cvt_timing *timing, double refresh)
+{
+    double h_period = (1e6 / refresh - CVT_RB_MIN_V_BLANK) / timing->vdisplay;
+
+    int32_t vblank = ceil(CVT_RB_MIN_V_BLANK / h_period);
+    vblank = max(vblank, CVT_RB2_MIN_V_FPORCH + CVT_RB2_VSYNC + CVT_MIN_V_BPORCH);
+    // The back porch is fixed, the front porch takes the rest
+    timing->vtotal = timing->vdisplay + vblank;
+    timing->vsync_end = timing->vtotal - CVT_MIN_V_BPORCH;
+    timing->vsync_start = timing->vsync_end - CVT_RB2_VSYNC;
+
+    timing->htotal = timing->hdisplay + CVT_RB2_H_BLANK;
+    timing->hsync_start = timing->hdisplay + CVT_RB2_H_FPORCH;
+    timing->hsync_end = timing->hsync_start + CVT_RB_H_SYNC;
+
+    timing->pixel_clock = refresh * timing->htotal * timing->vtotal / 1000.0;
+    timing->pixel_clock -= timing->pixel_clock % CVT_RB2_CLOCK_STEP;
+    timing->hsync_positive = true;
+    timing->vsync_positive = false;
+}
+
+
+bool wlay_cvt_compute(enum wlay_cvt_type type, int32_t width, int32_t height,
+                      double refresh, struct wlay_cvt_timing *timing)
+{
+    memset(timing, 0, sizeof(*timing));
+    // The vertical blanking alone takes about 0.5 ms, which caps the refresh rate
+    if (width < CVT_CELL_GRAN || height <= 0 || refresh < 1 || refresh > 1000) {
+        return false;
+    }
+    timing->hdisplay = width;
+    timing->vdisplay = height;
+    switch (type) {
+    case WLAY_CVT:
+        // CVT v1 needs whole character cells
+        timing->hdisplay -= width % CVT_CELL_GRAN;
+        cvt_full_blanking(timing, refresh);
+        break;
+    case WLAY_CVT_RB:
+        timing->hdisplay -= width % CVT_CELL_GRAN;
+        cvt_reduced_blanking(timing, refresh);
+        break;
+    case WLAY_CVT_RB2:
+    default:
+        cvt_reduced_blanking_v2(timing, refresh);
+        break;
+    }
+    if (timing->pixel_clock <= 0) {
+        return false;
+    }
+    timing->refresh_rate = round(timing->pixel_clock * 1e6 /
+                                 ((double)timing->htotal * timing->vtotal));
+    timing->data_rate = timing->pixel_clock * 1e3 * 24;
+    return true;
+}
+
+
+const char *wlay_cvt_link(double data_rate)
+{
+    // Effective data rates after line coding, without DSC
+    static const struct {
+        const char *name;
+        double rate;
+    } links[] = {
+        { "HDMI 1.4", 8.16e9 },
+        { "HDMI 2.0", 14.4e9 },
+        { "DP 1.2", 17.28e9 },
+        { "DP 1.4", 25.92e9 },
+        { "HDMI 2.1", 42.67e9 },
+        { "DP 2.0", 77.37e9 },
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+        if (data_rate <= links[i].rate) {
+            return links[i].name;
+        }
+    }
+    return NULL;
+}
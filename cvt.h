@@ -0,0 +1,49 @@
+#ifndef WLAY_CVT_H
+#define WLAY_CVT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// VESA Coordinated Video Timings, as used for custom modes
+enum wlay_cvt_type {
+    // Full blanking, for CRTs and old scalers
+    WLAY_CVT,
+    // Reduced blanking v1
+    WLAY_CVT_RB,
+    // Reduced blanking v2, the smallest blanking and the finest clock step
+    WLAY_CVT_RB2,
+    WLAY_CVT_TYPE_COUNT,
+};
+
+extern const char *wlay_cvt_type_names[WLAY_CVT_TYPE_COUNT];
+
+struct wlay_cvt_timing {
+    int32_t hdisplay;
+    int32_t hsync_start;
+    int32_t hsync_end;
+    int32_t htotal;
+    int32_t vdisplay;
+    int32_t vsync_start;
+    int32_t vsync_end;
+    int32_t vtotal;
+    bool hsync_positive;
+    bool vsync_positive;
+
+    // In kHz
+    int32_t pixel_clock;
+    // The refresh rate the pixel clock actually gives, in mHz
+    int32_t refresh_rate;
+    // Bits per second at 8 bits per channel
+    double data_rate;
+};
+
+// Computes the timing of a width x height mode at refresh Hz, returns false
+// if there is none (zero size, refresh out of range)
+bool wlay_cvt_compute(enum wlay_cvt_type type, int32_t width, int32_t height,
+                      double refresh, struct wlay_cvt_timing *timing);
+
+// The slowest common display link that can carry the data rate, NULL if
+// none of them can
+const char *wlay_cvt_link(double data_rate);
+
+#endif
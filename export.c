@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_EXPORT
+#include "util.h"
+#include "wlay.h"
+#include "json.h"
+#include "export.h"
+#include "snapshot.h"
+
+const char *wlay_output_transform_names[WLAY_TRANSFORM_COUNT] = {
+	[WL_OUTPUT_TRANSFORM_NORMAL] = "normal",
+	[WL_OUTPUT_TRANSFORM_90] = "90",
+	[WL_OUTPUT_TRANSFORM_180] = "180",
+	[WL_OUTPUT_TRANSFORM_270] = "270",
+	[WL_OUTPUT_TRANSFORM_FLIPPED] = "flipped",
+	[WL_OUTPUT_TRANSFORM_FLIPPED_90] = "flipped-90",
+	[WL_OUTPUT_TRANSFORM_FLIPPED_180] = "flipped-180",
+	[WL_OUTPUT_TRANSFORM_FLIPPED_270] = "flipped-270",
+};
+
+const char *wlay_config_type_names[WLAY_CONFIG_TYPE_COUNT] = {
+    [WLAY_CONFIG_SWAY] = "sway",
+    [WLAY_CONFIG_WLRRANDR] = "wlr-randr",
+    [WLAY_CONFIG_KANSHI] = "kanshi",
+    [WLAY_CONFIG_JSON] = "json",
+    [WLAY_CONFIG_WLRRANDR_SH] = "wlr-randr.sh",
+};
+
+
+void wlay_head_refresh_identifier(struct wlay_head *head)
+{
+    if (head->make != NULL && head->model != NULL) {
+        snprintf(head->identifier, sizeof(head->identifier), "%s %s %s",
+                 head->make, head->model,
+                 head->serial_number ? head->serial_number : "Unknown");
+    } else {
+        head->identifier[0] = '\0';
+    }
+}
+
+
+// The make, model and serial number survive moving the output to another
+// connector, the name does not
+static const char *wlay_head_identifier(const struct wlay_snapshot_head *head)
+{
+    return head->identifier[0] ? head->identifier : head->name;
+}
+
+
+struct wlay_export_layout *wlay_export_layout_create(struct wlay_snapshot *snapshot)
+{
+    struct wlay_export_layout *layout = xmalloc(sizeof(*layout) +
+                                                snapshot->count * sizeof(layout->outputs[0]));
+    layout->snapshot = wlay_snapshot_ref(snapshot);
+    layout->count = snapshot->count;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const struct wlay_snapshot_head *head = snapshot->heads[i];
+        struct wlay_export_output *output = &layout->outputs[i];
+        output->name = head->name;
+        output->identifier = wlay_head_identifier(head);
+        output->enabled = head->enabled;
+        if (head->custom) {
+            output->has_mode = output->custom = true;
+            output->width = head->custom_timing.hdisplay;
+            output->height = head->custom_timing.vdisplay;
+            output->refresh_rate = head->custom_timing.refresh_rate;
+            output->timing = &head->custom_timing;
+        } else if (head->mode != NULL) {
+            output->has_mode = true;
+            output->width = head->mode->width;
+            output->height = head->mode->height;
+            output->refresh_rate = head->mode->refresh_rate;
+        }
+        output->x = head->x;
+        output->y = head->y;
+        output->transform = wlay_output_transform_names[head->transform];
+        output->scale = head->scale;
+        output->adaptive_sync_supported = head->adaptive_sync_supported;
+        output->adaptive_sync = head->adaptive_sync;
+    }
+    return layout;
+}
+
+
+void wlay_export_layout_destroy(struct wlay_export_layout *layout)
+{
+    if (layout != NULL) {
+        wlay_snapshot_unref(layout->snapshot);
+        xfree(layout);
+    }
+}
+
+
+static void wlay_save_config_sway(const struct wlay_export_layout *layout, FILE *f)
+{
+    for (size_t i = 0; i < layout->count; i++) {
+        const struct wlay_export_output *output = &layout->outputs[i];
+        fprintf(f, "output \"%s\" {\n", output->identifier);
+        if (output->enabled) {
+            if (output->custom) {
+                // The exact timing, sway would recompute it with full blanking
+                const struct wlay_cvt_timing *t = output->timing;
+                fprintf(f, "\tmodeline %.3f %d %d %d %d %d %d %d %d %chsync %cvsync\n",
+                        t->pixel_clock / 1000.0,
+                        t->hdisplay, t->hsync_start, t->hsync_end, t->htotal,
+                        t->vdisplay, t->vsync_start, t->vsync_end, t->vtotal,
+                        t->hsync_positive ? '+' : '-', t->vsync_positive ? '+' : '-');
+            } else if (output->has_mode) {
+                char refresh[16];
+                wlay_refresh_format(refresh, sizeof(refresh), output->refresh_rate);
+                fprintf(f, "\tmode %dx%d@%sHz\n", output->width, output->height, refresh);
+            }
+            fprintf(f, "\tpos %d %d\n", output->x, output->y);
+            fprintf(f, "\ttransform %s\n", output->transform);
+            if (output->adaptive_sync_supported) {
+                fprintf(f, "\tadaptive_sync %s\n", output->adaptive_sync ? "on" : "off");
+            }
+        } else {
+            fprintf(f, "\tdisable\n");
+        }
+        fprintf(f, "}\n");
+    }
+}
+
+
+// Writes s as a single word for sh, quoted if it has to be
+static void wlay_shell_quote(FILE *f, const char *s)
+{
+    if (*s != '\0' && s[strspn(s, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                                  "0123456789-_.,:/@%+=")] == '\0') {
+        fputs(s, f);
+        return;
+    }
+    fputc('\'', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '\'') {
+            fputs("'\\''", f);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('\'', f);
+}
+
+
+static void wlay_save_config_wlrrandr_args(const struct wlay_export_layout *layout, FILE *f,
+                                           bool quote)
+{
+    for (size_t i = 0; i < layout->count; i++) {
+        const struct wlay_export_output *output = &layout->outputs[i];
+        fprintf(f, "\t--output ");
+        if (quote) {
+            wlay_shell_quote(f, output->name);
+            fputc(' ', f);
+        } else {
+            fprintf(f, "%s ", output->name);
+        }
+        if (output->enabled) {
+            if (output->custom) {
+                fprintf(f, "--custom-mode %dx%d@%.3fHz ",
+                        output->width, output->height, output->refresh_rate / 1000.0);
+            } else if (output->has_mode) {
+                char refresh[16];
+                wlay_refresh_format(refresh, sizeof(refresh), output->refresh_rate);
+                fprintf(f, "--mode %dx%d@%sHz ", output->width, output->height, refresh);
+            }
+            fprintf(f, "--pos %d,%d ", output->x, output->y);
+            fprintf(f, "--transform %s ", output->transform);
+            if (output->adaptive_sync_supported) {
+                fprintf(f, "--adaptive-sync %s ",
+                        output->adaptive_sync ? "enabled" : "disabled");
+            }
+        } else {
+            fprintf(f, "--off ");
+        }
+        if (i + 1 < layout->count) {
+            fprintf(f, "\\");
+        }
+        fprintf(f, "\n");
+    }
+}
+
+
+static void wlay_save_config_wlrrandr(const struct wlay_export_layout *layout, FILE *f)
+{
+    fprintf(f, "wlr-randr \\\n");
+    wlay_save_config_wlrrandr_args(layout, f, false);
+}
+
+
+static void wlay_save_config_wlrrandr_sh(const struct wlay_export_layout *layout, FILE *f)
+{
+    fprintf(f, "#!/bin/sh\nexec wlr-randr \\\n");
+    wlay_save_config_wlrrandr_args(layout, f, true);
+}
+
+
+static void wlay_save_config_kanshi(const struct wlay_export_layout *layout, FILE *f)
+{
+    fprintf(f, "{\n");
+    for (size_t i = 0; i < layout->count; i++) {
+        const struct wlay_export_output *output = &layout->outputs[i];
+        if (output->enabled) {
+            fprintf(f, "\toutput \"%s\"", output->identifier);
+            if (output->custom) {
+                fprintf(f, " mode --custom %dx%d@%.3fHz",
+                        output->width, output->height, output->refresh_rate / 1000.0);
+            } else if (output->has_mode) {
+                char refresh[16];
+                wlay_refresh_format(refresh, sizeof(refresh), output->refresh_rate);
+                fprintf(f, " mode %dx%d@%sHz", output->width, output->height, refresh);
+            }
+            fprintf(f, " position %d,%d transform %s", output->x, output->y, output->transform);
+            if (output->adaptive_sync_supported) {
+                fprintf(f, " adaptive_sync %s", output->adaptive_sync ? "on" : "off");
+            }
+            fprintf(f, "\n");
+        } else {
+            fprintf(f, "\toutput \"%s\" disable\n", output->identifier);
+        }
+    }
+    fprintf(f, "}\n");
+}
+
+
+static void wlay_save_config_json(const struct wlay_export_layout *layout, FILE *f)
+{
+    struct wlay_buffer buffer = { 0 };
+    wlay_buffer_append(&buffer, "[", 1);
+    for (size_t i = 0; i < layout->count; i++) {
+        const struct wlay_export_output *output = &layout->outputs[i];
+        if (i > 0) {
+            wlay_buffer_append(&buffer, ",", 1);
+        }
+        wlay_buffer_append(&buffer, "{\"name\":", 8);
+        wlay_json_string(&buffer, output->name);
+        wlay_buffer_append(&buffer, ",\"identifier\":", 14);
+        wlay_json_string(&buffer, output->identifier);
+        wlay_buffer_printf(&buffer, ",\"enabled\":%s", output->enabled ? "true" : "false");
+        if (output->enabled) {
+            if (output->has_mode) {
+                wlay_buffer_printf(&buffer, ",\"mode\":{\"width\":%d,\"height\":%d,"
+                                   "\"refresh\":%.3f,\"custom\":%s}",
+                                   output->width, output->height,
+                                   output->refresh_rate / 1000.0,
+                                   output->custom ? "true" : "false");
+            }
+            wlay_buffer_printf(&buffer, ",\"x\":%d,\"y\":%d,\"transform\":\"%s\",\"scale\":%.3f",
+                               output->x, output->y, output->transform,
+                               wl_fixed_to_double(output->scale));
+            if (output->adaptive_sync_supported) {
+                wlay_buffer_printf(&buffer, ",\"adaptive_sync\":%s",
+                                   output->adaptive_sync ? "true" : "false");
+            }
+        }
+        wlay_buffer_append(&buffer, "}", 1);
+    }
+    wlay_buffer_append(&buffer, "]\n", 2);
+    fwrite(buffer.data, 1, buffer.size, f);
+    wlay_buffer_finish(&buffer);
+}
+
+
+void wlay_export_layout(const struct wlay_export_layout *layout,
+                        const struct wlay_export_target *targets, size_t count)
+{
+    static void (*emitters[WLAY_CONFIG_TYPE_COUNT])(const struct wlay_export_layout *, FILE *) = {
+        [WLAY_CONFIG_SWAY] = wlay_save_config_sway,
+        [WLAY_CONFIG_WLRRANDR] = wlay_save_config_wlrrandr,
+        [WLAY_CONFIG_KANSHI] = wlay_save_config_kanshi,
+        [WLAY_CONFIG_JSON] = wlay_save_config_json,
+        [WLAY_CONFIG_WLRRANDR_SH] = wlay_save_config_wlrrandr_sh,
+    };
+    for (size_t i = 0; i < count; i++) {
+        emitters[targets[i].type](layout, targets[i].f);
+    }
+}
+
+
+void wlay_export_snapshot(struct wlay_snapshot *snapshot, enum wlay_config_type type, FILE *f)
+{
+    struct wlay_export_layout *layout = wlay_export_layout_create(snapshot);
+    wlay_export_layout(layout, &(struct wlay_export_target){ .type = type, .f = f }, 1);
+    wlay_export_layout_destroy(layout);
+}
+
+
+void wlay_export(struct wlay_state *wlay, enum wlay_config_type type, FILE *f)
+{
+    wlay_export_snapshot(wlay_snapshot_update(wlay), type, f);
+}
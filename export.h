@@ -0,0 +1,71 @@
+#ifndef WLAY_EXPORT_H
+#define WLAY_EXPORT_H
+
+#include <stdio.h>
+
+#include "wlay.h"
+
+struct wlay_snapshot;
+
+#define WLAY_TRANSFORM_COUNT (WL_OUTPUT_TRANSFORM_FLIPPED_270 + 1)
+
+// Transform names as sway, kanshi and wlr-randr spell them
+extern const char *wlay_output_transform_names[WLAY_TRANSFORM_COUNT];
+extern const char *wlay_config_type_names[WLAY_CONFIG_TYPE_COUNT];
+
+// An output as every config type describes it, resolved from the snapshot
+// once however many configs are written from it
+struct wlay_export_output {
+    const char *name;
+    // The make, model and serial number or the name, whichever survives
+    // moving the output to another connector
+    const char *identifier;
+    bool enabled;
+    // Without a mode the config leaves it to the compositor
+    bool has_mode;
+    bool custom;
+    int32_t width;
+    int32_t height;
+    // mHz
+    int32_t refresh_rate;
+    // Only for custom modes
+    const struct wlay_cvt_timing *timing;
+    int32_t x;
+    int32_t y;
+    const char *transform;
+    wl_fixed_t scale;
+    bool adaptive_sync_supported;
+    bool adaptive_sync;
+};
+
+// Immutable like the snapshot it holds on to, may be written on any thread
+// and by several threads at once
+struct wlay_export_layout {
+    struct wlay_snapshot *snapshot;
+    // In the order the compositor announced them
+    size_t count;
+    struct wlay_export_output outputs[];
+};
+
+struct wlay_export_target {
+    enum wlay_config_type type;
+    FILE *f;
+};
+
+// Takes a reference to the snapshot
+struct wlay_export_layout *wlay_export_layout_create(struct wlay_snapshot *snapshot);
+void wlay_export_layout_destroy(struct wlay_export_layout *layout);
+// Writes the layout once for every target
+void wlay_export_layout(const struct wlay_export_layout *layout,
+                        const struct wlay_export_target *targets, size_t count);
+
+// How sway and kanshi identify the output regardless of the connector,
+// from the make, model and serial number
+void wlay_head_refresh_identifier(struct wlay_head *head);
+// Writes the layout as a config of that type, outputs in the order the
+// compositor announced them. The snapshot may be written on any thread.
+void wlay_export_snapshot(struct wlay_snapshot *snapshot, enum wlay_config_type type, FILE *f);
+// The same for the model as it is now
+void wlay_export(struct wlay_state *wlay, enum wlay_config_type type, FILE *f);
+
+#endif
@@ -0,0 +1,670 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_CONTROL
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "ipc.h"
+#include "json.h"
+#include "snapshot.h"
+#include "fleet.h"
+
+#define FLEET_MAX_EVENTS 64
+// Longest command line, longer ones are answered with an error
+#define FLEET_MAX_LINE (64 * 1024)
+
+enum fleet_command {
+    FLEET_COMMAND_LIST,
+    FLEET_COMMAND_ADD,
+    FLEET_COMMAND_GET,
+    FLEET_COMMAND_SET,
+    FLEET_COMMAND_TEST,
+    FLEET_COMMAND_APPLY,
+    FLEET_COMMAND_EXPORT,
+    FLEET_COMMAND_COUNT,
+};
+
+static const char *fleet_command_names[FLEET_COMMAND_COUNT] = {
+    [FLEET_COMMAND_LIST] = "list",
+    [FLEET_COMMAND_ADD] = "add",
+    [FLEET_COMMAND_GET] = "get",
+    [FLEET_COMMAND_SET] = "set",
+    [FLEET_COMMAND_TEST] = "test",
+    [FLEET_COMMAND_APPLY] = "apply",
+    [FLEET_COMMAND_EXPORT] = "export",
+};
+
+struct fleet_display {
+    struct wlay_fleet *fleet;
+    char *name;
+    bool connected;
+    // Output model of this display alone, without a GUI
+    struct wlay_state wlay;
+
+    // Addressed by the command being run, its result goes into result
+    bool targeted;
+    struct wlay_buffer result;
+    struct zwlr_output_configuration_v1 *config;
+
+    struct wl_list link;
+};
+
+struct wlay_fleet {
+    struct wl_list displays;
+    int epoll_fd;
+
+    // Input not yet a whole line. stdin is not polled when it is a regular
+    // file, which epoll refuses but never blocks either.
+    struct wlay_buffer in;
+    bool in_polled;
+    bool in_eof;
+
+    // The command being answered, a test or apply is answered once no
+    // compositor is pending any more
+    enum fleet_command command;
+    bool waiting;
+    int pending;
+    struct wlay_buffer out;
+};
+
+
+__attribute__((format(printf, 2, 3)))
+static bool fleet_error(struct wlay_buffer *out, const char *format, ...)
+{
+    char message[256];
+    va_list vas;
+    va_start(vas, format);
+    vsnprintf(message, sizeof(message), format, vas);
+    va_end(vas);
+    wlay_buffer_append(out, "{\"ok\":false,\"error\":", 20);
+    wlay_json_string(out, message);
+    wlay_buffer_append(out, "}", 1);
+    return false;
+}
+
+
+static void fleet_write(struct wlay_buffer *line)
+{
+    wlay_buffer_append(line, "\n", 1);
+    fwrite(line->data, 1, line->size, stdout);
+    fflush(stdout);
+    line->size = 0;
+}
+
+
+static void fleet_display_lost(struct fleet_display *display)
+{
+    struct wlay_fleet *fleet = display->fleet;
+    log_info("Lost the connection to %s", display->name);
+    epoll_ctl(fleet->epoll_fd, EPOLL_CTL_DEL,
+              wl_display_get_fd(display->wlay.wl.display), NULL);
+    if (display->config) {
+        zwlr_output_configuration_v1_destroy(display->config);
+        display->config = NULL;
+        fleet_error(&display->result, "Connection lost");
+        fleet->pending--;
+    }
+    wlay_wayland_disconnect(&display->wlay);
+    display->connected = false;
+
+    struct wlay_buffer event = { 0 };
+    wlay_buffer_append(&event, "{\"event\":\"disconnected\",\"display\":", 34);
+    wlay_json_string(&event, display->name);
+    wlay_buffer_append(&event, "}", 1);
+    fleet_write(&event);
+    wlay_buffer_finish(&event);
+}
+
+
+static bool fleet_display_connect(struct fleet_display *display)
+{
+    struct wlay_fleet *fleet = display->fleet;
+    memset(&display->wlay, 0, sizeof(display->wlay));
+    if (!wlay_wayland_connect(&display->wlay, display->name)) {
+        return false;
+    }
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = display,
+    };
+    epoll_ctl(fleet->epoll_fd, EPOLL_CTL_ADD,
+              wl_display_get_fd(display->wlay.wl.display), &event);
+    display->connected = true;
+    return true;
+}
+
+
+static struct fleet_display *fleet_find(struct wlay_fleet *fleet, const char *name)
+{
+    struct fleet_display *display;
+    wl_list_for_each(display, &fleet->displays, link) {
+        if (!strcmp(display->name, name)) {
+            return display;
+        }
+    }
+    return NULL;
+}
+
+
+// Adds a display, or every wayland socket in a directory, and reconnects
+// displays that were lost. Those are targeted with their result, returns
+// how many there were.
+static int fleet_add(struct wlay_fleet *fleet, const char *name)
+{
+    struct stat st;
+    if (stat(name, &st) == 0 && S_ISDIR(st.st_mode)) {
+        char pattern[PATH_MAX];
+        snprintf(pattern, sizeof(pattern), "%s/wayland-*", name);
+        glob_t paths;
+        int count = 0;
+        if (glob(pattern, 0, NULL, &paths) == 0) {
+            for (size_t i = 0; i < paths.gl_pathc; i++) {
+                const char *path = paths.gl_pathv[i];
+                // Skips the lock files next to the sockets
+                if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                    count += fleet_add(fleet, path);
+                }
+            }
+        }
+        globfree(&paths);
+        return count;
+    }
+
+    struct fleet_display *display = fleet_find(fleet, name);
+    if (display != NULL && display->connected) {
+        return 0;
+    }
+    if (display == NULL) {
+        display = xmalloc(sizeof(*display));
+        display->fleet = fleet;
+        display->name = xstrdup(name);
+        wl_list_insert(fleet->displays.prev, &display->link);
+    }
+    display->targeted = true;
+    display->result.size = 0;
+    if (fleet_display_connect(display)) {
+        wlay_buffer_append(&display->result, "{\"ok\":true}", 11);
+    } else {
+        fleet_error(&display->result, "Connection failed");
+    }
+    return 1;
+}
+
+
+static void fleet_display_destroy(struct fleet_display *display)
+{
+    if (display->config) {
+        zwlr_output_configuration_v1_destroy(display->config);
+    }
+    if (display->connected) {
+        wlay_wayland_disconnect(&display->wlay);
+    }
+    wl_list_remove(&display->link);
+    wlay_buffer_finish(&display->result);
+    xfree(display->name);
+    xfree(display);
+}
+
+
+// Marks the displays named in args, all of them without any. False with
+// the error in out if one is unknown.
+static bool fleet_select(struct wlay_fleet *fleet, char *args, struct wlay_buffer *out)
+{
+    struct fleet_display *display;
+    wl_list_for_each(display, &fleet->displays, link) {
+        display->targeted = *args == '\0';
+        display->result.size = 0;
+    }
+    char *save;
+    for (char *name = strtok_r(args, " \t", &save); name != NULL;
+            name = strtok_r(NULL, " \t", &save)) {
+        display = fleet_find(fleet, name);
+        if (display == NULL) {
+            return fleet_error(out, "No display %s", name);
+        }
+        display->targeted = true;
+    }
+    return true;
+}
+
+
+// The response to the current command, from the results of the displays
+// it addressed
+static void fleet_respond(struct wlay_fleet *fleet)
+{
+    struct wlay_buffer *out = &fleet->out;
+    bool ok = true;
+    wlay_buffer_printf(out, "{\"command\":\"%s\",\"results\":{",
+                       fleet_command_names[fleet->command]);
+    bool first = true;
+    struct fleet_display *display;
+    wl_list_for_each(display, &fleet->displays, link) {
+        if (!display->targeted) {
+            continue;
+        }
+        if (!first) {
+            wlay_buffer_append(out, ",", 1);
+        }
+        first = false;
+        wlay_json_string(out, display->name);
+        wlay_buffer_append(out, ":", 1);
+        wlay_buffer_append(out, display->result.data, display->result.size);
+        // Every result is an object that starts with its verdict
+        ok &= display->result.size > 6 && !strncmp(display->result.data, "{\"ok\":t", 7);
+    }
+    wlay_buffer_printf(out, "},\"ok\":%s}", ok ? "true" : "false");
+    fleet_write(out);
+}
+
+
+static void fleet_config_result(struct fleet_display *display, const char *result, bool ok)
+{
+    struct wlay_fleet *fleet = display->fleet;
+    zwlr_output_configuration_v1_destroy(display->config);
+    display->config = NULL;
+    wlay_buffer_printf(&display->result, "{\"ok\":%s,\"result\":\"%s\"}",
+                       ok ? "true" : "false", result);
+    fleet->pending--;
+}
+
+
+static void handle_config_succeeded(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    fleet_config_result(data, "succeeded", true);
+}
+
+
+static void handle_config_failed(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    fleet_config_result(data, "failed", false);
+}
+
+
+static void handle_config_cancelled(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    fleet_config_result(data, "cancelled", false);
+}
+
+
+static const struct zwlr_output_configuration_v1_listener fleet_config_listener = {
+    .succeeded = handle_config_succeeded,
+    .failed = handle_config_failed,
+    .cancelled = handle_config_cancelled,
+};
+
+
+static void fleet_configure(struct fleet_display *display, bool apply)
+{
+    struct wlay_state *wlay = &display->wlay;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->enabled && head->current_mode == NULL &&
+                !(head->custom_mode.enabled && head->custom_mode.valid)) {
+            fleet_error(&display->result, "%s is enabled without a mode", head->name);
+            return;
+        }
+    }
+    display->config = wlay_create_configuration(wlay);
+    zwlr_output_configuration_v1_add_listener(display->config, &fleet_config_listener,
+                                              display);
+    if (apply) {
+        zwlr_output_configuration_v1_apply(display->config);
+    } else {
+        zwlr_output_configuration_v1_test(display->config);
+    }
+    wl_display_flush(wlay->wl.display);
+    display->fleet->pending++;
+}
+
+
+// Writes every type in types from one layout of the display
+static void fleet_export(struct fleet_display *display, unsigned types, const char *dir)
+{
+    const char *base = strrchr(display->name, '/');
+    base = base ? base + 1 : display->name;
+    struct wlay_export_target targets[WLAY_CONFIG_TYPE_COUNT];
+    char paths[WLAY_CONFIG_TYPE_COUNT][PATH_MAX];
+    size_t count = 0;
+    for (enum wlay_config_type type = 0; type < WLAY_CONFIG_TYPE_COUNT; type++) {
+        if (!(types & 1u << type)) {
+            continue;
+        }
+        snprintf(paths[count], sizeof(paths[count]), "%s/%s.%s", dir, base,
+                 wlay_config_type_names[type]);
+        targets[count].type = type;
+        targets[count].f = fopen(paths[count], "w");
+        if (targets[count].f == NULL) {
+            fleet_error(&display->result, "Can not write %s: %s", paths[count], strerror(errno));
+            for (size_t i = 0; i < count; i++) {
+                fclose(targets[i].f);
+            }
+            return;
+        }
+        count++;
+    }
+
+    struct wlay_export_layout *layout =
+        wlay_export_layout_create(wlay_snapshot_update(&display->wlay));
+    wlay_export_layout(layout, targets, count);
+    wlay_export_layout_destroy(layout);
+
+    const char *failed = NULL;
+    int error = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (fclose(targets[i].f) != 0 && failed == NULL) {
+            failed = paths[i];
+            error = errno;
+        }
+    }
+    if (failed != NULL) {
+        fleet_error(&display->result, "Can not write %s: %s", failed, strerror(error));
+        return;
+    }
+    if (count == 1) {
+        wlay_buffer_append(&display->result, "{\"ok\":true,\"path\":", 18);
+        wlay_json_string(&display->result, paths[0]);
+        wlay_buffer_append(&display->result, "}", 1);
+        return;
+    }
+    wlay_buffer_append(&display->result, "{\"ok\":true,\"paths\":[", 20);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            wlay_buffer_append(&display->result, ",", 1);
+        }
+        wlay_json_string(&display->result, paths[i]);
+    }
+    wlay_buffer_append(&display->result, "]}", 2);
+}
+
+
+// A comma separated list of config types or all of them, 0 if one of
+// them is unknown
+static unsigned fleet_parse_types(char *list)
+{
+    if (!strcmp(list, "all")) {
+        return (1u << WLAY_CONFIG_TYPE_COUNT) - 1;
+    }
+    unsigned types = 0;
+    char *save;
+    for (char *name = strtok_r(list, ",", &save); name != NULL;
+            name = strtok_r(NULL, ",", &save)) {
+        enum wlay_config_type type;
+        for (type = 0; type < WLAY_CONFIG_TYPE_COUNT; type++) {
+            if (!strcmp(name, wlay_config_type_names[type])) {
+                break;
+            }
+        }
+        if (type == WLAY_CONFIG_TYPE_COUNT) {
+            return 0;
+        }
+        types |= 1u << type;
+    }
+    return types;
+}
+
+
+// Runs the command for every display it addresses, false if it could not
+// be run at all
+static bool fleet_execute(struct wlay_fleet *fleet, enum fleet_command command, char *args)
+{
+    struct wlay_buffer *out = &fleet->out;
+    struct fleet_display *display;
+
+    if (command == FLEET_COMMAND_ADD) {
+        wl_list_for_each(display, &fleet->displays, link) {
+            display->targeted = false;
+        }
+        char *save;
+        for (char *name = strtok_r(args, " \t", &save); name != NULL;
+                name = strtok_r(NULL, " \t", &save)) {
+            if (fleet_add(fleet, name) == 0) {
+                return fleet_error(out, "Nothing new to add at %s", name);
+            }
+        }
+        return true;
+    }
+
+    unsigned types = 0;
+    char *dir = NULL;
+    if (command == FLEET_COMMAND_SET || command == FLEET_COMMAND_EXPORT) {
+        // The leading arguments are not display names
+        char *save;
+        char *first = strtok_r(args, " \t", &save);
+        char *second = command == FLEET_COMMAND_EXPORT ? strtok_r(NULL, " \t", &save) : NULL;
+        if (first == NULL || (command == FLEET_COMMAND_EXPORT && second == NULL)) {
+            return fleet_error(out, "%s needs more arguments", fleet_command_names[command]);
+        }
+        if (command == FLEET_COMMAND_SET) {
+            display = fleet_find(fleet, first);
+            if (display == NULL) {
+                return fleet_error(out, "No display %s", first);
+            }
+            wl_list_for_each(display, &fleet->displays, link) {
+                display->targeted = !strcmp(display->name, first);
+                display->result.size = 0;
+            }
+            // What follows is the control socket's set command
+            args = save ? save : "";
+        } else {
+            types = fleet_parse_types(first);
+            if (types == 0) {
+                return fleet_error(out, "Unknown config type in %s", first);
+            }
+            dir = second;
+            args = save ? save : "";
+        }
+    }
+    if (command != FLEET_COMMAND_SET && !fleet_select(fleet, args, out)) {
+        return false;
+    }
+
+    wl_list_for_each(display, &fleet->displays, link) {
+        if (!display->targeted) {
+            continue;
+        }
+        struct wlay_buffer *result = &display->result;
+        if (command == FLEET_COMMAND_LIST) {
+            wlay_buffer_printf(result, "{\"ok\":true,\"connected\":%s",
+                               display->connected ? "true" : "false");
+            if (display->connected) {
+                wlay_buffer_printf(result, ",\"serial\":%u,\"heads\":%d",
+                                   display->wlay.serial,
+                                   wl_list_length(&display->wlay.wl.heads));
+            }
+            wlay_buffer_append(result, "}", 1);
+            continue;
+        }
+        if (!display->connected) {
+            fleet_error(result, "Not connected");
+            continue;
+        }
+        switch (command) {
+        case FLEET_COMMAND_GET:
+            wlay_buffer_printf(result, "{\"ok\":true,\"serial\":%u,\"heads\":",
+                               display->wlay.serial);
+            wlay_json_heads(result, &display->wlay);
+            wlay_buffer_append(result, "}", 1);
+            break;
+        case FLEET_COMMAND_SET:
+            wlay_ipc_set(&display->wlay, args, result);
+            break;
+        case FLEET_COMMAND_TEST:
+        case FLEET_COMMAND_APPLY:
+            fleet_configure(display, command == FLEET_COMMAND_APPLY);
+            break;
+        case FLEET_COMMAND_EXPORT:
+            fleet_export(display, types, dir);
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+
+static void fleet_run_line(struct wlay_fleet *fleet, char *line)
+{
+    line += strspn(line, " \t");
+    if (*line == '\0') {
+        return;
+    }
+    size_t length = strcspn(line, " \t");
+    char *args = line + length;
+    args += strspn(args, " \t");
+    // Trailing blanks are no display names
+    for (size_t end = strlen(args); end > 0 && strchr(" \t\r", args[end - 1]); end--) {
+        args[end - 1] = '\0';
+    }
+
+    int command;
+    for (command = 0; command < FLEET_COMMAND_COUNT; command++) {
+        if (strlen(fleet_command_names[command]) == length &&
+                !strncmp(line, fleet_command_names[command], length)) {
+            break;
+        }
+    }
+    if (command == FLEET_COMMAND_COUNT) {
+        line[length] = '\0';
+        fleet_error(&fleet->out, "Unknown command %s", line);
+        fleet_write(&fleet->out);
+        return;
+    }
+    fleet->command = command;
+    if (!fleet_execute(fleet, command, args)) {
+        fleet_write(&fleet->out);
+    } else if (fleet->pending == 0) {
+        fleet_respond(fleet);
+    } else {
+        fleet->waiting = true;
+    }
+}
+
+
+// Runs whole lines of input for as long as no command is pending
+static void fleet_run_input(struct wlay_fleet *fleet)
+{
+    size_t start = 0;
+    while (fleet->pending == 0 && start < fleet->in.size) {
+        char *line = fleet->in.data + start;
+        char *end = memchr(line, '\n', fleet->in.size - start);
+        if (end == NULL) {
+            break;
+        }
+        *end = '\0';
+        start = end + 1 - fleet->in.data;
+        fleet_run_line(fleet, line);
+    }
+    wlay_buffer_consume(&fleet->in, start);
+    if (fleet->in.size > FLEET_MAX_LINE) {
+        fleet_error(&fleet->out, "Line too long");
+        fleet_write(&fleet->out);
+        fleet->in.size = 0;
+    }
+}
+
+
+static void fleet_read_input(struct wlay_fleet *fleet)
+{
+    wlay_buffer_reserve(&fleet->in, 4096);
+    ssize_t size = read(STDIN_FILENO, fleet->in.data + fleet->in.size,
+                        fleet->in.capacity - fleet->in.size);
+    if (size > 0) {
+        fleet->in.size += size;
+        return;
+    }
+    if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (fleet->in_polled) {
+        epoll_ctl(fleet->epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+    }
+    // A last line without a newline still counts
+    if (fleet->in.size > 0 && fleet->in.data[fleet->in.size - 1] != '\n') {
+        wlay_buffer_append(&fleet->in, "\n", 1);
+    }
+    fleet->in_eof = true;
+}
+
+
+static void fleet_dispatch(struct fleet_display *display, uint32_t events)
+{
+    // Only this display is read, however many others there are
+    struct wl_display *wl_display = display->wlay.wl.display;
+    if (wl_display_dispatch(wl_display) < 0) {
+        fleet_display_lost(display);
+        return;
+    }
+    wl_display_flush(wl_display);
+}
+
+
+int wlay_fleet_run(char **displays, int count)
+{
+    struct wlay_fleet fleet = { 0 };
+    wl_list_init(&fleet.displays);
+    fleet.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fleet.epoll_fd < 0) {
+        fail("epoll_create1 failed: %s", strerror(errno));
+    }
+    struct epoll_event input = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    fleet.in_polled = epoll_ctl(fleet.epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &input) == 0;
+
+    for (int i = 0; i < count; i++) {
+        if (fleet_add(&fleet, displays[i]) == 0) {
+            log_info("No displays at %s", displays[i]);
+        }
+    }
+
+    struct epoll_event events[FLEET_MAX_EVENTS];
+    for (;;) {
+        fleet_run_input(&fleet);
+        if (fleet.in_eof && fleet.pending == 0) {
+            break;
+        }
+        // Unpolled input is read between waits, which must not block then
+        bool read_input = !fleet.in_polled && !fleet.in_eof && fleet.pending == 0;
+        int n = epoll_wait(fleet.epoll_fd, events, FLEET_MAX_EVENTS, read_input ? 0 : -1);
+        if (n < 0 && errno != EINTR) {
+            fail("epoll_wait failed: %s", strerror(errno));
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                fleet_read_input(&fleet);
+            } else {
+                fleet_dispatch(events[i].data.ptr, events[i].events);
+            }
+        }
+        if (read_input) {
+            fleet_read_input(&fleet);
+        }
+        if (fleet.waiting && fleet.pending == 0) {
+            fleet.waiting = false;
+            fleet_respond(&fleet);
+        }
+    }
+
+    struct fleet_display *display, *tmp;
+    wl_list_for_each_safe(display, tmp, &fleet.displays, link) {
+        fleet_display_destroy(display);
+    }
+    close(fleet.epoll_fd);
+    wlay_buffer_finish(&fleet.in);
+    wlay_buffer_finish(&fleet.out);
+    return EXIT_SUCCESS;
+}
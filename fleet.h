@@ -0,0 +1,29 @@
+#ifndef WLAY_FLEET_H
+#define WLAY_FLEET_H
+
+// Headless mode managing the outputs of many compositors at once, such as
+// a rig of headless test instances. Every display gets its own model, all
+// of them are served from one epoll loop.
+//
+// Commands are read from stdin, one per line. Every command is answered
+// with one JSON line on stdout holding the result of every display it
+// addressed, DISPLAY... defaults to all of them:
+//
+//   list                        the displays, connected or not
+//   add DISPLAY..               connects to more displays
+//   get [DISPLAY..]             the head and mode model
+//   set DISPLAY NAME KEY=VALUE  changes a head as the control socket does
+//   test, apply [DISPLAY..]     answered once every compositor did
+//   export TYPE DIR [DISPLAY..] writes DIR/DISPLAY.TYPE, TYPE being sway,
+//                               wlr-randr, kanshi, json, wlr-randr.sh, a
+//                               comma separated list of them or all
+//
+// Commands are run one at a time, a test or apply holds back the next one
+// until it is answered. Displays that go away are announced as an event
+// line.
+
+// Displays are socket names or paths, a directory stands for every
+// wayland-* socket in it. Runs until stdin ends, returns the exit code.
+int wlay_fleet_run(char **displays, int count);
+
+#endif
@@ -0,0 +1,973 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_GUI
+#include "util.h"
+#include "wlay.h"
+#include "backend.h"
+#include "gui.h"
+#include "export.h"
+#include "layout.h"
+#include "journal.h"
+#include "profile.h"
+
+#define SNAP_THRESHOLD 200
+
+// Vertical space left below the editor canvas for the controls
+#define EDITOR_CONTROLS_HEIGHT 280
+// Heads smaller than this (in pixels) are drawn as a plain rectangle
+#define EDITOR_LOD_MIN_SIZE 4
+
+void wlay_gui_init(struct wlay_state *wlay)
+{
+    struct wlay_gui *gui = xmalloc(sizeof(*gui));
+    gui->arrange_constraints.keep_order = true;
+    gui->arrange_solved = gui->arrange_constraints;
+    gui->view.scale = 1./10;
+    gui->view.auto_fit = true;
+    strncpy(gui->file_path, "/tmp/config.txt", sizeof(gui->file_path));
+    wlay->gui = gui;
+    wlay->nk = wlay->backend->init(wlay);
+}
+
+
+void wlay_gui_destroy(struct wlay_state *wlay)
+{
+    struct wlay_gui *gui = wlay->gui;
+    wlay->backend->destroy(wlay);
+    xfree(gui->mode_filter.matches);
+    xfree(gui->enable_filter.matches);
+    xfree(gui->disabled_names);
+    xfree(gui->disabled_heads);
+    xfree(gui->rects);
+    xfree(gui->rect_heads);
+    xfree(gui->prev_rects);
+    xfree(gui->prev_rect_heads);
+    xfree(gui->arrange_items);
+    wlay_validation_finish(&gui->validation);
+    wlay_arrange_finish(&gui->arrange);
+    xfree(gui);
+    wlay->gui = NULL;
+}
+
+
+static void wlay_head_enable(struct wlay_head *head)
+{
+    log_info("Enabling %s", head->name);
+    struct wlay_mode *mode = wlay_head_best_mode(head, &head->wlay->mode_policy);
+    if (mode == NULL) {
+        log_info("No mode available for %s", head->name);
+        return;
+    }
+    head->current_mode = mode;
+    head->enabled = true;
+    head->scale = wl_fixed_from_int(1);
+    wlay_model_changed(head->wlay);
+}
+
+
+static void wlay_head_disable(struct wlay_head *head)
+{
+    log_info("Disabling %s", head->name);
+    head->enabled = false;
+    head->focused = false;
+    head->current_mode = NULL;
+    if (head->wlay->focused == head) {
+        head->wlay->focused = NULL;
+    }
+    wlay_model_changed(head->wlay);
+}
+
+
+static void wlay_gui_focus(struct wlay_state *wlay, struct wlay_head *focused)
+{
+    if (wlay->focused == focused) {
+        return;
+    }
+    if (wlay->focused != NULL) {
+        wlay->focused->focused = false;
+    }
+    if (focused != NULL) {
+        focused->focused = true;
+    }
+    wlay->focused = focused;
+}
+
+
+static void wlay_gui_refresh_head(struct wlay_head *head)
+{
+    struct nk_context *ctx = head->wlay->nk;
+    const struct nk_user_font *font = ctx->style.font;
+
+    snprintf(head->header, sizeof(head->header), "Output %s \"%s\"",
+             head->name, head->description);
+    wlay_head_refresh_identifier(head);
+    head->name_width = head->name == NULL ? 0 :
+        font->width(font->userdata, font->height, head->name, strlen(head->name));
+
+    // Duplicates are labeled too, one of them may be current
+    struct wlay_mode *mode;
+    wl_list_for_each(mode, &head->modes, link) {
+        char refresh[16];
+        wlay_refresh_format(refresh, sizeof(refresh), mode->refresh_rate);
+        snprintf(mode->label, sizeof(mode->label), "%dx%d@%sHz",
+                 mode->width, mode->height, refresh);
+    }
+    const struct wlay_mode_index *index = wlay_head_mode_index(head);
+    if (index->count > head->mode_capacity) {
+        head->mode_capacity = index->count * 2;
+        head->mode_labels = xrealloc(head->mode_labels, head->mode_capacity * sizeof(*head->mode_labels));
+        head->mode_list = xrealloc(head->mode_list, head->mode_capacity * sizeof(*head->mode_list));
+    }
+    for (int i = 0; i < index->count; i++) {
+        head->mode_labels[i] = index->modes[i]->label;
+        head->mode_list[i] = index->modes[i];
+    }
+    head->mode_count = index->count;
+}
+
+
+static void wlay_gui_refresh(struct wlay_state *wlay)
+{
+    if (wlay->gui->generation == wlay->generation) {
+        return;
+    }
+    wlay->gui->generation = wlay->generation;
+
+    wlay->gui->head_count = wl_list_length(&wlay->wl.heads);
+    if (wlay->gui->head_count > wlay->gui->disabled_capacity) {
+        wlay->gui->disabled_capacity = wlay->gui->head_count * 2;
+        wlay->gui->disabled_names = xrealloc(
+            wlay->gui->disabled_names,
+            wlay->gui->disabled_capacity * sizeof(*wlay->gui->disabled_names)
+        );
+        wlay->gui->disabled_heads = xrealloc(
+            wlay->gui->disabled_heads,
+            wlay->gui->disabled_capacity * sizeof(*wlay->gui->disabled_heads)
+        );
+    }
+
+    wlay->gui->disabled_count = 0;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        wlay_gui_refresh_head(head);
+        if (!head->enabled) {
+            // Heads may not have announced a name yet
+            wlay->gui->disabled_names[wlay->gui->disabled_count] = head->name ? head->name : "";
+            wlay->gui->disabled_heads[wlay->gui->disabled_count] = head;
+            wlay->gui->disabled_count++;
+        }
+    }
+}
+
+
+static struct nk_rect wlay_gui_editor_rect(struct wlay_state *wlay,
+                                          struct nk_rect canvas_bounds,
+                                          int32_t x, int32_t y,
+                                          int32_t w, int32_t h)
+{
+    // Maps screen space onto the editor canvas
+    float scale = wlay->gui->view.scale;
+    return nk_rect(
+        canvas_bounds.x + canvas_bounds.w/2 + (x - wlay->gui->view.center.x)*scale,
+        canvas_bounds.y + canvas_bounds.h/2 + (y - wlay->gui->view.center.y)*scale,
+        w*scale,
+        h*scale
+    );
+}
+
+
+static void wlay_gui_editor_view(struct wlay_state *wlay, struct nk_rect canvas_bounds,
+                                 bool interactive)
+{
+    struct nk_input *in = &wlay->nk->input;
+    struct nk_vec2 canvas_center = nk_vec2(
+        canvas_bounds.x + canvas_bounds.w/2, canvas_bounds.y + canvas_bounds.h/2
+    );
+    const float min_scale = 1./1000;
+    const float max_scale = 1;
+
+    if (interactive && nk_input_is_mouse_hovering_rect(in, canvas_bounds)) {
+        float wheel = in->mouse.scroll_delta.y;
+        if (wheel != 0) {
+            // Zoom around the cursor, the point under it stays in place
+            float scale = wlay->gui->view.scale;
+            float new_scale = min(max(scale * powf(1.1, wheel), min_scale), max_scale);
+            struct nk_vec2 offset = nk_vec2(
+                in->mouse.pos.x - canvas_center.x, in->mouse.pos.y - canvas_center.y
+            );
+            wlay->gui->view.center.x += offset.x/scale - offset.x/new_scale;
+            wlay->gui->view.center.y += offset.y/scale - offset.y/new_scale;
+            wlay->gui->view.scale = new_scale;
+            wlay->gui->view.auto_fit = false;
+            in->mouse.scroll_delta = nk_vec2(0, 0);
+        }
+    }
+    if (interactive &&
+            (nk_input_has_mouse_click_down_in_rect(in, NK_BUTTON_MIDDLE, canvas_bounds, nk_true) ||
+             nk_input_has_mouse_click_down_in_rect(in, NK_BUTTON_RIGHT, canvas_bounds, nk_true))) {
+        wlay->gui->view.center.x -= in->mouse.delta.x/wlay->gui->view.scale;
+        wlay->gui->view.center.y -= in->mouse.delta.y/wlay->gui->view.scale;
+        wlay->gui->view.auto_fit = false;
+    }
+
+    if (wlay->gui->view.auto_fit && wlay->gui->screen_size.x > 0 && wlay->gui->screen_size.y > 0) {
+        const float margin = 0.9;
+        wlay->gui->view.scale = min(max(margin * min(
+            canvas_bounds.w / wlay->gui->screen_size.x,
+            canvas_bounds.h / wlay->gui->screen_size.y
+        ), min_scale), max_scale);
+        wlay->gui->view.center = nk_vec2(
+            wlay->gui->screen_size.x/2, wlay->gui->screen_size.y/2
+        );
+    }
+}
+
+
+static bool wlay_gui_rect_contains(struct nk_rect r, struct nk_vec2 pos)
+{
+    return pos.x >= r.x && pos.x < r.x + r.w && pos.y >= r.y && pos.y < r.y + r.h;
+}
+
+
+static bool wlay_gui_rect_intersects(struct nk_rect a, struct nk_rect b)
+{
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+
+static void wlay_gui_editor_head(struct wlay_head *head,
+                                 struct nk_command_buffer *canvas,
+                                 struct nk_rect canvas_bounds)
+{
+    struct wlay_state *wlay = head->wlay;
+    struct nk_context *ctx = wlay->nk;
+    struct nk_rect bounds = wlay_gui_editor_rect(
+        wlay, canvas_bounds, head->x, head->y, head->w, head->h
+    );
+    if (!wlay_gui_rect_intersects(bounds, canvas_bounds)) {
+        return;
+    }
+
+    struct nk_color border_color = nk_rgb(200, 200, 200);
+    if (head->overlapping) {
+        border_color = nk_rgb(220, 60, 60);
+    } else if (head->detached) {
+        border_color = nk_rgb(230, 160, 40);
+    }
+    struct nk_color fill_color = head->focused ? nk_rgb(60, 60, 60) : nk_rgb(50, 50, 50);
+    if (bounds.w < EDITOR_LOD_MIN_SIZE || bounds.h < EDITOR_LOD_MIN_SIZE) {
+        // Too small for a border or a label, a dot in the border color
+        // still shows where it is and whether it is valid
+        nk_fill_rect(canvas, bounds, 0, border_color);
+        return;
+    }
+    nk_fill_rect(canvas, bounds, 0, fill_color);
+    const struct nk_image *thumbnail = head->thumbnail;
+    if (thumbnail != NULL && thumbnail->w && thumbnail->h) {
+        // Fitted inside the border, the output may be set to a mode of
+        // another aspect ratio than the capture has
+        float scale = min((bounds.w - 2) / thumbnail->w, (bounds.h - 2) / thumbnail->h);
+        float w = thumbnail->w * scale, h = thumbnail->h * scale;
+        nk_draw_image(canvas, nk_rect(bounds.x + (bounds.w - w)/2,
+                                      bounds.y + (bounds.h - h)/2, w, h),
+                      thumbnail, nk_rgb(255, 255, 255));
+    }
+    nk_stroke_rect(canvas, bounds, 0, 1, border_color);
+
+    // Labels that do not fit are left out rather than spilling over
+    // the neighbours
+    const struct nk_user_font *font = ctx->style.font;
+    float text_w = head->name_width;
+    if (head->name == NULL || text_w > bounds.w || font->height > bounds.h) {
+        return;
+    }
+    struct nk_rect text_bounds = nk_rect(
+        bounds.x + (bounds.w - text_w)/2, bounds.y + (bounds.h - font->height)/2,
+        text_w, font->height
+    );
+    if (thumbnail != NULL && thumbnail->w) {
+        // Keeps the name readable on top of whatever the output shows
+        nk_fill_rect(canvas, nk_rect(text_bounds.x - 2, text_bounds.y - 1,
+                                     text_bounds.w + 4, text_bounds.h + 2), 2, fill_color);
+    }
+    nk_draw_text(
+        canvas, text_bounds, head->name, strlen(head->name), font, fill_color,
+        head->focused ? nk_rgb(200, 60, 60) : ctx->style.text.color
+    );
+}
+
+
+static void wlay_gui_editor_issues(struct wlay_state *wlay,
+                                   struct nk_command_buffer *canvas,
+                                   struct nk_rect canvas_bounds)
+{
+    struct wlay_validation *v = &wlay->gui->validation;
+    for (size_t i = 0; i < v->issue_count; i++) {
+        struct wlay_rect *area = &v->issues[i].area;
+        struct nk_rect bounds = wlay_gui_editor_rect(
+            wlay, canvas_bounds, area->x, area->y, area->w, area->h
+        );
+        // Keep slivers visible at editor scale
+        bounds.w = max(bounds.w, 2.f);
+        bounds.h = max(bounds.h, 2.f);
+        nk_fill_rect(
+            canvas, bounds, 0,
+            v->issues[i].type == WLAY_ISSUE_OVERLAP ?
+                nk_rgba(220, 60, 60, 120) : nk_rgba(230, 160, 40, 120)
+        );
+    }
+}
+
+
+static struct wlay_head *wlay_gui_editor_hit(struct wlay_state *wlay,
+                                             struct nk_rect canvas_bounds,
+                                             struct nk_vec2 pos,
+                                             struct wlay_head *focused_head)
+{
+    // Same order as drawing, but topmost first
+    struct wlay_head *head;
+    if (focused_head != NULL) {
+        struct nk_rect r = wlay_gui_editor_rect(
+            wlay, canvas_bounds,
+            focused_head->x, focused_head->y, focused_head->w, focused_head->h
+        );
+        if (wlay_gui_rect_contains(r, pos)) {
+            return focused_head;
+        }
+    }
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        if (!head->enabled || head == focused_head) {
+            continue;
+        }
+        struct nk_rect r = wlay_gui_editor_rect(
+            wlay, canvas_bounds, head->x, head->y, head->w, head->h
+        );
+        if (wlay_gui_rect_contains(r, pos)) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+
+static struct wlay_head *wlay_gui_editor(struct wlay_state *wlay,
+                                         struct wlay_head *focused_head)
+{
+    // The whole layout is a single widget drawing straight into the window
+    // command buffer, there is no nuklear layout or panel per head
+    struct nk_context *ctx = wlay->nk;
+    struct nk_rect content = nk_window_get_content_region(ctx);
+    nk_layout_row_dynamic(ctx, max(content.h - EDITOR_CONTROLS_HEIGHT, 200.f), 1);
+    struct nk_rect canvas_bounds;
+    enum nk_widget_layout_states state = nk_widget(&canvas_bounds, ctx);
+    if (state == NK_WIDGET_INVALID) {
+        return focused_head;
+    }
+
+    struct nk_input *in = &ctx->input;
+    wlay->gui->bounds.canvas = canvas_bounds;
+    wlay_gui_editor_view(wlay, canvas_bounds, state == NK_WIDGET_VALID);
+    if (state == NK_WIDGET_VALID) {
+        if (nk_input_is_mouse_pressed(in, NK_BUTTON_LEFT) &&
+                nk_input_is_mouse_hovering_rect(in, canvas_bounds)) {
+            struct wlay_head *hit = wlay_gui_editor_hit(
+                wlay, canvas_bounds, in->mouse.pos, focused_head
+            );
+            if (hit != NULL) {
+                wlay_gui_focus(wlay, hit);
+                focused_head = hit;
+            }
+            wlay->drag_head = hit;
+        }
+        if (!in->mouse.buttons[NK_BUTTON_LEFT].down) {
+            wlay->drag_head = NULL;
+        }
+        struct wlay_head *drag_head = wlay->drag_head;
+        if (drag_head != NULL && drag_head->focused && drag_head->enabled) {
+            drag_head->x = drag_head->x + in->mouse.delta.x/wlay->gui->view.scale;
+            drag_head->y = drag_head->y + in->mouse.delta.y/wlay->gui->view.scale;
+            wlay->gui->dragging = true;
+        }
+    }
+
+    struct nk_command_buffer *canvas = nk_window_get_canvas(ctx);
+    struct nk_rect old_clip = canvas->clip;
+    nk_push_scissor(canvas, canvas_bounds);
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled || head == focused_head) {
+            continue;
+        }
+        wlay_gui_editor_head(head, canvas, canvas_bounds);
+    }
+    // Render focused head on top
+    if (focused_head != NULL && focused_head->enabled) {
+        wlay_gui_editor_head(focused_head, canvas, canvas_bounds);
+    }
+    wlay_gui_editor_issues(wlay, canvas, canvas_bounds);
+    nk_push_scissor(canvas, old_clip);
+    return focused_head;
+}
+
+
+static void wlay_custom_mode_update(struct wlay_head *head)
+{
+    struct wlay_cvt_timing *timing = &head->custom_mode.timing;
+    head->custom_mode.valid = wlay_cvt_compute(
+        head->custom_mode.type, head->custom_mode.width, head->custom_mode.height,
+        head->custom_mode.refresh, timing
+    );
+    wlay_model_changed(head->wlay);
+    if (!head->custom_mode.valid) {
+        snprintf(head->custom_mode.label, sizeof(head->custom_mode.label),
+                 "No timing for this mode");
+        return;
+    }
+    const char *link = wlay_cvt_link(timing->data_rate);
+    snprintf(head->custom_mode.label, sizeof(head->custom_mode.label),
+             "%.3f Hz, %.2f MHz, %dx%d total, %.2f Gbit/s, %s%s",
+             timing->refresh_rate / 1000.0, timing->pixel_clock / 1000.0,
+             timing->htotal, timing->vtotal, timing->data_rate / 1e9,
+             link ? "fits " : "exceeds DP 2.0", link ? link : "");
+}
+
+
+// Brings the matches up to date with the text typed. Typing on narrows
+// down the last matches, anything else scans all labels again.
+static void wlay_gui_filter_update(struct wlay_gui_filter *filter, const char **labels,
+                                   int count, uint64_t generation)
+{
+    bool stale = filter->labels != labels || filter->count != count ||
+        filter->generation != generation;
+    if (!stale && !strcmp(filter->text, filter->matched)) {
+        return;
+    }
+    if (count > filter->capacity) {
+        filter->capacity = count * 2;
+        filter->matches = xrealloc(filter->matches, filter->capacity * sizeof(*filter->matches));
+    }
+    if (stale || strncmp(filter->text, filter->matched, strlen(filter->matched))) {
+        filter->match_count = count;
+        for (int i = 0; i < count; i++) {
+            filter->matches[i] = i;
+        }
+    }
+    int match_count = 0;
+    for (int i = 0; i < filter->match_count; i++) {
+        int index = filter->matches[i];
+        if (strcasestr(labels[index], filter->text) != NULL) {
+            filter->matches[match_count++] = index;
+        }
+    }
+    filter->match_count = match_count;
+    filter->labels = labels;
+    filter->count = count;
+    filter->generation = generation;
+    strcpy(filter->matched, filter->text);
+}
+
+
+// A combo of labels with a filter field, type "2560" or "144Hz" to narrow
+// them down. Only the rows in view are laid out, so a long list costs no
+// more than a short one. Returns the index picked, -1 if none was.
+static int wlay_gui_list_combo(struct wlay_state *wlay, struct wlay_gui_filter *filter,
+                               const char *title, const char **labels, int count,
+                               struct nk_vec2 size)
+{
+    struct nk_context *ctx = wlay->nk;
+    const int row_height = 25;
+    if (!nk_combo_begin_label(ctx, title, size)) {
+        filter->open = false;
+        return -1;
+    }
+    if (!filter->open || filter->labels != labels) {
+        // Typing goes to the filter right away, a combo shared by the
+        // heads starts over for another one
+        filter->open = true;
+        filter->text[0] = '\0';
+        nk_edit_focus(ctx, NK_EDIT_FIELD);
+    }
+    nk_layout_row_dynamic(ctx, row_height, 1);
+    nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD, filter->text, sizeof(filter->text),
+                                   NULL);
+    wlay_gui_filter_update(filter, labels, count, wlay->generation);
+
+    int picked = -1;
+    struct nk_list_view view;
+    nk_layout_row_dynamic(ctx, size.y - 2*row_height, 1);
+    if (nk_list_view_begin(ctx, &view, "wlay_list_combo", 0, row_height,
+                           filter->match_count)) {
+        nk_layout_row_dynamic(ctx, row_height, 1);
+        for (int i = 0; i < view.count; i++) {
+            int index = filter->matches[view.begin + i];
+            if (nk_combo_item_label(ctx, labels[index], NK_TEXT_LEFT)) {
+                picked = index;
+            }
+        }
+        nk_list_view_end(&view);
+    }
+    nk_combo_end(ctx);
+    return picked;
+}
+
+
+// Custom mode parameters and the resulting CVT timing
+static void wlay_gui_custom_mode(struct wlay_head *head)
+{
+    struct nk_context *ctx = head->wlay->nk;
+    int width = head->custom_mode.width;
+    int height = head->custom_mode.height;
+    float refresh = head->custom_mode.refresh;
+    enum wlay_cvt_type type = head->custom_mode.type;
+
+    nk_layout_row_begin(ctx, NK_STATIC, 0, 4);
+    nk_layout_row_push(ctx, 130);
+    nk_property_int(ctx, "W:", 8, &head->custom_mode.width, 16384, 8, 8);
+    nk_layout_row_push(ctx, 130);
+    nk_property_int(ctx, "H:", 1, &head->custom_mode.height, 16384, 1, 1);
+    nk_layout_row_push(ctx, 130);
+    nk_property_float(ctx, "Hz:", 1, &head->custom_mode.refresh, 1000, 1, 0.5f);
+    nk_layout_row_push(ctx, 100);
+    head->custom_mode.type = nk_combo(
+        ctx, wlay_cvt_type_names, WLAY_CVT_TYPE_COUNT, head->custom_mode.type,
+        25, nk_vec2(120, 120)
+    );
+    nk_layout_row_end(ctx);
+
+    if (width != head->custom_mode.width || height != head->custom_mode.height ||
+            refresh != head->custom_mode.refresh || type != head->custom_mode.type) {
+        wlay_custom_mode_update(head);
+    }
+    nk_layout_row_dynamic(ctx, 0, 1);
+    nk_label(ctx, head->custom_mode.label, NK_TEXT_LEFT);
+}
+
+
+static void wlay_gui_details(struct wlay_head *head)
+{
+    struct nk_context *ctx = head->wlay->nk;
+    nk_layout_row_dynamic(ctx, 0, 1);
+    nk_label(ctx, head->header, NK_TEXT_CENTERED);
+    if (head->identifier[0]) {
+        nk_label(ctx, head->identifier, NK_TEXT_CENTERED);
+    }
+
+    nk_layout_row_begin(ctx, NK_STATIC, 0, 6);
+    nk_layout_row_push(ctx, 80);
+    if (nk_button_label(ctx, "Disable")) {
+        wlay_head_disable(head);
+    }
+    // Transform selector
+    nk_layout_row_push(ctx, 100);
+    head->transform = nk_combo(
+            ctx, wlay_output_transform_names, ARRAY_SIZE(wlay_output_transform_names),
+            head->transform, 25, nk_vec2(200, 200)
+    );
+
+    // Mode selector
+    nk_layout_row_push(ctx, 150);
+    if (head->custom_mode.enabled) {
+        nk_label(ctx, "Custom mode", NK_TEXT_LEFT);
+    } else if (head->mode_count > 0) {
+        head->wlay->gui->bounds.mode_combo = nk_widget_bounds(ctx);
+        int selected_mode = wlay_gui_list_combo(
+            head->wlay, &head->wlay->gui->mode_filter,
+            head->current_mode ? head->current_mode->label : "Mode",
+            head->mode_labels, head->mode_count, nk_vec2(200, 250)
+        );
+        if (selected_mode >= 0) {
+            head->current_mode = head->mode_list[selected_mode];
+        }
+    } else {
+        nk_label(ctx, "No modes", NK_TEXT_LEFT);
+    }
+
+    nk_layout_row_push(ctx, 60);
+    bool pinned = nk_check_label(ctx, "Pin", head->pinned);
+    if (pinned != head->pinned && head->wlay->gui->arrange_live) {
+        head->wlay->gui->should_arrange = true;
+    }
+    head->pinned = pinned;
+
+    nk_layout_row_push(ctx, 80);
+    bool custom = nk_check_label(ctx, "Custom", head->custom_mode.enabled);
+    if (custom != head->custom_mode.enabled) {
+        // Start from the current mode the first time
+        if (head->custom_mode.width == 0 && head->current_mode != NULL) {
+            head->custom_mode.width = head->current_mode->width;
+            head->custom_mode.height = head->current_mode->height;
+            head->custom_mode.refresh = roundf(head->current_mode->refresh_rate / 1000.0f);
+            head->custom_mode.type = WLAY_CVT_RB2;
+        }
+        head->custom_mode.enabled = custom;
+        wlay_custom_mode_update(head);
+    }
+
+    if (head->adaptive_sync_supported) {
+        nk_layout_row_push(ctx, 120);
+        head->adaptive_sync = nk_check_label(ctx, "Adaptive sync", head->adaptive_sync);
+    }
+    nk_layout_row_end(ctx);
+
+    if (head->custom_mode.enabled) {
+        wlay_gui_custom_mode(head);
+    }
+}
+
+
+static void wlay_calculate_screen_space(struct wlay_state *wlay)
+{
+    // We do this before rendering the GUI to allow stuff like edge
+    // snapping/editor autoscaling
+    wlay_layout_measure(wlay);
+    if (!wlay->nk->input.mouse.buttons[NK_BUTTON_LEFT].down) {
+        int32_t width = 0, height = 0;
+        wlay_layout_normalize(wlay, &width, &height);
+        wlay->gui->screen_size.x = width;
+        wlay->gui->screen_size.y = height;
+    }
+}
+
+
+static void wlay_gui_validate(struct wlay_state *wlay)
+{
+    // Swap buffers so that the previous frame can be compared against
+    struct wlay_rect *rects = wlay->gui->prev_rects;
+    struct wlay_head **rect_heads = wlay->gui->prev_rect_heads;
+    wlay->gui->prev_rects = wlay->gui->rects;
+    wlay->gui->prev_rect_heads = wlay->gui->rect_heads;
+    wlay->gui->prev_rect_count = wlay->gui->rect_count;
+    wlay->gui->rects = rects;
+    wlay->gui->rect_heads = rect_heads;
+
+    size_t head_count = wlay->gui->head_count;
+    if (head_count > wlay->gui->rect_capacity) {
+        size_t capacity = head_count * 2;
+        wlay->gui->rects = xrealloc(wlay->gui->rects, capacity * sizeof(*wlay->gui->rects));
+        wlay->gui->rect_heads = xrealloc(wlay->gui->rect_heads, capacity * sizeof(*wlay->gui->rect_heads));
+        wlay->gui->prev_rects = xrealloc(wlay->gui->prev_rects, capacity * sizeof(*wlay->gui->prev_rects));
+        wlay->gui->prev_rect_heads = xrealloc(wlay->gui->prev_rect_heads, capacity * sizeof(*wlay->gui->prev_rect_heads));
+        wlay->gui->rect_capacity = capacity;
+        // Contents of the previous frame are gone, force revalidation
+        wlay->gui->prev_rect_count = SIZE_MAX;
+    }
+
+    size_t count = 0;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        head->overlapping = false;
+        head->detached = false;
+        if (!head->enabled) {
+            continue;
+        }
+        wlay->gui->rects[count] = (struct wlay_rect){
+            .x = head->x, .y = head->y, .w = head->w, .h = head->h,
+        };
+        wlay->gui->rect_heads[count] = head;
+        count++;
+    }
+    wlay->gui->rect_count = count;
+
+    struct wlay_validation *v = &wlay->gui->validation;
+    bool unchanged = count == wlay->gui->prev_rect_count &&
+        !memcmp(wlay->gui->rects, wlay->gui->prev_rects, count * sizeof(*wlay->gui->rects)) &&
+        !memcmp(wlay->gui->rect_heads, wlay->gui->prev_rect_heads, count * sizeof(*wlay->gui->rect_heads));
+    if (!unchanged) {
+        wlay_validate(v, wlay->gui->rects, count, SNAP_THRESHOLD);
+        snprintf(wlay->gui->validation_label, sizeof(wlay->gui->validation_label),
+                 "Layout: %zu overlaps, %zu gaps, %d islands",
+                 v->overlap_count, v->gap_count, v->island_count);
+    }
+
+    for (size_t i = 0; i < v->issue_count; i++) {
+        if (v->issues[i].type == WLAY_ISSUE_OVERLAP) {
+            wlay->gui->rect_heads[v->issues[i].a]->overlapping = true;
+            wlay->gui->rect_heads[v->issues[i].b]->overlapping = true;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        wlay->gui->rect_heads[i]->detached = v->island[i] != 0;
+    }
+}
+
+
+static void wlay_gui_arrange(struct wlay_state *wlay)
+{
+    size_t head_count = wlay->gui->head_count;
+    if (head_count > wlay->gui->arrange_capacity) {
+        wlay->gui->arrange_capacity = head_count * 2;
+        wlay->gui->arrange_items = xrealloc(
+            wlay->gui->arrange_items,
+            wlay->gui->arrange_capacity * sizeof(*wlay->gui->arrange_items)
+        );
+    }
+
+    struct wlay_arrange_item *items = wlay->gui->arrange_items;
+    size_t count = 0;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled) {
+            continue;
+        }
+        items[count++] = (struct wlay_arrange_item){
+            .rect = { .x = head->x, .y = head->y, .w = head->w, .h = head->h },
+            .name = head->name,
+            .pinned = head->pinned,
+        };
+    }
+
+    wlay_arrange(&wlay->gui->arrange, items, count, &wlay->gui->arrange_constraints);
+    wlay->gui->arrange_solved = wlay->gui->arrange_constraints;
+
+    count = 0;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled) {
+            continue;
+        }
+        head->x = items[count].rect.x;
+        head->y = items[count].rect.y;
+        count++;
+    }
+}
+
+
+static void wlay_gui_arrange_controls(struct wlay_state *wlay)
+{
+    struct nk_context *ctx = wlay->nk;
+    struct wlay_arrange_constraints *c = &wlay->gui->arrange_constraints;
+    static const char *edge_names[] = {
+        [WLAY_ARRANGE_TOP] = "rows, top",
+        [WLAY_ARRANGE_BOTTOM] = "rows, bottom",
+        [WLAY_ARRANGE_LEFT] = "columns, left",
+        [WLAY_ARRANGE_RIGHT] = "columns, right",
+    };
+
+    nk_layout_row_begin(ctx, NK_STATIC, 0, 5);
+    nk_layout_row_push(ctx, 80);
+    if (nk_button_label(ctx, "Arrange")) {
+        wlay->gui->should_arrange = true;
+    }
+    nk_layout_row_push(ctx, 130);
+    c->edge = nk_combo(
+        ctx, edge_names, ARRAY_SIZE(edge_names), c->edge, 25, nk_vec2(200, 200)
+    );
+    nk_layout_row_push(ctx, 130);
+    nk_property_int(ctx, "Per line:", 0, &c->per_line, 64, 1, 0.1);
+    nk_layout_row_push(ctx, 110);
+    c->keep_order = nk_check_label(ctx, "Keep order", c->keep_order);
+    nk_layout_row_push(ctx, 60);
+    wlay->gui->arrange_live = nk_check_label(ctx, "Live", wlay->gui->arrange_live);
+    nk_layout_row_end(ctx);
+
+    if (wlay->gui->arrange_live) {
+        struct wlay_arrange_constraints *solved = &wlay->gui->arrange_solved;
+        bool drag_ended = wlay->gui->was_dragging && !wlay->gui->dragging;
+        if (drag_ended || c->edge != solved->edge ||
+                c->per_line != solved->per_line ||
+                c->keep_order != solved->keep_order) {
+            wlay->gui->should_arrange = true;
+        }
+    }
+    wlay->gui->was_dragging = wlay->gui->dragging;
+}
+
+
+// Live and peak memory and allocation rate of every subsystem, in a
+// window of its own so that it stays on top of the editor
+static void wlay_gui_mem_overlay(struct wlay_state *wlay, int window_width)
+{
+    struct nk_context *ctx = wlay->nk;
+    struct wlay_gui_mem_overlay *overlay = &wlay->gui->mem_overlay;
+    struct wlay_mem_stats stats[WLAY_MEM_TAG_COUNT];
+    for (int tag = 0; tag < WLAY_MEM_TAG_COUNT; tag++) {
+        wlay_mem_stats(tag, &stats[tag]);
+    }
+    double now = monotonic_time();
+    if (overlay->since == 0 || now - overlay->since >= 1) {
+        for (int tag = 0; tag < WLAY_MEM_TAG_COUNT; tag++) {
+            if (overlay->since != 0) {
+                overlay->rates[tag] = (stats[tag].allocations - overlay->allocations[tag]) /
+                    (now - overlay->since);
+            }
+            overlay->allocations[tag] = stats[tag].allocations;
+        }
+        overlay->since = now;
+    }
+
+    float width = 330;
+    float height = 45 + 22 * (WLAY_MEM_TAG_COUNT + 1);
+    if (nk_begin(ctx, "Memory", nk_rect(window_width - width - 10, 10, width, height),
+                 NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_NO_SCROLLBAR |
+                 NK_WINDOW_NO_INPUT)) {
+        nk_layout_row_dynamic(ctx, 16, 4);
+        nk_label(ctx, "", NK_TEXT_LEFT);
+        nk_label(ctx, "Live KiB", NK_TEXT_RIGHT);
+        nk_label(ctx, "Peak KiB", NK_TEXT_RIGHT);
+        nk_label(ctx, "Allocs/s", NK_TEXT_RIGHT);
+        for (int tag = 0; tag < WLAY_MEM_TAG_COUNT; tag++) {
+            char text[32];
+            nk_label(ctx, wlay_mem_tag_names[tag], NK_TEXT_LEFT);
+            snprintf(text, sizeof(text), "%.1f", stats[tag].live / 1024.0);
+            nk_label(ctx, text, NK_TEXT_RIGHT);
+            snprintf(text, sizeof(text), "%.1f", stats[tag].peak / 1024.0);
+            nk_label(ctx, text, NK_TEXT_RIGHT);
+            snprintf(text, sizeof(text), "%.0f", overlay->rates[tag]);
+            // Anything but 0 while nothing happens is a leak or churn
+            if (overlay->rates[tag] > 0) {
+                nk_label_colored(ctx, text, NK_TEXT_RIGHT, nk_rgb(230, 160, 40));
+            } else {
+                nk_label(ctx, text, NK_TEXT_RIGHT);
+            }
+        }
+    }
+    nk_end(ctx);
+}
+
+
+static void wlay_snap(struct wlay_state *wlay)
+{
+    if (wlay->focused != NULL) {
+        wlay_layout_snap(wlay, wlay->focused, SNAP_THRESHOLD);
+    }
+}
+
+
+static void wlay_save_config(struct wlay_state *wlay)
+{
+    log_info("Saving to %s", wlay->gui->file_path);
+    FILE *f = fopen(wlay->gui->file_path, "w");
+    if (f == NULL) {
+        log_info("File write failed");
+        return;
+    }
+    wlay_export(wlay, wlay->gui->config_type, f);
+    fclose(f);
+    // Whatever rewrites it from now on shows up in the profile, JSON is
+    // not a config the profiles can read
+    if (wlay->gui->config_type != WLAY_CONFIG_JSON) {
+        wlay_profiles_add(wlay->profiles, wlay->gui->file_path);
+    }
+}
+
+
+void wlay_gui(struct wlay_state *wlay)
+{
+    int window_width, window_height;
+    wlay->backend->get_size(wlay, &window_width, &window_height);
+    struct nk_context *ctx = wlay->nk;
+
+    wlay_gui_refresh(wlay);
+    wlay_calculate_screen_space(wlay);
+    if (wlay->gui->should_arrange) {
+        wlay->gui->should_arrange = false;
+        wlay_gui_arrange(wlay);
+    }
+    // Last frame's edits, after normalizing and arranging so that they are
+    // part of them. A drag is recorded once it ended.
+    if (wlay->drag_head == NULL) {
+        wlay_journal_track(wlay->journal);
+    }
+    wlay_gui_validate(wlay);
+
+    wlay->gui->dragging = false;
+
+    /* GUI */
+    ctx->style.window.padding = nk_vec2(20, 20);
+    ctx->style.window.spacing = nk_vec2(10, 10);
+    if (nk_begin(ctx, "", nk_rect(0, 0, window_width, window_height), 0))
+    {
+        struct wlay_head *focused_head = wlay_gui_editor(wlay, wlay->focused);
+        nk_layout_row_begin(ctx, NK_STATIC, 0, 4);
+        nk_layout_row_push(ctx, 60);
+        if (nk_button_label(ctx, "Fit")) {
+            wlay->gui->view.auto_fit = true;
+        }
+        nk_layout_row_push(ctx, 60);
+        if (nk_button_label(ctx, "Undo")) {
+            wlay_journal_undo(wlay->journal);
+        }
+        nk_layout_row_push(ctx, 60);
+        if (nk_button_label(ctx, "Redo")) {
+            wlay_journal_redo(wlay->journal);
+        }
+        nk_layout_row_push(ctx, 400);
+        struct wlay_validation *v = &wlay->gui->validation;
+        if (v->issue_count == 0 && v->island_count <= 1) {
+            nk_label(ctx, "Layout OK", NK_TEXT_LEFT);
+        } else {
+            nk_label_colored(
+                ctx, wlay->gui->validation_label, NK_TEXT_LEFT, nk_rgb(230, 160, 40)
+            );
+        }
+        nk_layout_row_end(ctx);
+        if (focused_head != NULL) {
+            wlay_gui_details(focused_head);
+        }
+        nk_layout_row_static(ctx, 10, 100, 1);
+        wlay_gui_arrange_controls(wlay);
+        nk_layout_row_begin(ctx, NK_STATIC, 0, 7);
+        {
+            nk_layout_row_push(ctx, 60);
+            if (nk_button_label(ctx, "Apply")) {
+                wlay->should_apply = true;
+            }
+            // Back to the configuration before the last applied one
+            nk_layout_row_push(ctx, 60);
+            if (nk_button_label(ctx, "Revert")) {
+                wlay_journal_revert(wlay->journal);
+            }
+            nk_layout_row_push(ctx, 100);
+            wlay->gui->bounds.enable_combo = nk_widget_bounds(ctx);
+            int enable_head_idx = wlay_gui_list_combo(
+                wlay, &wlay->gui->enable_filter, "Enable",
+                wlay->gui->disabled_names, wlay->gui->disabled_count, nk_vec2(200, 250)
+            );
+            if (enable_head_idx >= 0) {
+                wlay_head_enable(wlay->gui->disabled_heads[enable_head_idx]);
+            }
+
+            nk_layout_row_push(ctx, 20);
+            nk_label(ctx, "", NK_TEXT_LEFT);
+            nk_layout_row_push(ctx, 100);
+            wlay->gui->config_type = nk_combo(
+                ctx, wlay_config_type_names, WLAY_CONFIG_TYPE_COUNT, wlay->gui->config_type, 30,
+                nk_vec2(200, 200)
+            );
+            nk_layout_row_push(ctx, 200);
+            nk_edit_string_zero_terminated(
+                ctx, NK_EDIT_FIELD, wlay->gui->file_path, sizeof(wlay->gui->file_path),
+                NULL
+            );
+            nk_layout_row_push(ctx, 50);
+            if (nk_button_label(ctx, "Save")) {
+                wlay_save_config(wlay);
+            }
+        }
+        nk_layout_row_end(ctx);
+    }
+
+    if (nk_input_is_key_down(&ctx->input, NK_KEY_TAB)) {
+        wlay_snap(wlay);
+    }
+    // Ctrl+Z and Ctrl+R, unless they are meant for the file name
+    if (!nk_item_is_any_active(ctx)) {
+        if (nk_input_is_key_pressed(&ctx->input, NK_KEY_TEXT_UNDO)) {
+            wlay_journal_undo(wlay->journal);
+        }
+        if (nk_input_is_key_pressed(&ctx->input, NK_KEY_TEXT_REDO)) {
+            wlay_journal_redo(wlay->journal);
+        }
+    }
+    nk_end(ctx);
+
+    if (wlay->gui->mem_overlay.enabled) {
+        wlay_gui_mem_overlay(wlay, window_width);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef WLAY_GUI_H
+#define WLAY_GUI_H
+
+#include <limits.h>
+
+#include "wlay.h"
+#include "wlay_nuklear.h"
+#include "validate.h"
+#include "arrange.h"
+
+// What a list combo shows for the text typed into it, see
+// wlay_gui_list_combo()
+struct wlay_gui_filter {
+    char text[32];
+    bool open;
+    // Indices of the labels that contain matched, for the labels as they
+    // were at that generation
+    char matched[32];
+    const char **labels;
+    int count;
+    uint64_t generation;
+    int *matches;
+    int match_count;
+    int capacity;
+};
+
+// What --mem-stats shows, the rates are allocations per second over the
+// last second
+struct wlay_gui_mem_overlay {
+    bool enabled;
+    double since;
+    uint64_t allocations[WLAY_MEM_TAG_COUNT];
+    double rates[WLAY_MEM_TAG_COUNT];
+};
+
+// What the editor keeps between frames, the model itself knows nothing
+// about nuklear
+struct wlay_gui {
+    struct nk_vec2 screen_size;
+    bool dragging;
+
+    // Display data cached for the model generation it was built for,
+    // so that steady-state frames neither allocate nor rescan the model
+    uint64_t generation;
+    size_t head_count;
+    const char **disabled_names;
+    struct wlay_head **disabled_heads;
+    int disabled_count;
+    size_t disabled_capacity;
+    char validation_label[64];
+    struct wlay_gui_filter mode_filter;
+    struct wlay_gui_filter enable_filter;
+
+    // Editor view, maps the point center of screen space to the middle
+    // of the canvas. Auto-fit keeps the whole layout visible until the
+    // user zooms or pans.
+    struct {
+        float scale;
+        struct nk_vec2 center;
+        bool auto_fit;
+    } view;
+    // Where some of the widgets ended up in the last frame, lets
+    // wlay-bench script its input
+    struct {
+        struct nk_rect canvas;
+        struct nk_rect mode_combo;
+        struct nk_rect enable_combo;
+    } bounds;
+    enum wlay_config_type config_type;
+    char file_path[PATH_MAX];
+
+    // Layout validation of the enabled heads, recomputed whenever
+    // their geometry changes
+    struct wlay_validation validation;
+    struct wlay_rect *rects;
+    struct wlay_head **rect_heads;
+    struct wlay_rect *prev_rects;
+    struct wlay_head **prev_rect_heads;
+    size_t rect_count;
+    size_t prev_rect_count;
+    size_t rect_capacity;
+
+    // Auto-arrange solver, in live mode the layout is re-solved
+    // whenever the constraints change or a drag ends
+    struct wlay_arrange arrange;
+    struct wlay_arrange_constraints arrange_constraints;
+    struct wlay_arrange_constraints arrange_solved;
+    struct wlay_arrange_item *arrange_items;
+    size_t arrange_capacity;
+    bool arrange_live;
+    bool should_arrange;
+    bool was_dragging;
+    // Memory of every subsystem in a corner of the window
+    struct wlay_gui_mem_overlay mem_overlay;
+};
+
+// Allocates wlay->gui and opens the backend's window
+void wlay_gui_init(struct wlay_state *wlay);
+void wlay_gui_destroy(struct wlay_state *wlay);
+// Builds one frame of the GUI, between the backend's new_frame and render
+void wlay_gui(struct wlay_state *wlay);
+
+#endif
@@ -0,0 +1,786 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_CONTROL
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "ipc.h"
+#include "json.h"
+#include "profile.h"
+
+// Longest request line, and how much output a client may leave unread
+// before it is dropped
+#define IPC_MAX_LINE (64 * 1024)
+#define IPC_MAX_OUTPUT (1024 * 1024)
+// Latencies kept per command for the percentiles
+#define IPC_LATENCY_SAMPLES 1024
+#define IPC_MAX_EVENTS 16
+
+enum ipc_command {
+    IPC_COMMAND_PING,
+    IPC_COMMAND_GET,
+    IPC_COMMAND_SET,
+    IPC_COMMAND_TEST,
+    IPC_COMMAND_APPLY,
+    IPC_COMMAND_SUBSCRIBE,
+    IPC_COMMAND_STATS,
+    IPC_COMMAND_PROFILES,
+    IPC_COMMAND_COUNT,
+};
+
+static const char *ipc_command_names[IPC_COMMAND_COUNT] = {
+    [IPC_COMMAND_PING] = "ping",
+    [IPC_COMMAND_GET] = "get",
+    [IPC_COMMAND_SET] = "set",
+    [IPC_COMMAND_TEST] = "test",
+    [IPC_COMMAND_APPLY] = "apply",
+    [IPC_COMMAND_SUBSCRIBE] = "subscribe",
+    [IPC_COMMAND_STATS] = "stats",
+    [IPC_COMMAND_PROFILES] = "profiles",
+};
+
+struct ipc_latency {
+    uint64_t count;
+    double total;
+    double max;
+    double samples[IPC_LATENCY_SAMPLES];
+};
+
+struct ipc_client {
+    struct wlay_ipc *ipc;
+    // -1 once the peer is gone but a configuration result is outstanding
+    int fd;
+    struct wlay_buffer in;
+    struct wlay_buffer out;
+    // Events that arrived while a response was being written
+    struct wlay_buffer events;
+    bool subscribed;
+    // The peer shut down its side, close once everything is answered
+    bool hangup;
+
+    // The request line being executed, commands after a test or apply
+    // resume once the compositor answers
+    char *line;
+    char *cursor;
+    int result_count;
+    bool batch;
+    bool failed;
+    struct zwlr_output_configuration_v1 *config;
+    enum ipc_command config_command;
+    double config_start;
+
+    struct wl_list link;
+};
+
+struct wlay_ipc {
+    struct wlay_state *wlay;
+    char *path;
+    int listen_fd;
+    int epoll_fd;
+    struct wl_list clients;
+    struct ipc_latency latency[IPC_COMMAND_COUNT];
+};
+
+
+static void ipc_client_update(struct ipc_client *client)
+{
+    if (client->fd < 0) {
+        return;
+    }
+    struct epoll_event event = {
+        .events = (client->hangup ? 0 : EPOLLIN) | (client->out.size ? EPOLLOUT : 0),
+        .data.ptr = client,
+    };
+    epoll_ctl(client->ipc->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+
+static void ipc_client_free(struct ipc_client *client)
+{
+    wl_list_remove(&client->link);
+    xfree(client->in.data);
+    xfree(client->out.data);
+    xfree(client->events.data);
+    xfree(client->line);
+    xfree(client);
+}
+
+
+// Closes the connection, the client itself lives on until the compositor
+// answered its configuration, the listener still points to it
+static void ipc_client_close(struct ipc_client *client)
+{
+    if (client->fd >= 0) {
+        epoll_ctl(client->ipc->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+    }
+    if (client->config == NULL) {
+        ipc_client_free(client);
+    }
+}
+
+
+// Sends what it can, false if the client was closed
+static bool ipc_client_flush(struct ipc_client *client)
+{
+    while (client->out.size > 0) {
+        ssize_t n = send(client->fd, client->out.data, client->out.size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                ipc_client_close(client);
+                return false;
+            }
+            break;
+        }
+        wlay_buffer_consume(&client->out, n);
+    }
+    if (client->out.size > IPC_MAX_OUTPUT) {
+        log_info("Dropping IPC client that does not read its responses");
+        ipc_client_close(client);
+        return false;
+    }
+    if (client->hangup && client->config == NULL && client->out.size == 0) {
+        ipc_client_close(client);
+        return false;
+    }
+    ipc_client_update(client);
+    return true;
+}
+
+
+static void ipc_record_latency(struct wlay_ipc *ipc, enum ipc_command command,
+                               double start)
+{
+    double latency = monotonic_time() - start;
+    struct ipc_latency *l = &ipc->latency[command];
+    l->samples[l->count % IPC_LATENCY_SAMPLES] = latency;
+    l->count++;
+    l->total += latency;
+    l->max = max(l->max, latency);
+}
+
+
+static int ipc_compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static struct wlay_head *ipc_find_head(struct wlay_state *wlay, const char *name)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->name != NULL && !strcmp(head->name, name)) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+
+// Writes the error of a command, always returns false
+__attribute__((format(printf, 2, 3)))
+static bool ipc_error(struct wlay_buffer *out, const char *format, ...)
+{
+    char message[256];
+    va_list vas;
+    va_start(vas, format);
+    vsnprintf(message, sizeof(message), format, vas);
+    va_end(vas);
+    wlay_buffer_append(out, "{\"ok\":false,\"error\":", 20);
+    wlay_json_string(out, message);
+    wlay_buffer_append(out, "}", 1);
+    return false;
+}
+
+
+static bool ipc_command_get(struct wlay_ipc *ipc, struct wlay_buffer *out)
+{
+    wlay_buffer_printf(out, "{\"ok\":true,\"serial\":%u,\"heads\":", ipc->wlay->serial);
+    wlay_json_heads(out, ipc->wlay);
+    wlay_buffer_append(out, "}", 1);
+    return true;
+}
+
+
+// The mode of that size with the refresh rate closest to the requested
+// one, or the highest without one
+static struct wlay_mode *ipc_find_mode(struct wlay_head *head, int32_t width,
+                                       int32_t height, double refresh)
+{
+    struct wlay_mode *best = NULL;
+    double best_distance = 0;
+    struct wlay_mode *mode;
+    wl_list_for_each(mode, &head->modes, link) {
+        if (mode->width != width || mode->height != height) {
+            continue;
+        }
+        double distance = refresh > 0 ?
+            fabs(mode->refresh_rate / 1000.0 - refresh) : -mode->refresh_rate;
+        if (best == NULL || distance < best_distance) {
+            best = mode;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+
+static bool ipc_set_enabled(struct wlay_head *head, bool enabled, struct wlay_buffer *out)
+{
+    if (enabled && head->current_mode == NULL) {
+        head->current_mode = wlay_head_best_mode(head, &head->wlay->mode_policy);
+        if (head->current_mode == NULL) {
+            return ipc_error(out, "%s has no modes", head->name);
+        }
+    }
+    if (enabled && head->scale == 0) {
+        head->scale = wl_fixed_from_int(1);
+    }
+    if (!enabled && head->wlay->focused == head) {
+        head->wlay->focused = NULL;
+        head->focused = false;
+    }
+    head->enabled = enabled;
+    return true;
+}
+
+
+bool wlay_ipc_set(struct wlay_state *wlay, char *args, struct wlay_buffer *out)
+{
+    char *save;
+    char *name = strtok_r(args, " \t", &save);
+    if (name == NULL) {
+        return ipc_error(out, "set needs an output name");
+    }
+    struct wlay_head *head = ipc_find_head(wlay, name);
+    if (head == NULL) {
+        return ipc_error(out, "No output %s", name);
+    }
+
+    char *arg;
+    while ((arg = strtok_r(NULL, " \t", &save)) != NULL) {
+        char *value = strchr(arg, '=');
+        if (value == NULL) {
+            return ipc_error(out, "Expected KEY=VALUE, got %s", arg);
+        }
+        *value++ = '\0';
+        int32_t a, b;
+        double refresh = 0;
+        char tail;
+        if (!strcmp(arg, "enabled")) {
+            if (!ipc_set_enabled(head, atoi(value) != 0, out)) {
+                return false;
+            }
+        } else if (!strcmp(arg, "x") && sscanf(value, "%d%c", &a, &tail) == 1) {
+            head->x = a;
+        } else if (!strcmp(arg, "y") && sscanf(value, "%d%c", &a, &tail) == 1) {
+            head->y = a;
+        } else if (!strcmp(arg, "pos") && sscanf(value, "%d,%d%c", &a, &b, &tail) == 2) {
+            head->x = a;
+            head->y = b;
+        } else if (!strcmp(arg, "mode") &&
+                (sscanf(value, "%dx%d@%lf%c", &a, &b, &refresh, &tail) == 3 ||
+                 sscanf(value, "%dx%d%c", &a, &b, &tail) == 2)) {
+            struct wlay_mode *mode = ipc_find_mode(head, a, b, refresh);
+            if (mode == NULL) {
+                return ipc_error(out, "%s has no mode %s", head->name, value);
+            }
+            head->current_mode = mode;
+            head->custom_mode.enabled = false;
+        } else if (!strcmp(arg, "transform")) {
+            size_t i;
+            for (i = 0; i < ARRAY_SIZE(wlay_output_transform_names); i++) {
+                if (!strcmp(value, wlay_output_transform_names[i])) {
+                    break;
+                }
+            }
+            if (i == ARRAY_SIZE(wlay_output_transform_names)) {
+                return ipc_error(out, "Unknown transform %s", value);
+            }
+            head->transform = i;
+        } else if (!strcmp(arg, "scale") && sscanf(value, "%lf%c", &refresh, &tail) == 1 &&
+                refresh > 0) {
+            head->scale = wl_fixed_from_double(refresh);
+        } else if (!strcmp(arg, "adaptive_sync")) {
+            if (!head->adaptive_sync_supported) {
+                return ipc_error(out, "%s does not report adaptive sync", head->name);
+            }
+            head->adaptive_sync = atoi(value) != 0;
+        } else {
+            return ipc_error(out, "Invalid setting %s=%s", arg, value);
+        }
+    }
+    wlay_model_changed(wlay);
+    wlay_buffer_append(out, "{\"ok\":true}", 11);
+    return true;
+}
+
+
+static void ipc_command_stats(struct wlay_ipc *ipc, struct wlay_buffer *out)
+{
+    double sorted[IPC_LATENCY_SAMPLES];
+    wlay_buffer_append(out, "{\"ok\":true,\"commands\":{", 23);
+    bool first = true;
+    for (int i = 0; i < IPC_COMMAND_COUNT; i++) {
+        struct ipc_latency *l = &ipc->latency[i];
+        if (l->count == 0) {
+            continue;
+        }
+        size_t n = min(l->count, (uint64_t)IPC_LATENCY_SAMPLES);
+        memcpy(sorted, l->samples, n * sizeof(*sorted));
+        qsort(sorted, n, sizeof(*sorted), ipc_compare_double);
+        wlay_buffer_printf(out, "%s\"%s\":{\"count\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,"
+                   "\"p99_us\":%.1f,\"max_us\":%.1f}",
+                   first ? "" : ",", ipc_command_names[i], (unsigned long long)l->count,
+                   l->total / l->count * 1e6, sorted[n / 2] * 1e6,
+                   sorted[(n * 99) / 100] * 1e6, l->max * 1e6);
+        first = false;
+    }
+    wlay_buffer_append(out, "}}", 2);
+}
+
+
+static void ipc_client_run(struct ipc_client *client);
+
+
+static void ipc_config_result(struct ipc_client *client, const char *result, bool ok)
+{
+    struct wlay_ipc *ipc = client->ipc;
+    zwlr_output_configuration_v1_destroy(client->config);
+    client->config = NULL;
+    ipc_record_latency(ipc, client->config_command, client->config_start);
+    if (client->fd < 0) {
+        ipc_client_free(client);
+        return;
+    }
+    if (client->batch && client->result_count > 0) {
+        wlay_buffer_append(&client->out, ",", 1);
+    }
+    client->result_count++;
+    wlay_buffer_printf(&client->out, "{\"ok\":%s,\"result\":\"%s\"}", ok ? "true" : "false", result);
+    client->failed |= !ok;
+    ipc_client_run(client);
+    ipc_client_flush(client);
+}
+
+
+static void handle_config_succeeded(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    struct ipc_client *client = data;
+    const char *source = ipc_command_names[client->config_command];
+    struct wlay_ipc *ipc = client->ipc;
+    ipc_config_result(client, "succeeded", true);
+    wlay_ipc_notify_result(ipc, source, "succeeded");
+}
+
+
+static void handle_config_failed(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    struct ipc_client *client = data;
+    const char *source = ipc_command_names[client->config_command];
+    struct wlay_ipc *ipc = client->ipc;
+    ipc_config_result(client, "failed", false);
+    wlay_ipc_notify_result(ipc, source, "failed");
+}
+
+
+static void handle_config_cancelled(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    struct ipc_client *client = data;
+    const char *source = ipc_command_names[client->config_command];
+    struct wlay_ipc *ipc = client->ipc;
+    ipc_config_result(client, "cancelled", false);
+    wlay_ipc_notify_result(ipc, source, "cancelled");
+}
+
+
+static const struct zwlr_output_configuration_v1_listener ipc_config_listener = {
+    .succeeded = handle_config_succeeded,
+    .failed = handle_config_failed,
+    .cancelled = handle_config_cancelled,
+};
+
+
+static bool ipc_command_configure(struct ipc_client *client, enum ipc_command command,
+                                  struct wlay_buffer *out)
+{
+    struct wlay_state *wlay = client->ipc->wlay;
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->enabled && head->current_mode == NULL &&
+                !(head->custom_mode.enabled && head->custom_mode.valid)) {
+            return ipc_error(out, "%s is enabled without a mode", head->name);
+        }
+    }
+    client->config = wlay_create_configuration(wlay);
+    client->config_command = command;
+    client->config_start = monotonic_time();
+    zwlr_output_configuration_v1_add_listener(client->config, &ipc_config_listener, client);
+    if (command == IPC_COMMAND_TEST) {
+        zwlr_output_configuration_v1_test(client->config);
+    } else {
+        zwlr_output_configuration_v1_apply(client->config);
+    }
+    return true;
+}
+
+
+// Runs one command, false if it failed. The result is written to out,
+// except for test and apply which answer once the compositor did.
+static bool ipc_execute(struct ipc_client *client, char *command, struct wlay_buffer *out)
+{
+    struct wlay_ipc *ipc = client->ipc;
+    command += strspn(command, " \t");
+    size_t length = strcspn(command, " \t");
+    char *args = command + length;
+    args += strspn(args, " \t");
+
+    int type;
+    for (type = 0; type < IPC_COMMAND_COUNT; type++) {
+        if (strlen(ipc_command_names[type]) == length &&
+                !strncmp(command, ipc_command_names[type], length)) {
+            break;
+        }
+    }
+    if (type == IPC_COMMAND_COUNT) {
+        command[length] = '\0';
+        return ipc_error(out, "Unknown command %s", command);
+    }
+    if (type != IPC_COMMAND_SET && *args) {
+        return ipc_error(out, "%s takes no arguments", ipc_command_names[type]);
+    }
+
+    double start = monotonic_time();
+    bool ok = true;
+    switch (type) {
+    case IPC_COMMAND_PING:
+        wlay_buffer_append(out, "{\"ok\":true}", 11);
+        break;
+    case IPC_COMMAND_GET:
+        ok = ipc_command_get(ipc, out);
+        break;
+    case IPC_COMMAND_SET:
+        ok = wlay_ipc_set(ipc->wlay, args, out);
+        break;
+    case IPC_COMMAND_TEST:
+    case IPC_COMMAND_APPLY:
+        // Latency is recorded when the result arrives
+        return ipc_command_configure(client, type, out);
+    case IPC_COMMAND_SUBSCRIBE:
+        client->subscribed = true;
+        wlay_buffer_append(out, "{\"ok\":true}", 11);
+        break;
+    case IPC_COMMAND_STATS:
+        ipc_command_stats(ipc, out);
+        break;
+    case IPC_COMMAND_PROFILES:
+        wlay_buffer_append(out, "{\"ok\":true,\"profiles\":", 22);
+        wlay_profiles_json(out, ipc->wlay->profiles);
+        wlay_buffer_append(out, "}", 1);
+        break;
+    }
+    ipc_record_latency(ipc, type, start);
+    return ok;
+}
+
+
+// Executes the request lines the client sent, until one waits for the
+// compositor
+static void ipc_client_run(struct ipc_client *client)
+{
+    struct wlay_buffer *out = &client->out;
+    while (client->config == NULL) {
+        if (client->line == NULL) {
+            char *end = memchr(client->in.data, '\n', client->in.size);
+            if (end == NULL) {
+                return;
+            }
+            size_t length = end - client->in.data;
+            client->line = xmalloc(length + 1);
+            memcpy(client->line, client->in.data, length);
+            if (length > 0 && client->line[length - 1] == '\r') {
+                length--;
+            }
+            client->line[length] = '\0';
+            wlay_buffer_consume(&client->in, end - client->in.data + 1);
+
+            client->cursor = client->line;
+            client->result_count = 0;
+            client->failed = false;
+            client->batch = strchr(client->line, ';') != NULL;
+            if (client->batch) {
+                wlay_buffer_append(out, "{\"results\":[", 12);
+            }
+        }
+
+        char *command;
+        while ((command = strsep(&client->cursor, ";")) != NULL) {
+            if (command[strspn(command, " \t")] == '\0') {
+                continue;
+            }
+            size_t size = out->size;
+            if (client->batch && client->result_count > 0) {
+                wlay_buffer_append(out, ",", 1);
+            }
+            if (client->failed) {
+                ipc_error(out, "Skipped");
+            } else if (!ipc_execute(client, command, out)) {
+                client->failed = true;
+            }
+            if (client->config != NULL) {
+                // The result is written when the compositor answers
+                out->size = size;
+                return;
+            }
+            client->result_count++;
+        }
+
+        if (client->batch) {
+            wlay_buffer_printf(out, "],\"ok\":%s}", client->failed ? "false" : "true");
+        } else if (client->result_count == 0) {
+            ipc_error(out, "Empty request");
+        }
+        wlay_buffer_append(out, "\n", 1);
+        wlay_buffer_append(out, client->events.data, client->events.size);
+        client->events.size = 0;
+        xfree(client->line);
+        client->line = NULL;
+    }
+}
+
+
+static void ipc_client_read(struct ipc_client *client)
+{
+    for (;;) {
+        wlay_buffer_reserve(&client->in, 4096);
+        ssize_t n = recv(client->fd, client->in.data + client->in.size,
+                         client->in.capacity - client->in.size, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                ipc_client_close(client);
+                return;
+            }
+            break;
+        }
+        if (n == 0) {
+            // The peer may shut down its side right after its last request
+            client->hangup = true;
+            if (client->in.size > 0 && client->in.data[client->in.size - 1] != '\n') {
+                wlay_buffer_append(&client->in, "\n", 1);
+            }
+            ipc_client_run(client);
+            ipc_client_flush(client);
+            return;
+        }
+        client->in.size += n;
+    }
+    ipc_client_run(client);
+    if (client->line == NULL && client->in.size > IPC_MAX_LINE) {
+        ipc_error(&client->out, "Request too long");
+        wlay_buffer_append(&client->out, "\n", 1);
+        client->in.size = 0;
+        client->hangup = true;
+    }
+    ipc_client_flush(client);
+}
+
+
+static void ipc_accept(struct wlay_ipc *ipc)
+{
+    for (;;) {
+        int fd = accept4(ipc->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                log_info("IPC accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        struct ipc_client *client = xmalloc(sizeof(*client));
+        client->ipc = ipc;
+        client->fd = fd;
+        wl_list_insert(&ipc->clients, &client->link);
+        struct epoll_event event = {
+            .events = EPOLLIN,
+            .data.ptr = client,
+        };
+        epoll_ctl(ipc->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+
+const char *wlay_ipc_default_path(void)
+{
+    static char path[PATH_MAX];
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir == NULL || !*runtime_dir) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "%s/wlay.sock", runtime_dir);
+    return path;
+}
+
+
+struct wlay_ipc *wlay_ipc_create(struct wlay_state *wlay, const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_info("IPC socket path %s is too long", path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+
+    // A socket nobody listens at is left over from a crash
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fail("Failed to create the IPC socket: %s", strerror(errno));
+    }
+    bool in_use = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    close(fd);
+    if (in_use) {
+        log_info("Another wlay listens at %s, IPC disabled", path);
+        return NULL;
+    }
+    unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fail("Failed to create the IPC socket: %s", strerror(errno));
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        log_info("Failed to listen at %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    struct wlay_ipc *ipc = xmalloc(sizeof(*ipc));
+    ipc->wlay = wlay;
+    ipc->path = xstrdup(path);
+    ipc->listen_fd = fd;
+    wl_list_init(&ipc->clients);
+    ipc->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (ipc->epoll_fd < 0) {
+        fail("epoll_create1 failed: %s", strerror(errno));
+    }
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    epoll_ctl(ipc->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    log_info("Listening at %s", path);
+    return ipc;
+}
+
+
+void wlay_ipc_destroy(struct wlay_ipc *ipc)
+{
+    if (ipc == NULL) {
+        return;
+    }
+    struct ipc_client *client, *tmp;
+    wl_list_for_each_safe(client, tmp, &ipc->clients, link) {
+        if (client->config != NULL) {
+            zwlr_output_configuration_v1_destroy(client->config);
+            client->config = NULL;
+        }
+        ipc_client_close(client);
+    }
+    close(ipc->epoll_fd);
+    close(ipc->listen_fd);
+    unlink(ipc->path);
+    xfree(ipc->path);
+    xfree(ipc);
+}
+
+
+int wlay_ipc_get_fd(struct wlay_ipc *ipc)
+{
+    return ipc ? ipc->epoll_fd : -1;
+}
+
+
+void wlay_ipc_dispatch(struct wlay_ipc *ipc)
+{
+    if (ipc == NULL) {
+        return;
+    }
+    struct epoll_event events[IPC_MAX_EVENTS];
+    int count = epoll_wait(ipc->epoll_fd, events, IPC_MAX_EVENTS, 0);
+    for (int i = 0; i < count; i++) {
+        struct ipc_client *client = events[i].data.ptr;
+        if (client == NULL) {
+            ipc_accept(ipc);
+        } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            ipc_client_read(client);
+        } else if (events[i].events & EPOLLOUT) {
+            ipc_client_flush(client);
+        }
+    }
+    // Requests may have been sent to the compositor
+    wl_display_flush(ipc->wlay->wl.display);
+}
+
+
+static void ipc_broadcast(struct wlay_ipc *ipc, const char *message, size_t size)
+{
+    struct ipc_client *client, *tmp;
+    wl_list_for_each_safe(client, tmp, &ipc->clients, link) {
+        if (!client->subscribed || client->fd < 0) {
+            continue;
+        }
+        // Never in the middle of a response
+        if (client->line != NULL) {
+            wlay_buffer_append(&client->events, message, size);
+        } else {
+            wlay_buffer_append(&client->out, message, size);
+            ipc_client_flush(client);
+        }
+    }
+}
+
+
+void wlay_ipc_notify_done(struct wlay_ipc *ipc, uint32_t serial)
+{
+    if (ipc == NULL) {
+        return;
+    }
+    char message[64];
+    int size = snprintf(message, sizeof(message),
+                        "{\"event\":\"done\",\"serial\":%u}\n", serial);
+    ipc_broadcast(ipc, message, size);
+}
+
+
+void wlay_ipc_notify_result(struct wlay_ipc *ipc, const char *source, const char *result)
+{
+    if (ipc == NULL) {
+        return;
+    }
+    char message[128];
+    int size = snprintf(message, sizeof(message),
+                        "{\"event\":\"result\",\"source\":\"%s\",\"result\":\"%s\"}\n",
+                        source, result);
+    ipc_broadcast(ipc, message, size);
+}
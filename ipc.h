@@ -0,0 +1,51 @@
+#ifndef WLAY_IPC_H
+#define WLAY_IPC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Control socket for scripts. Every request is one line, several commands
+// can be batched on a line separated by ';'. Every request line gets one
+// JSON line in response, in order:
+//
+//   ping                  does nothing, for measuring round trips
+//   get                   the head and mode model
+//   set NAME KEY=VALUE..  changes a head: enabled=0|1, x=X, y=Y, pos=X,Y,
+//                         mode=WxH[@HZ], transform=NAME, scale=S,
+//                         adaptive_sync=0|1
+//   test, apply           sends the model to the compositor, answers with
+//                         its verdict
+//   subscribe             streams a JSON line for every model update and
+//                         configuration result
+//   stats                 per-command latency statistics
+//   profiles              the saved layouts wlay follows, with how long
+//                         their last reload took
+//
+// A batch stops at the first failing command, its response holds the
+// result of every command. Nothing is rendered in the middle of a batch.
+
+struct wlay_state;
+struct wlay_ipc;
+struct wlay_buffer;
+
+// Listens at path, NULL if it can not (another wlay already listens there)
+struct wlay_ipc *wlay_ipc_create(struct wlay_state *wlay, const char *path);
+void wlay_ipc_destroy(struct wlay_ipc *ipc);
+// Where wlay listens by default, NULL without XDG_RUNTIME_DIR
+const char *wlay_ipc_default_path(void);
+
+// Readable whenever wlay_ipc_dispatch() has something to do, for backends
+// that sleep while idle. -1 for a NULL ipc.
+int wlay_ipc_get_fd(struct wlay_ipc *ipc);
+// Services every client without blocking
+void wlay_ipc_dispatch(struct wlay_ipc *ipc);
+
+// Events for subscribers, ipc may be NULL
+void wlay_ipc_notify_done(struct wlay_ipc *ipc, uint32_t serial);
+void wlay_ipc_notify_result(struct wlay_ipc *ipc, const char *source, const char *result);
+
+// Runs the arguments of a set command against wlay and writes its JSON
+// response into out, for other front ends with the same syntax
+bool wlay_ipc_set(struct wlay_state *wlay, char *args, struct wlay_buffer *out);
+
+#endif
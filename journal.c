@@ -0,0 +1,915 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_GUI
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "snapshot.h"
+#include "journal.h"
+
+// What the journal knows about a head, the mode is its size and refresh
+// rate, 0x0 without one
+enum journal_value {
+    JOURNAL_ENABLED,
+    JOURNAL_MODE_WIDTH,
+    JOURNAL_MODE_HEIGHT,
+    JOURNAL_MODE_REFRESH,
+    JOURNAL_X,
+    JOURNAL_Y,
+    JOURNAL_TRANSFORM,
+    JOURNAL_SCALE,
+    JOURNAL_ADAPTIVE_SYNC,
+    JOURNAL_VALUE_COUNT,
+};
+
+// File layout: the magic, then one record per change to the history, each
+// the record type and its contents. Integers are LEB128 varints like in
+// traces, values zigzag encoded.
+//
+//   name       a head name, referred to by the index it was recorded at
+//   step       an edit: the number of changed values, then for each the
+//              head, the value, what it was and the difference to that
+//   undo, redo move through the edits, a step after an undo drops the
+//              edits that could have been redone
+//   applied    a configuration the compositor took: the number of heads,
+//              then for each the head and all of its values
+//   reverted   forgets the last configuration, the one before it is active
+//              again
+static const char journal_magic[8] = "WLAYJRN1";
+
+enum journal_record {
+    JOURNAL_RECORD_NAME,
+    JOURNAL_RECORD_STEP,
+    JOURNAL_RECORD_UNDO,
+    JOURNAL_RECORD_REDO,
+    JOURNAL_RECORD_APPLIED,
+    JOURNAL_RECORD_REVERTED,
+    JOURNAL_RECORD_COUNT,
+};
+
+struct journal_delta {
+    uint32_t head;
+    uint32_t value;
+    int32_t old;
+    int32_t new;
+};
+
+// An edit, the deltas of a head are next to each other
+struct journal_step {
+    size_t first;
+    size_t count;
+};
+
+struct journal_head_state {
+    uint32_t head;
+    int32_t values[JOURNAL_VALUE_COUNT];
+};
+
+struct journal_applied {
+    size_t count;
+    struct journal_head_state heads[];
+};
+
+struct wlay_journal {
+    struct wlay_state *wlay;
+    char *path;
+    // NULL while reading the history back, and when the file can not be
+    // written, the history is then only kept in memory
+    FILE *file;
+
+    char **names;
+    size_t name_count;
+    size_t name_capacity;
+    // The connected head of every name, for head_count names as of
+    // head_generation
+    struct wlay_head **heads;
+    size_t head_count;
+    uint64_t head_generation;
+
+    // Edits before cursor are done, the ones after it can be redone
+    struct journal_delta *deltas;
+    size_t delta_count;
+    size_t delta_capacity;
+    struct journal_step *steps;
+    size_t step_count;
+    size_t step_capacity;
+    size_t cursor;
+
+    // Oldest first, the last one is active
+    struct journal_applied *applied[WLAY_JOURNAL_MAX_APPLIED];
+    size_t applied_count;
+    // Sent and waiting for the compositor's verdict
+    struct journal_applied *pending;
+    bool reverting;
+
+    // The model as of the last edit
+    struct wlay_snapshot *base;
+    bool rebase;
+};
+
+struct journal_reader {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    bool error;
+};
+
+
+static void journal_put_varint(FILE *f, uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        fputc(byte | (value ? 0x80 : 0), f);
+    } while (value);
+}
+
+
+static void journal_put_int(FILE *f, int32_t value)
+{
+    journal_put_varint(f, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+
+static uint64_t journal_get_varint(struct journal_reader *reader)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && reader->offset < reader->size; shift += 7) {
+        uint8_t byte = reader->data[reader->offset++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    reader->error = true;
+    return 0;
+}
+
+
+static int32_t journal_get_int(struct journal_reader *reader)
+{
+    uint32_t value = journal_get_varint(reader);
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+static void journal_snapshot_values(const struct wlay_snapshot_head *head, int32_t *values)
+{
+    values[JOURNAL_ENABLED] = head->enabled;
+    values[JOURNAL_MODE_WIDTH] = head->mode ? head->mode->width : 0;
+    values[JOURNAL_MODE_HEIGHT] = head->mode ? head->mode->height : 0;
+    values[JOURNAL_MODE_REFRESH] = head->mode ? head->mode->refresh_rate : 0;
+    values[JOURNAL_X] = head->x;
+    values[JOURNAL_Y] = head->y;
+    values[JOURNAL_TRANSFORM] = head->transform;
+    values[JOURNAL_SCALE] = head->scale;
+    values[JOURNAL_ADAPTIVE_SYNC] = head->adaptive_sync;
+}
+
+
+static void journal_head_values(const struct wlay_head *head, int32_t *values)
+{
+    const struct wlay_mode *mode = head->current_mode;
+    values[JOURNAL_ENABLED] = head->enabled;
+    values[JOURNAL_MODE_WIDTH] = mode ? mode->width : 0;
+    values[JOURNAL_MODE_HEIGHT] = mode ? mode->height : 0;
+    values[JOURNAL_MODE_REFRESH] = mode ? mode->refresh_rate : 0;
+    values[JOURNAL_X] = head->x;
+    values[JOURNAL_Y] = head->y;
+    values[JOURNAL_TRANSFORM] = head->transform;
+    values[JOURNAL_SCALE] = head->scale;
+    values[JOURNAL_ADAPTIVE_SYNC] = head->adaptive_sync;
+}
+
+
+static void journal_set_head(struct wlay_head *head, const int32_t *values)
+{
+    head->enabled = values[JOURNAL_ENABLED];
+    if (values[JOURNAL_MODE_WIDTH] == 0) {
+        head->current_mode = NULL;
+    } else {
+        // A mode the head no longer has keeps the current one
+        struct wlay_mode *mode;
+        wl_list_for_each(mode, &head->modes, link) {
+            if (mode->width == values[JOURNAL_MODE_WIDTH] &&
+                    mode->height == values[JOURNAL_MODE_HEIGHT] &&
+                    mode->refresh_rate == values[JOURNAL_MODE_REFRESH]) {
+                head->current_mode = mode;
+                break;
+            }
+        }
+    }
+    // The recorded mode may be gone, an enabled head takes the one the
+    // policy picks and stays off without any
+    if (head->enabled && head->current_mode == NULL &&
+            !(head->custom_mode.enabled && head->custom_mode.valid)) {
+        head->current_mode = wlay_head_best_mode(head, &head->wlay->mode_policy);
+        head->enabled = head->current_mode != NULL;
+    }
+    if (head->enabled && values[JOURNAL_SCALE] == 0) {
+        head->scale = wl_fixed_from_int(1);
+    } else {
+        head->scale = values[JOURNAL_SCALE];
+    }
+    head->x = values[JOURNAL_X];
+    head->y = values[JOURNAL_Y];
+    head->transform = values[JOURNAL_TRANSFORM];
+    head->adaptive_sync = head->adaptive_sync_supported && values[JOURNAL_ADAPTIVE_SYNC];
+    if (!head->enabled && head->focused) {
+        head->focused = false;
+        head->wlay->focused = NULL;
+    }
+}
+
+
+// Looks the connected head of every name up once per set of heads
+static struct wlay_head *journal_find_head(struct wlay_journal *journal, uint32_t index)
+{
+    struct wlay_state *wlay = journal->wlay;
+    if (journal->head_count != journal->name_count ||
+            journal->head_generation != wlay->head_generation) {
+        journal->heads = xrealloc(journal->heads, journal->name_capacity * sizeof(*journal->heads));
+        memset(journal->heads, 0, journal->name_count * sizeof(*journal->heads));
+        struct wlay_head *head;
+        wl_list_for_each(head, &wlay->wl.heads, link) {
+            for (size_t i = 0; head->name != NULL && i < journal->name_count; i++) {
+                if (!strcmp(head->name, journal->names[i])) {
+                    journal->heads[i] = head;
+                    break;
+                }
+            }
+        }
+        journal->head_count = journal->name_count;
+        journal->head_generation = wlay->head_generation;
+    }
+    return journal->heads[index];
+}
+
+
+static void journal_write_name(FILE *f, const char *name)
+{
+    size_t length = strlen(name);
+    journal_put_varint(f, JOURNAL_RECORD_NAME);
+    journal_put_varint(f, length);
+    fwrite(name, 1, length, f);
+}
+
+
+static void journal_write_step(FILE *f, struct wlay_journal *journal,
+                               const struct journal_step *step)
+{
+    journal_put_varint(f, JOURNAL_RECORD_STEP);
+    journal_put_varint(f, step->count);
+    for (size_t i = step->first; i < step->first + step->count; i++) {
+        const struct journal_delta *delta = &journal->deltas[i];
+        journal_put_varint(f, delta->head);
+        journal_put_varint(f, delta->value);
+        journal_put_int(f, delta->old);
+        journal_put_int(f, (uint32_t)delta->new - (uint32_t)delta->old);
+    }
+}
+
+
+static void journal_write_applied(FILE *f, const struct journal_applied *applied)
+{
+    journal_put_varint(f, JOURNAL_RECORD_APPLIED);
+    journal_put_varint(f, applied->count);
+    for (size_t i = 0; i < applied->count; i++) {
+        journal_put_varint(f, applied->heads[i].head);
+        for (int value = 0; value < JOURNAL_VALUE_COUNT; value++) {
+            journal_put_int(f, applied->heads[i].values[value]);
+        }
+    }
+}
+
+
+// Replaces the file with one holding just the history in memory
+static void journal_compact(struct wlay_journal *journal)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s.tmp", journal->path);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        log_info("Failed to write %s", path);
+        return;
+    }
+    fwrite(journal_magic, sizeof(journal_magic), 1, f);
+    for (size_t i = 0; i < journal->name_count; i++) {
+        journal_write_name(f, journal->names[i]);
+    }
+    for (size_t i = 0; i < journal->applied_count; i++) {
+        journal_write_applied(f, journal->applied[i]);
+    }
+    for (size_t i = 0; i < journal->step_count; i++) {
+        journal_write_step(f, journal, &journal->steps[i]);
+    }
+    for (size_t i = journal->cursor; i < journal->step_count; i++) {
+        journal_put_varint(f, JOURNAL_RECORD_UNDO);
+    }
+    if (fflush(f) != 0 || rename(path, journal->path) < 0) {
+        log_info("Failed to write %s", path);
+        fclose(f);
+        return;
+    }
+    if (journal->file != NULL) {
+        fclose(journal->file);
+    }
+    journal->file = f;
+}
+
+
+// Makes whatever was appended to the file last stick
+static void journal_sync(struct wlay_journal *journal)
+{
+    if (journal->file == NULL) {
+        return;
+    }
+    fflush(journal->file);
+    if (ftell(journal->file) > WLAY_JOURNAL_MAX_SIZE) {
+        journal_compact(journal);
+    }
+}
+
+
+// Appends a record without contents
+static void journal_write_record(struct wlay_journal *journal, enum journal_record record)
+{
+    if (journal->file != NULL) {
+        journal_put_varint(journal->file, record);
+        journal_sync(journal);
+    }
+}
+
+
+static uint32_t journal_intern(struct wlay_journal *journal, const char *name)
+{
+    for (size_t i = 0; i < journal->name_count; i++) {
+        if (!strcmp(journal->names[i], name)) {
+            return i;
+        }
+    }
+    if (journal->name_count == journal->name_capacity) {
+        journal->name_capacity = journal->name_capacity ? journal->name_capacity * 2 : 16;
+        journal->names = xrealloc(journal->names, journal->name_capacity * sizeof(*journal->names));
+    }
+    journal->names[journal->name_count] = xstrdup(name);
+    if (journal->file != NULL) {
+        journal_write_name(journal->file, name);
+    }
+    return journal->name_count++;
+}
+
+
+static void journal_reserve_deltas(struct wlay_journal *journal, size_t count)
+{
+    if (count > journal->delta_capacity) {
+        journal->delta_capacity = max(count, journal->delta_capacity * 2);
+        journal->deltas = xrealloc(journal->deltas,
+                                   journal->delta_capacity * sizeof(*journal->deltas));
+    }
+}
+
+
+// Where the deltas of a new edit go, after the last one that is done
+static size_t journal_step_start(struct wlay_journal *journal)
+{
+    return journal->cursor < journal->step_count ?
+        journal->steps[journal->cursor].first : journal->delta_count;
+}
+
+
+// Makes the deltas from first to end the last edit, dropping the ones that
+// could have been redone and the oldest ones once there are too many
+static void journal_add_step(struct wlay_journal *journal, size_t first, size_t end)
+{
+    journal->delta_count = end;
+    journal->step_count = journal->cursor;
+    if (journal->step_count == journal->step_capacity) {
+        journal->step_capacity = journal->step_capacity ? journal->step_capacity * 2 : 64;
+        journal->steps = xrealloc(journal->steps, journal->step_capacity * sizeof(*journal->steps));
+    }
+    journal->steps[journal->step_count++] = (struct journal_step){
+        .first = first,
+        .count = end - first,
+    };
+    journal->cursor = journal->step_count;
+
+    if (journal->step_count > WLAY_JOURNAL_MAX_STEPS) {
+        size_t drop = journal->step_count / 2;
+        size_t shift = journal->steps[drop].first;
+        memmove(journal->deltas, journal->deltas + shift,
+                (journal->delta_count - shift) * sizeof(*journal->deltas));
+        journal->delta_count -= shift;
+        memmove(journal->steps, journal->steps + drop,
+                (journal->step_count - drop) * sizeof(*journal->steps));
+        journal->step_count -= drop;
+        journal->cursor -= drop;
+        for (size_t i = 0; i < journal->step_count; i++) {
+            journal->steps[i].first -= shift;
+        }
+    }
+}
+
+
+static bool journal_applied_equal(const struct journal_applied *a,
+                                  const struct journal_applied *b)
+{
+    return a->count == b->count && !memcmp(a->heads, b->heads, a->count * sizeof(a->heads[0]));
+}
+
+
+// Takes applied, false if it is the active configuration already
+static bool journal_add_applied(struct wlay_journal *journal, struct journal_applied *applied)
+{
+    if (journal->applied_count > 0 &&
+            journal_applied_equal(journal->applied[journal->applied_count - 1], applied)) {
+        xfree(applied);
+        return false;
+    }
+    if (journal->applied_count == WLAY_JOURNAL_MAX_APPLIED) {
+        xfree(journal->applied[0]);
+        memmove(journal->applied, journal->applied + 1,
+                (WLAY_JOURNAL_MAX_APPLIED - 1) * sizeof(journal->applied[0]));
+        journal->applied_count--;
+    }
+    journal->applied[journal->applied_count++] = applied;
+    return true;
+}
+
+
+static void journal_drop_applied(struct wlay_journal *journal)
+{
+    if (journal->applied_count > 0) {
+        xfree(journal->applied[--journal->applied_count]);
+    }
+}
+
+
+// The configuration of every named head in the model
+static struct journal_applied *journal_capture(struct wlay_journal *journal)
+{
+    size_t count = wl_list_length(&journal->wlay->wl.heads);
+    struct journal_applied *applied = xmalloc(sizeof(*applied) + count * sizeof(applied->heads[0]));
+    struct wlay_head *head;
+    wl_list_for_each_reverse(head, &journal->wlay->wl.heads, link) {
+        if (head->name == NULL) {
+            continue;
+        }
+        struct journal_head_state *state = &applied->heads[applied->count++];
+        state->head = journal_intern(journal, head->name);
+        journal_head_values(head, state->values);
+    }
+    return applied;
+}
+
+
+// Whether a value read from the file is one a head can have
+static bool journal_value_valid(enum journal_value value, int32_t v)
+{
+    switch (value) {
+    case JOURNAL_ENABLED:
+    case JOURNAL_ADAPTIVE_SYNC:
+        return v == 0 || v == 1;
+    case JOURNAL_MODE_WIDTH:
+    case JOURNAL_MODE_HEIGHT:
+    case JOURNAL_MODE_REFRESH:
+    case JOURNAL_SCALE:
+        return v >= 0;
+    case JOURNAL_TRANSFORM:
+        return v >= 0 && (size_t)v < ARRAY_SIZE(wlay_output_transform_names);
+    default:
+        return true;
+    }
+}
+
+
+static bool journal_read_step(struct wlay_journal *journal, struct journal_reader *reader)
+{
+    uint64_t count = journal_get_varint(reader);
+    if (count == 0 || count > reader->size - reader->offset) {
+        return false;
+    }
+    size_t first = journal_step_start(journal);
+    journal_reserve_deltas(journal, first + count);
+    for (size_t i = first; i < first + count; i++) {
+        struct journal_delta *delta = &journal->deltas[i];
+        delta->head = journal_get_varint(reader);
+        delta->value = journal_get_varint(reader);
+        delta->old = journal_get_int(reader);
+        delta->new = (uint32_t)delta->old + (uint32_t)journal_get_int(reader);
+        if (reader->error || delta->head >= journal->name_count ||
+                delta->value >= JOURNAL_VALUE_COUNT ||
+                !journal_value_valid(delta->value, delta->old) ||
+                !journal_value_valid(delta->value, delta->new)) {
+            return false;
+        }
+    }
+    journal_add_step(journal, first, first + count);
+    return true;
+}
+
+
+static bool journal_read_applied(struct wlay_journal *journal, struct journal_reader *reader)
+{
+    uint64_t count = journal_get_varint(reader);
+    if (count > reader->size - reader->offset) {
+        return false;
+    }
+    struct journal_applied *applied = xmalloc(sizeof(*applied) + count * sizeof(applied->heads[0]));
+    applied->count = count;
+    for (size_t i = 0; i < count; i++) {
+        applied->heads[i].head = journal_get_varint(reader);
+        bool valid = true;
+        for (int value = 0; value < JOURNAL_VALUE_COUNT; value++) {
+            applied->heads[i].values[value] = journal_get_int(reader);
+            valid &= journal_value_valid(value, applied->heads[i].values[value]);
+        }
+        if (reader->error || !valid || applied->heads[i].head >= journal->name_count) {
+            xfree(applied);
+            return false;
+        }
+    }
+    journal_add_applied(journal, applied);
+    return true;
+}
+
+
+static bool journal_read_record(struct wlay_journal *journal, struct journal_reader *reader)
+{
+    uint64_t record = journal_get_varint(reader);
+    if (reader->error) {
+        return false;
+    }
+    switch (record) {
+    case JOURNAL_RECORD_NAME: {
+        uint64_t length = journal_get_varint(reader);
+        if (reader->error || length > reader->size - reader->offset) {
+            return false;
+        }
+        char *name = xstrndup((const char *)reader->data + reader->offset, length);
+        reader->offset += length;
+        journal_intern(journal, name);
+        xfree(name);
+        return true;
+    }
+    case JOURNAL_RECORD_STEP:
+        return journal_read_step(journal, reader);
+    case JOURNAL_RECORD_UNDO:
+        if (journal->cursor > 0) {
+            journal->cursor--;
+        }
+        return true;
+    case JOURNAL_RECORD_REDO:
+        if (journal->cursor < journal->step_count) {
+            journal->cursor++;
+        }
+        return true;
+    case JOURNAL_RECORD_APPLIED:
+        return journal_read_applied(journal, reader);
+    case JOURNAL_RECORD_REVERTED:
+        journal_drop_applied(journal);
+        return true;
+    }
+    return false;
+}
+
+
+// Reads the history back, false if the file has to be rewritten
+static bool journal_load(struct wlay_journal *journal)
+{
+    FILE *f = fopen(journal->path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    uint8_t *data = NULL;
+    size_t size = 0, capacity = 0;
+    for (;;) {
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            data = xrealloc(data, capacity);
+        }
+        size_t n = fread(data + size, 1, capacity - size, f);
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    fclose(f);
+
+    struct journal_reader reader = {
+        .data = data,
+        .size = size,
+        .offset = sizeof(journal_magic),
+    };
+    if (size < sizeof(journal_magic) || memcmp(data, journal_magic, sizeof(journal_magic))) {
+        log_info("%s is not a wlay journal, starting a new one", journal->path);
+        xfree(data);
+        return false;
+    }
+    // A record cut short by a crash ends the history, everything up to
+    // it is still good
+    bool complete = true;
+    while (reader.offset < reader.size && complete) {
+        complete = journal_read_record(journal, &reader);
+    }
+    if (!complete) {
+        log_info("%s is damaged after %zu bytes", journal->path, reader.offset);
+    }
+    xfree(data);
+    return complete && size <= WLAY_JOURNAL_MAX_SIZE;
+}
+
+
+// Takes the model as it is now as the state before the next edit
+static void journal_rebase(struct wlay_journal *journal)
+{
+    struct wlay_snapshot *snapshot = wlay_snapshot_update(journal->wlay);
+    if (snapshot != journal->base) {
+        wlay_snapshot_unref(journal->base);
+        journal->base = wlay_snapshot_ref(snapshot);
+    }
+    journal->rebase = false;
+}
+
+
+// Creates the directories up to the file like mkdir -p, only accessible
+// to the user as the history tells what they connected
+static void journal_make_parents(const char *path)
+{
+    char *dirs = xstrdup(path);
+    for (char *slash = strchr(dirs + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(dirs, 0700) < 0 && errno != EEXIST) {
+            log_info("Can not create %s: %s", dirs, strerror(errno));
+            break;
+        }
+        *slash = '/';
+    }
+    xfree(dirs);
+}
+
+
+struct wlay_journal *wlay_journal_create(struct wlay_state *wlay, const char *path)
+{
+    struct wlay_journal *journal = xmalloc(sizeof(*journal));
+    journal->wlay = wlay;
+    journal->path = xstrdup(path);
+    if (journal_load(journal)) {
+        journal->file = fopen(path, "ab");
+    } else {
+        journal_make_parents(path);
+        journal_compact(journal);
+    }
+    if (journal->file == NULL) {
+        log_info("Can not write the journal to %s, the history is lost on exit", path);
+    }
+    log_info("Journal %s: %zu edits, %zu configurations", path,
+             journal->step_count, journal->applied_count);
+
+    // Whatever the compositor runs right now is known to work
+    struct journal_applied *applied = journal_capture(journal);
+    if (journal_add_applied(journal, applied) && journal->file != NULL) {
+        journal_write_applied(journal->file, applied);
+        journal_sync(journal);
+    }
+    journal_rebase(journal);
+    return journal;
+}
+
+
+void wlay_journal_destroy(struct wlay_journal *journal)
+{
+    if (journal == NULL) {
+        return;
+    }
+    if (journal->file != NULL) {
+        fclose(journal->file);
+    }
+    for (size_t i = 0; i < journal->name_count; i++) {
+        xfree(journal->names[i]);
+    }
+    while (journal->applied_count > 0) {
+        journal_drop_applied(journal);
+    }
+    xfree(journal->pending);
+    wlay_snapshot_unref(journal->base);
+    xfree(journal->names);
+    xfree(journal->heads);
+    xfree(journal->deltas);
+    xfree(journal->steps);
+    xfree(journal->path);
+    xfree(journal);
+}
+
+
+const char *wlay_journal_default_path(void)
+{
+    static char path[PATH_MAX];
+    const char *state_dir = getenv("XDG_STATE_HOME");
+    if (state_dir != NULL && *state_dir) {
+        snprintf(path, sizeof(path), "%s/wlay.journal", state_dir);
+        return path;
+    }
+    const char *home = getenv("HOME");
+    if (home == NULL || !*home) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "%s/.local/state/wlay.journal", home);
+    return path;
+}
+
+
+void wlay_journal_done(struct wlay_journal *journal)
+{
+    if (journal != NULL) {
+        journal->rebase = true;
+    }
+}
+
+
+void wlay_journal_track(struct wlay_journal *journal)
+{
+    if (journal == NULL) {
+        return;
+    }
+    struct wlay_snapshot *base = journal->base;
+    struct wlay_snapshot *snapshot = wlay_snapshot_update(journal->wlay);
+    if (snapshot == base || journal->rebase) {
+        journal_rebase(journal);
+        return;
+    }
+
+    // Heads that did not change are the same in both snapshots, everything
+    // else is compared by name since heads may come and go
+    size_t first = journal_step_start(journal);
+    size_t end = first;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const struct wlay_snapshot_head *head = snapshot->heads[i];
+        const struct wlay_snapshot_head *old = i < base->count ? base->heads[i] : NULL;
+        if (head == old || head->name == NULL) {
+            continue;
+        }
+        if (old == NULL || old->name == NULL || strcmp(old->name, head->name)) {
+            old = NULL;
+            for (size_t j = 0; j < base->count && old == NULL; j++) {
+                if (base->heads[j]->name != NULL && !strcmp(base->heads[j]->name, head->name)) {
+                    old = base->heads[j];
+                }
+            }
+            if (old == NULL) {
+                continue;
+            }
+        }
+        int32_t before[JOURNAL_VALUE_COUNT], after[JOURNAL_VALUE_COUNT];
+        journal_snapshot_values(old, before);
+        journal_snapshot_values(head, after);
+        uint32_t index = UINT32_MAX;
+        for (int value = 0; value < JOURNAL_VALUE_COUNT; value++) {
+            if (before[value] == after[value]) {
+                continue;
+            }
+            if (index == UINT32_MAX) {
+                index = journal_intern(journal, head->name);
+            }
+            journal_reserve_deltas(journal, end + 1);
+            journal->deltas[end++] = (struct journal_delta){
+                .head = index,
+                .value = value,
+                .old = before[value],
+                .new = after[value],
+            };
+        }
+    }
+    journal_rebase(journal);
+    if (end == first) {
+        return;
+    }
+    journal_add_step(journal, first, end);
+    if (journal->file != NULL) {
+        journal_write_step(journal->file, journal, &journal->steps[journal->step_count - 1]);
+        journal_sync(journal);
+    }
+}
+
+
+static void journal_apply_step(struct wlay_journal *journal, const struct journal_step *step,
+                               bool undo)
+{
+    size_t i = step->first, end = step->first + step->count;
+    while (i < end) {
+        uint32_t index = journal->deltas[i].head;
+        struct wlay_head *head = journal_find_head(journal, index);
+        int32_t values[JOURNAL_VALUE_COUNT];
+        if (head != NULL) {
+            journal_head_values(head, values);
+        }
+        for (; i < end && journal->deltas[i].head == index; i++) {
+            const struct journal_delta *delta = &journal->deltas[i];
+            values[delta->value] = undo ? delta->old : delta->new;
+        }
+        if (head != NULL) {
+            journal_set_head(head, values);
+        }
+    }
+    wlay_model_changed(journal->wlay);
+    journal_rebase(journal);
+}
+
+
+bool wlay_journal_can_undo(struct wlay_journal *journal)
+{
+    return journal != NULL && journal->cursor > 0;
+}
+
+
+bool wlay_journal_can_redo(struct wlay_journal *journal)
+{
+    return journal != NULL && journal->cursor < journal->step_count;
+}
+
+
+void wlay_journal_undo(struct wlay_journal *journal)
+{
+    if (!wlay_journal_can_undo(journal)) {
+        return;
+    }
+    journal_apply_step(journal, &journal->steps[--journal->cursor], true);
+    journal_write_record(journal, JOURNAL_RECORD_UNDO);
+}
+
+
+void wlay_journal_redo(struct wlay_journal *journal)
+{
+    if (!wlay_journal_can_redo(journal)) {
+        return;
+    }
+    journal_apply_step(journal, &journal->steps[journal->cursor++], false);
+    journal_write_record(journal, JOURNAL_RECORD_REDO);
+}
+
+
+void wlay_journal_push(struct wlay_journal *journal)
+{
+    if (journal == NULL) {
+        return;
+    }
+    xfree(journal->pending);
+    journal->pending = journal_capture(journal);
+    journal->reverting = false;
+}
+
+
+void wlay_journal_result(struct wlay_journal *journal, const char *result)
+{
+    if (journal == NULL || journal->pending == NULL) {
+        return;
+    }
+    if (strcmp(result, "succeeded")) {
+        xfree(journal->pending);
+    } else if (journal->reverting) {
+        xfree(journal->pending);
+        journal_drop_applied(journal);
+        journal_write_record(journal, JOURNAL_RECORD_REVERTED);
+    } else if (journal_add_applied(journal, journal->pending) && journal->file != NULL) {
+        journal_write_applied(journal->file, journal->pending);
+        journal_sync(journal);
+    }
+    journal->pending = NULL;
+    journal->reverting = false;
+}
+
+
+bool wlay_journal_can_revert(struct wlay_journal *journal)
+{
+    return journal != NULL && journal->applied_count > 1;
+}
+
+
+void wlay_journal_revert(struct wlay_journal *journal)
+{
+    if (!wlay_journal_can_revert(journal)) {
+        return;
+    }
+    log_info("Reverting to the previous configuration");
+    // Heads that are not connected any more are left out, the ones that
+    // were not back then stay as they are
+    const struct journal_applied *applied = journal->applied[journal->applied_count - 2];
+    for (size_t i = 0; i < applied->count; i++) {
+        struct wlay_head *head = journal_find_head(journal, applied->heads[i].head);
+        if (head != NULL) {
+            journal_set_head(head, applied->heads[i].values);
+        }
+    }
+    wlay_model_changed(journal->wlay);
+    wlay_journal_push(journal);
+    journal->reverting = true;
+    wlay_push_settings(journal->wlay);
+}
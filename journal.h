@@ -0,0 +1,56 @@
+#ifndef WLAY_JOURNAL_H
+#define WLAY_JOURNAL_H
+
+#include <stdbool.h>
+
+// History of the layout: every edit made in the editor as the fields it
+// changed, and every configuration the compositor took. Undo and redo step
+// through the edits, revert applies the configuration that was active
+// before the last one again.
+//
+// The history is appended to a file as it grows and read back at startup,
+// so the last known good configuration survives wlay. The file is rewritten
+// from the history in memory whenever it outgrows WLAY_JOURNAL_MAX_SIZE,
+// the history itself keeps at most WLAY_JOURNAL_MAX_STEPS edits and
+// WLAY_JOURNAL_MAX_APPLIED configurations.
+
+#define WLAY_JOURNAL_MAX_SIZE (256 * 1024)
+#define WLAY_JOURNAL_MAX_STEPS 512
+#define WLAY_JOURNAL_MAX_APPLIED 8
+
+struct wlay_state;
+struct wlay_journal;
+
+// Reads the history in path and keeps appending to it, creating the
+// directories to it. Without a file that can be written the history is
+// only kept in memory.
+struct wlay_journal *wlay_journal_create(struct wlay_state *wlay, const char *path);
+void wlay_journal_destroy(struct wlay_journal *journal);
+// $XDG_STATE_HOME/wlay.journal, NULL without a state or home directory
+const char *wlay_journal_default_path(void);
+
+// The model changed under the editor, what it is now after the next
+// wlay_journal_track() is not an edit. journal may be NULL.
+void wlay_journal_done(struct wlay_journal *journal);
+// Records whatever changed in the model since the last call as one edit.
+// Called once the editor is done with a frame and nothing is being
+// dragged, so that a drag is a single edit.
+void wlay_journal_track(struct wlay_journal *journal);
+
+bool wlay_journal_can_undo(struct wlay_journal *journal);
+bool wlay_journal_can_redo(struct wlay_journal *journal);
+// Set the model back to what it was before the last edit and forth again
+void wlay_journal_undo(struct wlay_journal *journal);
+void wlay_journal_redo(struct wlay_journal *journal);
+
+// To be called right before wlay_push_settings() and with its result,
+// journal may be NULL
+void wlay_journal_push(struct wlay_journal *journal);
+void wlay_journal_result(struct wlay_journal *journal, const char *result);
+// Whether there is a configuration before the current one
+bool wlay_journal_can_revert(struct wlay_journal *journal);
+// Sets the model to the configuration before the current one and applies
+// it. Once the compositor took it, the current one is forgotten.
+void wlay_journal_revert(struct wlay_journal *journal);
+
+#endif
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_EXPORT
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "snapshot.h"
+#include "json.h"
+
+
+void wlay_buffer_reserve(struct wlay_buffer *buffer, size_t size)
+{
+    if (buffer->size + size > buffer->capacity) {
+        buffer->capacity = max(buffer->capacity * 2, buffer->size + size);
+        buffer->data = xrealloc(buffer->data, buffer->capacity);
+    }
+}
+
+
+void wlay_buffer_append(struct wlay_buffer *buffer, const char *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    wlay_buffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+
+void wlay_buffer_consume(struct wlay_buffer *buffer, size_t size)
+{
+    memmove(buffer->data, buffer->data + size, buffer->size - size);
+    buffer->size -= size;
+}
+
+
+void wlay_buffer_printf(struct wlay_buffer *buffer, const char *format, ...)
+{
+    va_list vas;
+    va_start(vas, format);
+    int length = vsnprintf(NULL, 0, format, vas);
+    va_end(vas);
+
+    wlay_buffer_reserve(buffer, length + 1);
+    va_start(vas, format);
+    vsnprintf(buffer->data + buffer->size, length + 1, format, vas);
+    va_end(vas);
+    buffer->size += length;
+}
+
+
+void wlay_buffer_finish(struct wlay_buffer *buffer)
+{
+    xfree(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+
+void wlay_json_string(struct wlay_buffer *buffer, const char *s)
+{
+    if (s == NULL) {
+        wlay_buffer_append(buffer, "null", 4);
+        return;
+    }
+    wlay_buffer_append(buffer, "\"", 1);
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            wlay_buffer_printf(buffer, "\\%c", c);
+        } else if (c < 0x20) {
+            wlay_buffer_printf(buffer, "\\u%04x", c);
+        } else {
+            wlay_buffer_append(buffer, (const char *)&c, 1);
+        }
+    }
+    wlay_buffer_append(buffer, "\"", 1);
+}
+
+
+// Leaves the object open for more members
+static void json_mode(struct wlay_buffer *buffer, int32_t width, int32_t height,
+                      int32_t refresh_rate)
+{
+    wlay_buffer_printf(buffer, "{\"width\":%d,\"height\":%d,\"refresh\":%.3f",
+                       width, height, refresh_rate / 1000.0);
+}
+
+
+void wlay_json_snapshot(struct wlay_buffer *buffer, const struct wlay_snapshot *snapshot)
+{
+    wlay_buffer_append(buffer, "[", 1);
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const struct wlay_snapshot_head *head = snapshot->heads[i];
+        if (i > 0) {
+            wlay_buffer_append(buffer, ",", 1);
+        }
+        wlay_buffer_append(buffer, "{\"name\":", 8);
+        wlay_json_string(buffer, head->name);
+        wlay_buffer_append(buffer, ",\"description\":", 15);
+        wlay_json_string(buffer, head->description);
+        wlay_buffer_append(buffer, ",\"make\":", 8);
+        wlay_json_string(buffer, head->make);
+        wlay_buffer_append(buffer, ",\"model\":", 9);
+        wlay_json_string(buffer, head->model);
+        wlay_buffer_append(buffer, ",\"serial_number\":", 17);
+        wlay_json_string(buffer, head->serial_number);
+        wlay_buffer_printf(buffer, ",\"enabled\":%s,\"x\":%d,\"y\":%d,\"transform\":\"%s\","
+                           "\"scale\":%.3f,\"physical_width\":%d,\"physical_height\":%d,",
+                           head->enabled ? "true" : "false", head->x, head->y,
+                           wlay_output_transform_names[head->transform],
+                           wl_fixed_to_double(head->scale),
+                           head->physical_width, head->physical_height);
+        if (head->adaptive_sync_supported) {
+            wlay_buffer_printf(buffer, "\"adaptive_sync\":%s,",
+                               head->adaptive_sync ? "true" : "false");
+        } else {
+            wlay_buffer_printf(buffer, "\"adaptive_sync\":null,");
+        }
+
+        wlay_buffer_append(buffer, "\"mode\":", 7);
+        if (head->custom) {
+            json_mode(buffer, head->custom_timing.hdisplay, head->custom_timing.vdisplay,
+                      head->custom_timing.refresh_rate);
+            wlay_buffer_append(buffer, ",\"custom\":true}", 15);
+        } else if (head->mode != NULL) {
+            json_mode(buffer, head->mode->width, head->mode->height, head->mode->refresh_rate);
+            wlay_buffer_append(buffer, "}", 1);
+        } else {
+            wlay_buffer_append(buffer, "null", 4);
+        }
+
+        wlay_buffer_append(buffer, ",\"modes\":[", 10);
+        for (size_t m = 0; m < head->modes->count; m++) {
+            const struct wlay_snapshot_mode *mode = &head->modes->modes[m];
+            if (m > 0) {
+                wlay_buffer_append(buffer, ",", 1);
+            }
+            json_mode(buffer, mode->width, mode->height, mode->refresh_rate);
+            wlay_buffer_printf(buffer, ",\"preferred\":%s}", mode->preferred ? "true" : "false");
+        }
+        wlay_buffer_append(buffer, "]}", 2);
+    }
+    wlay_buffer_append(buffer, "]", 1);
+}
+
+
+void wlay_json_heads(struct wlay_buffer *buffer, struct wlay_state *wlay)
+{
+    wlay_json_snapshot(buffer, wlay_snapshot_update(wlay));
+}
@@ -0,0 +1,31 @@
+#ifndef WLAY_JSON_H
+#define WLAY_JSON_H
+
+#include <stddef.h>
+
+struct wlay_state;
+struct wlay_snapshot;
+
+// Growable byte buffer, zero-initialized is empty
+struct wlay_buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+void wlay_buffer_reserve(struct wlay_buffer *buffer, size_t size);
+void wlay_buffer_append(struct wlay_buffer *buffer, const char *data, size_t size);
+// Drops size bytes from the front
+void wlay_buffer_consume(struct wlay_buffer *buffer, size_t size);
+__attribute__((format(printf, 2, 3)))
+void wlay_buffer_printf(struct wlay_buffer *buffer, const char *format, ...);
+void wlay_buffer_finish(struct wlay_buffer *buffer);
+
+// A JSON string, or null
+void wlay_json_string(struct wlay_buffer *buffer, const char *s);
+// A JSON array of every head with its modes, oldest head first
+void wlay_json_snapshot(struct wlay_buffer *buffer, const struct wlay_snapshot *snapshot);
+// The same for the model as it is now
+void wlay_json_heads(struct wlay_buffer *buffer, struct wlay_state *wlay);
+
+#endif
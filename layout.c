@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wayland-client.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "layout.h"
+
+void wlay_layout_measure(struct wlay_state *wlay)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled) {
+            continue;
+        }
+        int32_t mode_width, mode_height;
+        if (!wlay_head_mode_size(head, &mode_width, &mode_height)) {
+            continue;
+        }
+        int32_t w, h;
+        switch(head->transform) {
+        case WL_OUTPUT_TRANSFORM_NORMAL:
+        case WL_OUTPUT_TRANSFORM_180:
+        case WL_OUTPUT_TRANSFORM_FLIPPED:
+        case WL_OUTPUT_TRANSFORM_FLIPPED_180:
+            w = mode_width;
+            h = mode_height;
+            break;
+        case WL_OUTPUT_TRANSFORM_90:
+        case WL_OUTPUT_TRANSFORM_FLIPPED_90:
+            w = mode_height;
+            h = mode_width;
+            break;
+        case WL_OUTPUT_TRANSFORM_270:
+        case WL_OUTPUT_TRANSFORM_FLIPPED_270:
+            w = mode_height;
+            h = mode_width;
+            break;
+        default:
+            w = mode_width;
+            h = mode_height;
+            log_info("Transform %d not implemented", head->transform);
+            break;
+        }
+        head->h = h;
+        head->w = w;
+    }
+}
+
+
+bool wlay_layout_normalize(struct wlay_state *wlay, int32_t *width, int32_t *height)
+{
+    int32_t min_x = INT32_MAX;
+    int32_t max_x = INT32_MIN;
+    int32_t min_y = INT32_MAX;
+    int32_t max_y = INT32_MIN;
+
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled) {
+            continue;
+        }
+        min_x = min(min_x, head->x);
+        max_x = max(max_x, head->x + head->w);
+        min_y = min(min_y, head->y);
+        max_y = max(max_y, head->y + head->h);
+    }
+    if (min_x > max_x) {
+        return false;
+    }
+    // Now we shift everything to be based on 0,0
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        head->x -= min_x;
+        head->y -= min_y;
+    }
+    *width = max_x - min_x;
+    *height = max_y - min_y;
+    return true;
+}
+
+
+void wlay_layout_snap(struct wlay_state *wlay, struct wlay_head *head, int32_t threshold)
+{
+    // Compute snap points
+    struct wlay_head *other;
+    int32_t best_delta_x = INT32_MAX;
+    int32_t best_delta_y = INT32_MAX;
+    int32_t best_x;
+    int32_t best_y;
+    wl_list_for_each(other, &wlay->wl.heads, link) {
+        if (other == head) {
+            continue;
+        }
+        bool x_feasible = (head->y + head->h) > other->y &&
+            head->y < (other->y + other->h);
+        int32_t x_snaps[2] = {
+            other->x + other->w, other->x - head->w
+        };
+        bool y_feasible = (head->x + head->w) > other->x &&
+            head->x < (other->x + other->w);
+        int32_t y_snaps[2] = {
+            // Top border to bottom border
+            other->y + other->h,
+            // Bottom border to top border
+            other->y - head->h
+        };
+        _Static_assert(ARRAY_SIZE(x_snaps) == ARRAY_SIZE(y_snaps), "Invalid snaps");
+        for (unsigned int i = 0; i < ARRAY_SIZE(x_snaps); i++) {
+            int32_t want_x = x_snaps[i];
+            int32_t delta_x = abs(head->x - want_x);
+            if (x_feasible && delta_x < best_delta_x) {
+                best_x = want_x;
+                best_delta_x = delta_x;
+            }
+
+            int32_t want_y = y_snaps[i];
+            int32_t delta_y = abs(head->y - want_y);
+            if (y_feasible && delta_y < best_delta_y) {
+                best_y = want_y;
+                best_delta_y = delta_y;
+            }
+        }
+    }
+
+    if (best_delta_x <= threshold) {
+        head->x = best_x;
+    }
+    if (best_delta_y <= threshold) {
+        head->y = best_y;
+    }
+}
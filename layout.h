@@ -0,0 +1,22 @@
+#ifndef WLAY_LAYOUT_H
+#define WLAY_LAYOUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct wlay_state;
+struct wlay_head;
+
+// Geometry of the layout in compositor space, shared by the editor and
+// everything else that edits the model
+
+// Sets w and h of every enabled head from its mode and transform
+void wlay_layout_measure(struct wlay_state *wlay);
+// Moves the enabled heads so that the layout starts at 0,0 and returns its
+// size, false without an enabled head. Heads have to be measured.
+bool wlay_layout_normalize(struct wlay_state *wlay, int32_t *width, int32_t *height);
+// Moves head so that its edges meet the nearest edges of the other heads,
+// if they are at most threshold away
+void wlay_layout_snap(struct wlay_state *wlay, struct wlay_head *head, int32_t threshold);
+
+#endif
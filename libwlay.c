@@ -0,0 +1,459 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "wlay.h"
+#include "layout.h"
+#include "export.h"
+#include "json.h"
+#include "libwlay.h"
+
+struct api_callbacks {
+    wlay_done_func done;
+    void *done_data;
+};
+
+// A test or apply waiting for the compositor
+struct api_config {
+    struct wlay_state *wlay;
+    struct zwlr_output_configuration_v1 *config;
+    wlay_result_func func;
+    void *data;
+};
+
+
+static void api_done(struct wlay_state *wlay, uint32_t serial)
+{
+    struct api_callbacks *callbacks = wlay->hooks_data;
+    if (callbacks->done != NULL) {
+        callbacks->done(wlay, callbacks->done_data);
+    }
+}
+
+
+static const struct wlay_hooks api_hooks = {
+    .done = api_done,
+};
+
+
+struct wlay_state *wlay_connect(const char *display)
+{
+    struct wlay_state *wlay = xmalloc(sizeof(*wlay));
+    wlay->hooks = &api_hooks;
+    wlay->hooks_data = xmalloc(sizeof(struct api_callbacks));
+    if (!wlay_wayland_connect(wlay, display)) {
+        xfree(wlay->hooks_data);
+        xfree(wlay);
+        return NULL;
+    }
+    return wlay;
+}
+
+
+void wlay_destroy(struct wlay_state *wlay)
+{
+    if (wlay == NULL) {
+        return;
+    }
+    wlay_wayland_disconnect(wlay);
+    xfree(wlay->hooks_data);
+    xfree(wlay);
+}
+
+
+int wlay_get_fd(struct wlay_state *wlay)
+{
+    return wl_display_get_fd(wlay->wl.display);
+}
+
+
+int wlay_dispatch(struct wlay_state *wlay)
+{
+    struct wl_display *display = wlay->wl.display;
+    while (wl_display_prepare_read(display) != 0) {
+        if (wl_display_dispatch_pending(display) < 0) {
+            return -1;
+        }
+    }
+    if (wl_display_flush(display) < 0 && errno != EAGAIN) {
+        wl_display_cancel_read(display);
+        return -1;
+    }
+    struct pollfd pfd = { .fd = wl_display_get_fd(display), .events = POLLIN };
+    if (poll(&pfd, 1, 0) > 0) {
+        if (wl_display_read_events(display) < 0) {
+            return -1;
+        }
+    } else {
+        wl_display_cancel_read(display);
+    }
+    return wl_display_dispatch_pending(display);
+}
+
+
+void wlay_set_done_callback(struct wlay_state *wlay, wlay_done_func func, void *data)
+{
+    struct api_callbacks *callbacks = wlay->hooks_data;
+    callbacks->done = func;
+    callbacks->done_data = data;
+}
+
+
+uint32_t wlay_get_serial(struct wlay_state *wlay)
+{
+    return wlay->serial;
+}
+
+
+struct wlay_head *wlay_get_head(struct wlay_state *wlay, struct wlay_head *prev)
+{
+    // New heads are inserted at the front of the list
+    struct wl_list *link = prev ? prev->link.prev : wlay->wl.heads.prev;
+    if (link == &wlay->wl.heads) {
+        return NULL;
+    }
+    struct wlay_head *head;
+    return wl_container_of(link, head, link);
+}
+
+
+struct wlay_head *wlay_find_head(struct wlay_state *wlay, const char *name)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->name != NULL && !strcmp(head->name, name)) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+
+const char *wlay_head_get_name(struct wlay_head *head)
+{
+    return head->name;
+}
+
+
+const char *wlay_head_get_description(struct wlay_head *head)
+{
+    return head->description;
+}
+
+
+const char *wlay_head_get_make(struct wlay_head *head)
+{
+    return head->make;
+}
+
+
+const char *wlay_head_get_model(struct wlay_head *head)
+{
+    return head->model;
+}
+
+
+const char *wlay_head_get_serial_number(struct wlay_head *head)
+{
+    return head->serial_number;
+}
+
+
+void wlay_head_get_physical_size(struct wlay_head *head, int32_t *width, int32_t *height)
+{
+    *width = head->physical_width;
+    *height = head->physical_height;
+}
+
+
+bool wlay_head_get_enabled(struct wlay_head *head)
+{
+    return head->enabled;
+}
+
+
+struct wlay_mode *wlay_head_get_current_mode(struct wlay_head *head)
+{
+    return head->enabled ? head->current_mode : NULL;
+}
+
+
+void wlay_head_get_position(struct wlay_head *head, int32_t *x, int32_t *y)
+{
+    *x = head->x;
+    *y = head->y;
+}
+
+
+void wlay_head_get_size(struct wlay_head *head, int32_t *width, int32_t *height)
+{
+    *width = *height = 0;
+    if (head->enabled) {
+        wlay_layout_measure(head->wlay);
+        *width = head->w;
+        *height = head->h;
+    }
+}
+
+
+int32_t wlay_head_get_transform(struct wlay_head *head)
+{
+    return head->transform;
+}
+
+
+double wlay_head_get_scale(struct wlay_head *head)
+{
+    return wl_fixed_to_double(head->scale);
+}
+
+
+int wlay_head_get_adaptive_sync(struct wlay_head *head)
+{
+    return head->adaptive_sync_supported ? head->adaptive_sync : -1;
+}
+
+
+struct wlay_mode *wlay_head_get_mode(struct wlay_head *head, struct wlay_mode *prev)
+{
+    // New modes are inserted at the front of the list as well
+    struct wl_list *link = prev ? prev->link.prev : head->modes.prev;
+    if (link == &head->modes) {
+        return NULL;
+    }
+    struct wlay_mode *mode;
+    return wl_container_of(link, mode, link);
+}
+
+
+int32_t wlay_mode_get_width(struct wlay_mode *mode)
+{
+    return mode->width;
+}
+
+
+int32_t wlay_mode_get_height(struct wlay_mode *mode)
+{
+    return mode->height;
+}
+
+
+int32_t wlay_mode_get_refresh(struct wlay_mode *mode)
+{
+    return mode->refresh_rate;
+}
+
+
+bool wlay_mode_get_preferred(struct wlay_mode *mode)
+{
+    return mode->preferred;
+}
+
+
+bool wlay_set_mode_policy(struct wlay_state *wlay, const char *rules)
+{
+    struct wlay_mode_policy policy;
+    if (!wlay_mode_policy_parse(&policy, rules)) {
+        return false;
+    }
+    wlay->mode_policy = policy;
+    return true;
+}
+
+
+bool wlay_head_set_enabled(struct wlay_head *head, bool enabled)
+{
+    if (enabled && head->current_mode == NULL) {
+        head->current_mode = wlay_head_best_mode(head, &head->wlay->mode_policy);
+        if (head->current_mode == NULL) {
+            return false;
+        }
+    }
+    if (enabled && head->scale == 0) {
+        head->scale = wl_fixed_from_int(1);
+    }
+    head->enabled = enabled;
+    wlay_model_changed(head->wlay);
+    return true;
+}
+
+
+void wlay_head_set_mode(struct wlay_head *head, struct wlay_mode *mode)
+{
+    head->current_mode = mode;
+    head->custom_mode.enabled = false;
+    wlay_model_changed(head->wlay);
+}
+
+
+void wlay_head_set_position(struct wlay_head *head, int32_t x, int32_t y)
+{
+    head->x = x;
+    head->y = y;
+    wlay_model_changed(head->wlay);
+}
+
+
+bool wlay_head_set_transform(struct wlay_head *head, int32_t transform)
+{
+    if (transform < 0 || transform >= WLAY_TRANSFORM_COUNT) {
+        return false;
+    }
+    head->transform = transform;
+    wlay_model_changed(head->wlay);
+    return true;
+}
+
+
+bool wlay_head_set_scale(struct wlay_head *head, double scale)
+{
+    if (!(scale > 0)) {
+        return false;
+    }
+    head->scale = wl_fixed_from_double(scale);
+    wlay_model_changed(head->wlay);
+    return true;
+}
+
+
+bool wlay_head_set_adaptive_sync(struct wlay_head *head, bool enabled)
+{
+    if (!head->adaptive_sync_supported) {
+        return false;
+    }
+    head->adaptive_sync = enabled;
+    wlay_model_changed(head->wlay);
+    return true;
+}
+
+
+void wlay_head_snap(struct wlay_head *head, int32_t threshold)
+{
+    wlay_layout_measure(head->wlay);
+    wlay_layout_snap(head->wlay, head, threshold);
+    wlay_model_changed(head->wlay);
+}
+
+
+bool wlay_normalize(struct wlay_state *wlay)
+{
+    int32_t width, height;
+    wlay_layout_measure(wlay);
+    wlay_model_changed(wlay);
+    return wlay_layout_normalize(wlay, &width, &height);
+}
+
+
+static void api_config_result(void *data, enum wlay_result result)
+{
+    struct api_config *config = data;
+    zwlr_output_configuration_v1_destroy(config->config);
+    if (config->func != NULL) {
+        config->func(config->wlay, result, config->data);
+    }
+    xfree(config);
+}
+
+
+static void handle_api_config_succeeded(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    api_config_result(data, WLAY_RESULT_SUCCEEDED);
+}
+
+
+static void handle_api_config_failed(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    api_config_result(data, WLAY_RESULT_FAILED);
+}
+
+
+static void handle_api_config_cancelled(void *data, struct zwlr_output_configuration_v1 *config)
+{
+    api_config_result(data, WLAY_RESULT_CANCELLED);
+}
+
+
+static const struct zwlr_output_configuration_v1_listener api_config_listener = {
+    .succeeded = handle_api_config_succeeded,
+    .failed = handle_api_config_failed,
+    .cancelled = handle_api_config_cancelled,
+};
+
+
+static bool api_configure(struct wlay_state *wlay, bool test, wlay_result_func func,
+                          void *data)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->enabled && head->current_mode == NULL &&
+                !(head->custom_mode.enabled && head->custom_mode.valid)) {
+            return false;
+        }
+    }
+    struct api_config *config = xmalloc(sizeof(*config));
+    config->wlay = wlay;
+    config->func = func;
+    config->data = data;
+    config->config = wlay_create_configuration(wlay);
+    zwlr_output_configuration_v1_add_listener(config->config, &api_config_listener, config);
+    if (test) {
+        zwlr_output_configuration_v1_test(config->config);
+    } else {
+        zwlr_output_configuration_v1_apply(config->config);
+    }
+    wl_display_flush(wlay->wl.display);
+    return true;
+}
+
+
+bool wlay_test(struct wlay_state *wlay, wlay_result_func func, void *data)
+{
+    return api_configure(wlay, true, func, data);
+}
+
+
+bool wlay_apply(struct wlay_state *wlay, wlay_result_func func, void *data)
+{
+    return api_configure(wlay, false, func, data);
+}
+
+
+char *wlay_serialize(struct wlay_state *wlay, enum wlay_format format)
+{
+    static const enum wlay_config_type types[] = {
+        [WLAY_FORMAT_SWAY] = WLAY_CONFIG_SWAY,
+        [WLAY_FORMAT_WLRRANDR] = WLAY_CONFIG_WLRRANDR,
+        [WLAY_FORMAT_KANSHI] = WLAY_CONFIG_KANSHI,
+        [WLAY_FORMAT_WLRRANDR_SH] = WLAY_CONFIG_WLRRANDR_SH,
+        [WLAY_FORMAT_LAYOUT_JSON] = WLAY_CONFIG_JSON,
+    };
+    if (format == WLAY_FORMAT_JSON) {
+        struct wlay_buffer buffer = { 0 };
+        wlay_json_heads(&buffer, wlay);
+        wlay_buffer_append(&buffer, "", 1);
+        // The caller frees it with free(), not xfree()
+        char *text = strdup(buffer.data);
+        wlay_buffer_finish(&buffer);
+        return text;
+    }
+    if ((unsigned)format >= ARRAY_SIZE(types)) {
+        return NULL;
+    }
+    char *text = NULL;
+    size_t size;
+    FILE *f = open_memstream(&text, &size);
+    if (f == NULL) {
+        return NULL;
+    }
+    wlay_export(wlay, types[format], f);
+    fclose(f);
+    return text;
+}
@@ -0,0 +1,132 @@
+#ifndef LIBWLAY_H
+#define LIBWLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The output layout engine of wlay without its GUI: the head and mode
+// model of a wlr-output-management compositor, editing it, applying it and
+// writing it out as a config. Links against libwayland-client only.
+//
+// Everything declared here keeps its signature and meaning, later versions
+// only add to it. The structures are opaque, heads and modes belong to the
+// model and stay valid until the compositor removes them, which it only
+// does while wlay_dispatch() runs.
+//
+// Edits only change the model. wlay_test() and wlay_apply() send the whole
+// model to the compositor, which answers every head again if it took it.
+// Everything runs on the thread that calls wlay_dispatch().
+
+#define WLAY_API_VERSION 1
+
+struct wlay_state;
+struct wlay_head;
+struct wlay_mode;
+
+enum wlay_result {
+    WLAY_RESULT_SUCCEEDED,
+    WLAY_RESULT_FAILED,
+    // The model was out of date, the compositor changed it meanwhile
+    WLAY_RESULT_CANCELLED,
+};
+
+enum wlay_format {
+    WLAY_FORMAT_SWAY,
+    WLAY_FORMAT_WLRRANDR,
+    WLAY_FORMAT_KANSHI,
+    // The same heads array as the control socket's get command
+    WLAY_FORMAT_JSON,
+    // wlr-randr as a script with every output name quoted for sh
+    WLAY_FORMAT_WLRRANDR_SH,
+    // Only the layout, what a config would say about every output
+    WLAY_FORMAT_LAYOUT_JSON,
+};
+
+typedef void (*wlay_done_func)(struct wlay_state *wlay, void *data);
+typedef void (*wlay_result_func)(struct wlay_state *wlay, enum wlay_result result,
+                                 void *data);
+
+// Connects to the named display, NULL for $WAYLAND_DISPLAY, and collects
+// its heads. NULL if that fails or the compositor has no output management.
+struct wlay_state *wlay_connect(const char *display);
+void wlay_destroy(struct wlay_state *wlay);
+
+// Readable whenever wlay_dispatch() has something to do
+int wlay_get_fd(struct wlay_state *wlay);
+// Handles whatever the compositor sent without blocking, -1 once the
+// connection is lost
+int wlay_dispatch(struct wlay_state *wlay);
+// Called after the compositor sent a complete new state of the heads
+void wlay_set_done_callback(struct wlay_state *wlay, wlay_done_func func, void *data);
+uint32_t wlay_get_serial(struct wlay_state *wlay);
+
+// Heads in the order the compositor announced them, the first for NULL,
+// NULL after the last one
+struct wlay_head *wlay_get_head(struct wlay_state *wlay, struct wlay_head *prev);
+struct wlay_head *wlay_find_head(struct wlay_state *wlay, const char *name);
+// NULL when the compositor does not know them
+const char *wlay_head_get_name(struct wlay_head *head);
+const char *wlay_head_get_description(struct wlay_head *head);
+const char *wlay_head_get_make(struct wlay_head *head);
+const char *wlay_head_get_model(struct wlay_head *head);
+const char *wlay_head_get_serial_number(struct wlay_head *head);
+// Millimeters, 0 if unknown
+void wlay_head_get_physical_size(struct wlay_head *head, int32_t *width, int32_t *height);
+bool wlay_head_get_enabled(struct wlay_head *head);
+// NULL while disabled
+struct wlay_mode *wlay_head_get_current_mode(struct wlay_head *head);
+void wlay_head_get_position(struct wlay_head *head, int32_t *x, int32_t *y);
+// Size in the layout, after the transform, 0x0 while disabled
+void wlay_head_get_size(struct wlay_head *head, int32_t *width, int32_t *height);
+// A wl_output_transform
+int32_t wlay_head_get_transform(struct wlay_head *head);
+double wlay_head_get_scale(struct wlay_head *head);
+// -1 when the compositor can not set it
+int wlay_head_get_adaptive_sync(struct wlay_head *head);
+
+// Modes of the head in the order the compositor announced them, like
+// wlay_get_head()
+struct wlay_mode *wlay_head_get_mode(struct wlay_head *head, struct wlay_mode *prev);
+int32_t wlay_mode_get_width(struct wlay_mode *mode);
+int32_t wlay_mode_get_height(struct wlay_mode *mode);
+// mHz
+int32_t wlay_mode_get_refresh(struct wlay_mode *mode);
+bool wlay_mode_get_preferred(struct wlay_mode *mode);
+
+// How heads that are enabled without a mode get one: a comma separated
+// list of native, preferred, largest, fastest or WxH[@HZ], tried in order.
+// Native, the default, is the preferred resolution at its fastest refresh
+// rate. false if the rules can not be parsed.
+bool wlay_set_mode_policy(struct wlay_state *wlay, const char *rules);
+// Enabling picks a mode by the mode policy if the head has none, false if
+// it has no modes at all
+bool wlay_head_set_enabled(struct wlay_head *head, bool enabled);
+// mode has to be one of the head's
+void wlay_head_set_mode(struct wlay_head *head, struct wlay_mode *mode);
+void wlay_head_set_position(struct wlay_head *head, int32_t x, int32_t y);
+bool wlay_head_set_transform(struct wlay_head *head, int32_t transform);
+bool wlay_head_set_scale(struct wlay_head *head, double scale);
+// false when the compositor can not set it
+bool wlay_head_set_adaptive_sync(struct wlay_head *head, bool enabled);
+// Moves the head against the nearest edges of the others within threshold
+void wlay_head_snap(struct wlay_head *head, int32_t threshold);
+// Moves the layout to start at 0,0, false without an enabled head
+bool wlay_normalize(struct wlay_state *wlay);
+
+// Sends the model to the compositor, func gets its verdict from within
+// wlay_dispatch(). false without sending when an enabled head has no mode.
+bool wlay_test(struct wlay_state *wlay, wlay_result_func func, void *data);
+bool wlay_apply(struct wlay_state *wlay, wlay_result_func func, void *data);
+
+// The model as text, to be freed by the caller. NULL for an unknown format.
+char *wlay_serialize(struct wlay_state *wlay, enum wlay_format format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "wlay.h"
+#include "modes.h"
+
+const char *wlay_mode_rule_names[WLAY_MODE_RULE_TYPE_COUNT] = {
+    [WLAY_MODE_RULE_NATIVE] = "native",
+    [WLAY_MODE_RULE_PREFERRED] = "preferred",
+    [WLAY_MODE_RULE_LARGEST] = "largest",
+    [WLAY_MODE_RULE_FASTEST] = "fastest",
+    [WLAY_MODE_RULE_SIZE] = "WxH[@HZ]",
+};
+
+// How close a rule's refresh rate has to be, users write 144 for 143.998
+#define REFRESH_TOLERANCE 500
+
+
+// Largest resolution first, then the fastest refresh rate. Of modes that
+// only differ in their timing the current one comes first, then the
+// preferred one, they stand in for the others.
+static int modes_compare(const void *a, const void *b)
+{
+    const struct wlay_mode *x = *(struct wlay_mode *const *)a;
+    const struct wlay_mode *y = *(struct wlay_mode *const *)b;
+    int64_t area_x = (int64_t)x->width * x->height;
+    int64_t area_y = (int64_t)y->width * y->height;
+    if (area_x != area_y) {
+        return area_x < area_y ? 1 : -1;
+    }
+    if (x->width != y->width) {
+        return x->width < y->width ? 1 : -1;
+    }
+    if (x->height != y->height) {
+        return x->height < y->height ? 1 : -1;
+    }
+    if (x->refresh_rate != y->refresh_rate) {
+        return x->refresh_rate < y->refresh_rate ? 1 : -1;
+    }
+    bool current_x = x->head->current_mode == x, current_y = y->head->current_mode == y;
+    if (current_x != current_y) {
+        return current_x ? -1 : 1;
+    }
+    return (int)y->preferred - (int)x->preferred;
+}
+
+
+const struct wlay_mode_index *wlay_head_mode_index(struct wlay_head *head)
+{
+    struct wlay_mode_index *index = &head->mode_index;
+    if (index->valid && index->generation == head->wlay->generation) {
+        return index;
+    }
+    index->valid = true;
+    index->generation = head->wlay->generation;
+
+    int count = wl_list_length(&head->modes);
+    if (count > index->capacity) {
+        index->capacity = count * 2;
+        index->modes = xrealloc(index->modes, index->capacity * sizeof(*index->modes));
+        index->groups = xrealloc(index->groups, index->capacity * sizeof(*index->groups));
+    }
+    index->count = 0;
+    struct wlay_mode *mode;
+    wl_list_for_each_reverse(mode, &head->modes, link) {
+        index->modes[index->count++] = mode;
+    }
+    qsort(index->modes, index->count, sizeof(*index->modes), modes_compare);
+
+    // Drop the duplicates, sorting put them next to each other
+    int kept = 0;
+    index->group_count = 0;
+    for (int i = 0; i < index->count; i++) {
+        mode = index->modes[i];
+        struct wlay_mode *last = kept > 0 ? index->modes[kept - 1] : NULL;
+        if (last != NULL && last->width == mode->width && last->height == mode->height &&
+                last->refresh_rate == mode->refresh_rate) {
+            continue;
+        }
+        if (last == NULL || last->width != mode->width || last->height != mode->height) {
+            index->groups[index->group_count++] = (struct wlay_mode_group){
+                .width = mode->width,
+                .height = mode->height,
+                .first = kept,
+            };
+        }
+        index->groups[index->group_count - 1].count++;
+        index->modes[kept++] = mode;
+    }
+    index->count = kept;
+    return index;
+}
+
+
+void wlay_mode_index_finish(struct wlay_mode_index *index)
+{
+    xfree(index->modes);
+    xfree(index->groups);
+    memset(index, 0, sizeof(*index));
+}
+
+
+static const struct wlay_mode_group *modes_find_group(const struct wlay_mode_index *index,
+                                                      int32_t width, int32_t height)
+{
+    for (int i = 0; i < index->group_count; i++) {
+        if (index->groups[i].width == width && index->groups[i].height == height) {
+            return &index->groups[i];
+        }
+    }
+    return NULL;
+}
+
+
+static struct wlay_mode *modes_preferred(struct wlay_head *head)
+{
+    struct wlay_mode *mode;
+    wl_list_for_each(mode, &head->modes, link) {
+        if (mode->preferred) {
+            return mode;
+        }
+    }
+    return NULL;
+}
+
+
+static struct wlay_mode *modes_apply_rule(struct wlay_head *head,
+                                          const struct wlay_mode_index *index,
+                                          const struct wlay_mode_rule *rule)
+{
+    struct wlay_mode *preferred = modes_preferred(head);
+    const struct wlay_mode_group *group;
+    struct wlay_mode *best = NULL;
+    switch (rule->type) {
+    case WLAY_MODE_RULE_NATIVE:
+        group = preferred ? modes_find_group(index, preferred->width, preferred->height) : NULL;
+        if (group == NULL) {
+            group = &index->groups[0];
+        }
+        return index->modes[group->first];
+    case WLAY_MODE_RULE_PREFERRED:
+        return preferred;
+    case WLAY_MODE_RULE_LARGEST:
+        return index->modes[0];
+    case WLAY_MODE_RULE_FASTEST:
+        for (int i = 0; i < index->count; i++) {
+            if (best == NULL || index->modes[i]->refresh_rate > best->refresh_rate) {
+                best = index->modes[i];
+            }
+        }
+        return best;
+    case WLAY_MODE_RULE_SIZE:
+        group = modes_find_group(index, rule->width, rule->height);
+        if (group == NULL) {
+            return NULL;
+        }
+        if (rule->refresh_rate == 0) {
+            return index->modes[group->first];
+        }
+        for (int i = group->first; i < group->first + group->count; i++) {
+            struct wlay_mode *mode = index->modes[i];
+            if (abs(mode->refresh_rate - rule->refresh_rate) <= REFRESH_TOLERANCE &&
+                    (best == NULL || abs(mode->refresh_rate - rule->refresh_rate) <
+                     abs(best->refresh_rate - rule->refresh_rate))) {
+                best = mode;
+            }
+        }
+        return best;
+    default:
+        return NULL;
+    }
+}
+
+
+struct wlay_mode *wlay_head_best_mode(struct wlay_head *head,
+                                      const struct wlay_mode_policy *policy)
+{
+    const struct wlay_mode_index *index = wlay_head_mode_index(head);
+    if (index->count == 0) {
+        return NULL;
+    }
+    for (int i = 0; policy != NULL && i < policy->count; i++) {
+        struct wlay_mode *mode = modes_apply_rule(head, index, &policy->rules[i]);
+        if (mode != NULL) {
+            return mode;
+        }
+    }
+    return modes_apply_rule(head, index, &(struct wlay_mode_rule){ WLAY_MODE_RULE_NATIVE });
+}
+
+
+static bool modes_parse_rule(struct wlay_mode_rule *rule, const char *s)
+{
+    memset(rule, 0, sizeof(*rule));
+    for (int type = 0; type < WLAY_MODE_RULE_SIZE; type++) {
+        if (!strcmp(s, wlay_mode_rule_names[type])) {
+            rule->type = type;
+            return true;
+        }
+    }
+    rule->type = WLAY_MODE_RULE_SIZE;
+    int end = 0;
+    if (sscanf(s, "%dx%d%n", &rule->width, &rule->height, &end) != 2 ||
+            rule->width <= 0 || rule->height <= 0) {
+        return false;
+    }
+    s += end;
+    if (*s == '@') {
+        char *unit;
+        double refresh = strtod(s + 1, &unit);
+        if (unit == s + 1 || !(refresh > 0 && refresh < 1000)) {
+            return false;
+        }
+        rule->refresh_rate = lround(refresh * 1000);
+        s = unit;
+        if (!strcmp(s, "Hz")) {
+            s += 2;
+        }
+    }
+    return *s == '\0';
+}
+
+
+bool wlay_mode_policy_parse(struct wlay_mode_policy *policy, const char *spec)
+{
+    char *copy = xstrdup(spec);
+    char *save;
+    bool ok = true;
+    policy->count = 0;
+    for (char *rule = strtok_r(copy, ",", &save); rule != NULL && ok;
+            rule = strtok_r(NULL, ",", &save)) {
+        ok = policy->count < WLAY_MODE_POLICY_MAX_RULES &&
+            modes_parse_rule(&policy->rules[policy->count++], rule);
+    }
+    xfree(copy);
+    return ok && policy->count > 0;
+}
+
+
+void wlay_refresh_format(char *buffer, size_t size, int32_t refresh_rate)
+{
+    int length = snprintf(buffer, size, "%.3f", refresh_rate / 1000.0);
+    if (length <= 0 || (size_t)length >= size) {
+        return;
+    }
+    while (buffer[length - 1] == '0') {
+        buffer[--length] = '\0';
+    }
+    if (buffer[length - 1] == '.') {
+        buffer[length - 1] = '\0';
+    }
+}
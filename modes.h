@@ -0,0 +1,85 @@
+#ifndef WLAY_MODES_H
+#define WLAY_MODES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compositors announce the modes of a head in no particular order and
+// often the same one several times, with timings that differ in nothing
+// the protocol tells us. The index of a head has every resolution once,
+// the largest first, and every refresh rate of it once, the fastest first.
+// It is rebuilt when the model changed since it was last asked for.
+
+struct wlay_state;
+struct wlay_head;
+struct wlay_mode;
+
+// The modes of one resolution
+struct wlay_mode_group {
+    int32_t width;
+    int32_t height;
+    int first;
+    int count;
+};
+
+struct wlay_mode_index {
+    uint64_t generation;
+    bool valid;
+    struct wlay_mode **modes;
+    int count;
+    struct wlay_mode_group *groups;
+    int group_count;
+    int capacity;
+};
+
+enum wlay_mode_rule_type {
+    // The resolution of the preferred mode, or the largest one, at its
+    // fastest refresh rate
+    WLAY_MODE_RULE_NATIVE,
+    // The preferred mode as the compositor announced it
+    WLAY_MODE_RULE_PREFERRED,
+    // The largest resolution at its fastest refresh rate
+    WLAY_MODE_RULE_LARGEST,
+    // The fastest refresh rate, at the largest resolution that has it
+    WLAY_MODE_RULE_FASTEST,
+    // WxH at the refresh rate closest to refresh_rate, or the fastest
+    // without one
+    WLAY_MODE_RULE_SIZE,
+    WLAY_MODE_RULE_TYPE_COUNT,
+};
+
+struct wlay_mode_rule {
+    enum wlay_mode_rule_type type;
+    int32_t width;
+    int32_t height;
+    // mHz, 0 for any
+    int32_t refresh_rate;
+};
+
+#define WLAY_MODE_POLICY_MAX_RULES 8
+
+// The rules are tried in order, native is the last resort
+struct wlay_mode_policy {
+    struct wlay_mode_rule rules[WLAY_MODE_POLICY_MAX_RULES];
+    int count;
+};
+
+extern const char *wlay_mode_rule_names[WLAY_MODE_RULE_TYPE_COUNT];
+
+// Up to date with the model, never NULL
+const struct wlay_mode_index *wlay_head_mode_index(struct wlay_head *head);
+void wlay_mode_index_finish(struct wlay_mode_index *index);
+
+// The mode the policy picks, NULL if the head has no modes
+struct wlay_mode *wlay_head_best_mode(struct wlay_head *head,
+                                      const struct wlay_mode_policy *policy);
+// A comma separated list of native, preferred, largest, fastest or
+// WxH[@HZ], false if one of them is not
+bool wlay_mode_policy_parse(struct wlay_mode_policy *policy, const char *spec);
+
+// The refresh rate in Hz with as many decimals as it needs, 59.94 and 60
+// stay apart
+void wlay_refresh_format(char *buffer, size_t size, int32_t refresh_rate);
+
+#endif
@@ -0,0 +1,401 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "wlay.h"
+#include "modeset.h"
+
+// Changes the compositor did not answer in time count as failed
+#define MODESET_TIMEOUT 5.0
+// How far the position change moves the output
+#define MODESET_OFFSET 64
+
+enum modeset_change {
+    MODESET_POSITION,
+    MODESET_TRANSFORM,
+    MODESET_MODE,
+    MODESET_ENABLE,
+    MODESET_CHANGE_COUNT,
+};
+
+static const char *modeset_change_names[MODESET_CHANGE_COUNT] = {
+    [MODESET_POSITION] = "position",
+    [MODESET_TRANSFORM] = "transform",
+    [MODESET_MODE] = "mode",
+    [MODESET_ENABLE] = "enable",
+};
+
+// Milliseconds per successful change
+struct modeset_samples {
+    double *apply;
+    double *reenumerate;
+    int count;
+    int failed;
+    bool skipped;
+};
+
+// What a change is taken back to
+struct modeset_saved {
+    int32_t x;
+    int32_t transform;
+    int32_t width;
+    int32_t height;
+    int32_t refresh_rate;
+};
+
+struct wlay_modeset_bench {
+    struct wlay_state *wlay;
+    int iterations;
+    struct modeset_samples samples[MODESET_CHANGE_COUNT];
+
+    // Configurations sent and answered. The compositor answers them in
+    // order, a change that timed out may still be answered during the next
+    // one and must not count for it.
+    uint64_t sent;
+    uint64_t answered;
+
+    // The change in flight, the times stay 0 until its events arrived
+    bool pending;
+    double start;
+    double applied;
+    double done;
+    const char *result;
+};
+
+
+void wlay_modeset_bench_result(struct wlay_modeset_bench *bench, const char *result)
+{
+    if (bench == NULL) {
+        return;
+    }
+    if (++bench->answered < bench->sent) {
+        log_info("Late answer to an earlier change: %s", result);
+        return;
+    }
+    if (!bench->pending || bench->result != NULL) {
+        return;
+    }
+    bench->applied = monotonic_time();
+    bench->result = result;
+}
+
+
+void wlay_modeset_bench_done(struct wlay_modeset_bench *bench)
+{
+    // Until the earlier changes are answered the heads may still be sent
+    // again for one of them
+    if (bench == NULL || !bench->pending || bench->done != 0 ||
+            bench->answered + 1 < bench->sent) {
+        return;
+    }
+    bench->done = monotonic_time();
+}
+
+
+struct wlay_modeset_bench *wlay_modeset_bench_create(struct wlay_state *wlay, int iterations)
+{
+    struct wlay_modeset_bench *bench = xmalloc(sizeof(*bench));
+    bench->wlay = wlay;
+    bench->iterations = iterations;
+    // Every iteration makes a change and takes it back
+    for (int i = 0; i < MODESET_CHANGE_COUNT; i++) {
+        bench->samples[i].apply = xmalloc(2 * iterations * sizeof(double));
+        bench->samples[i].reenumerate = xmalloc(2 * iterations * sizeof(double));
+    }
+    return bench;
+}
+
+
+void wlay_modeset_bench_destroy(struct wlay_modeset_bench *bench)
+{
+    for (int i = 0; i < MODESET_CHANGE_COUNT; i++) {
+        xfree(bench->samples[i].apply);
+        xfree(bench->samples[i].reenumerate);
+    }
+    xfree(bench);
+}
+
+
+static struct wlay_mode *modeset_find_mode(struct wlay_head *head, int32_t width,
+                                           int32_t height, int32_t refresh_rate)
+{
+    struct wlay_mode *mode;
+    wl_list_for_each(mode, &head->modes, link) {
+        if (mode->width == width && mode->height == height &&
+                mode->refresh_rate == refresh_rate) {
+            return mode;
+        }
+    }
+    return wlay_head_best_mode(head, &head->wlay->mode_policy);
+}
+
+
+// Changes the model, or takes a change back to saved. False if the outputs
+// can not make it.
+static bool modeset_make(struct wlay_state *wlay, enum modeset_change change,
+                         struct modeset_saved *saved, bool revert)
+{
+    // Changes are made to the first enabled head in display order, outputs
+    // are switched on and off at the end of it
+    struct wlay_head *head, *first = NULL, *last = NULL;
+    int enabled = 0;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        if (head->enabled && first == NULL) {
+            first = head;
+        }
+        enabled += head->enabled;
+        last = head;
+    }
+    head = change == MODESET_ENABLE ? last : first;
+    if (head == NULL) {
+        return false;
+    }
+
+    switch (change) {
+    case MODESET_POSITION:
+        if (!revert) {
+            saved->x = head->x;
+        }
+        head->x = revert ? saved->x : head->x + MODESET_OFFSET;
+        return true;
+    case MODESET_TRANSFORM:
+        if (!revert) {
+            saved->transform = head->transform;
+        }
+        // A quarter turn, which changes the size of the output as well
+        head->transform = revert ? saved->transform : head->transform ^ 1;
+        return true;
+    case MODESET_MODE: {
+        struct wlay_mode *current = head->current_mode, *mode;
+        if (revert) {
+            head->current_mode = modeset_find_mode(head, saved->width, saved->height,
+                                                   saved->refresh_rate);
+            return head->current_mode != NULL;
+        }
+        if (current == NULL) {
+            return false;
+        }
+        wl_list_for_each(mode, &head->modes, link) {
+            if (mode->width != current->width || mode->height != current->height ||
+                    mode->refresh_rate != current->refresh_rate) {
+                saved->width = current->width;
+                saved->height = current->height;
+                saved->refresh_rate = current->refresh_rate;
+                head->current_mode = mode;
+                return true;
+            }
+        }
+        return false;
+    }
+    case MODESET_ENABLE:
+        if (head->enabled) {
+            // Switching off every output is not a change worth measuring
+            if (enabled == 1 || head->current_mode == NULL) {
+                return false;
+            }
+            saved->width = head->current_mode->width;
+            saved->height = head->current_mode->height;
+            saved->refresh_rate = head->current_mode->refresh_rate;
+            head->enabled = false;
+            return true;
+        }
+        // Disabled heads have no current mode, enabled ones take back theirs
+        if (!revert) {
+            saved->width = saved->height = saved->refresh_rate = 0;
+        }
+        head->current_mode = modeset_find_mode(head, saved->width, saved->height,
+                                               saved->refresh_rate);
+        head->enabled = head->current_mode != NULL;
+        return head->enabled;
+    default:
+        return false;
+    }
+}
+
+
+// 1 once the change is answered, 0 on a timeout, -1 when the connection is
+// lost
+static int modeset_wait(struct wlay_modeset_bench *bench)
+{
+    struct wl_display *display = bench->wlay->wl.display;
+    double deadline = bench->start + MODESET_TIMEOUT;
+    // A change that failed is not sent back
+    while (bench->result == NULL || (!strcmp(bench->result, "succeeded") && bench->done == 0)) {
+        int timeout = (int)ceil((deadline - monotonic_time()) * 1e3);
+        if (timeout <= 0) {
+            return 0;
+        }
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+        struct pollfd pfd = { .fd = wl_display_get_fd(display), .events = POLLIN };
+        int ret = poll(&pfd, 1, timeout);
+        if (ret > 0) {
+            if (wl_display_read_events(display) < 0) {
+                return -1;
+            }
+        } else {
+            wl_display_cancel_read(display);
+            if (ret < 0 && errno != EINTR) {
+                return -1;
+            }
+        }
+        if (wl_display_dispatch_pending(display) < 0) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+
+// Applies the model, -1 when the connection is lost, otherwise whether the
+// change succeeded
+static int modeset_measure(struct wlay_modeset_bench *bench, enum modeset_change change)
+{
+    struct modeset_samples *samples = &bench->samples[change];
+    bench->pending = true;
+    bench->result = NULL;
+    bench->applied = bench->done = 0;
+    bench->start = monotonic_time();
+    bench->sent++;
+    wlay_push_settings(bench->wlay);
+    int ret = modeset_wait(bench);
+    bench->pending = false;
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret == 0 || strcmp(bench->result, "succeeded")) {
+        log_info("%s change %s", modeset_change_names[change],
+                 ret == 0 ? "timed out" : bench->result);
+        samples->failed++;
+        return 0;
+    }
+    samples->apply[samples->count] = (bench->applied - bench->start) * 1e3;
+    samples->reenumerate[samples->count] = (bench->done - bench->start) * 1e3;
+    samples->count++;
+    return 1;
+}
+
+
+static int modeset_compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+
+static double modeset_percentile(const double *sorted, int count, double p)
+{
+    int i = (int)ceil(p * count) - 1;
+    return sorted[min(max(i, 0), count - 1)];
+}
+
+
+static void modeset_report(struct wlay_modeset_bench *bench, FILE *csv)
+{
+    static const double percentiles[] = { 0.5, 0.9, 0.99, 1.0 };
+    static const char *percentile_names[] = { "p50", "p90", "p99", "max" };
+    fprintf(csv, "change,samples,failed,skipped");
+    for (int metric = 0; metric < 2; metric++) {
+        for (size_t p = 0; p < ARRAY_SIZE(percentiles); p++) {
+            fprintf(csv, ",%s_%s_ms", metric ? "reenumerate" : "apply", percentile_names[p]);
+        }
+    }
+    fprintf(csv, "\n");
+    printf("%-10s %7s %7s %9s %9s %9s %9s  (ms)\n", "change", "samples", "failed",
+           "apply p50", "p99", "reenum p50", "p99");
+
+    for (int change = 0; change < MODESET_CHANGE_COUNT; change++) {
+        struct modeset_samples *samples = &bench->samples[change];
+        const char *name = modeset_change_names[change];
+        fprintf(csv, "%s,%d,%d,%d", name, samples->count, samples->failed, samples->skipped);
+        if (samples->count == 0) {
+            fprintf(csv, ",,,,,,,,\n");
+            printf("%-10s %7d %7d  %s\n", name, samples->count, samples->failed,
+                   samples->skipped ? "skipped" : "-");
+            continue;
+        }
+        qsort(samples->apply, samples->count, sizeof(double), modeset_compare_double);
+        qsort(samples->reenumerate, samples->count, sizeof(double), modeset_compare_double);
+        for (int metric = 0; metric < 2; metric++) {
+            const double *sorted = metric ? samples->reenumerate : samples->apply;
+            for (size_t p = 0; p < ARRAY_SIZE(percentiles); p++) {
+                fprintf(csv, ",%.3f", modeset_percentile(sorted, samples->count,
+                                                         percentiles[p]));
+            }
+        }
+        fprintf(csv, "\n");
+        printf("%-10s %7d %7d %9.3f %9.3f %10.3f %9.3f\n", name, samples->count,
+               samples->failed, modeset_percentile(samples->apply, samples->count, 0.5),
+               modeset_percentile(samples->apply, samples->count, 0.99),
+               modeset_percentile(samples->reenumerate, samples->count, 0.5),
+               modeset_percentile(samples->reenumerate, samples->count, 0.99));
+    }
+}
+
+
+// One change and taking it back, false when the connection is lost
+static bool modeset_run_change(struct wlay_modeset_bench *bench, enum modeset_change change)
+{
+    struct modeset_samples *samples = &bench->samples[change];
+    // Whatever the last change still had coming is in the model before the
+    // clock starts
+    if (wl_display_roundtrip(bench->wlay->wl.display) < 0) {
+        return false;
+    }
+    struct modeset_saved saved;
+    if (!modeset_make(bench->wlay, change, &saved, false)) {
+        if (samples->count == 0 && samples->failed == 0) {
+            log_info("Outputs can not make %s changes, skipping them",
+                     modeset_change_names[change]);
+            samples->skipped = true;
+        } else {
+            samples->failed++;
+        }
+        return true;
+    }
+    int ret = modeset_measure(bench, change);
+    if (ret < 0) {
+        return false;
+    }
+    // After a failure the compositor still has the layout the change was
+    // made to, the model only has to follow
+    if (!modeset_make(bench->wlay, change, &saved, true)) {
+        samples->failed++;
+        return true;
+    }
+    return ret == 0 || modeset_measure(bench, change) >= 0;
+}
+
+
+int wlay_modeset_bench_run(struct wlay_modeset_bench *bench, const char *csv_path)
+{
+    FILE *csv = fopen(csv_path, "w");
+    if (csv == NULL) {
+        log_info("Could not open %s: %s", csv_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < bench->iterations; i++) {
+        for (int change = 0; change < MODESET_CHANGE_COUNT; change++) {
+            if (!bench->samples[change].skipped && !modeset_run_change(bench, change)) {
+                log_info("Wayland connection lost");
+                fclose(csv);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    modeset_report(bench, csv);
+    if (fclose(csv) != 0) {
+        log_info("Could not write %s: %s", csv_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+#ifndef WLAY_MODESET_H
+#define WLAY_MODESET_H
+
+struct wlay_state;
+struct wlay_modeset_bench;
+
+// Headless benchmark of how fast the compositor applies changes. Every
+// iteration makes each kind of change to the model and takes it back
+// again, each through wlay_push_settings(), and times
+//
+//   apply        from the request to the succeeded event
+//   reenumerate  from the request to the done event that ends the heads
+//                being sent again with the change in them
+//
+// Percentiles per kind of change are printed and written to a CSV file.
+// Kinds of change the outputs can not make, such as switching modes with
+// only one mode, are reported as skipped.
+struct wlay_modeset_bench *wlay_modeset_bench_create(struct wlay_state *wlay, int iterations);
+void wlay_modeset_bench_destroy(struct wlay_modeset_bench *bench);
+
+// Configuration results and done events, bench may be NULL
+void wlay_modeset_bench_result(struct wlay_modeset_bench *bench, const char *result);
+void wlay_modeset_bench_done(struct wlay_modeset_bench *bench);
+
+// Runs every iteration and writes csv_path, returns the exit code
+int wlay_modeset_bench_run(struct wlay_modeset_bench *bench, const char *csv_path);
+
+#endif
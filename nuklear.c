@@ -0,0 +1,28 @@
+#define NK_IMPLEMENTATION
+#include "wlay_nuklear.h"
+#include "util.h"
+
+
+static void *wlay_nk_alloc(nk_handle handle, void *old, nk_size size)
+{
+    return wlay_xmalloc(handle.id, size);
+}
+
+
+static void wlay_nk_free(nk_handle handle, void *ptr)
+{
+    xfree(ptr);
+}
+
+
+struct nk_allocator *wlay_nk_allocator(int tag)
+{
+    // nuklear copies it
+    static struct nk_allocator allocator;
+    allocator = (struct nk_allocator){
+        .userdata = { .id = tag },
+        .alloc = wlay_nk_alloc,
+        .free = wlay_nk_free,
+    };
+    return &allocator;
+}
@@ -33,6 +33,15 @@ NK_API void                 nk_glfw3_device_create(void);
 NK_API void                 nk_glfw3_char_callback(GLFWwindow *win, unsigned int codepoint);
 NK_API void                 nk_gflw3_scroll_callback(GLFWwindow *win, double xoff, double yoff);
 NK_API void                 nk_glfw3_mouse_button_callback(GLFWwindow *win, int button, int action, int mods);
+NK_API void                 nk_glfw3_key_callback(GLFWwindow *win, int key, int scancode, int action, int mods);
+NK_API void                 nk_glfw3_cursor_pos_callback(GLFWwindow *win, double x, double y);
+
+/* Input arrives through the callbacks only and is queued with the time it
+ * was received. nk_glfw3_new_frame() hands nuklear what was queued since
+ * the last frame; a key or button that went down and up again in between
+ * is kept down for one frame and released in the next. */
+NK_API int                  nk_glfw3_late_motion(void);
+NK_API double               nk_glfw3_motion_time(void);
 
 #endif
 /*
@@ -44,15 +53,67 @@ NK_API void                 nk_glfw3_mouse_button_callback(GLFWwindow *win, int
  */
 #ifdef NK_GLFW_GL3_IMPLEMENTATION
 
-#ifndef NK_GLFW_TEXT_MAX
-#define NK_GLFW_TEXT_MAX 256
-#endif
 #ifndef NK_GLFW_DOUBLE_CLICK_LO
 #define NK_GLFW_DOUBLE_CLICK_LO 0.02
 #endif
 #ifndef NK_GLFW_DOUBLE_CLICK_HI
 #define NK_GLFW_DOUBLE_CLICK_HI 0.2
 #endif
+#ifndef NK_GLFW_EVENT_MAX
+#define NK_GLFW_EVENT_MAX 256
+#endif
+
+enum nk_glfw_event_type {
+    NK_GLFW_EVENT_MOTION,
+    NK_GLFW_EVENT_BUTTON,
+    NK_GLFW_EVENT_SCROLL,
+    NK_GLFW_EVENT_KEY,
+    NK_GLFW_EVENT_TEXT
+};
+
+struct nk_glfw_event {
+    enum nk_glfw_event_type type;
+    /* glfwGetTime() when GLFW delivered it */
+    double time;
+    /* Cursor position, or the scroll offset */
+    struct nk_vec2 pos;
+    /* enum nk_buttons or enum nk_keys */
+    int id;
+    int down;
+    nk_rune text;
+};
+
+/* The nuklear keys a GLFW key stands for, with and without Ctrl held when
+ * it was pressed. Home and End move both the cursor and the view. */
+static const struct nk_glfw_key {
+    int key;
+    enum nk_keys plain;
+    enum nk_keys ctrl;
+    enum nk_keys also;
+} nk_glfw_keys[] = {
+    {GLFW_KEY_DELETE, NK_KEY_DEL, NK_KEY_DEL, NK_KEY_NONE},
+    {GLFW_KEY_ENTER, NK_KEY_ENTER, NK_KEY_ENTER, NK_KEY_NONE},
+    {GLFW_KEY_TAB, NK_KEY_TAB, NK_KEY_TAB, NK_KEY_NONE},
+    {GLFW_KEY_BACKSPACE, NK_KEY_BACKSPACE, NK_KEY_BACKSPACE, NK_KEY_NONE},
+    {GLFW_KEY_UP, NK_KEY_UP, NK_KEY_UP, NK_KEY_NONE},
+    {GLFW_KEY_DOWN, NK_KEY_DOWN, NK_KEY_DOWN, NK_KEY_NONE},
+    {GLFW_KEY_HOME, NK_KEY_TEXT_START, NK_KEY_TEXT_START, NK_KEY_SCROLL_START},
+    {GLFW_KEY_END, NK_KEY_TEXT_END, NK_KEY_TEXT_END, NK_KEY_SCROLL_END},
+    {GLFW_KEY_PAGE_DOWN, NK_KEY_SCROLL_DOWN, NK_KEY_SCROLL_DOWN, NK_KEY_NONE},
+    {GLFW_KEY_PAGE_UP, NK_KEY_SCROLL_UP, NK_KEY_SCROLL_UP, NK_KEY_NONE},
+    {GLFW_KEY_LEFT_SHIFT, NK_KEY_SHIFT, NK_KEY_SHIFT, NK_KEY_NONE},
+    {GLFW_KEY_RIGHT_SHIFT, NK_KEY_SHIFT, NK_KEY_SHIFT, NK_KEY_NONE},
+    {GLFW_KEY_LEFT, NK_KEY_LEFT, NK_KEY_TEXT_WORD_LEFT, NK_KEY_NONE},
+    {GLFW_KEY_RIGHT, NK_KEY_RIGHT, NK_KEY_TEXT_WORD_RIGHT, NK_KEY_NONE},
+    {GLFW_KEY_C, NK_KEY_NONE, NK_KEY_COPY, NK_KEY_NONE},
+    {GLFW_KEY_V, NK_KEY_NONE, NK_KEY_PASTE, NK_KEY_NONE},
+    {GLFW_KEY_X, NK_KEY_NONE, NK_KEY_CUT, NK_KEY_NONE},
+    {GLFW_KEY_Z, NK_KEY_NONE, NK_KEY_TEXT_UNDO, NK_KEY_NONE},
+    {GLFW_KEY_R, NK_KEY_NONE, NK_KEY_TEXT_REDO, NK_KEY_NONE},
+    {GLFW_KEY_B, NK_KEY_NONE, NK_KEY_TEXT_LINE_START, NK_KEY_NONE},
+    {GLFW_KEY_E, NK_KEY_NONE, NK_KEY_TEXT_LINE_END, NK_KEY_NONE}
+};
+#define NK_GLFW_KEY_COUNT (sizeof(nk_glfw_keys) / sizeof(nk_glfw_keys[0]))
 
 struct nk_glfw_device {
     struct nk_buffer cmds;
@@ -83,12 +144,19 @@ static struct nk_glfw {
     struct nk_context ctx;
     struct nk_font_atlas atlas;
     struct nk_vec2 fb_scale;
-    unsigned int text[NK_GLFW_TEXT_MAX];
-    int text_len;
-    struct nk_vec2 scroll;
+    /* Ring of the events nuklear has not seen yet. It grows rather than
+     * dropping anything, a lost release would leave a key held. */
+    struct nk_glfw_event *events;
+    int event_capacity;
+    int event_first;
+    int event_count;
+    /* Time of the newest motion event of the current frame, 0 if none */
+    double motion_time;
+    /* Whether Ctrl was held when the key was pressed, its release goes to
+     * the same nuklear keys */
+    int key_ctrl[NK_GLFW_KEY_COUNT];
     double last_button_click;
     int is_double_click_down;
-    struct nk_vec2 double_click_pos;
 } glfw;
 
 #ifdef __APPLE__
@@ -126,7 +194,8 @@ nk_glfw3_device_create(void)
         "}\n";
 
     struct nk_glfw_device *dev = &glfw.ogl;
-    nk_buffer_init_default(&dev->cmds);
+    nk_buffer_init(&dev->cmds, wlay_nk_allocator(WLAY_MEM_RENDER),
+                   NK_BUFFER_DEFAULT_INITIAL_SIZE);
     dev->prog = glCreateProgram();
     dev->vert_shdr = glCreateShader(GL_VERTEX_SHADER);
     dev->frag_shdr = glCreateShader(GL_FRAGMENT_SHADER);
@@ -306,36 +375,140 @@ nk_glfw3_render(enum nk_anti_aliasing AA, int max_vertex_buffer, int max_element
     glDisable(GL_SCISSOR_TEST);
 }
 
+NK_INTERN struct nk_glfw_event*
+nk_glfw3_event_at(int i)
+{
+    return &glfw.events[(glfw.event_first + i) % glfw.event_capacity];
+}
+
+NK_INTERN void
+nk_glfw3_event_pop(void)
+{
+    glfw.event_first = (glfw.event_first + 1) % glfw.event_capacity;
+    glfw.event_count--;
+}
+
+/* Doubles the ring, NK_GLFW_EVENT_MAX events to begin with */
+NK_INTERN void
+nk_glfw3_event_grow(void)
+{
+    const struct nk_allocator *alloc = wlay_nk_allocator(WLAY_MEM_GUI);
+    int capacity = glfw.event_capacity ? glfw.event_capacity * 2 : NK_GLFW_EVENT_MAX;
+    struct nk_glfw_event *events = (struct nk_glfw_event*)
+        alloc->alloc(alloc->userdata, 0, (nk_size)capacity * sizeof(*events));
+    int i;
+    for (i = 0; i < glfw.event_count; i++)
+        events[i] = *nk_glfw3_event_at(i);
+    if (glfw.events)
+        alloc->free(alloc->userdata, glfw.events);
+    glfw.events = events;
+    glfw.event_capacity = capacity;
+    glfw.event_first = 0;
+}
+
+/* Motion and scroll events in a row add up to one, nothing is dropped */
+NK_INTERN void
+nk_glfw3_queue(struct nk_glfw_event event)
+{
+    struct nk_glfw_event *last = glfw.event_count ? nk_glfw3_event_at(glfw.event_count - 1) : 0;
+    event.time = glfwGetTime();
+    if (last && last->type == event.type && event.type == NK_GLFW_EVENT_MOTION) {
+        *last = event;
+        return;
+    }
+    if (last && last->type == event.type && event.type == NK_GLFW_EVENT_SCROLL) {
+        last->pos.x += event.pos.x;
+        last->pos.y += event.pos.y;
+        last->time = event.time;
+        return;
+    }
+    if (glfw.event_count == glfw.event_capacity)
+        nk_glfw3_event_grow();
+    *nk_glfw3_event_at(glfw.event_count++) = event;
+}
+
+NK_INTERN void
+nk_glfw3_queue_key(enum nk_keys key, int down)
+{
+    struct nk_glfw_event event = {.type = NK_GLFW_EVENT_KEY};
+    if (key == NK_KEY_NONE) return;
+    event.id = key;
+    event.down = down;
+    nk_glfw3_queue(event);
+}
+
 NK_API void
 nk_glfw3_char_callback(GLFWwindow *win, unsigned int codepoint)
 {
+    struct nk_glfw_event event = {.type = NK_GLFW_EVENT_TEXT};
     (void)win;
-    if (glfw.text_len < NK_GLFW_TEXT_MAX)
-        glfw.text[glfw.text_len++] = codepoint;
+    event.text = codepoint;
+    nk_glfw3_queue(event);
 }
 
 NK_API void
 nk_gflw3_scroll_callback(GLFWwindow *win, double xoff, double yoff)
 {
-    (void)win; (void)xoff;
-    glfw.scroll.x += (float)xoff;
-    glfw.scroll.y += (float)yoff;
+    struct nk_glfw_event event = {.type = NK_GLFW_EVENT_SCROLL};
+    (void)win;
+    event.pos = nk_vec2((float)xoff, (float)yoff);
+    nk_glfw3_queue(event);
+}
+
+NK_API void
+nk_glfw3_cursor_pos_callback(GLFWwindow *win, double x, double y)
+{
+    struct nk_glfw_event event = {.type = NK_GLFW_EVENT_MOTION};
+    (void)win;
+    event.pos = nk_vec2((float)(int)x, (float)(int)y);
+    nk_glfw3_queue(event);
 }
 
 NK_API void
 nk_glfw3_mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+    struct nk_glfw_event event = {.type = NK_GLFW_EVENT_BUTTON};
     double x, y;
-    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+    (void)mods;
+    switch (button) {
+    case GLFW_MOUSE_BUTTON_LEFT: event.id = NK_BUTTON_LEFT; break;
+    case GLFW_MOUSE_BUTTON_MIDDLE: event.id = NK_BUTTON_MIDDLE; break;
+    case GLFW_MOUSE_BUTTON_RIGHT: event.id = NK_BUTTON_RIGHT; break;
+    default: return;
+    }
     glfwGetCursorPos(window, &x, &y);
+    event.pos = nk_vec2((float)(int)x, (float)(int)y);
+    event.down = action == GLFW_PRESS;
+    nk_glfw3_queue(event);
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+
+    event.id = NK_BUTTON_DOUBLE;
     if (action == GLFW_PRESS)  {
         double dt = glfwGetTime() - glfw.last_button_click;
-        if (dt > NK_GLFW_DOUBLE_CLICK_LO && dt < NK_GLFW_DOUBLE_CLICK_HI) {
-            glfw.is_double_click_down = nk_true;
-            glfw.double_click_pos = nk_vec2((float)x, (float)y);
-        }
         glfw.last_button_click = glfwGetTime();
-    } else glfw.is_double_click_down = nk_false;
+        if (dt <= NK_GLFW_DOUBLE_CLICK_LO || dt >= NK_GLFW_DOUBLE_CLICK_HI) return;
+        glfw.is_double_click_down = nk_true;
+    } else if (glfw.is_double_click_down) {
+        glfw.is_double_click_down = nk_false;
+    } else return;
+    nk_glfw3_queue(event);
+}
+
+NK_API void
+nk_glfw3_key_callback(GLFWwindow *win, int key, int scancode, int action, int mods)
+{
+    size_t i;
+    int down = action != GLFW_RELEASE;
+    (void)win; (void)scancode;
+    /* Keystate based input, a repeat changes nothing */
+    if (action == GLFW_REPEAT) return;
+    for (i = 0; i < NK_GLFW_KEY_COUNT; ++i) {
+        const struct nk_glfw_key *k = &nk_glfw_keys[i];
+        if (k->key != key) continue;
+        if (down) glfw.key_ctrl[i] = (mods & GLFW_MOD_CONTROL) != 0;
+        nk_glfw3_queue_key(glfw.key_ctrl[i] ? k->ctrl : k->plain, down);
+        nk_glfw3_queue_key(k->also, down);
+    }
 }
 
 NK_INTERN void
@@ -368,8 +541,10 @@ nk_glfw3_init(GLFWwindow *win, enum nk_glfw_init_state init_state)
         glfwSetScrollCallback(win, nk_gflw3_scroll_callback);
         glfwSetCharCallback(win, nk_glfw3_char_callback);
         glfwSetMouseButtonCallback(win, nk_glfw3_mouse_button_callback);
+        glfwSetKeyCallback(win, nk_glfw3_key_callback);
+        glfwSetCursorPosCallback(win, nk_glfw3_cursor_pos_callback);
     }
-    nk_init_default(&glfw.ctx, 0);
+    nk_init(&glfw.ctx, wlay_nk_allocator(WLAY_MEM_GUI), 0);
     glfw.ctx.clip.copy = nk_glfw3_clipboard_copy;
     glfw.ctx.clip.paste = nk_glfw3_clipboard_paste;
     glfw.ctx.clip.userdata = nk_handle_ptr(0);
@@ -377,7 +552,7 @@ nk_glfw3_init(GLFWwindow *win, enum nk_glfw_init_state init_state)
     nk_glfw3_device_create();
 
     glfw.is_double_click_down = nk_false;
-    glfw.double_click_pos = nk_vec2(0, 0);
+    glfw.event_first = glfw.event_count = 0;
 
     return &glfw.ctx;
 }
@@ -385,7 +560,7 @@ nk_glfw3_init(GLFWwindow *win, enum nk_glfw_init_state init_state)
 NK_API void
 nk_glfw3_font_stash_begin(struct nk_font_atlas **atlas)
 {
-    nk_font_atlas_init_default(&glfw.atlas);
+    nk_font_atlas_init(&glfw.atlas, wlay_nk_allocator(WLAY_MEM_RENDER));
     nk_font_atlas_begin(&glfw.atlas);
     *atlas = &glfw.atlas;
 }
@@ -401,11 +576,30 @@ nk_glfw3_font_stash_end(void)
         nk_style_set_font(&glfw.ctx, &glfw.atlas.default_font->handle);
 }
 
+/* Whether the event can go into the frame nuklear is building. A key or
+ * button changes at most once per frame, text goes in as long as it fits. */
+NK_INTERN int
+nk_glfw3_event_fits(const struct nk_glfw_event *event,
+    const char *keys_changed, const char *buttons_changed)
+{
+    const struct nk_input *in = &glfw.ctx.input;
+    switch (event->type) {
+    case NK_GLFW_EVENT_KEY:
+        return !keys_changed[event->id] || in->keyboard.keys[event->id].down == event->down;
+    case NK_GLFW_EVENT_BUTTON:
+        return !buttons_changed[event->id] || in->mouse.buttons[event->id].down == event->down;
+    case NK_GLFW_EVENT_TEXT:
+        return in->keyboard.text_len + NK_UTF_SIZE < NK_INPUT_MAX;
+    default:
+        return nk_true;
+    }
+}
+
 NK_API void
 nk_glfw3_new_frame(void)
 {
-    int i;
-    double x, y;
+    char keys_changed[NK_KEY_MAX] = {0};
+    char buttons_changed[NK_BUTTON_MAX] = {0};
     struct nk_context *ctx = &glfw.ctx;
     struct GLFWwindow *win = glfw.win;
 
@@ -415,9 +609,6 @@ nk_glfw3_new_frame(void)
     glfw.fb_scale.y = (float)glfw.display_height/(float)glfw.height;
 
     nk_input_begin(ctx);
-    for (i = 0; i < glfw.text_len; ++i)
-        nk_input_unicode(ctx, glfw.text[i]);
-
 #ifdef NK_GLFW_GL3_MOUSE_GRABBING
     /* optional grabbing behavior */
     if (ctx->input.mouse.grab)
@@ -426,43 +617,35 @@ nk_glfw3_new_frame(void)
         glfwSetInputMode(glfw.win, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 #endif
 
-    nk_input_key(ctx, NK_KEY_DEL, glfwGetKey(win, GLFW_KEY_DELETE) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_ENTER, glfwGetKey(win, GLFW_KEY_ENTER) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_TAB, glfwGetKey(win, GLFW_KEY_TAB) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_BACKSPACE, glfwGetKey(win, GLFW_KEY_BACKSPACE) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_UP, glfwGetKey(win, GLFW_KEY_UP) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_DOWN, glfwGetKey(win, GLFW_KEY_DOWN) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_TEXT_START, glfwGetKey(win, GLFW_KEY_HOME) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_TEXT_END, glfwGetKey(win, GLFW_KEY_END) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_SCROLL_START, glfwGetKey(win, GLFW_KEY_HOME) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_SCROLL_END, glfwGetKey(win, GLFW_KEY_END) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_SCROLL_DOWN, glfwGetKey(win, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_SCROLL_UP, glfwGetKey(win, GLFW_KEY_PAGE_UP) == GLFW_PRESS);
-    nk_input_key(ctx, NK_KEY_SHIFT, glfwGetKey(win, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS||
-                                    glfwGetKey(win, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS);
-
-    if (glfwGetKey(win, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
-        glfwGetKey(win, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS) {
-        nk_input_key(ctx, NK_KEY_COPY, glfwGetKey(win, GLFW_KEY_C) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_PASTE, glfwGetKey(win, GLFW_KEY_V) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_CUT, glfwGetKey(win, GLFW_KEY_X) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_UNDO, glfwGetKey(win, GLFW_KEY_Z) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_REDO, glfwGetKey(win, GLFW_KEY_R) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_WORD_LEFT, glfwGetKey(win, GLFW_KEY_LEFT) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_WORD_RIGHT, glfwGetKey(win, GLFW_KEY_RIGHT) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_LINE_START, glfwGetKey(win, GLFW_KEY_B) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_TEXT_LINE_END, glfwGetKey(win, GLFW_KEY_E) == GLFW_PRESS);
-    } else {
-        nk_input_key(ctx, NK_KEY_LEFT, glfwGetKey(win, GLFW_KEY_LEFT) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_RIGHT, glfwGetKey(win, GLFW_KEY_RIGHT) == GLFW_PRESS);
-        nk_input_key(ctx, NK_KEY_COPY, 0);
-        nk_input_key(ctx, NK_KEY_PASTE, 0);
-        nk_input_key(ctx, NK_KEY_CUT, 0);
-        nk_input_key(ctx, NK_KEY_SHIFT, 0);
+    /* Whatever does not fit stays queued for the next frame, and so does
+     * everything after it */
+    glfw.motion_time = 0;
+    while (glfw.event_count) {
+        const struct nk_glfw_event *event = nk_glfw3_event_at(0);
+        if (!nk_glfw3_event_fits(event, keys_changed, buttons_changed)) break;
+        switch (event->type) {
+        case NK_GLFW_EVENT_MOTION:
+            nk_input_motion(ctx, (int)event->pos.x, (int)event->pos.y);
+            glfw.motion_time = event->time;
+            break;
+        case NK_GLFW_EVENT_BUTTON:
+            buttons_changed[event->id] = 1;
+            nk_input_button(ctx, (enum nk_buttons)event->id, (int)event->pos.x,
+                (int)event->pos.y, event->down);
+            break;
+        case NK_GLFW_EVENT_SCROLL:
+            nk_input_scroll(ctx, event->pos);
+            break;
+        case NK_GLFW_EVENT_KEY:
+            keys_changed[event->id] = 1;
+            nk_input_key(ctx, (enum nk_keys)event->id, event->down);
+            break;
+        case NK_GLFW_EVENT_TEXT:
+            nk_input_unicode(ctx, event->text);
+            break;
+        }
+        nk_glfw3_event_pop();
     }
-
-    glfwGetCursorPos(win, &x, &y);
-    nk_input_motion(ctx, (int)x, (int)y);
 #ifdef NK_GLFW_GL3_MOUSE_GRABBING
     if (ctx->input.mouse.grabbed) {
         glfwSetCursorPos(glfw.win, ctx->input.mouse.prev.x, ctx->input.mouse.prev.y);
@@ -470,19 +653,44 @@ nk_glfw3_new_frame(void)
         ctx->input.mouse.pos.y = ctx->input.mouse.prev.y;
     }
 #endif
-    nk_input_button(ctx, NK_BUTTON_LEFT, (int)x, (int)y, glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS);
-    nk_input_button(ctx, NK_BUTTON_MIDDLE, (int)x, (int)y, glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS);
-    nk_input_button(ctx, NK_BUTTON_RIGHT, (int)x, (int)y, glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS);
-    nk_input_button(ctx, NK_BUTTON_DOUBLE, (int)glfw.double_click_pos.x, (int)glfw.double_click_pos.y, glfw.is_double_click_down);
-    nk_input_scroll(ctx, glfw.scroll);
     nk_input_end(&glfw.ctx);
-    glfw.text_len = 0;
-    glfw.scroll = nk_vec2(0,0);
+}
+
+/* For a frame whose input already ended: moves the mouse to the newest of
+ * the motion events at the front of the queue, nk_true if there was one */
+NK_API int
+nk_glfw3_late_motion(void)
+{
+    struct nk_mouse *mouse = &glfw.ctx.input.mouse;
+    int moved = nk_false;
+    while (glfw.event_count && nk_glfw3_event_at(0)->type == NK_GLFW_EVENT_MOTION) {
+        mouse->pos = nk_glfw3_event_at(0)->pos;
+        glfw.motion_time = nk_glfw3_event_at(0)->time;
+        nk_glfw3_event_pop();
+        moved = nk_true;
+    }
+    if (moved) {
+        mouse->delta.x = mouse->pos.x - mouse->prev.x;
+        mouse->delta.y = mouse->pos.y - mouse->prev.y;
+    }
+    return moved;
+}
+
+/* glfwGetTime() of the newest cursor position the current frame shows, 0
+ * if the cursor did not move since the last frame */
+NK_API double
+nk_glfw3_motion_time(void)
+{
+    return glfw.motion_time;
 }
 
 NK_API
 void nk_glfw3_shutdown(void)
 {
+    if (glfw.events) {
+        const struct nk_allocator *alloc = wlay_nk_allocator(WLAY_MEM_GUI);
+        alloc->free(alloc->userdata, glfw.events);
+    }
     nk_font_atlas_clear(&glfw.atlas);
     nk_free(&glfw.ctx);
     nk_glfw3_device_destroy();
@@ -0,0 +1,694 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_EXPORT
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "json.h"
+#include "profile.h"
+
+// A rewrite in place ends with closing the file, a rewrite through a
+// temporary file with moving it over the old one
+#define PROFILE_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+struct wlay_profiles {
+    struct wlay_state *wlay;
+    int fd;
+    struct wl_list profiles;
+};
+
+enum profile_token {
+    PROFILE_TOKEN_WORD,
+    PROFILE_TOKEN_NEWLINE,
+    PROFILE_TOKEN_OPEN,
+    PROFILE_TOKEN_CLOSE,
+    PROFILE_TOKEN_END,
+};
+
+// Splits the config into words, quoted ones without the quotes, and braces.
+// Comments are left out and escaped line breaks joined.
+struct profile_lexer {
+    const char *p;
+    const char *end;
+    char word[256];
+    // A token that was read ahead, see profile_word()
+    bool pushed;
+    enum profile_token pushed_token;
+};
+
+enum profile_key {
+    PROFILE_KEY_OUTPUT,
+    PROFILE_KEY_MODE,
+    PROFILE_KEY_CUSTOM_MODE,
+    PROFILE_KEY_MODELINE,
+    PROFILE_KEY_POSITION,
+    PROFILE_KEY_TRANSFORM,
+    PROFILE_KEY_SCALE,
+    PROFILE_KEY_ADAPTIVE_SYNC,
+    PROFILE_KEY_DISABLE,
+    PROFILE_KEY_ENABLE,
+    PROFILE_KEY_PROFILE,
+    PROFILE_KEY_COMMAND,
+};
+
+// The keywords of all three formats, the way sway, kanshi and wlr-randr
+// spell them
+static const struct {
+    const char *name;
+    enum profile_key key;
+} profile_keys[] = {
+    { "output", PROFILE_KEY_OUTPUT },
+    { "--output", PROFILE_KEY_OUTPUT },
+    { "mode", PROFILE_KEY_MODE },
+    { "res", PROFILE_KEY_MODE },
+    { "resolution", PROFILE_KEY_MODE },
+    { "--mode", PROFILE_KEY_MODE },
+    { "--custom-mode", PROFILE_KEY_CUSTOM_MODE },
+    { "modeline", PROFILE_KEY_MODELINE },
+    { "pos", PROFILE_KEY_POSITION },
+    { "position", PROFILE_KEY_POSITION },
+    { "--pos", PROFILE_KEY_POSITION },
+    { "transform", PROFILE_KEY_TRANSFORM },
+    { "--transform", PROFILE_KEY_TRANSFORM },
+    { "scale", PROFILE_KEY_SCALE },
+    { "--scale", PROFILE_KEY_SCALE },
+    { "adaptive_sync", PROFILE_KEY_ADAPTIVE_SYNC },
+    { "--adaptive-sync", PROFILE_KEY_ADAPTIVE_SYNC },
+    { "disable", PROFILE_KEY_DISABLE },
+    { "--off", PROFILE_KEY_DISABLE },
+    { "enable", PROFILE_KEY_ENABLE },
+    { "--on", PROFILE_KEY_ENABLE },
+    { "profile", PROFILE_KEY_PROFILE },
+    { "wlr-randr", PROFILE_KEY_COMMAND },
+    { "exec", PROFILE_KEY_COMMAND },
+};
+
+
+static enum profile_token profile_next(struct profile_lexer *lexer)
+{
+    if (lexer->pushed) {
+        lexer->pushed = false;
+        return lexer->pushed_token;
+    }
+    for (;;) {
+        while (lexer->p < lexer->end && strchr(" \t\r", *lexer->p)) {
+            lexer->p++;
+        }
+        if (lexer->p == lexer->end) {
+            return PROFILE_TOKEN_END;
+        }
+        char c = *lexer->p;
+        if (c == '\\' && lexer->p + 1 < lexer->end &&
+                (lexer->p[1] == '\n' || lexer->p[1] == '\r')) {
+            lexer->p += 2;
+            continue;
+        }
+        if (c == '#') {
+            while (lexer->p < lexer->end && *lexer->p != '\n') {
+                lexer->p++;
+            }
+            continue;
+        }
+        lexer->p++;
+        if (c == '\n') {
+            return PROFILE_TOKEN_NEWLINE;
+        } else if (c == '{') {
+            return PROFILE_TOKEN_OPEN;
+        } else if (c == '}') {
+            return PROFILE_TOKEN_CLOSE;
+        }
+        break;
+    }
+
+    // Words longer than the buffer are cut short, no output is named
+    // like that
+    size_t length = 0;
+    if (lexer->p[-1] == '"') {
+        while (lexer->p < lexer->end && *lexer->p != '"' && *lexer->p != '\n') {
+            if (*lexer->p == '\\' && lexer->p + 1 < lexer->end) {
+                lexer->p++;
+            }
+            if (length + 1 < sizeof(lexer->word)) {
+                lexer->word[length++] = *lexer->p;
+            }
+            lexer->p++;
+        }
+        if (lexer->p < lexer->end && *lexer->p == '"') {
+            lexer->p++;
+        }
+    } else {
+        // Quoted the way sh quotes, as in the wlr-randr scripts
+        lexer->p--;
+        bool quoted = false;
+        while (lexer->p < lexer->end && *lexer->p != '\n' &&
+               (quoted || !strchr(" \t\r{}#", *lexer->p))) {
+            char c = *lexer->p++;
+            if (c == '\'') {
+                quoted = !quoted;
+                continue;
+            }
+            if (c == '\\' && !quoted && lexer->p < lexer->end && !strchr("\r\n", *lexer->p)) {
+                c = *lexer->p++;
+            }
+            if (length + 1 < sizeof(lexer->word)) {
+                lexer->word[length++] = c;
+            }
+        }
+    }
+    lexer->word[length] = '\0';
+    return PROFILE_TOKEN_WORD;
+}
+
+
+static void profile_push(struct profile_lexer *lexer, enum profile_token token)
+{
+    lexer->pushed = true;
+    lexer->pushed_token = token;
+}
+
+
+// The next word, NULL without consuming anything if a line break or a
+// brace comes first
+static const char *profile_word(struct profile_lexer *lexer)
+{
+    enum profile_token token = profile_next(lexer);
+    if (token == PROFILE_TOKEN_WORD) {
+        return lexer->word;
+    }
+    profile_push(lexer, token);
+    return NULL;
+}
+
+
+static bool profile_int(const char *s, int32_t *value)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end || errno || v < INT32_MIN || v > INT32_MAX) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+
+// WxH, optionally followed by @R or @RHz
+static bool profile_mode(struct wlay_profile_output *output, const char *s)
+{
+    int32_t width, height;
+    double refresh = 0;
+    int consumed = 0;
+    if (sscanf(s, "%dx%d%n", &width, &height, &consumed) != 2) {
+        return false;
+    }
+    s += consumed;
+    if (*s == '@') {
+        char *end;
+        refresh = strtod(s + 1, &end);
+        if (end == s + 1 || (*end && strcmp(end, "Hz"))) {
+            return false;
+        }
+    } else if (*s) {
+        return false;
+    }
+    output->width = width;
+    output->height = height;
+    output->refresh_rate = lround(refresh * 1000);
+    return true;
+}
+
+
+static struct wlay_profile_output *profile_output(struct wlay_profile *profile,
+                                                  size_t *capacity, const char *name)
+{
+    // Several output lines for the same output add up
+    for (size_t i = 0; i < profile->output_count; i++) {
+        if (!strcmp(profile->outputs[i].name, name)) {
+            return &profile->outputs[i];
+        }
+    }
+    if (profile->output_count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 8;
+        profile->outputs = xrealloc(profile->outputs, *capacity * sizeof(*profile->outputs));
+    }
+    struct wlay_profile_output *output = &profile->outputs[profile->output_count++];
+    *output = (struct wlay_profile_output){
+        .name = xstrdup(name),
+        .enabled = true,
+        .transform = -1,
+        .adaptive_sync = -1,
+    };
+    return output;
+}
+
+
+// Handles the keyword and its arguments, false if they make no sense
+static bool profile_key(struct profile_lexer *lexer, enum profile_key key,
+                        struct wlay_profile_output *output)
+{
+    const char *word;
+    switch (key) {
+    case PROFILE_KEY_OUTPUT:
+    case PROFILE_KEY_PROFILE:
+    case PROFILE_KEY_COMMAND:
+        // Handled by the caller
+        return true;
+    case PROFILE_KEY_MODE:
+    case PROFILE_KEY_CUSTOM_MODE:
+        word = profile_word(lexer);
+        output->custom = key == PROFILE_KEY_CUSTOM_MODE;
+        if (word != NULL && !strcmp(word, "--custom")) {
+            output->custom = true;
+            word = profile_word(lexer);
+        }
+        return word != NULL && profile_mode(output, word);
+    case PROFILE_KEY_MODELINE: {
+        // Clock in MHz, then the horizontal and vertical timing
+        int32_t timing[8];
+        word = profile_word(lexer);
+        double clock = word ? strtod(word, NULL) : 0;
+        for (int i = 0; i < 8; i++) {
+            word = profile_word(lexer);
+            if (word == NULL || !profile_int(word, &timing[i])) {
+                return false;
+            }
+        }
+        // The sync polarities
+        while ((word = profile_word(lexer)) != NULL) {
+            if (!strstr(word, "sync")) {
+                profile_push(lexer, PROFILE_TOKEN_WORD);
+                break;
+            }
+        }
+        if (timing[3] <= 0 || timing[7] <= 0) {
+            return false;
+        }
+        output->custom = true;
+        output->width = timing[0];
+        output->height = timing[4];
+        output->refresh_rate = lround(clock * 1e9 / ((double)timing[3] * timing[7]));
+        return true;
+    }
+    case PROFILE_KEY_POSITION:
+        // x,y or sway's x y
+        word = profile_word(lexer);
+        if (word == NULL) {
+            return false;
+        }
+        if (strchr(word, ',')) {
+            output->has_position = sscanf(word, "%d,%d", &output->x, &output->y) == 2;
+        } else if (profile_int(word, &output->x)) {
+            word = profile_word(lexer);
+            output->has_position = word != NULL && profile_int(word, &output->y);
+        }
+        return output->has_position;
+    case PROFILE_KEY_TRANSFORM:
+        word = profile_word(lexer);
+        for (int i = 0; word != NULL && i < WLAY_TRANSFORM_COUNT; i++) {
+            if (!strcmp(word, wlay_output_transform_names[i])) {
+                output->transform = i;
+                return true;
+            }
+        }
+        return false;
+    case PROFILE_KEY_SCALE: {
+        word = profile_word(lexer);
+        char *end;
+        double scale = word ? strtod(word, &end) : 0;
+        if (word == NULL || *end || !(scale > 0)) {
+            return false;
+        }
+        output->scale = wl_fixed_from_double(scale);
+        return true;
+    }
+    case PROFILE_KEY_ADAPTIVE_SYNC:
+        word = profile_word(lexer);
+        if (word != NULL && (!strcmp(word, "on") || !strcmp(word, "enabled"))) {
+            output->adaptive_sync = 1;
+        } else if (word != NULL && (!strcmp(word, "off") || !strcmp(word, "disabled"))) {
+            output->adaptive_sync = 0;
+        } else {
+            return false;
+        }
+        return true;
+    case PROFILE_KEY_DISABLE:
+        output->enabled = false;
+        return true;
+    case PROFILE_KEY_ENABLE:
+        output->enabled = true;
+        return true;
+    }
+    return false;
+}
+
+
+static void profile_free_outputs(struct wlay_profile *profile)
+{
+    for (size_t i = 0; i < profile->output_count; i++) {
+        xfree(profile->outputs[i].name);
+    }
+    xfree(profile->outputs);
+    profile->outputs = NULL;
+    profile->output_count = 0;
+}
+
+
+void wlay_profile_parse(struct wlay_profile *profile, const char *text, size_t size)
+{
+    profile_free_outputs(profile);
+    profile->unknown_count = 0;
+    struct profile_lexer lexer = { .p = text, .end = text + size };
+    size_t capacity = 0;
+
+    // Told apart by how they start: kanshi with a profile, wlr-randr with
+    // the command, as a script after the shebang comment with exec, sway
+    // with an output
+    enum profile_token token = profile_next(&lexer);
+    while (token == PROFILE_TOKEN_NEWLINE) {
+        token = profile_next(&lexer);
+    }
+    profile->type = WLAY_CONFIG_SWAY;
+    if (token == PROFILE_TOKEN_OPEN ||
+            (token == PROFILE_TOKEN_WORD && !strcmp(lexer.word, "profile"))) {
+        profile->type = WLAY_CONFIG_KANSHI;
+    } else if (token == PROFILE_TOKEN_WORD && !strcmp(lexer.word, "wlr-randr")) {
+        profile->type = WLAY_CONFIG_WLRRANDR;
+    } else if (token == PROFILE_TOKEN_WORD && !strcmp(lexer.word, "exec")) {
+        const char *command = profile_word(&lexer);
+        if (command != NULL && !strcmp(command, "wlr-randr")) {
+            profile->type = WLAY_CONFIG_WLRRANDR_SH;
+        }
+    }
+
+    // Only sway ends an output with the line, unless it is in braces
+    struct wlay_profile_output *output = NULL;
+    int depth = 0;
+    for (; token != PROFILE_TOKEN_END; token = profile_next(&lexer)) {
+        if (token == PROFILE_TOKEN_OPEN) {
+            depth++;
+            continue;
+        }
+        if (token == PROFILE_TOKEN_CLOSE) {
+            depth = max(depth - 1, 0);
+        }
+        if (token == PROFILE_TOKEN_NEWLINE || token == PROFILE_TOKEN_CLOSE) {
+            if (profile->type == WLAY_CONFIG_SWAY && depth == 0) {
+                output = NULL;
+            }
+            continue;
+        }
+
+        size_t k;
+        for (k = 0; k < ARRAY_SIZE(profile_keys); k++) {
+            if (!strcmp(lexer.word, profile_keys[k].name)) {
+                break;
+            }
+        }
+        if (k == ARRAY_SIZE(profile_keys)) {
+            profile->unknown_count++;
+            continue;
+        }
+        enum profile_key key = profile_keys[k].key;
+        if (key == PROFILE_KEY_OUTPUT) {
+            const char *name = profile_word(&lexer);
+            output = name ? profile_output(profile, &capacity, name) : NULL;
+        } else if (key == PROFILE_KEY_PROFILE) {
+            // Its name, if it has one
+            profile_word(&lexer);
+            output = NULL;
+        } else if (key != PROFILE_KEY_COMMAND &&
+                   (output == NULL || !profile_key(&lexer, key, output))) {
+            profile->unknown_count++;
+        }
+    }
+}
+
+
+static char *profile_read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    char *data = NULL;
+    size_t capacity = 0;
+    *size = 0;
+    for (;;) {
+        if (*size == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            data = xrealloc(data, capacity);
+        }
+        size_t n = fread(data + *size, 1, capacity - *size, f);
+        if (n == 0) {
+            break;
+        }
+        *size += n;
+    }
+    fclose(f);
+    return data;
+}
+
+
+// Reparses the file if it changed, false if it can not be read. The
+// profile keeps what it had then.
+static bool profile_reload(struct wlay_profile *profile, bool initial)
+{
+    // Once inotify saw a write it is reparsed in any case, a rewrite of the
+    // same size within the timestamp granularity looks unchanged to stat()
+    bool written = profile->dirty;
+    profile->dirty = false;
+    struct stat st;
+    if (stat(profile->path, &st) < 0) {
+        return false;
+    }
+    if (!initial && !written && st.st_dev == profile->dev && st.st_ino == profile->ino &&
+            st.st_size == profile->size &&
+            st.st_mtim.tv_sec == profile->mtime.tv_sec &&
+            st.st_mtim.tv_nsec == profile->mtime.tv_nsec) {
+        return true;
+    }
+    size_t size;
+    char *text = profile_read_file(profile->path, &size);
+    if (text == NULL) {
+        return false;
+    }
+    double start = monotonic_time();
+    wlay_profile_parse(profile, text, size);
+    double end = monotonic_time();
+    xfree(text);
+
+    profile->dev = st.st_dev;
+    profile->ino = st.st_ino;
+    profile->size = st.st_size;
+    profile->mtime = st.st_mtim;
+    profile->parse_time = end - start;
+    if (initial) {
+        return true;
+    }
+    // The write is only known as wall clock time
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    profile->latency = max((now.tv_sec - st.st_mtim.tv_sec) +
+                           (now.tv_nsec - st.st_mtim.tv_nsec) / 1e9, 0.);
+    profile->max_latency = max(profile->max_latency, profile->latency);
+    profile->total_parse_time += profile->parse_time;
+    profile->reloads++;
+    log_info("Reloaded %s: %zu outputs, parsed in %.1f us, %.2f ms after the write",
+             profile->path, profile->output_count, profile->parse_time * 1e6,
+             profile->latency * 1e3);
+    return true;
+}
+
+
+struct wlay_profiles *wlay_profiles_create(struct wlay_state *wlay)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        log_info("Saved layouts are not reloaded, inotify failed: %s", strerror(errno));
+        return NULL;
+    }
+    struct wlay_profiles *profiles = xmalloc(sizeof(*profiles));
+    profiles->wlay = wlay;
+    profiles->fd = fd;
+    wl_list_init(&profiles->profiles);
+    return profiles;
+}
+
+
+void wlay_profiles_destroy(struct wlay_profiles *profiles)
+{
+    if (profiles == NULL) {
+        return;
+    }
+    struct wlay_profile *profile, *tmp;
+    wl_list_for_each_safe(profile, tmp, &profiles->profiles, link) {
+        wl_list_remove(&profile->link);
+        profile_free_outputs(profile);
+        xfree(profile->path);
+        xfree(profile);
+    }
+    close(profiles->fd);
+    xfree(profiles);
+}
+
+
+struct wlay_profile *wlay_profiles_add(struct wlay_profiles *profiles, const char *path)
+{
+    if (profiles == NULL) {
+        return NULL;
+    }
+    char *resolved = realpath(path, NULL);
+    if (resolved == NULL) {
+        log_info("Can not follow %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    char *full_path = xstrdup(resolved);
+    free(resolved);
+    struct wlay_profile *profile;
+    wl_list_for_each(profile, &profiles->profiles, link) {
+        if (!strcmp(profile->path, full_path)) {
+            xfree(full_path);
+            profile_reload(profile, false);
+            return profile;
+        }
+    }
+
+    profile = xmalloc(sizeof(*profile));
+    profile->path = full_path;
+    char *slash = strrchr(full_path, '/');
+    profile->base = slash + 1;
+    // Watching the directory sees the file being replaced too, the
+    // watch of a directory that is watched already is the same
+    *slash = '\0';
+    profile->wd = inotify_add_watch(profiles->fd, slash == full_path ? "/" : full_path,
+                                    PROFILE_WATCH_EVENTS);
+    *slash = '/';
+    if (profile->wd < 0 || !profile_reload(profile, true)) {
+        log_info("Can not follow %s: %s", path, strerror(errno));
+        xfree(profile->path);
+        xfree(profile);
+        return NULL;
+    }
+    wl_list_insert(profiles->profiles.prev, &profile->link);
+    log_info("Following %s, a %s layout of %zu outputs", profile->path,
+             wlay_config_type_names[profile->type], profile->output_count);
+    return profile;
+}
+
+
+int wlay_profiles_get_fd(struct wlay_profiles *profiles)
+{
+    return profiles ? profiles->fd : -1;
+}
+
+
+void wlay_profiles_dispatch(struct wlay_profiles *profiles)
+{
+    if (profiles == NULL) {
+        return;
+    }
+    // A tool writing a file may cause several events, it is reparsed
+    // once all of them are read
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool dirty = false;
+    ssize_t length;
+    while ((length = read(profiles->fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(*event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+            struct wlay_profile *profile;
+            wl_list_for_each(profile, &profiles->profiles, link) {
+                if (profile->wd == event->wd && !strcmp(profile->base, event->name)) {
+                    profile->dirty = true;
+                    dirty = true;
+                }
+            }
+        }
+    }
+    if (!dirty) {
+        return;
+    }
+    struct wlay_profile *profile;
+    wl_list_for_each(profile, &profiles->profiles, link) {
+        if (profile->dirty && !profile_reload(profile, false)) {
+            log_info("Can not reload %s, keeping the last version", profile->path);
+        }
+    }
+}
+
+
+static void profile_json_output(struct wlay_buffer *buffer,
+                                const struct wlay_profile_output *output)
+{
+    wlay_buffer_append(buffer, "{\"name\":", 8);
+    wlay_json_string(buffer, output->name);
+    wlay_buffer_printf(buffer, ",\"enabled\":%s", output->enabled ? "true" : "false");
+    if (output->width > 0) {
+        wlay_buffer_printf(buffer, ",\"width\":%d,\"height\":%d,\"custom\":%s",
+                           output->width, output->height, output->custom ? "true" : "false");
+    }
+    if (output->refresh_rate > 0) {
+        wlay_buffer_printf(buffer, ",\"refresh\":%d", output->refresh_rate);
+    }
+    if (output->has_position) {
+        wlay_buffer_printf(buffer, ",\"x\":%d,\"y\":%d", output->x, output->y);
+    }
+    if (output->transform >= 0) {
+        wlay_buffer_printf(buffer, ",\"transform\":\"%s\"",
+                           wlay_output_transform_names[output->transform]);
+    }
+    if (output->scale > 0) {
+        wlay_buffer_printf(buffer, ",\"scale\":%g", wl_fixed_to_double(output->scale));
+    }
+    if (output->adaptive_sync >= 0) {
+        wlay_buffer_printf(buffer, ",\"adaptive_sync\":%s",
+                           output->adaptive_sync ? "true" : "false");
+    }
+    wlay_buffer_append(buffer, "}", 1);
+}
+
+
+void wlay_profiles_json(struct wlay_buffer *buffer, struct wlay_profiles *profiles)
+{
+    wlay_buffer_append(buffer, "[", 1);
+    bool first = true;
+    struct wlay_profile *profile;
+    if (profiles != NULL) {
+        wl_list_for_each(profile, &profiles->profiles, link) {
+            wlay_buffer_append(buffer, first ? "{\"path\":" : ",{\"path\":", first ? 8 : 9);
+            wlay_json_string(buffer, profile->path);
+            wlay_buffer_printf(buffer, ",\"type\":\"%s\",\"outputs\":[",
+                               wlay_config_type_names[profile->type]);
+            for (size_t i = 0; i < profile->output_count; i++) {
+                if (i > 0) {
+                    wlay_buffer_append(buffer, ",", 1);
+                }
+                profile_json_output(buffer, &profile->outputs[i]);
+            }
+            wlay_buffer_printf(buffer, "],\"unknown\":%zu,\"reloads\":%llu,"
+                               "\"parse_us\":%.1f,\"mean_parse_us\":%.1f,"
+                               "\"latency_ms\":%.2f,\"max_latency_ms\":%.2f}",
+                               profile->unknown_count, (unsigned long long)profile->reloads,
+                               profile->parse_time * 1e6,
+                               profile->reloads ?
+                                   profile->total_parse_time / profile->reloads * 1e6 : 0,
+                               profile->latency * 1e3, profile->max_latency * 1e3);
+            first = false;
+        }
+    }
+    wlay_buffer_append(buffer, "]", 1);
+}
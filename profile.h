@@ -0,0 +1,89 @@
+#ifndef WLAY_PROFILE_H
+#define WLAY_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <wayland-client.h>
+
+#include "wlay.h"
+
+// Layouts saved as sway, kanshi or wlr-randr configs, read back into
+// memory and kept up to date while something else rewrites them. The
+// directories of the files are watched with inotify, a change to one file
+// reparses only that file.
+
+struct wlay_buffer;
+struct wlay_profiles;
+
+// Everything a config says about an output, what it leaves out is 0 or -1
+struct wlay_profile_output {
+    // The connector or the make, model and serial number
+    char *name;
+    bool enabled;
+    int32_t width;
+    int32_t height;
+    // mHz, 0 when the config leaves it to the compositor
+    int32_t refresh_rate;
+    bool custom;
+    bool has_position;
+    int32_t x;
+    int32_t y;
+    int32_t transform;
+    wl_fixed_t scale;
+    int adaptive_sync;
+};
+
+struct wlay_profile {
+    char *path;
+    enum wlay_config_type type;
+    struct wlay_profile_output *outputs;
+    size_t output_count;
+    // Words the parser did not understand, they are skipped
+    size_t unknown_count;
+
+    // The file as of the last parse. Without an inotify event, a file that
+    // still looks like this is not reparsed
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    // inotify watch of the directory and the name in it
+    int wd;
+    const char *base;
+    // inotify reported a write since the last parse
+    bool dirty;
+
+    // Reload statistics, the latency is from the file being written to
+    // the profile being up to date again
+    uint64_t reloads;
+    double parse_time;
+    double total_parse_time;
+    double latency;
+    double max_latency;
+
+    struct wl_list link;
+};
+
+// NULL without inotify
+struct wlay_profiles *wlay_profiles_create(struct wlay_state *wlay);
+void wlay_profiles_destroy(struct wlay_profiles *profiles);
+
+// Reads the file now and follows it from then on, the profile that
+// already follows it if there is one. NULL if it can not be read or
+// profiles is NULL.
+struct wlay_profile *wlay_profiles_add(struct wlay_profiles *profiles, const char *path);
+// Readable whenever wlay_profiles_dispatch() has something to do, for
+// backends that sleep while idle. -1 for NULL profiles.
+int wlay_profiles_get_fd(struct wlay_profiles *profiles);
+// Reparses whatever changed without blocking, profiles may be NULL
+void wlay_profiles_dispatch(struct wlay_profiles *profiles);
+
+// A JSON array of every profile with its outputs and reload statistics
+void wlay_profiles_json(struct wlay_buffer *buffer, struct wlay_profiles *profiles);
+
+// Parses config text into profile, replacing its outputs
+void wlay_profile_parse(struct wlay_profile *profile, const char *text, size_t size);
+
+#endif
@@ -0,0 +1,920 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define WLAY_MEM_TAG WLAY_MEM_RENDER
+#include "util.h"
+#include "raster.h"
+
+// Number of segments used to flatten bezier curves
+#define CURVE_SEGMENTS 16
+// Upper bound of segments used to flatten an arc
+#define ARC_MAX_SEGMENTS 64
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+
+static inline uint32_t wlay_raster_pack(struct nk_color c)
+{
+    // Alpha is handled by blending, the surface itself is opaque
+    return 0xff000000 | (uint32_t)c.r << 16 | (uint32_t)c.g << 8 | c.b;
+}
+
+
+// a * b / 255, rounded
+static inline uint32_t wlay_raster_mul(uint32_t a, uint32_t b)
+{
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+
+static inline uint32_t wlay_raster_blend(uint32_t dst, uint32_t src, uint32_t alpha)
+{
+    // Two channels at a time, each in its own 16 bit lane
+    uint32_t inv = 255 - alpha;
+    uint32_t rb = (src & 0xff00ff) * alpha + (dst & 0xff00ff) * inv + 0x800080;
+    rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+    uint32_t ag = ((src >> 8) & 0xff00ff) * alpha + ((dst >> 8) & 0xff00ff) * inv + 0x800080;
+    ag = (ag + ((ag >> 8) & 0xff00ff)) & 0xff00ff00;
+    return rb | ag;
+}
+
+
+static void wlay_raster_fill_pixels(uint32_t *dst, int n, uint32_t color)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i c = _mm_set1_epi32((int)color);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), c);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = color;
+    }
+}
+
+
+static void wlay_raster_blend_pixels(uint32_t *dst, int n, uint32_t color, uint32_t alpha)
+{
+    int i = 0;
+#ifdef __SSE2__
+    // Same as wlay_raster_blend, four pixels at a time with the source
+    // term precomputed
+    __m128i zero = _mm_setzero_si128();
+    __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+    __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    src = _mm_add_epi16(_mm_mullo_epi16(src, _mm_set1_epi16((short)alpha)),
+                        _mm_set1_epi16(128));
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv);
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv);
+        lo = _mm_add_epi16(lo, src);
+        hi = _mm_add_epi16(hi, src);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = wlay_raster_blend(dst[i], color, alpha);
+    }
+}
+
+
+static struct wlay_rect wlay_raster_intersect(struct wlay_rect a, struct wlay_rect b)
+{
+    int32_t x0 = max(a.x, b.x);
+    int32_t y0 = max(a.y, b.y);
+    int32_t x1 = min(a.x + a.w, b.x + b.w);
+    int32_t y1 = min(a.y + a.h, b.y + b.h);
+    return (struct wlay_rect){ x0, y0, max(x1 - x0, 0), max(y1 - y0, 0) };
+}
+
+
+static bool wlay_raster_empty(struct wlay_rect rect)
+{
+    return rect.w <= 0 || rect.h <= 0;
+}
+
+
+// Fills pixels [x0, x1) of row y
+static void wlay_raster_span(struct wlay_raster *r, int y, int x0, int x1,
+                             struct nk_color color)
+{
+    const struct wlay_rect *clip = &r->clip;
+    if (color.a == 0 || y < clip->y || y >= clip->y + clip->h) {
+        return;
+    }
+    x0 = max(x0, clip->x);
+    x1 = min(x1, clip->x + clip->w);
+    if (x0 >= x1) {
+        return;
+    }
+    uint32_t *dst = r->pixels + (size_t)y * r->stride + x0;
+    if (color.a == 255) {
+        wlay_raster_fill_pixels(dst, x1 - x0, wlay_raster_pack(color));
+    } else {
+        wlay_raster_blend_pixels(dst, x1 - x0, wlay_raster_pack(color), color.a);
+    }
+}
+
+
+// Fills the pixels whose centers lie within [left, right) of row y
+static void wlay_raster_spanf(struct wlay_raster *r, int y, float left, float right,
+                              struct nk_color color)
+{
+    wlay_raster_span(r, y, (int)ceilf(left - 0.5f), (int)ceilf(right - 0.5f), color);
+}
+
+
+// Clips the rows [y0, y1) to the current clip rectangle
+static void wlay_raster_rows(const struct wlay_raster *r, float top, float bottom,
+                             int *y0, int *y1)
+{
+    *y0 = max((int)floorf(top), r->clip.y);
+    *y1 = min((int)ceilf(bottom), r->clip.y + r->clip.h);
+}
+
+
+// Horizontal extent of a rounded rectangle at row center cy
+static bool wlay_raster_rounded_row(float x, float y, float w, float h, float rounding,
+                                    float cy, float *left, float *right)
+{
+    if (w <= 0 || h <= 0 || cy < y || cy >= y + h) {
+        return false;
+    }
+    float radius = min(rounding, min(w, h) / 2);
+    float dy = 0;
+    if (cy < y + radius) {
+        dy = y + radius - cy;
+    } else if (cy > y + h - radius) {
+        dy = cy - (y + h - radius);
+    }
+    float inset = 0;
+    if (dy > 0) {
+        inset = radius - sqrtf(max(radius * radius - dy * dy, 0.0f));
+    }
+    *left = x + inset;
+    *right = x + w - inset;
+    return true;
+}
+
+
+// Horizontal extent of an ellipse at row center cy
+static bool wlay_raster_ellipse_row(float cx, float cy0, float rx, float ry,
+                                    float cy, float *left, float *right)
+{
+    float dy = cy - cy0;
+    if (rx <= 0 || ry <= 0 || fabsf(dy) >= ry) {
+        return false;
+    }
+    float half = rx * sqrtf(1 - (dy / ry) * (dy / ry));
+    *left = cx - half;
+    *right = cx + half;
+    return true;
+}
+
+
+// Draws the part of row y covered by the outer but not the inner shape
+static void wlay_raster_ring_row(struct wlay_raster *r, int y,
+                                 float outer_left, float outer_right,
+                                 bool inner, float inner_left, float inner_right,
+                                 struct nk_color color)
+{
+    if (!inner || inner_left >= inner_right) {
+        wlay_raster_spanf(r, y, outer_left, outer_right, color);
+        return;
+    }
+    wlay_raster_spanf(r, y, outer_left, inner_left, color);
+    wlay_raster_spanf(r, y, inner_right, outer_right, color);
+}
+
+
+static void wlay_raster_rect(struct wlay_raster *r, float x, float y, float w, float h,
+                             float rounding, float thickness, struct nk_color color)
+{
+    // Strokes are drawn on the inside, same as nuklear's own rawfb backend
+    int y0, y1;
+    wlay_raster_rows(r, y, y + h, &y0, &y1);
+    for (int row = y0; row < y1; row++) {
+        float cy = row + 0.5f;
+        float ol, or, il = 0, ir = 0;
+        if (!wlay_raster_rounded_row(x, y, w, h, rounding, cy, &ol, &or)) {
+            continue;
+        }
+        bool inner = thickness > 0 && wlay_raster_rounded_row(
+            x + thickness, y + thickness, w - 2 * thickness, h - 2 * thickness,
+            max(rounding - thickness, 0.0f), cy, &il, &ir
+        );
+        wlay_raster_ring_row(r, row, ol, or, inner, il, ir, color);
+    }
+}
+
+
+static void wlay_raster_ellipse(struct wlay_raster *r, float x, float y, float w, float h,
+                                float thickness, struct nk_color color)
+{
+    float cx = x + w / 2, cy0 = y + h / 2;
+    int y0, y1;
+    wlay_raster_rows(r, y, y + h, &y0, &y1);
+    for (int row = y0; row < y1; row++) {
+        float cy = row + 0.5f;
+        float ol, or, il = 0, ir = 0;
+        if (!wlay_raster_ellipse_row(cx, cy0, w / 2, h / 2, cy, &ol, &or)) {
+            continue;
+        }
+        bool inner = thickness > 0 && wlay_raster_ellipse_row(
+            cx, cy0, w / 2 - thickness, h / 2 - thickness, cy, &il, &ir
+        );
+        wlay_raster_ring_row(r, row, ol, or, inner, il, ir, color);
+    }
+}
+
+
+static int wlay_raster_compare_float(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+
+// Even-odd scanline fill
+static void wlay_raster_polygon(struct wlay_raster *r, const struct nk_vec2 *points,
+                                int count, struct nk_color color)
+{
+    if (count < 3 || color.a == 0) {
+        return;
+    }
+    if ((size_t)count > r->crossing_capacity) {
+        r->crossing_capacity = count;
+        r->crossings = xrealloc(r->crossings, count * sizeof(*r->crossings));
+    }
+
+    float top = points[0].y, bottom = points[0].y;
+    for (int i = 1; i < count; i++) {
+        top = min(top, points[i].y);
+        bottom = max(bottom, points[i].y);
+    }
+    int y0, y1;
+    wlay_raster_rows(r, top, bottom, &y0, &y1);
+    for (int row = y0; row < y1; row++) {
+        float cy = row + 0.5f;
+        int crossings = 0;
+        for (int i = 0; i < count; i++) {
+            struct nk_vec2 a = points[i];
+            struct nk_vec2 b = points[(i + 1) % count];
+            if ((a.y <= cy) != (b.y <= cy)) {
+                r->crossings[crossings++] = a.x + (cy - a.y) * (b.x - a.x) / (b.y - a.y);
+            }
+        }
+        if (crossings == 2) {
+            // The common convex case
+            if (r->crossings[0] > r->crossings[1]) {
+                float tmp = r->crossings[0];
+                r->crossings[0] = r->crossings[1];
+                r->crossings[1] = tmp;
+            }
+        } else {
+            qsort(r->crossings, crossings, sizeof(*r->crossings),
+                  wlay_raster_compare_float);
+        }
+        for (int i = 0; i + 1 < crossings; i += 2) {
+            wlay_raster_spanf(r, row, r->crossings[i], r->crossings[i + 1], color);
+        }
+    }
+}
+
+
+static void wlay_raster_line(struct wlay_raster *r, struct nk_vec2 a, struct nk_vec2 b,
+                             float thickness, struct nk_color color)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length == 0) {
+        return;
+    }
+    // Quad around the segment, extended by half the thickness at the ends
+    // so that consecutive segments join up
+    float half = max(thickness, 1.0f) / 2;
+    float ux = dx / length * half, uy = dy / length * half;
+    struct nk_vec2 quad[4] = {
+        { a.x - ux - uy, a.y - uy + ux },
+        { b.x + ux - uy, b.y + uy + ux },
+        { b.x + ux + uy, b.y + uy - ux },
+        { a.x - ux + uy, a.y - uy - ux },
+    };
+    wlay_raster_polygon(r, quad, 4, color);
+}
+
+
+// Integer command coordinates address pixel corners, strokes are centered
+// on the pixel instead
+static struct nk_vec2 wlay_raster_center(struct nk_vec2i p)
+{
+    return (struct nk_vec2){ p.x + 0.5f, p.y + 0.5f };
+}
+
+
+static void wlay_raster_polyline(struct wlay_raster *r, const struct nk_vec2i *points,
+                                 int count, bool closed, float thickness,
+                                 struct nk_color color)
+{
+    for (int i = 0; i + 1 < count; i++) {
+        wlay_raster_line(r, wlay_raster_center(points[i]),
+                         wlay_raster_center(points[i + 1]), thickness, color);
+    }
+    if (closed && count > 2) {
+        wlay_raster_line(r, wlay_raster_center(points[count - 1]),
+                         wlay_raster_center(points[0]), thickness, color);
+    }
+}
+
+
+static struct nk_vec2 *wlay_raster_points(struct wlay_raster *r, size_t count)
+{
+    if (count > r->point_capacity) {
+        r->point_capacity = count;
+        r->points = xrealloc(r->points, count * sizeof(*r->points));
+    }
+    return r->points;
+}
+
+
+static void wlay_raster_curve(struct wlay_raster *r, const struct nk_command_curve *c)
+{
+    struct nk_vec2 p0 = wlay_raster_center(c->begin);
+    struct nk_vec2 p1 = wlay_raster_center(c->ctrl[0]);
+    struct nk_vec2 p2 = wlay_raster_center(c->ctrl[1]);
+    struct nk_vec2 p3 = wlay_raster_center(c->end);
+    struct nk_vec2 prev = p0;
+    for (int i = 1; i <= CURVE_SEGMENTS; i++) {
+        float t = (float)i / CURVE_SEGMENTS, u = 1 - t;
+        float w0 = u * u * u, w1 = 3 * u * u * t, w2 = 3 * u * t * t, w3 = t * t * t;
+        struct nk_vec2 p = {
+            w0 * p0.x + w1 * p1.x + w2 * p2.x + w3 * p3.x,
+            w0 * p0.y + w1 * p1.y + w2 * p2.y + w3 * p3.y,
+        };
+        wlay_raster_line(r, prev, p, c->line_thickness, c->color);
+        prev = p;
+    }
+}
+
+
+static void wlay_raster_arc(struct wlay_raster *r, float cx, float cy, float radius,
+                            const float a[2], bool filled, float thickness,
+                            struct nk_color color)
+{
+    float sweep = a[1] - a[0];
+    int segments = (int)ceilf(fabsf(sweep) * radius / 8);
+    segments = max(min(segments, ARC_MAX_SEGMENTS), 4);
+    struct nk_vec2 *points = wlay_raster_points(r, segments + 2);
+    int count = 0;
+    if (filled) {
+        points[count++] = (struct nk_vec2){ cx, cy };
+    }
+    for (int i = 0; i <= segments; i++) {
+        float angle = a[0] + sweep * i / segments;
+        points[count++] = (struct nk_vec2){
+            cx + cosf(angle) * radius, cy + sinf(angle) * radius
+        };
+    }
+    if (filled) {
+        wlay_raster_polygon(r, points, count, color);
+        return;
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        wlay_raster_line(r, points[i], points[i + 1], thickness, color);
+    }
+}
+
+
+static void wlay_raster_polygon_filled(struct wlay_raster *r, const struct nk_vec2i *points,
+                                       int count, struct nk_color color)
+{
+    struct nk_vec2 *converted = wlay_raster_points(r, count);
+    for (int i = 0; i < count; i++) {
+        converted[i] = (struct nk_vec2){ points[i].x, points[i].y };
+    }
+    wlay_raster_polygon(r, converted, count, color);
+}
+
+
+static void wlay_raster_multi_color(struct wlay_raster *r,
+                                    const struct nk_command_rect_multi_color *c)
+{
+    // nuklear's corner order: left is top-left, top is top-right, right is
+    // bottom-right and bottom is bottom-left
+    struct wlay_rect area = wlay_raster_intersect(
+        (struct wlay_rect){ c->x, c->y, c->w, c->h }, r->clip
+    );
+    if (wlay_raster_empty(area)) {
+        return;
+    }
+    const struct nk_color corners[4] = { c->left, c->top, c->bottom, c->right };
+    for (int y = area.y; y < area.y + area.h; y++) {
+        float v = (y + 0.5f - c->y) / c->h;
+        uint32_t *dst = r->pixels + (size_t)y * r->stride;
+        for (int x = area.x; x < area.x + area.w; x++) {
+            float u = (x + 0.5f - c->x) / c->w;
+            float w[4] = { (1 - u) * (1 - v), u * (1 - v), (1 - u) * v, u * v };
+            float rgba[4] = { 0, 0, 0, 0 };
+            for (int i = 0; i < 4; i++) {
+                rgba[0] += corners[i].r * w[i];
+                rgba[1] += corners[i].g * w[i];
+                rgba[2] += corners[i].b * w[i];
+                rgba[3] += corners[i].a * w[i];
+            }
+            struct nk_color color = {
+                (nk_byte)(rgba[0] + 0.5f), (nk_byte)(rgba[1] + 0.5f),
+                (nk_byte)(rgba[2] + 0.5f), (nk_byte)(rgba[3] + 0.5f),
+            };
+            dst[x] = wlay_raster_blend(dst[x], wlay_raster_pack(color), color.a);
+        }
+    }
+}
+
+
+static void wlay_raster_image(struct wlay_raster *r, const struct nk_command_image *c)
+{
+    const struct wlay_raster_image *image = c->img.handle.ptr;
+    struct wlay_rect area = wlay_raster_intersect(
+        (struct wlay_rect){ c->x, c->y, c->w, c->h }, r->clip
+    );
+    if (image == NULL || image->pixels == NULL || wlay_raster_empty(area)) {
+        return;
+    }
+    int sx = 0, sy = 0, sw = image->width, sh = image->height;
+    if (c->img.region[2] && c->img.region[3]) {
+        sx = c->img.region[0];
+        sy = c->img.region[1];
+        sw = c->img.region[2];
+        sh = c->img.region[3];
+    }
+    // Nearest neighbour, images are drawn at (or near) their native size
+    for (int y = area.y; y < area.y + area.h; y++) {
+        int ty = min(sy + (y - c->y) * sh / c->h, image->height - 1);
+        const uint32_t *src = image->pixels + (size_t)ty * image->stride;
+        uint32_t *dst = r->pixels + (size_t)y * r->stride;
+        for (int x = area.x; x < area.x + area.w; x++) {
+            int tx = min(sx + (x - c->x) * sw / c->w, image->width - 1);
+            dst[x] = c->col.a == 255 ? src[tx] | 0xff000000
+                                     : wlay_raster_blend(dst[x], src[tx], c->col.a);
+        }
+    }
+}
+
+
+static void wlay_raster_glyph(struct wlay_raster *r, const struct nk_user_font_glyph *g,
+                              float gx, float gy, struct nk_color color)
+{
+    if (g->width <= 0 || g->height <= 0) {
+        return;
+    }
+    struct wlay_rect area = wlay_raster_intersect((struct wlay_rect){
+        (int32_t)floorf(gx), (int32_t)floorf(gy),
+        (int32_t)ceilf(gx + g->width) - (int32_t)floorf(gx),
+        (int32_t)ceilf(gy + g->height) - (int32_t)floorf(gy),
+    }, r->clip);
+    if (wlay_raster_empty(area)) {
+        return;
+    }
+    float u0 = g->uv[0].x * r->atlas_width, u1 = g->uv[1].x * r->atlas_width;
+    float v0 = g->uv[0].y * r->atlas_height, v1 = g->uv[1].y * r->atlas_height;
+    float su = (u1 - u0) / g->width, sv = (v1 - v0) / g->height;
+    int tx_min = (int)floorf(u0), tx_max = max((int)ceilf(u1) - 1, tx_min);
+    uint32_t src = wlay_raster_pack(color);
+
+    for (int y = area.y; y < area.y + area.h; y++) {
+        int ty = (int)(v0 + (y + 0.5f - gy) * sv);
+        if (ty < 0 || ty >= r->atlas_height) {
+            continue;
+        }
+        const uint8_t *texels = r->atlas + (size_t)ty * r->atlas_width;
+        uint32_t *dst = r->pixels + (size_t)y * r->stride;
+        for (int x = area.x; x < area.x + area.w; x++) {
+            // The default font is oversampled horizontally, average all
+            // texels that fall into the pixel
+            float start = u0 + (x - gx) * su;
+            int t0 = max((int)floorf(start), tx_min);
+            int t1 = min(max((int)ceilf(start + su) - 1, t0), tx_max);
+            t1 = min(t1, r->atlas_width - 1);
+            uint32_t sum = 0;
+            for (int t = t0; t <= t1; t++) {
+                sum += texels[t];
+            }
+            uint32_t coverage = t1 >= t0 ? sum / (t1 - t0 + 1) : 0;
+            uint32_t alpha = wlay_raster_mul(coverage, color.a);
+            if (alpha) {
+                dst[x] = wlay_raster_blend(dst[x], src, alpha);
+            }
+        }
+    }
+}
+
+
+static void wlay_raster_text(struct wlay_raster *r, const struct nk_command_text *c)
+{
+    const struct nk_user_font *font = c->font;
+    if (font == NULL || font->query == NULL || r->atlas == NULL || c->length <= 0) {
+        return;
+    }
+
+    // Same glyph walk as nk_draw_list_add_text()
+    nk_rune unicode, next;
+    int glyph_len = nk_utf_decode(c->string, &unicode, c->length);
+    int text_len = 0;
+    float x = c->x;
+    while (glyph_len && text_len < c->length) {
+        if (unicode == NK_UTF_INVALID) {
+            break;
+        }
+        int next_len = nk_utf_decode(c->string + text_len + glyph_len, &next,
+                                     c->length - text_len - glyph_len);
+        struct nk_user_font_glyph g;
+        font->query(font->userdata, c->height, &g, unicode,
+                    (next == NK_UTF_INVALID || !next_len) ? '\0' : next);
+        wlay_raster_glyph(r, &g, x + g.offset.x, c->y + g.offset.y, c->foreground);
+        text_len += glyph_len;
+        x += g.xadvance;
+        glyph_len = next_len;
+        unicode = next;
+    }
+}
+
+
+// Bounding box of what a command can touch and the number of bytes
+// describing it, false for commands that do not draw anything
+static bool wlay_raster_command_info(const struct nk_command *cmd,
+                                     struct wlay_rect *bounds, size_t *size)
+{
+    int32_t pad = 0;
+    switch (cmd->type) {
+    case NK_COMMAND_LINE: {
+        const struct nk_command_line *c = (const void *)cmd;
+        pad = c->line_thickness + 1;
+        *bounds = (struct wlay_rect){
+            min(c->begin.x, c->end.x), min(c->begin.y, c->end.y),
+            abs(c->end.x - c->begin.x), abs(c->end.y - c->begin.y),
+        };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_CURVE: {
+        const struct nk_command_curve *c = (const void *)cmd;
+        const struct nk_vec2i p[4] = { c->begin, c->ctrl[0], c->ctrl[1], c->end };
+        int32_t x0 = p[0].x, y0 = p[0].y, x1 = p[0].x, y1 = p[0].y;
+        for (int i = 1; i < 4; i++) {
+            x0 = min(x0, (int32_t)p[i].x);
+            y0 = min(y0, (int32_t)p[i].y);
+            x1 = max(x1, (int32_t)p[i].x);
+            y1 = max(y1, (int32_t)p[i].y);
+        }
+        pad = c->line_thickness + 1;
+        *bounds = (struct wlay_rect){ x0, y0, x1 - x0, y1 - y0 };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_RECT: {
+        const struct nk_command_rect *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_RECT_FILLED: {
+        const struct nk_command_rect_filled *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_RECT_MULTI_COLOR: {
+        const struct nk_command_rect_multi_color *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_CIRCLE: {
+        const struct nk_command_circle *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_CIRCLE_FILLED: {
+        const struct nk_command_circle_filled *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_ARC: {
+        const struct nk_command_arc *c = (const void *)cmd;
+        pad = c->line_thickness + 1;
+        *bounds = (struct wlay_rect){ c->cx - c->r, c->cy - c->r, 2 * c->r, 2 * c->r };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_ARC_FILLED: {
+        const struct nk_command_arc_filled *c = (const void *)cmd;
+        pad = 1;
+        *bounds = (struct wlay_rect){ c->cx - c->r, c->cy - c->r, 2 * c->r, 2 * c->r };
+        *size = sizeof(*c);
+        break;
+    }
+    case NK_COMMAND_TRIANGLE:
+    case NK_COMMAND_TRIANGLE_FILLED: {
+        const struct nk_vec2i *p;
+        if (cmd->type == NK_COMMAND_TRIANGLE) {
+            const struct nk_command_triangle *c = (const void *)cmd;
+            p = &c->a;
+            pad = c->line_thickness + 1;
+            *size = sizeof(*c);
+        } else {
+            const struct nk_command_triangle_filled *c = (const void *)cmd;
+            p = &c->a;
+            pad = 1;
+            *size = sizeof(*c);
+        }
+        const struct nk_vec2i *b = p + 1, *c = p + 2;
+        int32_t x0 = min(p->x, min(b->x, c->x)), x1 = max(p->x, max(b->x, c->x));
+        int32_t y0 = min(p->y, min(b->y, c->y)), y1 = max(p->y, max(b->y, c->y));
+        *bounds = (struct wlay_rect){ x0, y0, x1 - x0, y1 - y0 };
+        break;
+    }
+    case NK_COMMAND_POLYGON:
+    case NK_COMMAND_POLYGON_FILLED:
+    case NK_COMMAND_POLYLINE: {
+        const struct nk_vec2i *points;
+        unsigned short count;
+        if (cmd->type == NK_COMMAND_POLYGON_FILLED) {
+            const struct nk_command_polygon_filled *c = (const void *)cmd;
+            points = c->points;
+            count = c->point_count;
+            pad = 1;
+            *size = offsetof(struct nk_command_polygon_filled, points);
+        } else {
+            // nk_command_polyline has the same layout
+            const struct nk_command_polygon *c = (const void *)cmd;
+            points = c->points;
+            count = c->point_count;
+            pad = c->line_thickness + 1;
+            *size = offsetof(struct nk_command_polygon, points);
+        }
+        if (count == 0) {
+            return false;
+        }
+        int32_t x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+        for (unsigned short i = 1; i < count; i++) {
+            x0 = min(x0, (int32_t)points[i].x);
+            y0 = min(y0, (int32_t)points[i].y);
+            x1 = max(x1, (int32_t)points[i].x);
+            y1 = max(y1, (int32_t)points[i].y);
+        }
+        *bounds = (struct wlay_rect){ x0, y0, x1 - x0, y1 - y0 };
+        *size += count * sizeof(*points);
+        break;
+    }
+    case NK_COMMAND_TEXT: {
+        const struct nk_command_text *c = (const void *)cmd;
+        // Glyphs may overhang the text rectangle slightly
+        pad = 2;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = offsetof(struct nk_command_text, string) + c->length;
+        break;
+    }
+    case NK_COMMAND_IMAGE: {
+        const struct nk_command_image *c = (const void *)cmd;
+        *bounds = (struct wlay_rect){ c->x, c->y, c->w, c->h };
+        *size = sizeof(*c);
+        break;
+    }
+    default:
+        return false;
+    }
+    bounds->x -= pad;
+    bounds->y -= pad;
+    bounds->w += 2 * pad;
+    bounds->h += 2 * pad;
+    return true;
+}
+
+
+static struct wlay_rect wlay_raster_scissor(const struct nk_command *cmd)
+{
+    const struct nk_command_scissor *s = (const void *)cmd;
+    return (struct wlay_rect){ s->x, s->y, s->w, s->h };
+}
+
+
+static void wlay_raster_command(struct wlay_raster *r, const struct nk_command *cmd)
+{
+    switch (cmd->type) {
+    case NK_COMMAND_LINE: {
+        const struct nk_command_line *c = (const void *)cmd;
+        wlay_raster_line(r, wlay_raster_center(c->begin), wlay_raster_center(c->end),
+                         c->line_thickness, c->color);
+        break;
+    }
+    case NK_COMMAND_CURVE:
+        wlay_raster_curve(r, (const void *)cmd);
+        break;
+    case NK_COMMAND_RECT: {
+        const struct nk_command_rect *c = (const void *)cmd;
+        wlay_raster_rect(r, c->x, c->y, c->w, c->h, c->rounding,
+                         max(c->line_thickness, 1), c->color);
+        break;
+    }
+    case NK_COMMAND_RECT_FILLED: {
+        const struct nk_command_rect_filled *c = (const void *)cmd;
+        wlay_raster_rect(r, c->x, c->y, c->w, c->h, c->rounding, 0, c->color);
+        break;
+    }
+    case NK_COMMAND_RECT_MULTI_COLOR:
+        wlay_raster_multi_color(r, (const void *)cmd);
+        break;
+    case NK_COMMAND_CIRCLE: {
+        const struct nk_command_circle *c = (const void *)cmd;
+        wlay_raster_ellipse(r, c->x, c->y, c->w, c->h,
+                            max(c->line_thickness, 1), c->color);
+        break;
+    }
+    case NK_COMMAND_CIRCLE_FILLED: {
+        const struct nk_command_circle_filled *c = (const void *)cmd;
+        wlay_raster_ellipse(r, c->x, c->y, c->w, c->h, 0, c->color);
+        break;
+    }
+    case NK_COMMAND_ARC: {
+        const struct nk_command_arc *c = (const void *)cmd;
+        wlay_raster_arc(r, c->cx, c->cy, c->r, c->a, false, c->line_thickness, c->color);
+        break;
+    }
+    case NK_COMMAND_ARC_FILLED: {
+        const struct nk_command_arc_filled *c = (const void *)cmd;
+        wlay_raster_arc(r, c->cx, c->cy, c->r, c->a, true, 0, c->color);
+        break;
+    }
+    case NK_COMMAND_TRIANGLE: {
+        const struct nk_command_triangle *c = (const void *)cmd;
+        const struct nk_vec2i points[3] = { c->a, c->b, c->c };
+        wlay_raster_polyline(r, points, 3, true, c->line_thickness, c->color);
+        break;
+    }
+    case NK_COMMAND_TRIANGLE_FILLED: {
+        const struct nk_command_triangle_filled *c = (const void *)cmd;
+        const struct nk_vec2i points[3] = { c->a, c->b, c->c };
+        wlay_raster_polygon_filled(r, points, 3, c->color);
+        break;
+    }
+    case NK_COMMAND_POLYGON: {
+        const struct nk_command_polygon *c = (const void *)cmd;
+        wlay_raster_polyline(r, c->points, c->point_count, true,
+                             c->line_thickness, c->color);
+        break;
+    }
+    case NK_COMMAND_POLYGON_FILLED: {
+        const struct nk_command_polygon_filled *c = (const void *)cmd;
+        wlay_raster_polygon_filled(r, c->points, c->point_count, c->color);
+        break;
+    }
+    case NK_COMMAND_POLYLINE: {
+        const struct nk_command_polyline *c = (const void *)cmd;
+        wlay_raster_polyline(r, c->points, c->point_count, false,
+                             c->line_thickness, c->color);
+        break;
+    }
+    case NK_COMMAND_TEXT:
+        wlay_raster_text(r, (const void *)cmd);
+        break;
+    case NK_COMMAND_IMAGE:
+        wlay_raster_image(r, (const void *)cmd);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void wlay_raster_init(struct wlay_raster *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+
+void wlay_raster_finish(struct wlay_raster *r)
+{
+    xfree(r->crossings);
+    xfree(r->points);
+    memset(r, 0, sizeof(*r));
+}
+
+
+void wlay_raster_target(struct wlay_raster *r, uint32_t *pixels,
+                        int width, int height, int stride)
+{
+    r->pixels = pixels;
+    r->width = width;
+    r->height = height;
+    r->stride = stride;
+}
+
+
+void wlay_raster_draw(struct wlay_raster *r, struct nk_context *ctx,
+                      struct wlay_rect region, struct nk_color background)
+{
+    const struct wlay_rect surface = { 0, 0, r->width, r->height };
+    r->region = wlay_raster_intersect(region, surface);
+    if (wlay_raster_empty(r->region)) {
+        return;
+    }
+    r->clip = r->region;
+    for (int y = r->region.y; y < r->region.y + r->region.h; y++) {
+        wlay_raster_fill_pixels(r->pixels + (size_t)y * r->stride + r->region.x,
+                                r->region.w, wlay_raster_pack(background));
+    }
+
+    const struct nk_command *cmd;
+    nk_foreach(cmd, ctx) {
+        if (cmd->type == NK_COMMAND_SCISSOR) {
+            r->clip = wlay_raster_intersect(wlay_raster_scissor(cmd), r->region);
+            continue;
+        }
+        struct wlay_rect bounds;
+        size_t size;
+        if (wlay_raster_empty(r->clip) ||
+                !wlay_raster_command_info(cmd, &bounds, &size) ||
+                wlay_raster_empty(wlay_raster_intersect(bounds, r->clip))) {
+            continue;
+        }
+        wlay_raster_command(r, cmd);
+    }
+}
+
+
+static uint32_t wlay_raster_hash(uint32_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+
+void wlay_raster_hash_tiles(struct nk_context *ctx, int width, int height,
+                            uint32_t *tiles)
+{
+    const int columns = wlay_raster_tile_count(width);
+    const int rows = wlay_raster_tile_count(height);
+    for (int i = 0; i < columns * rows; i++) {
+        tiles[i] = FNV_OFFSET;
+    }
+
+    const struct wlay_rect surface = { 0, 0, width, height };
+    struct wlay_rect clip = surface;
+    const struct nk_command *cmd;
+    nk_foreach(cmd, ctx) {
+        if (cmd->type == NK_COMMAND_SCISSOR) {
+            clip = wlay_raster_intersect(wlay_raster_scissor(cmd), surface);
+            continue;
+        }
+        struct wlay_rect bounds;
+        size_t size;
+        if (!wlay_raster_command_info(cmd, &bounds, &size)) {
+            continue;
+        }
+        bounds = wlay_raster_intersect(bounds, clip);
+        if (wlay_raster_empty(bounds)) {
+            continue;
+        }
+        // Everything after the header describes what gets drawn, the clip
+        // rectangle decides which part of it ends up visible
+        const size_t header = sizeof(struct nk_command);
+        uint32_t hash = wlay_raster_hash(FNV_OFFSET, &cmd->type, sizeof(cmd->type));
+        hash = wlay_raster_hash(hash, (const uint8_t *)cmd + header, size - header);
+        hash = wlay_raster_hash(hash, &bounds, sizeof(bounds));
+        if (cmd->type == NK_COMMAND_IMAGE) {
+            // The command only points at the pixels
+            const struct nk_command_image *c = (const void *)cmd;
+            const struct wlay_raster_image *image = c->img.handle.ptr;
+            if (image != NULL) {
+                hash = wlay_raster_hash(hash, &image->serial, sizeof(image->serial));
+            }
+        }
+
+        int tx0 = bounds.x / WLAY_RASTER_TILE;
+        int ty0 = bounds.y / WLAY_RASTER_TILE;
+        int tx1 = (bounds.x + bounds.w - 1) / WLAY_RASTER_TILE;
+        int ty1 = (bounds.y + bounds.h - 1) / WLAY_RASTER_TILE;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                uint32_t *tile = &tiles[ty * columns + tx];
+                *tile = (*tile ^ hash) * FNV_PRIME;
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef WLAY_RASTER_H
+#define WLAY_RASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wlay_nuklear.h"
+#include "validate.h"
+
+// Size of the square tiles damage is tracked in
+#define WLAY_RASTER_TILE 64
+
+// Pixel data referenced by an nk_image handle when drawing with the
+// software rasteriser, pixels are in the same 0xAARRGGBB layout as the target
+struct wlay_raster_image {
+    const uint32_t *pixels;
+    int width, height;
+    int stride; // in pixels
+    // Changed whenever the pixels do, tiles showing the image are only
+    // redrawn when the command or this changes
+    uint32_t serial;
+};
+
+struct wlay_raster {
+    // Target, 0xAARRGGBB (wl_shm ARGB8888/XRGB8888) pixels
+    uint32_t *pixels;
+    int width, height;
+    int stride; // in pixels
+
+    // ALPHA8 font atlas the text glyphs point into
+    const uint8_t *atlas;
+    int atlas_width, atlas_height;
+
+    // Intersection of the nuklear scissor and the region being redrawn
+    struct wlay_rect region;
+    struct wlay_rect clip;
+
+    // Scratch space for polygon scanlines
+    float *crossings;
+    size_t crossing_capacity;
+    struct nk_vec2 *points;
+    size_t point_capacity;
+};
+
+void wlay_raster_init(struct wlay_raster *r);
+void wlay_raster_finish(struct wlay_raster *r);
+
+// Sets the target surface, contents are kept between frames
+void wlay_raster_target(struct wlay_raster *r, uint32_t *pixels,
+                        int width, int height, int stride);
+
+// Draws all commands of the current nuklear frame, clipped to region
+void wlay_raster_draw(struct wlay_raster *r, struct nk_context *ctx,
+                      struct wlay_rect region, struct nk_color background);
+
+// Computes a hash of everything drawn into each tile of a width x height
+// surface. tiles has to hold tile_columns * tile_rows entries.
+void wlay_raster_hash_tiles(struct nk_context *ctx, int width, int height,
+                            uint32_t *tiles);
+
+static inline int wlay_raster_tile_count(int size)
+{
+    return (size + WLAY_RASTER_TILE - 1) / WLAY_RASTER_TILE;
+}
+
+#endif
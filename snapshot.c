@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "snapshot.h"
+
+static void snapshot_modes_unref(struct wlay_snapshot_modes *modes)
+{
+    if (modes != NULL && atomic_fetch_sub_explicit(&modes->refs, 1, memory_order_acq_rel) == 1) {
+        xfree(modes);
+    }
+}
+
+
+void wlay_snapshot_head_unref(struct wlay_snapshot_head *head)
+{
+    if (head == NULL || atomic_fetch_sub_explicit(&head->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    snapshot_modes_unref(head->modes);
+    xfree(head->name);
+    xfree(head->description);
+    xfree(head->make);
+    xfree(head->model);
+    xfree(head->serial_number);
+    xfree(head);
+}
+
+
+struct wlay_snapshot *wlay_snapshot_ref(struct wlay_snapshot *snapshot)
+{
+    atomic_fetch_add_explicit(&snapshot->refs, 1, memory_order_relaxed);
+    return snapshot;
+}
+
+
+void wlay_snapshot_unref(struct wlay_snapshot *snapshot)
+{
+    if (snapshot == NULL ||
+            atomic_fetch_sub_explicit(&snapshot->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    for (size_t i = 0; i < snapshot->count; i++) {
+        wlay_snapshot_head_unref(snapshot->heads[i]);
+    }
+    xfree(snapshot);
+}
+
+
+static bool snapshot_string_equal(const char *a, const char *b)
+{
+    return a == b || (a != NULL && b != NULL && !strcmp(a, b));
+}
+
+
+static char *snapshot_strdup(const char *s)
+{
+    return s ? xstrdup(s) : NULL;
+}
+
+
+// Whether modes holds the head's modes, and which of them is current
+static bool snapshot_modes_match(struct wlay_snapshot_modes *modes, struct wlay_head *head,
+                                 const struct wlay_snapshot_mode **current)
+{
+    *current = NULL;
+    if (modes == NULL) {
+        return false;
+    }
+    size_t i = 0;
+    struct wlay_mode *mode;
+    // New modes are inserted at the front of the list
+    wl_list_for_each_reverse(mode, &head->modes, link) {
+        if (i == modes->count) {
+            return false;
+        }
+        const struct wlay_snapshot_mode *m = &modes->modes[i++];
+        if (m->width != mode->width || m->height != mode->height ||
+                m->refresh_rate != mode->refresh_rate || m->preferred != mode->preferred) {
+            return false;
+        }
+        if (mode == head->current_mode) {
+            *current = m;
+        }
+    }
+    return i == modes->count;
+}
+
+
+static bool snapshot_head_match(struct wlay_snapshot_head *s, struct wlay_head *head)
+{
+    const struct wlay_snapshot_mode *current;
+    bool custom = head->custom_mode.enabled && head->custom_mode.valid;
+    return snapshot_modes_match(s->modes, head, &current) &&
+        current == s->mode &&
+        s->enabled == head->enabled &&
+        s->x == head->x && s->y == head->y &&
+        s->transform == head->transform && s->scale == head->scale &&
+        s->adaptive_sync_supported == head->adaptive_sync_supported &&
+        s->adaptive_sync == head->adaptive_sync &&
+        s->physical_width == head->physical_width &&
+        s->physical_height == head->physical_height &&
+        s->custom == custom &&
+        (!custom || !memcmp(&s->custom_timing, &head->custom_mode.timing,
+                            sizeof(s->custom_timing))) &&
+        snapshot_string_equal(s->name, head->name) &&
+        snapshot_string_equal(s->description, head->description) &&
+        snapshot_string_equal(s->make, head->make) &&
+        snapshot_string_equal(s->model, head->model) &&
+        snapshot_string_equal(s->serial_number, head->serial_number);
+}
+
+
+// A new version of the head, sharing the modes of the last one if they
+// did not change
+static struct wlay_snapshot_head *snapshot_head_create(struct wlay_head *head,
+                                                       struct wlay_snapshot_head *last)
+{
+    struct wlay_snapshot_head *s = xmalloc(sizeof(*s));
+    atomic_init(&s->refs, 1);
+
+    const struct wlay_snapshot_mode *current;
+    if (last != NULL && snapshot_modes_match(last->modes, head, &current)) {
+        s->modes = last->modes;
+        atomic_fetch_add_explicit(&s->modes->refs, 1, memory_order_relaxed);
+    } else {
+        size_t count = wl_list_length(&head->modes);
+        s->modes = xmalloc(sizeof(*s->modes) + count * sizeof(s->modes->modes[0]));
+        atomic_init(&s->modes->refs, 1);
+        s->modes->count = count;
+        size_t i = 0;
+        struct wlay_mode *mode;
+        wl_list_for_each_reverse(mode, &head->modes, link) {
+            s->modes->modes[i++] = (struct wlay_snapshot_mode){
+                .width = mode->width,
+                .height = mode->height,
+                .refresh_rate = mode->refresh_rate,
+                .preferred = mode->preferred,
+            };
+        }
+        snapshot_modes_match(s->modes, head, &current);
+    }
+    s->mode = current;
+
+    s->name = snapshot_strdup(head->name);
+    s->description = snapshot_strdup(head->description);
+    s->make = snapshot_strdup(head->make);
+    s->model = snapshot_strdup(head->model);
+    s->serial_number = snapshot_strdup(head->serial_number);
+    wlay_head_refresh_identifier(head);
+    memcpy(s->identifier, head->identifier, sizeof(s->identifier));
+
+    s->physical_width = head->physical_width;
+    s->physical_height = head->physical_height;
+    s->enabled = head->enabled;
+    s->x = head->x;
+    s->y = head->y;
+    s->transform = head->transform;
+    s->scale = head->scale;
+    s->adaptive_sync_supported = head->adaptive_sync_supported;
+    s->adaptive_sync = head->adaptive_sync;
+    s->custom = head->custom_mode.enabled && head->custom_mode.valid;
+    if (s->custom) {
+        s->custom_timing = head->custom_mode.timing;
+    }
+    int32_t width, height;
+    if (s->enabled && wlay_head_mode_size(head, &width, &height)) {
+        // Odd transforms turn the output by 90 or 270 degrees
+        s->w = head->transform & 1 ? height : width;
+        s->h = head->transform & 1 ? width : height;
+    }
+    return s;
+}
+
+
+struct wlay_snapshot *wlay_snapshot_update(struct wlay_state *wlay)
+{
+    // Bring every head's last version up to date, the snapshot only has
+    // to be replaced if one of them changed
+    struct wlay_snapshot *last = wlay->snapshot;
+    size_t count = 0;
+    bool changed = last == NULL || last->serial != wlay->serial;
+    struct wlay_head *head;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        if (head->snapshot == NULL || !snapshot_head_match(head->snapshot, head)) {
+            struct wlay_snapshot_head *s = snapshot_head_create(head, head->snapshot);
+            wlay_snapshot_head_unref(head->snapshot);
+            head->snapshot = s;
+        }
+        if (!changed) {
+            changed = count >= last->count || last->heads[count] != head->snapshot;
+        }
+        count++;
+    }
+    if (!changed && count == last->count) {
+        return last;
+    }
+
+    struct wlay_snapshot *snapshot = xmalloc(sizeof(*snapshot) + count * sizeof(snapshot->heads[0]));
+    atomic_init(&snapshot->refs, 1);
+    snapshot->serial = wlay->serial;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        atomic_fetch_add_explicit(&head->snapshot->refs, 1, memory_order_relaxed);
+        snapshot->heads[snapshot->count++] = head->snapshot;
+    }
+    wlay->snapshot = snapshot;
+    wlay_snapshot_unref(last);
+    return snapshot;
+}
@@ -0,0 +1,88 @@
+#ifndef WLAY_SNAPSHOT_H
+#define WLAY_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <wayland-client.h>
+
+#include "cvt.h"
+
+// Immutable copies of the head/mode model. The model itself is only ever
+// touched on the main thread and changes under everyone reading it, a
+// snapshot stays as it was taken and may be read and released on any
+// thread.
+//
+// Snapshots share whatever did not change with the one before them: a head
+// that is the same as in the last snapshot is the same wlay_snapshot_head,
+// a mode list that did not change is the same wlay_snapshot_modes. Taking a
+// snapshot of a model that did not change at all returns the last one.
+// Comparing pointers is enough to tell what changed between two versions.
+
+struct wlay_state;
+
+struct wlay_snapshot_mode {
+    int32_t width;
+    int32_t height;
+    int32_t refresh_rate;
+    bool preferred;
+};
+
+// In the order the compositor announced them
+struct wlay_snapshot_modes {
+    atomic_uint refs;
+    size_t count;
+    struct wlay_snapshot_mode modes[];
+};
+
+struct wlay_snapshot_head {
+    atomic_uint refs;
+    char *name;
+    char *description;
+    char *make;
+    char *model;
+    char *serial_number;
+    // See wlay_head_refresh_identifier(), empty without make and model
+    char identifier[192];
+
+    int32_t physical_width;
+    int32_t physical_height;
+    bool enabled;
+    int32_t x;
+    int32_t y;
+    // Size in the layout after the transform, 0x0 while disabled
+    int32_t w;
+    int32_t h;
+    int32_t transform;
+    wl_fixed_t scale;
+    bool adaptive_sync_supported;
+    bool adaptive_sync;
+
+    // One of modes or NULL. A valid custom mode is used instead of it.
+    const struct wlay_snapshot_mode *mode;
+    bool custom;
+    struct wlay_cvt_timing custom_timing;
+    struct wlay_snapshot_modes *modes;
+};
+
+struct wlay_snapshot {
+    atomic_uint refs;
+    // Serial of the last done event before the snapshot was taken
+    uint32_t serial;
+    // In the order the compositor announced them
+    size_t count;
+    struct wlay_snapshot_head *heads[];
+};
+
+// Brings wlay->snapshot up to date with the model and returns it. It stays
+// valid until the next call, take a reference to keep it longer or to hand
+// it to another thread.
+struct wlay_snapshot *wlay_snapshot_update(struct wlay_state *wlay);
+
+struct wlay_snapshot *wlay_snapshot_ref(struct wlay_snapshot *snapshot);
+void wlay_snapshot_unref(struct wlay_snapshot *snapshot);
+// For the model, which keeps the last version of every head
+void wlay_snapshot_head_unref(struct wlay_snapshot_head *head);
+
+#endif
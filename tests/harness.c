@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <wayland-client.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "backend.h"
+#include "gui.h"
+#include "snapshot.h"
+#include "harness.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define HARNESS_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define HARNESS_ASAN
+#endif
+#endif
+
+static struct harness_allocs *armed;
+
+#if defined(__GLIBC__) && !defined(HARNESS_ASAN)
+// glibc lets the program replace malloc() and uses the replacement for
+// its own allocations too, strdup() and asprintf() included
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+
+static void harness_count(void *caller)
+{
+    if (armed != NULL && armed->allocations++ == 0) {
+        armed->first_caller = caller;
+    }
+}
+
+
+void *malloc(size_t size)
+{
+    harness_count(__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+
+void *calloc(size_t count, size_t size)
+{
+    harness_count(__builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+
+void *realloc(void *ptr, size_t size)
+{
+    harness_count(__builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+
+void free(void *ptr)
+{
+    if (armed != NULL && ptr != NULL) {
+        armed->frees++;
+    }
+    __libc_free(ptr);
+}
+
+
+bool harness_hooks_malloc(void)
+{
+    return true;
+}
+#else
+bool harness_hooks_malloc(void)
+{
+    return false;
+}
+#endif
+
+
+void harness_arm(struct harness_allocs *allocs)
+{
+    memset(allocs, 0, sizeof(*allocs));
+    armed = allocs;
+}
+
+
+void harness_disarm(void)
+{
+    armed = NULL;
+}
+
+
+static const struct {
+    int32_t width, height, refresh_rate;
+} harness_modes[] = {
+    { 3840, 2160, 60000 },
+    { 2560, 1440, 143912 },
+    { 2560, 1440, 59951 },
+    { 1920, 1080, 60000 },
+};
+
+static struct nk_context harness_ctx;
+
+
+static float harness_text_width(nk_handle handle, float height, const char *text, int len)
+{
+    return len * 7;
+}
+
+
+static struct nk_context *harness_backend_init(struct wlay_state *wlay)
+{
+    static struct nk_user_font font = {
+        .height = 13,
+        .width = harness_text_width,
+    };
+    nk_init(&harness_ctx, wlay_nk_allocator(WLAY_MEM_GUI), &font);
+    return &harness_ctx;
+}
+
+
+static void harness_backend_destroy(struct wlay_state *wlay)
+{
+    nk_free(&harness_ctx);
+}
+
+
+static bool harness_backend_should_close(struct wlay_state *wlay)
+{
+    return false;
+}
+
+
+static void harness_backend_new_frame(struct wlay_state *wlay)
+{
+    nk_input_begin(&harness_ctx);
+    nk_input_end(&harness_ctx);
+}
+
+
+// Nothing is drawn, the commands are only built
+static void harness_backend_render(struct wlay_state *wlay)
+{
+    nk_clear(&harness_ctx);
+}
+
+
+static void harness_backend_get_size(struct wlay_state *wlay, int *width, int *height)
+{
+    *width = WINDOW_WIDTH;
+    *height = WINDOW_HEIGHT;
+}
+
+
+static const struct wlay_backend harness_backend = {
+    .name = "test",
+    .init = harness_backend_init,
+    .destroy = harness_backend_destroy,
+    .should_close = harness_backend_should_close,
+    .new_frame = harness_backend_new_frame,
+    .render = harness_backend_render,
+    .get_size = harness_backend_get_size,
+};
+
+
+void harness_heads(struct wlay_state *wlay, int count)
+{
+    memset(wlay, 0, sizeof(*wlay));
+    wl_list_init(&wlay->wl.heads);
+
+    int columns = (int)ceil(sqrt(count));
+    for (int i = 0; i < count; i++) {
+        struct wlay_head *head = xmalloc(sizeof(*head));
+        head->wlay = wlay;
+        wl_list_init(&head->modes);
+        wl_list_insert(wlay->wl.heads.prev, &head->link);
+        char name[32];
+        snprintf(name, sizeof(name), "TEST-%d", i + 1);
+        head->name = xstrdup(name);
+        head->description = xstrdup("Synthetic output");
+        head->physical_width = 600;
+        head->physical_height = 340;
+        head->scale = wl_fixed_from_int(1);
+        head->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+        head->enabled = count == 1 || i != count - 1;
+        for (size_t m = 0; m < ARRAY_SIZE(harness_modes); m++) {
+            struct wlay_mode *mode = xmalloc(sizeof(*mode));
+            mode->head = head;
+            mode->width = harness_modes[m].width;
+            mode->height = harness_modes[m].height;
+            mode->refresh_rate = harness_modes[m].refresh_rate;
+            mode->preferred = m == 0;
+            wl_list_insert(head->modes.prev, &mode->link);
+            if (m == 1 && head->enabled) {
+                head->current_mode = mode;
+            }
+        }
+        head->x = (i % columns) * 2560;
+        head->y = (i / columns) * 1440;
+    }
+    wlay_model_changed(wlay);
+}
+
+
+void harness_heads_finish(struct wlay_state *wlay)
+{
+    struct wlay_head *head, *tmp_head;
+    wl_list_for_each_safe(head, tmp_head, &wlay->wl.heads, link) {
+        struct wlay_mode *mode, *tmp_mode;
+        wl_list_for_each_safe(mode, tmp_mode, &head->modes, link) {
+            wl_list_remove(&mode->link);
+            xfree(mode);
+        }
+        wl_list_remove(&head->link);
+        xfree(head->name);
+        xfree(head->description);
+        xfree(head->mode_labels);
+        xfree(head->mode_list);
+        wlay_mode_index_finish(&head->mode_index);
+        wlay_snapshot_head_unref(head->snapshot);
+        xfree(head);
+    }
+    wlay_snapshot_unref(wlay->snapshot);
+    wlay->snapshot = NULL;
+}
+
+
+void harness_init(struct wlay_state *wlay, int count)
+{
+    harness_heads(wlay, count);
+    wlay->backend = &harness_backend;
+    wlay_gui_init(wlay);
+}
+
+
+void harness_finish(struct wlay_state *wlay)
+{
+    wlay_gui_destroy(wlay);
+    harness_heads_finish(wlay);
+}
+
+
+void harness_frames(struct wlay_state *wlay, int count)
+{
+    for (int i = 0; i < count; i++) {
+        wlay->backend->new_frame(wlay);
+        wlay_gui(wlay);
+        wlay->backend->render(wlay);
+        // Nothing is ever applied
+        wlay->should_apply = false;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef WLAY_TESTS_HARNESS_H
+#define WLAY_TESTS_HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wlay.h"
+
+// What the tests share: the GUI driven without a display over synthetic
+// heads, and every heap allocation counted, libc's own included.
+
+// Exit status that makes ctest report a test as skipped
+#define HARNESS_SKIP 77
+
+struct harness_allocs {
+    // malloc(), calloc() and realloc() while armed
+    uint64_t allocations;
+    uint64_t frees;
+    // Return address of the first allocation, to find it in a debugger
+    void *first_caller;
+};
+
+// False where malloc() can not be replaced: only glibc supports it, and
+// not under ASan, which replaces it itself
+bool harness_hooks_malloc(void);
+void harness_arm(struct harness_allocs *allocs);
+void harness_disarm(void);
+
+// count synthetic heads in a grid, the last one disabled, without a GUI
+void harness_heads(struct wlay_state *wlay, int count);
+void harness_heads_finish(struct wlay_state *wlay);
+
+// A GUI over count synthetic heads in a grid, the last one disabled
+void harness_init(struct wlay_state *wlay, int count);
+void harness_finish(struct wlay_state *wlay);
+// Frames without any input
+void harness_frames(struct wlay_state *wlay, int count);
+
+#endif
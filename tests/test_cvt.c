@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "util.h"
+#include "cvt.h"
+
+static bool failed;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+// Modelines as printed by cvt(1), cvt -r and the VESA CVT 1.2 spreadsheet
+// for reduced blanking v2
+static const struct {
+    enum wlay_cvt_type type;
+    int32_t width, height;
+    double refresh;
+    // In kHz
+    int32_t pixel_clock;
+    int32_t h[4], v[4];
+    bool hsync_positive, vsync_positive;
+} references[] = {
+    { WLAY_CVT, 1920, 1080, 60, 173000,
+      { 1920, 2048, 2248, 2576 }, { 1080, 1083, 1088, 1120 }, false, true },
+    { WLAY_CVT, 2560, 1440, 60, 312250,
+      { 2560, 2752, 3024, 3488 }, { 1440, 1443, 1448, 1493 }, false, true },
+    { WLAY_CVT, 1280, 1024, 75, 138750,
+      { 1280, 1368, 1504, 1728 }, { 1024, 1027, 1034, 1072 }, false, true },
+    // Not a whole number of cells, cvt(1) rounds the width down
+    { WLAY_CVT, 1366, 768, 60, 84750,
+      { 1360, 1432, 1568, 1776 }, { 768, 771, 781, 798 }, false, true },
+    { WLAY_CVT_RB, 1920, 1080, 60, 138500,
+      { 1920, 1968, 2000, 2080 }, { 1080, 1083, 1088, 1111 }, true, false },
+    { WLAY_CVT_RB, 2560, 1440, 60, 241500,
+      { 2560, 2608, 2640, 2720 }, { 1440, 1443, 1448, 1481 }, true, false },
+    { WLAY_CVT_RB2, 1920, 1080, 60, 133320,
+      { 1920, 1928, 1960, 2000 }, { 1080, 1097, 1105, 1111 }, true, false },
+    { WLAY_CVT_RB2, 2560, 1440, 60, 234590,
+      { 2560, 2568, 2600, 2640 }, { 1440, 1467, 1475, 1481 }, true, false },
+};
+
+
+static void test_references(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(references); i++) {
+        struct wlay_cvt_timing t;
+        char what[64];
+        snprintf(what, sizeof(what), "%s %dx%d@%g", wlay_cvt_type_names[references[i].type],
+                 references[i].width, references[i].height, references[i].refresh);
+        if (!wlay_cvt_compute(references[i].type, references[i].width, references[i].height,
+                              references[i].refresh, &t)) {
+            check(false, what);
+            continue;
+        }
+        printf("%s: %.2f MHz %d %d %d %d %d %d %d %d\n", what, t.pixel_clock / 1e3,
+               t.hdisplay, t.hsync_start, t.hsync_end, t.htotal,
+               t.vdisplay, t.vsync_start, t.vsync_end, t.vtotal);
+        const int32_t *h = references[i].h, *v = references[i].v;
+        check(t.pixel_clock == references[i].pixel_clock, what);
+        check(t.hdisplay == h[0] && t.hsync_start == h[1] && t.hsync_end == h[2] &&
+              t.htotal == h[3], "horizontal timing");
+        check(t.vdisplay == v[0] && t.vsync_start == v[1] && t.vsync_end == v[2] &&
+              t.vtotal == v[3], "vertical timing");
+        check(t.hsync_positive == references[i].hsync_positive &&
+              t.vsync_positive == references[i].vsync_positive, "sync polarity");
+        // Rounding the clock down only ever makes the refresh rate a little slower
+        int32_t refresh = references[i].refresh * 1000;
+        check(t.refresh_rate <= refresh && t.refresh_rate > refresh - 500, "refresh rate");
+    }
+}
+
+
+static void test_rejected(void)
+{
+    struct wlay_cvt_timing t;
+    for (int type = 0; type < WLAY_CVT_TYPE_COUNT; type++) {
+        check(!wlay_cvt_compute(type, 1920, 1080, 0.5, &t), "refresh below 1 Hz");
+        check(!wlay_cvt_compute(type, 1920, 1080, 1001, &t), "refresh above 1000 Hz");
+        check(!wlay_cvt_compute(type, 7, 1080, 60, &t), "width below one cell");
+        check(!wlay_cvt_compute(type, 1920, 0, 60, &t), "no height");
+        check(wlay_cvt_compute(type, 8, 1080, 60, &t), "width of one cell");
+    }
+}
+
+
+static void test_links(void)
+{
+    struct wlay_cvt_timing t;
+    wlay_cvt_compute(WLAY_CVT_RB, 1920, 1080, 60, &t);
+    check(wlay_cvt_link(t.data_rate) != NULL && !strcmp(wlay_cvt_link(t.data_rate), "HDMI 1.4"),
+          "1080p over HDMI 1.4");
+    check(wlay_cvt_link(1e12) == NULL, "no link for 1 Tbit/s");
+}
+
+
+int main(void)
+{
+    test_references();
+    test_rejected();
+    test_links();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "gui.h"
+#include "harness.h"
+
+#define HEAD_COUNT 16
+// Frames until caches and nuklear's buffers have their final size
+#define WARMUP 20
+#define FRAMES 500
+
+static bool failed;
+
+
+// Once the GUI settled, frames must not touch the heap at all. malloc()
+// sees every allocation, the subsystem counters tell whose they were.
+static void check_steady(struct wlay_state *wlay, const char *what)
+{
+    struct harness_allocs allocs;
+    struct wlay_mem_stats before[WLAY_MEM_TAG_COUNT];
+    harness_frames(wlay, WARMUP);
+    for (int tag = 0; tag < WLAY_MEM_TAG_COUNT; tag++) {
+        wlay_mem_stats(tag, &before[tag]);
+    }
+    harness_arm(&allocs);
+    harness_frames(wlay, FRAMES);
+    harness_disarm();
+    printf("%s: %llu allocations, %llu frees in %d frames\n", what,
+           (unsigned long long)allocs.allocations, (unsigned long long)allocs.frees, FRAMES);
+    if (allocs.allocations == 0 && allocs.frees == 0) {
+        return;
+    }
+
+    uint64_t tagged = 0;
+    for (int tag = 0; tag < WLAY_MEM_TAG_COUNT; tag++) {
+        struct wlay_mem_stats after;
+        wlay_mem_stats(tag, &after);
+        uint64_t allocations = after.allocations - before[tag].allocations;
+        if (allocations > 0) {
+            printf("  %-8s %llu allocations, %lld bytes more live\n", wlay_mem_tag_names[tag],
+                   (unsigned long long)allocations,
+                   (long long)after.live - (long long)before[tag].live);
+        }
+        tagged += allocations;
+    }
+    if (allocs.allocations > tagged) {
+        printf("  %-8s %llu allocations\n", "libc",
+               (unsigned long long)(allocs.allocations - tagged));
+    }
+    printf("FAIL %s, first allocation from %p\n", what, allocs.first_caller);
+    failed = true;
+}
+
+
+int main(void)
+{
+    if (!harness_hooks_malloc()) {
+        printf("malloc() can not be replaced here\n");
+        return HARNESS_SKIP;
+    }
+    struct wlay_state wlay;
+    harness_init(&wlay, HEAD_COUNT);
+    check_steady(&wlay, "steady state");
+
+    // The cached display data is rebuilt once, then frames are free again
+    struct wlay_head *head = wl_container_of(wlay.wl.heads.next, head, link);
+    wlay.focused = head;
+    head->x += 100;
+    wlay_model_changed(&wlay);
+    check_steady(&wlay, "after a model change");
+
+    // Showing the counters must not change them
+    wlay.gui->mem_overlay.enabled = true;
+    check_steady(&wlay, "with the memory overlay");
+
+    harness_finish(&wlay);
+    return failed ? 1 : 0;
+}
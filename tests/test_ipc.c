@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#include "util.h"
+#include "wlay.h"
+#include "ipc.h"
+#include "harness.h"
+
+// The control socket driven by real clients over a synthetic model. There
+// is no compositor: the build wraps wlay_create_configuration() and the
+// libwayland calls ipc.c makes on configurations (-Wl,--wrap), so every
+// configuration is a fake the test answers by hand.
+
+#define HEAD_COUNT 4
+#define FAKE_MAX 16
+// Dispatches before a response counts as missing
+#define PATIENCE 2000
+// Enough events to fill the kernel's socket buffer and 1 MiB behind it
+#define FLOOD 200000
+
+struct fake_config {
+    bool destroyed;
+    // The last request other than destroy
+    uint32_t request;
+    const struct zwlr_output_configuration_v1_listener *listener;
+    void *data;
+};
+
+struct test_client {
+    int fd;
+    size_t size;
+    char buffer[64 * 1024];
+};
+
+static struct fake_config fakes[FAKE_MAX];
+static size_t fake_count;
+static struct wlay_state wlay;
+static char socket_path[PATH_MAX + 16];
+static bool failed;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+struct zwlr_output_configuration_v1 *__wrap_wlay_create_configuration(struct wlay_state *wlay)
+{
+    if (fake_count == FAKE_MAX) {
+        fail("Too many configurations");
+    }
+    struct fake_config *fake = &fakes[fake_count++];
+    memset(fake, 0, sizeof(*fake));
+    return (struct zwlr_output_configuration_v1 *)fake;
+}
+
+
+static struct fake_config *fake_lookup(struct wl_proxy *proxy)
+{
+    struct fake_config *fake = (struct fake_config *)proxy;
+    if (fake < fakes || fake >= fakes + fake_count) {
+        fail("Protocol request on something that is not a configuration");
+    }
+    return fake;
+}
+
+
+static void fake_request(struct wl_proxy *proxy, uint32_t opcode)
+{
+    struct fake_config *fake = fake_lookup(proxy);
+    if (fake->destroyed) {
+        fail("Request on a destroyed configuration");
+    }
+    if (opcode == ZWLR_OUTPUT_CONFIGURATION_V1_DESTROY) {
+        fake->destroyed = true;
+    } else {
+        fake->request = opcode;
+    }
+}
+
+
+int __wrap_wl_proxy_add_listener(struct wl_proxy *proxy, void (**implementation)(void),
+                                 void *data)
+{
+    struct fake_config *fake = fake_lookup(proxy);
+    fake->listener = (const struct zwlr_output_configuration_v1_listener *)implementation;
+    fake->data = data;
+    return 0;
+}
+
+
+// Protocol headers from wayland-scanner 1.20 on
+struct wl_proxy *__wrap_wl_proxy_marshal_flags(struct wl_proxy *proxy, uint32_t opcode,
+                                               const struct wl_interface *interface,
+                                               uint32_t version, uint32_t flags, ...)
+{
+    fake_request(proxy, opcode);
+    return NULL;
+}
+
+
+uint32_t __wrap_wl_proxy_get_version(struct wl_proxy *proxy)
+{
+    return 1;
+}
+
+
+// Older ones, destroy is marshalled and then destroyed
+void __wrap_wl_proxy_marshal(struct wl_proxy *proxy, uint32_t opcode, ...)
+{
+    fake_request(proxy, opcode);
+}
+
+
+void __wrap_wl_proxy_destroy(struct wl_proxy *proxy)
+{
+    fake_lookup(proxy)->destroyed = true;
+}
+
+
+int __wrap_wl_display_flush(struct wl_display *display)
+{
+    return 0;
+}
+
+
+// What the compositor would answer, as the listener is called from
+// wl_display_dispatch()
+static void fake_answer(struct fake_config *fake, const char *result)
+{
+    struct zwlr_output_configuration_v1 *config = (struct zwlr_output_configuration_v1 *)fake;
+    if (!strcmp(result, "succeeded")) {
+        fake->listener->succeeded(fake->data, config);
+    } else if (!strcmp(result, "failed")) {
+        fake->listener->failed(fake->data, config);
+    } else {
+        fake->listener->cancelled(fake->data, config);
+    }
+}
+
+
+static struct wlay_ipc *ipc_start(void)
+{
+    fake_count = 0;
+    struct wlay_ipc *ipc = wlay_ipc_create(&wlay, socket_path);
+    if (ipc == NULL) {
+        fail("Can not listen at %s", socket_path);
+    }
+    return ipc;
+}
+
+
+static void ipc_spin(struct wlay_ipc *ipc, int count)
+{
+    for (int i = 0; i < count; i++) {
+        wlay_ipc_dispatch(ipc);
+    }
+}
+
+
+static void client_connect(struct wlay_ipc *ipc, struct test_client *client)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, socket_path);
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fail("Failed to connect to %s: %s", socket_path, strerror(errno));
+    }
+    client->size = 0;
+    ipc_spin(ipc, 1);
+}
+
+
+static void client_close(struct wlay_ipc *ipc, struct test_client *client)
+{
+    close(client->fd);
+    client->fd = -1;
+    ipc_spin(ipc, 2);
+}
+
+
+static void client_send(struct test_client *client, const char *request)
+{
+    size_t size = strlen(request);
+    while (size > 0) {
+        ssize_t n = send(client->fd, request, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            fail("Failed to send a request: %s", strerror(errno));
+        }
+        request += n;
+        size -= n;
+    }
+}
+
+
+// Receives what is there, false at the end of the stream
+static bool client_receive(struct test_client *client)
+{
+    for (;;) {
+        if (client->size == sizeof(client->buffer)) {
+            fail("Response too long");
+        }
+        ssize_t n = recv(client->fd, client->buffer + client->size,
+                         sizeof(client->buffer) - client->size, MSG_DONTWAIT);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        if (n == 0) {
+            return false;
+        }
+        client->size += n;
+    }
+}
+
+
+// The next response line without its newline, NULL if none arrives
+static const char *client_line(struct wlay_ipc *ipc, struct test_client *client)
+{
+    static char line[sizeof(client->buffer)];
+    for (int i = 0; i < PATIENCE; i++) {
+        bool open = client_receive(client);
+        char *end = memchr(client->buffer, '\n', client->size);
+        if (end != NULL) {
+            size_t length = end - client->buffer;
+            memcpy(line, client->buffer, length);
+            line[length] = '\0';
+            client->size -= length + 1;
+            memmove(client->buffer, end + 1, client->size);
+            return line;
+        }
+        if (!open) {
+            return NULL;
+        }
+        wlay_ipc_dispatch(ipc);
+        if (i > 10) {
+            nanosleep(&(struct timespec){ .tv_nsec = 100000 }, NULL);
+        }
+    }
+    return NULL;
+}
+
+
+static void expect(struct wlay_ipc *ipc, struct test_client *client, const char *expected,
+                   const char *what)
+{
+    const char *line = client_line(ipc, client);
+    if (line == NULL || strcmp(line, expected)) {
+        printf("FAIL %s\n  expected %s\n  got      %s\n", what, expected,
+               line ? line : "nothing");
+        failed = true;
+    }
+}
+
+
+// Nothing at all for a client
+static void expect_silence(struct wlay_ipc *ipc, struct test_client *client, const char *what)
+{
+    ipc_spin(ipc, 10);
+    client_receive(client);
+    if (client->size > 0) {
+        printf("FAIL %s\n  got %.*s\n", what, (int)client->size, client->buffer);
+        failed = true;
+        client->size = 0;
+    }
+}
+
+
+// A request waiting for the compositor may have written the start of its
+// response, but nothing may complete a line
+static void expect_pending(struct wlay_ipc *ipc, struct test_client *client, const char *what)
+{
+    ipc_spin(ipc, 10);
+    client_receive(client);
+    if (memchr(client->buffer, '\n', client->size) != NULL) {
+        printf("FAIL %s\n  got %.*s\n", what, (int)client->size, client->buffer);
+        failed = true;
+    }
+}
+
+
+static struct wlay_head *find_head(const char *name)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay.wl.heads, link) {
+        if (!strcmp(head->name, name)) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+
+static void test_commands(void)
+{
+    struct wlay_ipc *ipc = ipc_start();
+    struct test_client client;
+    client_connect(ipc, &client);
+
+    client_send(&client, "ping\n");
+    expect(ipc, &client, "{\"ok\":true}", "ping");
+    client_send(&client, "\n");
+    expect(ipc, &client, "{\"ok\":false,\"error\":\"Empty request\"}", "empty request");
+    client_send(&client, "bogus\n");
+    expect(ipc, &client, "{\"ok\":false,\"error\":\"Unknown command bogus\"}", "unknown command");
+    client_send(&client, "ping now\r\n");
+    expect(ipc, &client, "{\"ok\":false,\"error\":\"ping takes no arguments\"}",
+           "arguments to ping");
+
+    // Several requests in one write are answered in order
+    client_send(&client, "set TEST-1 x=-100\nget\n");
+    expect(ipc, &client, "{\"ok\":true}", "set");
+    const char *line = client_line(ipc, &client);
+    check(line != NULL && !strncmp(line, "{\"ok\":true,\"serial\":", 20) &&
+          strstr(line, "\"TEST-1\"") != NULL, "get");
+    check(find_head("TEST-1")->x == -100, "set position");
+
+    client_close(ipc, &client);
+    wlay_ipc_destroy(ipc);
+}
+
+
+static void test_batch(void)
+{
+    struct wlay_ipc *ipc = ipc_start();
+    struct test_client client;
+    client_connect(ipc, &client);
+
+    client_send(&client, "set TEST-2 pos=10,20; ;ping;set TEST-2 mode=1920x1080@60\n");
+    expect(ipc, &client, "{\"results\":[{\"ok\":true},{\"ok\":true},{\"ok\":true}],\"ok\":true}",
+           "batch");
+    struct wlay_head *head = find_head("TEST-2");
+    check(head->x == 10 && head->y == 20, "batched position");
+    check(head->current_mode->width == 1920, "batched mode");
+
+    // Everything after the first failure is skipped, and not executed
+    client_send(&client, "set TEST-2 x=30;set TEST-9 x=1;set TEST-2 x=40;ping\n");
+    expect(ipc, &client,
+           "{\"results\":[{\"ok\":true},{\"ok\":false,\"error\":\"No output TEST-9\"},"
+           "{\"ok\":false,\"error\":\"Skipped\"},{\"ok\":false,\"error\":\"Skipped\"}],"
+           "\"ok\":false}", "failing batch");
+    check(head->x == 30, "skipped commands are not executed");
+
+    // A configuration in the middle of a batch holds back the rest
+    client_send(&client, "ping;test;set TEST-2 x=50\n");
+    expect_pending(ipc, &client, "batch waiting for a test");
+    check(fake_count == 1 && fakes[0].request == ZWLR_OUTPUT_CONFIGURATION_V1_TEST,
+          "test sent");
+    check(head->x == 30, "commands after a pending test wait");
+    fake_answer(&fakes[0], "failed");
+    expect(ipc, &client,
+           "{\"results\":[{\"ok\":true},{\"ok\":false,\"result\":\"failed\"},"
+           "{\"ok\":false,\"error\":\"Skipped\"}],\"ok\":false}", "failed test");
+    check(fakes[0].destroyed, "answered configuration destroyed");
+    check(head->x == 30, "command after a failed test skipped");
+
+    client_close(ipc, &client);
+    wlay_ipc_destroy(ipc);
+}
+
+
+static void test_subscribe(void)
+{
+    struct wlay_ipc *ipc = ipc_start();
+    struct test_client subscriber, other;
+    client_connect(ipc, &subscriber);
+    client_connect(ipc, &other);
+
+    client_send(&subscriber, "subscribe\n");
+    expect(ipc, &subscriber, "{\"ok\":true}", "subscribe");
+    wlay_ipc_notify_done(ipc, 7);
+    expect(ipc, &subscriber, "{\"event\":\"done\",\"serial\":7}", "idle event");
+    expect_silence(ipc, &other, "events for clients that did not subscribe");
+
+    // Events wait for the response being written, and then follow it
+    client_send(&subscriber, "ping;apply;ping\n");
+    expect_pending(ipc, &subscriber, "batch waiting for an apply");
+    check(fake_count == 1 && fakes[0].request == ZWLR_OUTPUT_CONFIGURATION_V1_APPLY,
+          "apply sent");
+    wlay_ipc_notify_done(ipc, 8);
+    expect_pending(ipc, &subscriber, "event in the middle of a response");
+    fake_answer(&fakes[0], "succeeded");
+    expect(ipc, &subscriber,
+           "{\"results\":[{\"ok\":true},{\"ok\":true,\"result\":\"succeeded\"},{\"ok\":true}],"
+           "\"ok\":true}", "applied batch");
+    expect(ipc, &subscriber, "{\"event\":\"done\",\"serial\":8}", "held back event");
+    expect(ipc, &subscriber, "{\"event\":\"result\",\"source\":\"apply\",\"result\":\"succeeded\"}",
+           "result event");
+
+    // Results of other clients' configurations reach subscribers as events
+    client_send(&other, "test\n");
+    ipc_spin(ipc, 2);
+    check(fake_count == 2, "test of the other client sent");
+    fake_answer(&fakes[1], "cancelled");
+    expect(ipc, &other, "{\"ok\":false,\"result\":\"cancelled\"}", "cancelled test");
+    expect(ipc, &subscriber, "{\"event\":\"result\",\"source\":\"test\",\"result\":\"cancelled\"}",
+           "result event of another client");
+
+    client_close(ipc, &subscriber);
+    client_close(ipc, &other);
+    wlay_ipc_destroy(ipc);
+}
+
+
+// A client that hangs up while its configuration is pending stays around
+// for the answer, which still reaches the subscribers
+static void test_hangup(void)
+{
+    struct wlay_ipc *ipc = ipc_start();
+    struct test_client subscriber, client;
+    client_connect(ipc, &subscriber);
+    client_send(&subscriber, "subscribe\n");
+    expect(ipc, &subscriber, "{\"ok\":true}", "subscribe");
+
+    client_connect(ipc, &client);
+    client_send(&client, "apply;ping");
+    shutdown(client.fd, SHUT_WR);
+    ipc_spin(ipc, 2);
+    check(fake_count == 1 && fakes[0].request == ZWLR_OUTPUT_CONFIGURATION_V1_APPLY,
+          "last request without a newline is run");
+    client_close(ipc, &client);
+    check(!fakes[0].destroyed, "configuration outlives its client");
+    fake_answer(&fakes[0], "succeeded");
+    check(fakes[0].destroyed, "configuration destroyed once answered");
+    expect(ipc, &subscriber, "{\"event\":\"result\",\"source\":\"apply\",\"result\":\"succeeded\"}",
+           "result event after the hangup");
+
+    // Pending configurations are given up with the socket
+    client_connect(ipc, &client);
+    client_send(&client, "test\n");
+    ipc_spin(ipc, 2);
+    check(fake_count == 2, "test sent");
+    client_close(ipc, &subscriber);
+    wlay_ipc_destroy(ipc);
+    check(fakes[1].destroyed, "pending configuration destroyed with the socket");
+    close(client.fd);
+}
+
+
+static void test_limits(void)
+{
+    struct wlay_ipc *ipc = ipc_start();
+    struct test_client slow, client;
+    client_connect(ipc, &slow);
+    client_send(&slow, "subscribe\n");
+    expect(ipc, &slow, "{\"ok\":true}", "subscribe");
+
+    // A subscriber that stops reading is dropped once 1 MiB piled up
+    size_t sent = 0;
+    for (int i = 0; i < FLOOD; i++) {
+        wlay_ipc_notify_done(ipc, i);
+        sent += snprintf(NULL, 0, "{\"event\":\"done\",\"serial\":%d}\n", i);
+    }
+    size_t received = 0;
+    for (;;) {
+        bool open = client_receive(&slow);
+        received += slow.size;
+        slow.size = 0;
+        if (!open) {
+            break;
+        }
+        ipc_spin(ipc, 1);
+    }
+    check(received < sent, "slow reader dropped");
+    close(slow.fd);
+
+    // Lines longer than 64 KiB are refused
+    client_connect(ipc, &client);
+    static char request[80 * 1024];
+    memset(request, 'x', sizeof(request) - 1);
+    client_send(&client, request);
+    expect(ipc, &client, "{\"ok\":false,\"error\":\"Request too long\"}", "long request");
+    check(client_line(ipc, &client) == NULL, "closed after a long request");
+    close(client.fd);
+
+    // Neither took the others down
+    client_connect(ipc, &client);
+    client_send(&client, "ping\n");
+    expect(ipc, &client, "{\"ok\":true}", "ping after the limits");
+    client_close(ipc, &client);
+    wlay_ipc_destroy(ipc);
+}
+
+
+int main(void)
+{
+    const char *tmp = getenv("TMPDIR");
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/wlay-test-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (mkdtemp(dir) == NULL) {
+        fail("mkdtemp failed: %s", strerror(errno));
+    }
+    snprintf(socket_path, sizeof(socket_path), "%s/wlay.sock", dir);
+    harness_heads(&wlay, HEAD_COUNT);
+
+    test_commands();
+    test_batch();
+    test_subscribe();
+    test_hangup();
+    test_limits();
+
+    harness_heads_finish(&wlay);
+    rmdir(dir);
+    return failed ? 1 : 0;
+}
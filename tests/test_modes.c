@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "modes.h"
+
+static bool failed;
+
+static struct wlay_state wlay;
+static struct wlay_head head;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+// Modes the way compositors announce them, unsorted and some of them twice
+static void add_mode(int32_t width, int32_t height, int32_t refresh_rate, bool preferred)
+{
+    struct wlay_mode *mode = xmalloc(sizeof(*mode));
+    mode->head = &head;
+    mode->width = width;
+    mode->height = height;
+    mode->refresh_rate = refresh_rate;
+    mode->preferred = preferred;
+    wl_list_insert(head.modes.prev, &mode->link);
+    wlay_model_changed(&wlay);
+}
+
+
+static bool is_mode(const struct wlay_mode *mode, int32_t width, int32_t height,
+                    int32_t refresh_rate)
+{
+    return mode != NULL && mode->width == width && mode->height == height &&
+        mode->refresh_rate == refresh_rate;
+}
+
+
+static void test_parse(void)
+{
+    struct wlay_mode_policy policy;
+    check(wlay_mode_policy_parse(&policy, "2560x1440@144Hz"), "2560x1440@144Hz");
+    check(policy.count == 1 && policy.rules[0].type == WLAY_MODE_RULE_SIZE &&
+          policy.rules[0].width == 2560 && policy.rules[0].height == 1440 &&
+          policy.rules[0].refresh_rate == 144000, "rule of 2560x1440@144Hz");
+    check(wlay_mode_policy_parse(&policy, "1920x1080@59.94,fastest,native"), "a list of rules");
+    check(policy.count == 3 && policy.rules[0].refresh_rate == 59940 &&
+          policy.rules[1].type == WLAY_MODE_RULE_FASTEST &&
+          policy.rules[2].type == WLAY_MODE_RULE_NATIVE, "rules of the list");
+    check(wlay_mode_policy_parse(&policy, "1920x1080") && policy.rules[0].refresh_rate == 0,
+          "any refresh rate");
+
+    check(!wlay_mode_policy_parse(&policy, "fastest,quickest"), "unknown word");
+    check(!wlay_mode_policy_parse(&policy, "1920x1080@"), "missing refresh rate");
+    check(!wlay_mode_policy_parse(&policy, "1920x1080@60MHz"), "unknown unit");
+    check(!wlay_mode_policy_parse(&policy, "0x1080"), "empty resolution");
+    check(!wlay_mode_policy_parse(&policy, ""), "no rules");
+
+    char spec[256] = "native";
+    for (int i = 1; i < WLAY_MODE_POLICY_MAX_RULES; i++) {
+        strcat(spec, ",largest");
+    }
+    check(wlay_mode_policy_parse(&policy, spec) && policy.count == WLAY_MODE_POLICY_MAX_RULES,
+          "as many rules as fit");
+    strcat(spec, ",fastest");
+    check(!wlay_mode_policy_parse(&policy, spec), "too many rules");
+}
+
+
+static void test_index(void)
+{
+    const struct wlay_mode_index *index = wlay_head_mode_index(&head);
+    check(index->count == 6, "duplicates collapsed");
+    check(index->group_count == 3, "resolutions");
+    check(is_mode(index->modes[0], 3840, 2160, 60000), "largest first");
+    check(index->groups[1].width == 2560 && index->groups[1].count == 2,
+          "refresh rates of 2560x1440");
+    check(is_mode(index->modes[index->groups[1].first], 2560, 1440, 143912),
+          "fastest first");
+    // The current mode stands in for its duplicates
+    check(index->modes[index->groups[2].first + 1] == head.current_mode, "current duplicate kept");
+}
+
+
+static void test_best(void)
+{
+    struct wlay_mode_policy policy;
+    check(is_mode(wlay_head_best_mode(&head, NULL), 2560, 1440, 143912),
+          "native is the preferred resolution at its fastest");
+    wlay_mode_policy_parse(&policy, "fastest");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 1920, 1080, 240000), "fastest");
+    wlay_mode_policy_parse(&policy, "largest");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 3840, 2160, 60000), "largest");
+    wlay_mode_policy_parse(&policy, "preferred");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 2560, 1440, 59951), "preferred");
+    wlay_mode_policy_parse(&policy, "2560x1440@60");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 2560, 1440, 59951), "close refresh rate");
+    wlay_mode_policy_parse(&policy, "2560x1440@75,1920x1080@60Hz");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 1920, 1080, 60000), "next rule");
+    wlay_mode_policy_parse(&policy, "1280x720");
+    check(is_mode(wlay_head_best_mode(&head, &policy), 2560, 1440, 143912), "native fallback");
+}
+
+
+static void test_refresh_format(void)
+{
+    char buffer[32];
+    wlay_refresh_format(buffer, sizeof(buffer), 60000);
+    check(!strcmp(buffer, "60"), "60 Hz");
+    wlay_refresh_format(buffer, sizeof(buffer), 59940);
+    check(!strcmp(buffer, "59.94"), "59.94 Hz");
+    wlay_refresh_format(buffer, sizeof(buffer), 143912);
+    check(!strcmp(buffer, "143.912"), "143.912 Hz");
+    wlay_refresh_format(buffer, sizeof(buffer), 74500);
+    check(!strcmp(buffer, "74.5"), "74.5 Hz");
+}
+
+
+int main(void)
+{
+    wl_list_init(&wlay.wl.heads);
+    head.wlay = &wlay;
+    wl_list_init(&head.modes);
+    wl_list_insert(&wlay.wl.heads, &head.link);
+    add_mode(1920, 1080, 60000, false);
+    add_mode(2560, 1440, 59951, true);
+    add_mode(3840, 2160, 60000, false);
+    add_mode(1920, 1080, 240000, false);
+    add_mode(2560, 1440, 143912, false);
+    add_mode(1920, 1080, 60000, false);
+    head.current_mode = wl_container_of(head.modes.prev, head.current_mode, link);
+    add_mode(2560, 1440, 59951, false);
+    add_mode(1920, 1080, 50000, false);
+
+    test_parse();
+    test_index();
+    test_best();
+    test_refresh_format();
+
+    struct wlay_mode *mode, *tmp;
+    wl_list_for_each_safe(mode, tmp, &head.modes, link) {
+        wl_list_remove(&mode->link);
+        xfree(mode);
+    }
+    wlay_mode_index_finish(&head.mode_index);
+    return failed ? 1 : 0;
+}
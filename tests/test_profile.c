@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "profile.h"
+#include "harness.h"
+
+#define HEAD_COUNT 5
+
+static bool failed;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+// Every config wlay writes has to read back as the layout it was written
+// from, and as the type it was written as
+static void test_round_trip(struct wlay_state *wlay, enum wlay_config_type type)
+{
+    const char *name = wlay_config_type_names[type];
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&text, &size);
+    wlay_export(wlay, type, f);
+    fclose(f);
+
+    struct wlay_profile profile = { 0 };
+    wlay_profile_parse(&profile, text, size);
+    check(profile.type == type, name);
+    check(profile.unknown_count == 0, "no unknown words");
+    check(profile.output_count == HEAD_COUNT, "all outputs");
+
+    // Written in the order the compositor announced the heads
+    size_t i = 0;
+    struct wlay_head *head;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        if (i == profile.output_count) {
+            break;
+        }
+        const struct wlay_profile_output *output = &profile.outputs[i++];
+        // sway and kanshi find outputs by make, model and serial number
+        bool identified = head->identifier[0] &&
+            (type == WLAY_CONFIG_SWAY || type == WLAY_CONFIG_KANSHI);
+        check(!strcmp(output->name, identified ? head->identifier : head->name), "output name");
+        check(output->enabled == head->enabled, "enabled");
+        if (!head->enabled) {
+            continue;
+        }
+        check(output->width == head->current_mode->width &&
+              output->height == head->current_mode->height &&
+              output->refresh_rate == head->current_mode->refresh_rate, "mode");
+        check(output->has_position && output->x == head->x && output->y == head->y,
+              "position");
+        check(output->transform == (int32_t)head->transform, "transform");
+    }
+    if (failed) {
+        printf("%s:\n%s", name, text);
+    }
+
+    for (i = 0; i < profile.output_count; i++) {
+        xfree(profile.outputs[i].name);
+    }
+    xfree(profile.outputs);
+    free(text);
+}
+
+
+// Names as sh quotes them, wlay only writes connector names that need none
+static void test_shell_quotes(void)
+{
+    static const char script[] =
+        "#!/bin/sh\n"
+        "exec wlr-randr \\\n"
+        "\t--output 'DP 1'\\''s' --off \\\n"
+        "\t--output HDMI\\ A --pos 10,20\n";
+    struct wlay_profile profile = { 0 };
+    wlay_profile_parse(&profile, script, strlen(script));
+    check(profile.type == WLAY_CONFIG_WLRRANDR_SH, "script");
+    check(profile.output_count == 2 && !strcmp(profile.outputs[0].name, "DP 1's") &&
+          !strcmp(profile.outputs[1].name, "HDMI A"), "quoted names");
+    for (size_t i = 0; i < profile.output_count; i++) {
+        xfree(profile.outputs[i].name);
+    }
+    xfree(profile.outputs);
+}
+
+
+int main(void)
+{
+    struct wlay_state wlay;
+    harness_heads(&wlay, HEAD_COUNT);
+    // Not at the origin, rotated and with an identifier that needs quotes
+    struct wlay_head *head = wl_container_of(wlay.wl.heads.next, head, link);
+    head->x = -1920;
+    head->transform = WL_OUTPUT_TRANSFORM_90;
+    head->make = xstrdup("Dell Inc.");
+    head->model = xstrdup("DELL U2720Q");
+    head->serial_number = xstrdup("8XQ2K13");
+    wlay_head_refresh_identifier(head);
+    wlay_model_changed(&wlay);
+
+    for (int type = 0; type < WLAY_CONFIG_TYPE_COUNT; type++) {
+        // JSON is for other programs, wlay never reads it back
+        if (type != WLAY_CONFIG_JSON) {
+            test_round_trip(&wlay, type);
+        }
+    }
+    test_shell_quotes();
+
+    xfree(head->make);
+    xfree(head->model);
+    xfree(head->serial_number);
+    harness_heads_finish(&wlay);
+    return failed ? 1 : 0;
+}
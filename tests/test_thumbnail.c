@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "util.h"
+#include "thumbnail.h"
+
+static bool failed;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+// One pixel at a time, what the vectorized sums have to match exactly
+static uint32_t reference_pixel(const uint8_t *src, int height, int stride, int factor,
+                                int dx, int dy, bool y_invert, bool swap)
+{
+    const uint32_t area = (uint32_t)factor * factor;
+    uint32_t sum[3] = { 0 };
+    for (int y = dy * factor; y < (dy + 1) * factor; y++) {
+        const uint8_t *row = src + (size_t)(y_invert ? height - 1 - y : y) * stride;
+        for (int x = dx * factor; x < (dx + 1) * factor; x++) {
+            for (int c = 0; c < 3; c++) {
+                sum[c] += row[x * 4 + c];
+            }
+        }
+    }
+    uint32_t b = (sum[0] + area / 2) / area;
+    uint32_t g = (sum[1] + area / 2) / area;
+    uint32_t r = (sum[2] + area / 2) / area;
+    return swap ? 0xff000000 | b << 16 | g << 8 | r : 0xff000000 | r << 16 | g << 8 | b;
+}
+
+
+static void test_equivalence(void)
+{
+    // Widths that leave a scalar tail after the 16 channel steps, strides
+    // with padding, and the largest factor
+    static const struct {
+        int width, height, padding, factor;
+    } cases[] = {
+        { 64, 64, 0, 1 },
+        { 64, 64, 0, 4 },
+        { 67, 35, 12, 2 },
+        { 101, 50, 4, 3 },
+        { 1920, 1080, 0, 8 },
+        { 2560, 1440, 64, 10 },
+        { 3840, 257, 0, 257 },
+    };
+    unsigned int seed = 1;
+    for (size_t i = 0; i < ARRAY_SIZE(cases); i++) {
+        int width = cases[i].width, height = cases[i].height, factor = cases[i].factor;
+        int stride = width * 4 + cases[i].padding;
+        uint8_t *src = xmalloc((size_t)stride * height);
+        for (size_t b = 0; b < (size_t)stride * height; b++) {
+            seed = seed * 1103515245 + 12345;
+            src[b] = seed >> 16;
+        }
+        int dst_width = width / factor, dst_height = height / factor;
+        uint32_t *dst = xmalloc((size_t)dst_width * dst_height * sizeof(*dst));
+        uint16_t *accumulator = xmalloc((size_t)width * 4 * sizeof(*accumulator));
+
+        for (int flags = 0; flags < 4; flags++) {
+            bool y_invert = flags & 1, swap = flags & 2;
+            wlay_thumbnail_downscale(dst, accumulator, src, width, height, stride, factor,
+                                     y_invert, swap);
+            int mismatches = 0;
+            for (int dy = 0; dy < dst_height; dy++) {
+                for (int dx = 0; dx < dst_width; dx++) {
+                    mismatches += dst[(size_t)dy * dst_width + dx] !=
+                        reference_pixel(src, height, stride, factor, dx, dy, y_invert, swap);
+                }
+            }
+            char what[96];
+            snprintf(what, sizeof(what), "%dx%d by %d%s%s, %d pixels differ", width, height,
+                     factor, y_invert ? " inverted" : "", swap ? " swapped" : "", mismatches);
+            check(mismatches == 0, what);
+        }
+        xfree(accumulator);
+        xfree(dst);
+        xfree(src);
+    }
+}
+
+
+static void test_saturated(void)
+{
+    // The largest factor at full brightness must not overflow a column sum
+    const int factor = 257, width = factor * 2;
+    uint8_t *src = xmalloc((size_t)width * 4 * factor);
+    memset(src, 0xff, (size_t)width * 4 * factor);
+    uint32_t dst[2];
+    uint16_t *accumulator = xmalloc((size_t)width * 4 * sizeof(*accumulator));
+    wlay_thumbnail_downscale(dst, accumulator, src, width, factor, width * 4, factor,
+                             false, false);
+    check(dst[0] == 0xffffffff && dst[1] == 0xffffffff, "white at the largest factor");
+    xfree(accumulator);
+    xfree(src);
+}
+
+
+int main(void)
+{
+    test_equivalence();
+    test_saturated();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "util.h"
+#include "validate.h"
+
+// A few hundred heads, validated every frame while dragging. Shared and
+// sanitized builders are too noisy to hold the budget to, it is only
+// enforced with WLAY_TEST_TIMING set.
+#define HEAD_COUNT 300
+#define BUDGET 1e-3
+#define ROUNDS 10
+#define RUNS 20
+
+static bool failed;
+
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed = true;
+    }
+}
+
+
+static void test_small(struct wlay_validation *v)
+{
+    // Two outputs side by side, one overlapping the first, one just short
+    // of touching the second and one far away
+    const struct wlay_rect rects[] = {
+        { 0, 0, 1920, 1080 },
+        { 1920, 0, 1920, 1080 },
+        { 1000, 500, 1920, 1080 },
+        { 3845, 0, 1280, 1024 },
+        { 20000, 20000, 800, 600 },
+    };
+    wlay_validate(v, rects, ARRAY_SIZE(rects), 10);
+    check(v->overlap_count == 2, "overlaps of the third output");
+    check(v->gap_count == 1, "gap to the fourth output");
+    check(v->island_count == 3, "islands");
+    check(v->island[0] == 0 && v->island[1] == 0 && v->island[2] == 0, "largest island");
+    check(v->island[3] != 0 && v->island[4] != 0 && v->island[3] != v->island[4],
+          "separate islands");
+}
+
+
+// The best average of a few rounds, the others may have been preempted
+static double time_validate(struct wlay_validation *v, const struct wlay_rect *rects,
+                            size_t count)
+{
+    double best = INFINITY;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = monotonic_time();
+        for (int run = 0; run < RUNS; run++) {
+            wlay_validate(v, rects, count, 10);
+        }
+        best = min(best, (monotonic_time() - start) / RUNS);
+    }
+    return best;
+}
+
+
+static void test_timing(struct wlay_validation *v, bool enforce)
+{
+    static const char *shapes[] = { "grid", "column", "row", "diagonal" };
+    struct wlay_rect *rects = xmalloc(HEAD_COUNT * sizeof(*rects));
+    for (size_t shape = 0; shape < ARRAY_SIZE(shapes); shape++) {
+        for (int i = 0; i < HEAD_COUNT; i++) {
+            int column = shape == 0 ? i % 20 : shape == 1 ? 0 : i;
+            int row = shape == 0 ? i / 20 : shape == 2 ? 0 : i;
+            rects[i] = (struct wlay_rect){ column * 1920, row * 1080, 1920, 1080 };
+        }
+        double time = time_validate(v, rects, HEAD_COUNT);
+        printf("%s of %d heads: %.3f ms\n", shapes[shape], HEAD_COUNT, time * 1e3);
+        check(!enforce || time < BUDGET, shapes[shape]);
+        check(v->overlap_count == 0 && v->gap_count == 0, "no issues");
+        check(v->island_count == (shape == 3 ? HEAD_COUNT : 1), "islands");
+    }
+    xfree(rects);
+}
+
+
+int main(void)
+{
+    struct wlay_validation v;
+    wlay_validation_init(&v);
+    test_small(&v);
+    test_timing(&v, getenv("WLAY_TEST_TIMING") != NULL);
+    wlay_validation_finish(&v);
+    return failed ? 1 : 0;
+}
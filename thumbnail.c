@@ -0,0 +1,595 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <wayland-client.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "wayland-wlr-screencopy-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_RENDER
+#include "util.h"
+#include "wlay.h"
+#include "wlay_nuklear.h"
+#include "backend.h"
+#include "thumbnail.h"
+
+// wl_output gained the connector name in version 4, older outputs can not
+// be matched to heads
+#define THUMBNAIL_OUTPUT_VERSION 4u
+// Version 3 announces every buffer type before the copy has to be made
+#define THUMBNAIL_SCREENCOPY_VERSION 3u
+
+struct thumbnail_output {
+    struct wlay_thumbnails *thumbnails;
+    struct wl_output *output;
+    uint32_t global_name;
+    uint32_t version;
+    // Connector name, the same as the head's
+    char *name;
+    int32_t transform;
+
+    // Capture in flight
+    struct zwlr_screencopy_frame_v1 *frame;
+    uint32_t frame_format;
+    int frame_width, frame_height, frame_stride;
+    bool frame_y_invert;
+
+    // Shared memory the compositor copies into, kept as long as the
+    // output's buffer parameters stay the same
+    struct wl_buffer *buffer;
+    void *data;
+    size_t size;
+    uint32_t format;
+    int width, height, stride;
+
+    // Downscaled in the output's buffer orientation, then transformed
+    uint32_t *small;
+    uint32_t *pixels;
+    size_t pixel_capacity;
+    struct nk_image image;
+
+    struct wl_list link;
+};
+
+struct wlay_thumbnails {
+    struct wlay_state *wlay;
+    struct zwlr_screencopy_manager_v1 *manager;
+    uint32_t manager_version;
+    struct wl_list outputs;
+
+    double interval;
+    double next_capture;
+
+    uint16_t *accumulator;
+    size_t accumulator_capacity;
+};
+
+
+static bool thumbnail_format_supported(uint32_t format, bool *swap)
+{
+    switch (format) {
+    case WL_SHM_FORMAT_ARGB8888:
+    case WL_SHM_FORMAT_XRGB8888:
+        *swap = false;
+        return true;
+    case WL_SHM_FORMAT_ABGR8888:
+    case WL_SHM_FORMAT_XBGR8888:
+        *swap = true;
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+void wlay_thumbnail_downscale(uint32_t *dst, uint16_t *accumulator, const void *src,
+                              int width, int height, int stride, int factor,
+                              bool y_invert, bool swap)
+{
+    const int dst_width = width / factor;
+    const int dst_height = height / factor;
+    // Only whole blocks, the remainder columns are never read
+    const int channels = dst_width * factor * 4;
+    const uint32_t area = (uint32_t)factor * factor;
+
+    for (int dy = 0; dy < dst_height; dy++) {
+        memset(accumulator, 0, channels * sizeof(*accumulator));
+        for (int r = 0; r < factor; r++) {
+            int sy = dy * factor + r;
+            if (y_invert) {
+                sy = height - 1 - sy;
+            }
+            const uint8_t *row = (const uint8_t *)src + (size_t)sy * stride;
+            int i = 0;
+#ifdef __SSE2__
+            // Sums whole rows 16 channels at a time, the horizontal pass
+            // then only touches the accumulator
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= channels; i += 16) {
+                __m128i p = _mm_loadu_si128((const __m128i *)(row + i));
+                __m128i *acc = (__m128i *)(accumulator + i);
+                _mm_storeu_si128(acc, _mm_add_epi16(_mm_loadu_si128(acc),
+                                                    _mm_unpacklo_epi8(p, zero)));
+                _mm_storeu_si128(acc + 1, _mm_add_epi16(_mm_loadu_si128(acc + 1),
+                                                        _mm_unpackhi_epi8(p, zero)));
+            }
+#endif
+            for (; i < channels; i++) {
+                accumulator[i] += row[i];
+            }
+        }
+
+        uint32_t *out = dst + (size_t)dy * dst_width;
+        for (int dx = 0; dx < dst_width; dx++) {
+            const uint16_t *block = accumulator + dx * factor * 4;
+            uint32_t b = 0, g = 0, r = 0;
+            for (int x = 0; x < factor; x++) {
+                b += block[x * 4];
+                g += block[x * 4 + 1];
+                r += block[x * 4 + 2];
+            }
+            b = (b + area / 2) / area;
+            g = (g + area / 2) / area;
+            r = (r + area / 2) / area;
+            if (swap) {
+                uint32_t t = b;
+                b = r;
+                r = t;
+            }
+            out[dx] = 0xff000000 | r << 16 | g << 8 | b;
+        }
+    }
+}
+
+
+// Turns the image from the output's buffer orientation into the layout's,
+// the reverse of what the compositor does when rendering to the output
+static void thumbnail_transform(uint32_t *dst, const uint32_t *src, int width, int height,
+                                int32_t transform, int *dst_width, int *dst_height)
+{
+    const bool rotated = transform & 1;
+    const int w = rotated ? height : width;
+    const int h = rotated ? width : height;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int tx = transform & 4 ? w - 1 - x : x;
+            int sx, sy;
+            switch (transform & 3) {
+            case WL_OUTPUT_TRANSFORM_90:
+                sx = y;
+                sy = w - 1 - tx;
+                break;
+            case WL_OUTPUT_TRANSFORM_180:
+                sx = w - 1 - tx;
+                sy = h - 1 - y;
+                break;
+            case WL_OUTPUT_TRANSFORM_270:
+                sx = h - 1 - y;
+                sy = tx;
+                break;
+            default:
+                sx = tx;
+                sy = y;
+                break;
+            }
+            dst[(size_t)y * w + x] = src[(size_t)sy * width + sx];
+        }
+    }
+    *dst_width = w;
+    *dst_height = h;
+}
+
+
+static void thumbnail_buffer_destroy(struct thumbnail_output *output)
+{
+    if (output->buffer) {
+        wl_buffer_destroy(output->buffer);
+    }
+    if (output->data) {
+        munmap(output->data, output->size);
+    }
+    output->buffer = NULL;
+    output->data = NULL;
+    output->size = 0;
+}
+
+
+static bool thumbnail_buffer_create(struct thumbnail_output *output)
+{
+    struct wlay_state *wlay = output->thumbnails->wlay;
+    output->format = output->frame_format;
+    output->width = output->frame_width;
+    output->height = output->frame_height;
+    output->stride = output->frame_stride;
+    output->size = (size_t)output->stride * output->height;
+
+    int fd = memfd_create("wlay-thumbnail", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, output->size) < 0) {
+        log_info("Failed to allocate a capture buffer for %s", output->name);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    output->data = mmap(NULL, output->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (output->data == MAP_FAILED) {
+        output->data = NULL;
+        close(fd);
+        log_info("Failed to map a capture buffer for %s", output->name);
+        return false;
+    }
+    struct wl_shm_pool *pool = wl_shm_create_pool(wlay->wl.shm, fd, output->size);
+    output->buffer = wl_shm_pool_create_buffer(pool, 0, output->width, output->height,
+                                               output->stride, output->format);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return true;
+}
+
+
+static void thumbnail_frame_destroy(struct thumbnail_output *output)
+{
+    if (output->frame) {
+        zwlr_screencopy_frame_v1_destroy(output->frame);
+        output->frame = NULL;
+    }
+}
+
+
+static void thumbnail_copy(struct thumbnail_output *output)
+{
+    if (output->frame_width == 0) {
+        // None of the offered formats is one we can read
+        thumbnail_frame_destroy(output);
+        return;
+    }
+    if (output->buffer == NULL || output->format != output->frame_format ||
+            output->width != output->frame_width ||
+            output->height != output->frame_height ||
+            output->stride != output->frame_stride) {
+        thumbnail_buffer_destroy(output);
+        if (!thumbnail_buffer_create(output)) {
+            thumbnail_frame_destroy(output);
+            return;
+        }
+    }
+    zwlr_screencopy_frame_v1_copy(output->frame, output->buffer);
+}
+
+
+static void handle_frame_buffer(void *data, struct zwlr_screencopy_frame_v1 *frame,
+                                uint32_t format, uint32_t width, uint32_t height,
+                                uint32_t stride)
+{
+    struct thumbnail_output *output = data;
+    bool swap;
+    if (output->frame_width == 0 && thumbnail_format_supported(format, &swap)) {
+        output->frame_format = format;
+        output->frame_width = width;
+        output->frame_height = height;
+        output->frame_stride = stride;
+    }
+    if (output->thumbnails->manager_version <
+            ZWLR_SCREENCOPY_FRAME_V1_BUFFER_DONE_SINCE_VERSION) {
+        // The only buffer event, it has to be copied right away
+        thumbnail_copy(output);
+    }
+}
+
+
+static void handle_frame_flags(void *data, struct zwlr_screencopy_frame_v1 *frame,
+                               uint32_t flags)
+{
+    struct thumbnail_output *output = data;
+    output->frame_y_invert = flags & ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT;
+}
+
+
+static void thumbnail_assign(struct wlay_thumbnails *thumbnails, const char *name,
+                             const struct nk_image *image)
+{
+    struct wlay_head *head;
+    wl_list_for_each(head, &thumbnails->wlay->wl.heads, link) {
+        if (head->name && !strcmp(head->name, name)) {
+            head->thumbnail = image;
+        }
+    }
+}
+
+
+static void handle_frame_ready(void *data, struct zwlr_screencopy_frame_v1 *frame,
+                               uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec)
+{
+    struct thumbnail_output *output = data;
+    struct wlay_thumbnails *thumbnails = output->thumbnails;
+    struct wlay_state *wlay = thumbnails->wlay;
+    thumbnail_frame_destroy(output);
+
+    const int longest = max(output->width, output->height);
+    const int factor = max((longest + WLAY_THUMBNAIL_SIZE - 1) / WLAY_THUMBNAIL_SIZE, 1);
+    const int width = output->width / factor;
+    const int height = output->height / factor;
+    if (factor > 257 || width == 0 || height == 0) {
+        return;
+    }
+
+    const size_t channels = (size_t)output->width * 4;
+    if (channels > thumbnails->accumulator_capacity) {
+        thumbnails->accumulator_capacity = channels;
+        thumbnails->accumulator = xrealloc(thumbnails->accumulator,
+                                           channels * sizeof(*thumbnails->accumulator));
+    }
+    const size_t pixel_count = (size_t)width * height;
+    if (pixel_count > output->pixel_capacity) {
+        output->pixel_capacity = pixel_count;
+        output->small = xrealloc(output->small, pixel_count * sizeof(*output->small));
+        output->pixels = xrealloc(output->pixels, pixel_count * sizeof(*output->pixels));
+    }
+
+    bool swap = false;
+    thumbnail_format_supported(output->format, &swap);
+    wlay_thumbnail_downscale(output->small, thumbnails->accumulator, output->data,
+                             output->width, output->height, output->stride, factor,
+                             output->frame_y_invert, swap);
+    int image_width, image_height;
+    thumbnail_transform(output->pixels, output->small, width, height, output->transform,
+                        &image_width, &image_height);
+    wlay->backend->image_upload(wlay, &output->image, output->pixels,
+                                image_width, image_height);
+    thumbnail_assign(thumbnails, output->name, &output->image);
+}
+
+
+static void handle_frame_failed(void *data, struct zwlr_screencopy_frame_v1 *frame)
+{
+    // The output went away or got disabled, the next capture tells
+    struct thumbnail_output *output = data;
+    thumbnail_frame_destroy(output);
+}
+
+
+static void handle_frame_damage(void *data, struct zwlr_screencopy_frame_v1 *frame,
+                                uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+}
+
+
+static void handle_frame_linux_dmabuf(void *data, struct zwlr_screencopy_frame_v1 *frame,
+                                      uint32_t format, uint32_t width, uint32_t height)
+{
+}
+
+
+static void handle_frame_buffer_done(void *data, struct zwlr_screencopy_frame_v1 *frame)
+{
+    thumbnail_copy(data);
+}
+
+
+static const struct zwlr_screencopy_frame_v1_listener frame_listener = {
+    .buffer = handle_frame_buffer,
+    .flags = handle_frame_flags,
+    .ready = handle_frame_ready,
+    .failed = handle_frame_failed,
+    .damage = handle_frame_damage,
+    .linux_dmabuf = handle_frame_linux_dmabuf,
+    .buffer_done = handle_frame_buffer_done,
+};
+
+
+static void handle_output_geometry(void *data, struct wl_output *wl_output,
+                                   int32_t x, int32_t y, int32_t physical_width,
+                                   int32_t physical_height, int32_t subpixel,
+                                   const char *make, const char *model, int32_t transform)
+{
+    struct thumbnail_output *output = data;
+    output->transform = transform;
+}
+
+
+static void handle_output_mode(void *data, struct wl_output *wl_output, uint32_t flags,
+                               int32_t width, int32_t height, int32_t refresh)
+{
+}
+
+
+static void handle_output_done(void *data, struct wl_output *wl_output)
+{
+}
+
+
+static void handle_output_scale(void *data, struct wl_output *wl_output, int32_t factor)
+{
+}
+
+
+static void handle_output_name(void *data, struct wl_output *wl_output, const char *name)
+{
+    struct thumbnail_output *output = data;
+    xfree(output->name);
+    output->name = xstrdup(name);
+}
+
+
+static void handle_output_description(void *data, struct wl_output *wl_output,
+                                      const char *description)
+{
+}
+
+
+static const struct wl_output_listener output_listener = {
+    .geometry = handle_output_geometry,
+    .mode = handle_output_mode,
+    .done = handle_output_done,
+    .scale = handle_output_scale,
+    .name = handle_output_name,
+    .description = handle_output_description,
+};
+
+
+static void thumbnail_output_destroy(struct thumbnail_output *output)
+{
+    struct wlay_thumbnails *thumbnails = output->thumbnails;
+    struct wlay_state *wlay = thumbnails->wlay;
+    thumbnail_frame_destroy(output);
+    thumbnail_buffer_destroy(output);
+    if (output->name) {
+        thumbnail_assign(thumbnails, output->name, NULL);
+    }
+    if (output->image.w) {
+        wlay->backend->image_destroy(wlay, &output->image);
+    }
+    if (output->version >= WL_OUTPUT_RELEASE_SINCE_VERSION) {
+        wl_output_release(output->output);
+    } else {
+        wl_output_destroy(output->output);
+    }
+    wl_list_remove(&output->link);
+    xfree(output->name);
+    xfree(output->small);
+    xfree(output->pixels);
+    xfree(output);
+}
+
+
+struct wlay_thumbnails *wlay_thumbnails_create(struct wlay_state *wlay, double fps)
+{
+    if (wlay->backend->image_upload == NULL) {
+        log_info("The %s backend can not draw thumbnails", wlay->backend->name);
+        return NULL;
+    }
+    struct wlay_thumbnails *thumbnails = xmalloc(sizeof(*thumbnails));
+    thumbnails->wlay = wlay;
+    thumbnails->interval = 1 / min(fps, WLAY_THUMBNAIL_MAX_FPS);
+    wl_list_init(&thumbnails->outputs);
+    return thumbnails;
+}
+
+
+void wlay_thumbnails_destroy(struct wlay_thumbnails *thumbnails)
+{
+    if (thumbnails == NULL) {
+        return;
+    }
+    struct thumbnail_output *output, *tmp;
+    wl_list_for_each_safe(output, tmp, &thumbnails->outputs, link) {
+        thumbnail_output_destroy(output);
+    }
+    if (thumbnails->manager) {
+        zwlr_screencopy_manager_v1_destroy(thumbnails->manager);
+    }
+    xfree(thumbnails->accumulator);
+    xfree(thumbnails);
+}
+
+
+void wlay_thumbnails_global(struct wlay_thumbnails *thumbnails, struct wl_registry *registry,
+                            uint32_t name, const char *interface, uint32_t version)
+{
+    if (thumbnails == NULL) {
+        return;
+    }
+    if (!strcmp(interface, zwlr_screencopy_manager_v1_interface.name)) {
+        thumbnails->manager_version = min(version, THUMBNAIL_SCREENCOPY_VERSION);
+        thumbnails->manager = wl_registry_bind(
+            registry, name, &zwlr_screencopy_manager_v1_interface,
+            thumbnails->manager_version
+        );
+    } else if (!strcmp(interface, wl_output_interface.name)) {
+        if (version < WL_OUTPUT_NAME_SINCE_VERSION) {
+            log_info("wl_output version %u has no names, no thumbnail for it", version);
+            return;
+        }
+        struct thumbnail_output *output = xmalloc(sizeof(*output));
+        output->thumbnails = thumbnails;
+        output->global_name = name;
+        output->version = min(version, THUMBNAIL_OUTPUT_VERSION);
+        output->output = wl_registry_bind(registry, name, &wl_output_interface,
+                                          output->version);
+        wl_output_add_listener(output->output, &output_listener, output);
+        wl_list_insert(thumbnails->outputs.prev, &output->link);
+    }
+}
+
+
+void wlay_thumbnails_global_remove(struct wlay_thumbnails *thumbnails, uint32_t name)
+{
+    if (thumbnails == NULL) {
+        return;
+    }
+    struct thumbnail_output *output;
+    wl_list_for_each(output, &thumbnails->outputs, link) {
+        if (output->global_name == name) {
+            thumbnail_output_destroy(output);
+            return;
+        }
+    }
+}
+
+
+static bool thumbnail_wanted(struct wlay_thumbnails *thumbnails,
+                             struct thumbnail_output *output)
+{
+    if (output->name == NULL) {
+        return false;
+    }
+    struct wlay_head *head;
+    wl_list_for_each(head, &thumbnails->wlay->wl.heads, link) {
+        if (head->enabled && head->name && !strcmp(head->name, output->name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void wlay_thumbnails_update(struct wlay_thumbnails *thumbnails)
+{
+    if (thumbnails == NULL || thumbnails->manager == NULL) {
+        return;
+    }
+    struct wlay_state *wlay = thumbnails->wlay;
+    const double now = monotonic_time();
+    if (now < thumbnails->next_capture || wlay->wl.shm == NULL) {
+        return;
+    }
+    // A hidden window is only looked at again an interval later
+    thumbnails->next_capture = now + thumbnails->interval;
+    if (wlay->backend->visible && !wlay->backend->visible(wlay)) {
+        return;
+    }
+
+    struct thumbnail_output *output;
+    wl_list_for_each(output, &thumbnails->outputs, link) {
+        // A capture still in flight means the compositor is slower than
+        // our rate, skip rather than queue up
+        if (output->frame || !thumbnail_wanted(thumbnails, output)) {
+            continue;
+        }
+        output->frame_format = 0;
+        output->frame_width = 0;
+        output->frame_y_invert = false;
+        output->frame = zwlr_screencopy_manager_v1_capture_output(
+            thumbnails->manager, 0, output->output
+        );
+        zwlr_screencopy_frame_v1_add_listener(output->frame, &frame_listener, output);
+    }
+}
+
+
+int wlay_thumbnails_timeout(struct wlay_thumbnails *thumbnails)
+{
+    if (thumbnails == NULL || thumbnails->manager == NULL ||
+            wl_list_empty(&thumbnails->outputs)) {
+        return -1;
+    }
+    double remaining = thumbnails->next_capture - monotonic_time();
+    return remaining > 0 ? (int)ceil(remaining * 1000) : 0;
+}
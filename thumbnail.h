@@ -0,0 +1,46 @@
+#ifndef WLAY_THUMBNAIL_H
+#define WLAY_THUMBNAIL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <wayland-client.h>
+
+// Live output contents for the editor. Every enabled output is captured
+// with wlr-screencopy at a low rate, downscaled to a small image and
+// handed to the backend, the editor draws head->thumbnail once there is
+// one. Nothing is captured while the window can not be seen.
+
+// Longest side of a thumbnail, outputs are downscaled by a whole factor
+// until they fit
+#define WLAY_THUMBNAIL_SIZE 256
+#define WLAY_THUMBNAIL_MAX_FPS 2.0
+
+struct wlay_state;
+struct wlay_thumbnails;
+
+// Has to be created before the registry is bound, NULL if the backend can
+// not draw images
+struct wlay_thumbnails *wlay_thumbnails_create(struct wlay_state *wlay, double fps);
+void wlay_thumbnails_destroy(struct wlay_thumbnails *thumbnails);
+
+// Registry events, thumbnails may be NULL
+void wlay_thumbnails_global(struct wlay_thumbnails *thumbnails, struct wl_registry *registry,
+                            uint32_t name, const char *interface, uint32_t version);
+void wlay_thumbnails_global_remove(struct wlay_thumbnails *thumbnails, uint32_t name);
+
+// Starts the captures that are due, once per frame. thumbnails may be NULL.
+void wlay_thumbnails_update(struct wlay_thumbnails *thumbnails);
+// Milliseconds until the next capture is due, -1 for never, for backends
+// that sleep while idle
+int wlay_thumbnails_timeout(struct wlay_thumbnails *thumbnails);
+
+// Averages factor x factor blocks of a width x height XRGB8888 image into
+// dst, which holds (width / factor) x (height / factor) pixels. Rows of
+// src are stride bytes apart and read bottom up when y_invert is set.
+// swap exchanges red and blue, alpha is always opaque. accumulator holds
+// width * 4 entries, factor is at most 257 so that a column sum fits.
+void wlay_thumbnail_downscale(uint32_t *dst, uint16_t *accumulator, const void *src,
+                              int width, int height, int stride, int factor,
+                              bool y_invert, bool swap);
+
+#endif
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "trace.h"
+
+// File layout: the magic, then one record per event. A record is the time
+// since the previous one in microseconds, the event, the object id and the
+// arguments. Integers are LEB128 varints (zigzag for signed ones), strings
+// are a length followed by the bytes.
+static const char trace_magic[8] = "WLAYTRC1";
+
+// Arguments of every event: i is int32_t, u uint32_t, o an object id and
+// s a string
+static const char *trace_signatures[WLAY_TRACE_EVENT_COUNT] = {
+    [WLAY_TRACE_MANAGER_HEAD] = "o",
+    [WLAY_TRACE_MANAGER_DONE] = "u",
+    [WLAY_TRACE_MANAGER_FINISHED] = "",
+    [WLAY_TRACE_HEAD_NAME] = "s",
+    [WLAY_TRACE_HEAD_DESCRIPTION] = "s",
+    [WLAY_TRACE_HEAD_PHYSICAL_SIZE] = "ii",
+    [WLAY_TRACE_HEAD_MODE] = "o",
+    [WLAY_TRACE_HEAD_ENABLED] = "i",
+    [WLAY_TRACE_HEAD_CURRENT_MODE] = "o",
+    [WLAY_TRACE_HEAD_POSITION] = "ii",
+    [WLAY_TRACE_HEAD_TRANSFORM] = "i",
+    [WLAY_TRACE_HEAD_SCALE] = "i",
+    [WLAY_TRACE_HEAD_FINISHED] = "",
+    [WLAY_TRACE_MODE_SIZE] = "ii",
+    [WLAY_TRACE_MODE_REFRESH] = "i",
+    [WLAY_TRACE_MODE_PREFERRED] = "",
+    [WLAY_TRACE_MODE_FINISHED] = "",
+    [WLAY_TRACE_HEAD_MAKE] = "s",
+    [WLAY_TRACE_HEAD_MODEL] = "s",
+    [WLAY_TRACE_HEAD_SERIAL_NUMBER] = "s",
+    [WLAY_TRACE_HEAD_ADAPTIVE_SYNC] = "u",
+};
+
+
+static void trace_put_varint(FILE *f, uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        fputc(byte | (value ? 0x80 : 0), f);
+    } while (value);
+}
+
+
+static uint64_t trace_get_varint(struct wlay_trace *trace)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (trace->offset >= trace->size) {
+            fail("Truncated trace");
+        }
+        uint8_t byte = trace->data[trace->offset++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    fail("Corrupt trace");
+    return 0;
+}
+
+
+struct wlay_trace *wlay_trace_create(const char *path)
+{
+    struct wlay_trace *trace = xmalloc(sizeof(*trace));
+    trace->file = fopen(path, "wb");
+    if (trace->file == NULL) {
+        fail("Failed to open %s", path);
+    }
+    fwrite(trace_magic, sizeof(trace_magic), 1, trace->file);
+    trace->start = monotonic_time();
+    return trace;
+}
+
+
+void wlay_trace_record(struct wlay_trace *trace, enum wlay_trace_event event,
+                       uint32_t object, ...)
+{
+    if (trace == NULL || trace->file == NULL) {
+        return;
+    }
+    uint64_t time = (monotonic_time() - trace->start) * 1e6;
+    trace_put_varint(trace->file, time - trace->last_time);
+    trace->last_time = time;
+    trace_put_varint(trace->file, event);
+    trace_put_varint(trace->file, object);
+
+    va_list args;
+    va_start(args, object);
+    for (const char *sig = trace_signatures[event]; *sig; sig++) {
+        switch (*sig) {
+        case 'i': {
+            int32_t value = va_arg(args, int32_t);
+            trace_put_varint(trace->file, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+            break;
+        }
+        case 'u':
+        case 'o':
+            trace_put_varint(trace->file, va_arg(args, uint32_t));
+            break;
+        case 's': {
+            const char *value = va_arg(args, const char *);
+            size_t length = value ? strlen(value) : 0;
+            trace_put_varint(trace->file, length);
+            fwrite(value, 1, length, trace->file);
+            break;
+        }
+        }
+    }
+    va_end(args);
+}
+
+
+void wlay_trace_flush(struct wlay_trace *trace)
+{
+    if (trace != NULL && trace->file != NULL) {
+        fflush(trace->file);
+    }
+}
+
+
+struct wlay_trace *wlay_trace_open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fail("Failed to open %s", path);
+    }
+    struct wlay_trace *trace = xmalloc(sizeof(*trace));
+    size_t capacity = 0;
+    for (;;) {
+        if (trace->size == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            trace->data = xrealloc(trace->data, capacity);
+        }
+        size_t n = fread(trace->data + trace->size, 1, capacity - trace->size, f);
+        if (n == 0) {
+            break;
+        }
+        trace->size += n;
+    }
+    fclose(f);
+
+    if (trace->size < sizeof(trace_magic) ||
+            memcmp(trace->data, trace_magic, sizeof(trace_magic))) {
+        fail("%s is not a wlay trace", path);
+    }
+    wlay_trace_rewind(trace);
+    return trace;
+}
+
+
+void wlay_trace_rewind(struct wlay_trace *trace)
+{
+    trace->offset = sizeof(trace_magic);
+    trace->time = 0;
+}
+
+
+bool wlay_trace_next(struct wlay_trace *trace, struct wlay_trace_record *record)
+{
+    if (trace->offset >= trace->size) {
+        return false;
+    }
+    trace->time += trace_get_varint(trace);
+    record->time = trace->time;
+    uint64_t event = trace_get_varint(trace);
+    if (event >= WLAY_TRACE_EVENT_COUNT) {
+        fail("Unknown event %llu in trace", (unsigned long long)event);
+    }
+    record->event = event;
+    record->object = trace_get_varint(trace);
+
+    int arg = 0;
+    for (const char *sig = trace_signatures[event]; *sig; sig++, arg++) {
+        switch (*sig) {
+        case 'i': {
+            uint32_t value = trace_get_varint(trace);
+            record->args[arg].i = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            break;
+        }
+        case 'u':
+        case 'o':
+            record->args[arg].u = trace_get_varint(trace);
+            break;
+        case 's': {
+            uint64_t length = trace_get_varint(trace);
+            if (length > trace->size - trace->offset) {
+                fail("Truncated trace");
+            }
+            if (length + 1 > trace->string_capacity[arg]) {
+                trace->string_capacity[arg] = length + 1;
+                trace->strings[arg] = xrealloc(trace->strings[arg], length + 1);
+            }
+            memcpy(trace->strings[arg], trace->data + trace->offset, length);
+            trace->strings[arg][length] = '\0';
+            trace->offset += length;
+            record->args[arg].s = trace->strings[arg];
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+
+void wlay_trace_close(struct wlay_trace *trace)
+{
+    if (trace == NULL) {
+        return;
+    }
+    if (trace->file != NULL) {
+        fclose(trace->file);
+    }
+    xfree(trace->data);
+    for (int i = 0; i < WLAY_TRACE_MAX_ARGS; i++) {
+        xfree(trace->strings[i]);
+    }
+    xfree(trace);
+}
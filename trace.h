@@ -0,0 +1,84 @@
+#ifndef WLAY_TRACE_H
+#define WLAY_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Every output management event wlay handles, objects are identified by
+// ids assigned in creation order, the output manager itself is 0
+enum wlay_trace_event {
+    WLAY_TRACE_MANAGER_HEAD,
+    WLAY_TRACE_MANAGER_DONE,
+    WLAY_TRACE_MANAGER_FINISHED,
+    WLAY_TRACE_HEAD_NAME,
+    WLAY_TRACE_HEAD_DESCRIPTION,
+    WLAY_TRACE_HEAD_PHYSICAL_SIZE,
+    WLAY_TRACE_HEAD_MODE,
+    WLAY_TRACE_HEAD_ENABLED,
+    WLAY_TRACE_HEAD_CURRENT_MODE,
+    WLAY_TRACE_HEAD_POSITION,
+    WLAY_TRACE_HEAD_TRANSFORM,
+    WLAY_TRACE_HEAD_SCALE,
+    WLAY_TRACE_HEAD_FINISHED,
+    WLAY_TRACE_MODE_SIZE,
+    WLAY_TRACE_MODE_REFRESH,
+    WLAY_TRACE_MODE_PREFERRED,
+    WLAY_TRACE_MODE_FINISHED,
+    // Version 2 and later, kept at the end so older traces stay readable
+    WLAY_TRACE_HEAD_MAKE,
+    WLAY_TRACE_HEAD_MODEL,
+    WLAY_TRACE_HEAD_SERIAL_NUMBER,
+    WLAY_TRACE_HEAD_ADAPTIVE_SYNC,
+    WLAY_TRACE_EVENT_COUNT,
+};
+
+#define WLAY_TRACE_MAX_ARGS 2
+
+union wlay_trace_arg {
+    int32_t i;
+    uint32_t u;
+    const char *s;
+};
+
+struct wlay_trace_record {
+    enum wlay_trace_event event;
+    // Microseconds since the start of the recording
+    uint64_t time;
+    uint32_t object;
+    union wlay_trace_arg args[WLAY_TRACE_MAX_ARGS];
+};
+
+struct wlay_trace {
+    // Writing
+    FILE *file;
+    double start;
+    uint64_t last_time;
+
+    // Reading, the whole trace is kept in memory
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+    uint64_t time;
+    char *strings[WLAY_TRACE_MAX_ARGS];
+    size_t string_capacity[WLAY_TRACE_MAX_ARGS];
+};
+
+struct wlay_trace *wlay_trace_create(const char *path);
+// Appends an event, the arguments depend on the event (int32_t, uint32_t
+// and object ids as uint32_t, strings as const char *). Does nothing when
+// trace is NULL.
+void wlay_trace_record(struct wlay_trace *trace, enum wlay_trace_event event,
+                       uint32_t object, ...);
+void wlay_trace_flush(struct wlay_trace *trace);
+
+struct wlay_trace *wlay_trace_open(const char *path);
+// Decodes the next event, false at the end of the trace. Strings stay valid
+// until the next call.
+bool wlay_trace_next(struct wlay_trace *trace, struct wlay_trace_record *record);
+void wlay_trace_rewind(struct wlay_trace *trace);
+
+void wlay_trace_close(struct wlay_trace *trace);
+
+#endif
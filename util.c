@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "util.h"
+
+
+void log_info(const char *format, ...)
+{
+    va_list vas;
+    va_start(vas, format);
+    vfprintf(stderr, format, vas);
+    va_end(vas);
+    fprintf(stderr, "\n");
+}
+
+
+void fail(const char *format, ...)
+{
+    va_list vas;
+    va_start(vas, format);
+    vfprintf(stderr, format, vas);
+    va_end(vas);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+
+// In front of every block, keeps the block as aligned as malloc() does
+struct mem_header {
+    _Alignas(max_align_t) size_t size;
+    uint32_t tag;
+    uint32_t magic;
+};
+
+#define MEM_MAGIC 0x776c6179
+
+const char *wlay_mem_tag_names[WLAY_MEM_TAG_COUNT] = {
+    [WLAY_MEM_OTHER] = "other",
+    [WLAY_MEM_MODEL] = "model",
+    [WLAY_MEM_GUI] = "gui",
+    [WLAY_MEM_RENDER] = "render",
+    [WLAY_MEM_EXPORT] = "export",
+    [WLAY_MEM_CONTROL] = "control",
+};
+
+static struct {
+    atomic_size_t live;
+    atomic_size_t peak;
+    atomic_uint_least64_t allocations;
+} mem_stats[WLAY_MEM_TAG_COUNT];
+
+
+static void mem_account(uint32_t tag, size_t added, size_t removed)
+{
+    size_t live = atomic_fetch_add_explicit(&mem_stats[tag].live, added - removed,
+                                            memory_order_relaxed) + added - removed;
+    size_t peak = atomic_load_explicit(&mem_stats[tag].peak, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(
+               &mem_stats[tag].peak, &peak, live, memory_order_relaxed, memory_order_relaxed)) {
+    }
+    if (added > 0) {
+        atomic_fetch_add_explicit(&mem_stats[tag].allocations, 1, memory_order_relaxed);
+    }
+}
+
+
+static struct mem_header *mem_header(void *ptr)
+{
+    struct mem_header *header = (struct mem_header *)ptr - 1;
+    if (header->magic != MEM_MAGIC || header->tag >= WLAY_MEM_TAG_COUNT) {
+        fail("%p was not allocated by xmalloc", ptr);
+    }
+    return header;
+}
+
+
+void *wlay_xmalloc(enum wlay_mem_tag tag, size_t size)
+{
+    struct mem_header *header = malloc(sizeof(*header) + size);
+    if (header == NULL) {
+        fail("malloc failed");
+    }
+    memset(header + 1, 0, size);
+    header->size = size;
+    header->tag = tag;
+    header->magic = MEM_MAGIC;
+    mem_account(tag, size, 0);
+    return header + 1;
+}
+
+
+void *wlay_xrealloc(enum wlay_mem_tag tag, void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return wlay_xmalloc(tag, size);
+    }
+    if (size == 0) {
+        xfree(ptr);
+        return NULL;
+    }
+    // The memory stays with whoever allocated it
+    struct mem_header *header = mem_header(ptr);
+    size_t old_size = header->size;
+    header = realloc(header, sizeof(*header) + size);
+    if (header == NULL) {
+        fail("realloc failed");
+    }
+    header->size = size;
+    mem_account(header->tag, size, old_size);
+    return header + 1;
+}
+
+
+char *wlay_xstrndup(enum wlay_mem_tag tag, const char *s, size_t n)
+{
+    size_t length = strnlen(s, n);
+    char *copy = wlay_xmalloc(tag, length + 1);
+    memcpy(copy, s, length);
+    return copy;
+}
+
+
+void xfree(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    struct mem_header *header = mem_header(ptr);
+    mem_account(header->tag, 0, header->size);
+    header->magic = 0;
+    free(header);
+}
+
+
+void wlay_mem_stats(enum wlay_mem_tag tag, struct wlay_mem_stats *stats)
+{
+    stats->live = atomic_load_explicit(&mem_stats[tag].live, memory_order_relaxed);
+    stats->peak = atomic_load_explicit(&mem_stats[tag].peak, memory_order_relaxed);
+    stats->allocations = atomic_load_explicit(&mem_stats[tag].allocations,
+                                              memory_order_relaxed);
+}
+
+
+double monotonic_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
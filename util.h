@@ -0,0 +1,67 @@
+#ifndef WLAY_UTIL_H
+#define WLAY_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+#define max(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a > _b ? _a : _b; })
+#define min(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
+// What memory is allocated for. A translation unit defines WLAY_MEM_TAG
+// before including this header to have its allocations counted there.
+enum wlay_mem_tag {
+    WLAY_MEM_OTHER,
+    // Heads, modes, snapshots and everything derived from them
+    WLAY_MEM_MODEL,
+    // The editor, its history and nuklear
+    WLAY_MEM_GUI,
+    // Backends, rasterizer and thumbnails
+    WLAY_MEM_RENDER,
+    // Configs, JSON and profiles
+    WLAY_MEM_EXPORT,
+    // Control socket, watch and fleet
+    WLAY_MEM_CONTROL,
+    WLAY_MEM_TAG_COUNT,
+};
+
+#ifndef WLAY_MEM_TAG
+#define WLAY_MEM_TAG WLAY_MEM_OTHER
+#endif
+
+struct wlay_mem_stats {
+    size_t live;
+    size_t peak;
+    // Every xmalloc(), xrealloc() and xstrdup()
+    uint64_t allocations;
+};
+
+extern const char *wlay_mem_tag_names[WLAY_MEM_TAG_COUNT];
+
+void log_info(const char *format, ...);
+void fail(const char *format, ...);
+
+// Memory from these is counted and has to be released with xfree(), libc's
+// free() is only for memory libc handed out. Allocation never fails, the
+// memory is zeroed.
+#define xmalloc(size) wlay_xmalloc(WLAY_MEM_TAG, size)
+#define xrealloc(ptr, size) wlay_xrealloc(WLAY_MEM_TAG, ptr, size)
+#define xstrdup(s) wlay_xstrndup(WLAY_MEM_TAG, s, (size_t)-1)
+#define xstrndup(s, n) wlay_xstrndup(WLAY_MEM_TAG, s, n)
+void *wlay_xmalloc(enum wlay_mem_tag tag, size_t size);
+// Memory that grows is not zeroed beyond what it was
+void *wlay_xrealloc(enum wlay_mem_tag tag, void *ptr, size_t size);
+char *wlay_xstrndup(enum wlay_mem_tag tag, const char *s, size_t n);
+void xfree(void *ptr);
+// Safe to call from any thread, the counters are not a consistent snapshot
+void wlay_mem_stats(enum wlay_mem_tag tag, struct wlay_mem_stats *stats);
+// Seconds on CLOCK_MONOTONIC
+double monotonic_time(void);
+
+#endif
@@ -0,0 +1,403 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "validate.h"
+
+/*
+ * Layout validation is a sweep over the left edges of the output rectangles.
+ * Rectangles are visited in order of their left edge while an active set
+ * holds every rectangle whose right edge (plus the gap tolerance) has not
+ * been passed yet. The active set is a treap ordered by the top edge, each
+ * node knowing the lowest bottom edge below it, so a rectangle is only
+ * compared against the active ones it vertically overlaps or almost
+ * touches. A min-heap by right edge retires rectangles as the sweep line
+ * passes them. That is O(n log n) plus the number of neighbouring pairs,
+ * whatever the shape of the layout. Pairs sharing a border with non-zero
+ * length are merged with union-find to find the islands the cursor can
+ * move between. Near misses are only reported as gaps when they actually
+ * separate two islands, a sliver bridged by a third output is harmless.
+ */
+
+#define SWEEP_NIL SIZE_MAX
+
+struct wlay_sweep_node {
+    size_t left;
+    size_t right;
+    uint32_t priority;
+    // Largest bottom edge in the subtree
+    int64_t bottom;
+};
+
+struct sweep {
+    struct wlay_validation *v;
+    const struct wlay_rect *rects;
+    struct wlay_sweep_node *nodes;
+    size_t root;
+    size_t retire_count;
+    int32_t gap_tolerance;
+};
+
+
+static int compare_left_edge(const void *a, const void *b, void *data)
+{
+    const struct wlay_rect *rects = data;
+    const struct wlay_rect *ra = &rects[*(const size_t *)a];
+    const struct wlay_rect *rb = &rects[*(const size_t *)b];
+    if (ra->x != rb->x) {
+        return ra->x < rb->x ? -1 : 1;
+    }
+    return (ra->y > rb->y) - (ra->y < rb->y);
+}
+
+
+// Treap order, the index breaks ties so that every key is unique
+static bool sweep_less(const struct sweep *sweep, size_t a, size_t b)
+{
+    const struct wlay_rect *ra = &sweep->rects[a], *rb = &sweep->rects[b];
+    return ra->y != rb->y ? ra->y < rb->y : a < b;
+}
+
+
+static void sweep_update(struct sweep *sweep, size_t i)
+{
+    struct wlay_sweep_node *node = &sweep->nodes[i];
+    node->bottom = (int64_t)sweep->rects[i].y + sweep->rects[i].h;
+    if (node->left != SWEEP_NIL) {
+        node->bottom = max(node->bottom, sweep->nodes[node->left].bottom);
+    }
+    if (node->right != SWEEP_NIL) {
+        node->bottom = max(node->bottom, sweep->nodes[node->right].bottom);
+    }
+}
+
+
+static size_t sweep_merge(struct sweep *sweep, size_t a, size_t b)
+{
+    if (a == SWEEP_NIL) {
+        return b;
+    }
+    if (b == SWEEP_NIL) {
+        return a;
+    }
+    if (sweep->nodes[a].priority > sweep->nodes[b].priority) {
+        sweep->nodes[a].right = sweep_merge(sweep, sweep->nodes[a].right, b);
+        sweep_update(sweep, a);
+        return a;
+    }
+    sweep->nodes[b].left = sweep_merge(sweep, a, sweep->nodes[b].left);
+    sweep_update(sweep, b);
+    return b;
+}
+
+
+// Into the nodes ordered before key and the rest
+static void sweep_split(struct sweep *sweep, size_t root, size_t key,
+                        size_t *before, size_t *after)
+{
+    if (root == SWEEP_NIL) {
+        *before = *after = SWEEP_NIL;
+        return;
+    }
+    struct wlay_sweep_node *node = &sweep->nodes[root];
+    if (sweep_less(sweep, root, key)) {
+        sweep_split(sweep, node->right, key, &node->right, after);
+        *before = root;
+    } else {
+        sweep_split(sweep, node->left, key, before, &node->left);
+        *after = root;
+    }
+    sweep_update(sweep, root);
+}
+
+
+static void sweep_insert(struct sweep *sweep, size_t i)
+{
+    struct wlay_sweep_node *node = &sweep->nodes[i];
+    node->left = node->right = SWEEP_NIL;
+    // Any well mixed value will do, this keeps the result reproducible
+    node->priority = (uint32_t)((i + 1) * 2654435761u);
+    sweep_update(sweep, i);
+    size_t before, after;
+    sweep_split(sweep, sweep->root, i, &before, &after);
+    sweep->root = sweep_merge(sweep, sweep_merge(sweep, before, i), after);
+}
+
+
+static size_t sweep_erase(struct sweep *sweep, size_t root, size_t i)
+{
+    struct wlay_sweep_node *node = &sweep->nodes[root];
+    if (root == i) {
+        return sweep_merge(sweep, node->left, node->right);
+    }
+    if (sweep_less(sweep, i, root)) {
+        node->left = sweep_erase(sweep, node->left, i);
+    } else {
+        node->right = sweep_erase(sweep, node->right, i);
+    }
+    sweep_update(sweep, root);
+    return root;
+}
+
+
+static int64_t sweep_right_edge(const struct sweep *sweep, size_t i)
+{
+    return (int64_t)sweep->rects[i].x + sweep->rects[i].w;
+}
+
+
+static void sweep_heap_push(struct sweep *sweep, size_t i)
+{
+    size_t *heap = sweep->v->retire;
+    size_t child = sweep->retire_count++;
+    while (child > 0) {
+        size_t parent = (child - 1) / 2;
+        if (sweep_right_edge(sweep, heap[parent]) <= sweep_right_edge(sweep, i)) {
+            break;
+        }
+        heap[child] = heap[parent];
+        child = parent;
+    }
+    heap[child] = i;
+}
+
+
+static void sweep_heap_pop(struct sweep *sweep)
+{
+    size_t *heap = sweep->v->retire;
+    size_t last = heap[--sweep->retire_count];
+    size_t parent = 0;
+    for (;;) {
+        size_t child = parent * 2 + 1;
+        if (child >= sweep->retire_count) {
+            break;
+        }
+        if (child + 1 < sweep->retire_count &&
+                sweep_right_edge(sweep, heap[child + 1]) < sweep_right_edge(sweep, heap[child])) {
+            child++;
+        }
+        if (sweep_right_edge(sweep, last) <= sweep_right_edge(sweep, heap[child])) {
+            break;
+        }
+        heap[parent] = heap[child];
+        parent = child;
+    }
+    heap[parent] = last;
+}
+
+
+static size_t island_find(size_t *parent, size_t i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+
+static void island_union(size_t *parent, size_t a, size_t b)
+{
+    a = island_find(parent, a);
+    b = island_find(parent, b);
+    if (a != b) {
+        parent[max(a, b)] = min(a, b);
+    }
+}
+
+
+static void wlay_validation_reserve(struct wlay_validation *v, size_t count)
+{
+    if (count <= v->capacity) {
+        return;
+    }
+    size_t capacity = max(count, v->capacity * 2);
+    v->island = xrealloc(v->island, capacity * sizeof(*v->island));
+    v->order = xrealloc(v->order, capacity * sizeof(*v->order));
+    v->nodes = xrealloc(v->nodes, capacity * sizeof(*v->nodes));
+    v->retire = xrealloc(v->retire, capacity * sizeof(*v->retire));
+    v->parent = xrealloc(v->parent, capacity * sizeof(*v->parent));
+    v->island_size = xrealloc(v->island_size, capacity * sizeof(*v->island_size));
+    v->capacity = capacity;
+}
+
+
+static void wlay_validation_add(struct wlay_validation *v,
+                                enum wlay_issue_type type, size_t a, size_t b,
+                                int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+    if (v->issue_count == v->issue_capacity) {
+        v->issue_capacity = max(v->issue_capacity * 2, (size_t)16);
+        v->issues = xrealloc(v->issues, v->issue_capacity * sizeof(*v->issues));
+    }
+    struct wlay_issue *issue = &v->issues[v->issue_count++];
+    issue->type = type;
+    issue->a = a;
+    issue->b = b;
+    issue->area.x = x0;
+    issue->area.y = y0;
+    issue->area.w = x1 - x0;
+    issue->area.h = y1 - y0;
+    if (type == WLAY_ISSUE_OVERLAP) {
+        v->overlap_count++;
+    } else {
+        v->gap_count++;
+    }
+}
+
+
+static void wlay_validate_pair(struct wlay_validation *v,
+                               const struct wlay_rect *rects, size_t a, size_t b,
+                               int32_t gap_tolerance)
+{
+    const struct wlay_rect *ra = &rects[a];
+    const struct wlay_rect *rb = &rects[b];
+    // The inner edges of the pair: negative distance means the projections
+    // overlap, zero means they touch
+    int32_t x0 = max(ra->x, rb->x);
+    int32_t x1 = min(ra->x + ra->w, rb->x + rb->w);
+    int32_t y0 = max(ra->y, rb->y);
+    int32_t y1 = min(ra->y + ra->h, rb->y + rb->h);
+    int32_t dx = x0 - x1;
+    int32_t dy = y0 - y1;
+
+    if (dx < 0 && dy < 0) {
+        wlay_validation_add(v, WLAY_ISSUE_OVERLAP, a, b, x0, y0, x1, y1);
+        island_union(v->parent, a, b);
+    } else if ((dx == 0 && dy < 0) || (dy == 0 && dx < 0)) {
+        // Shared border, corners alone do not let the cursor through
+        island_union(v->parent, a, b);
+    } else if (dx > 0 && dx <= gap_tolerance && dy < 0) {
+        wlay_validation_add(v, WLAY_ISSUE_GAP, a, b, x1, y0, x0, y1);
+    } else if (dy > 0 && dy <= gap_tolerance && dx < 0) {
+        wlay_validation_add(v, WLAY_ISSUE_GAP, a, b, x0, y1, x1, y0);
+    }
+}
+
+
+static void wlay_validate_islands(struct wlay_validation *v, size_t count)
+{
+    // The sort order is not needed anymore, reuse it to number the roots
+    size_t *root_id = v->order;
+    size_t largest = 0;
+    for (size_t i = 0; i < count; i++) {
+        v->island_size[i] = 0;
+        root_id[i] = SIZE_MAX;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t root = island_find(v->parent, i);
+        if (++v->island_size[root] > v->island_size[largest]) {
+            largest = root;
+        }
+    }
+
+    v->island_count = count > 0 ? 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t root = island_find(v->parent, i);
+        if (root == largest) {
+            v->island[i] = 0;
+            continue;
+        }
+        if (root_id[root] == SIZE_MAX) {
+            root_id[root] = v->island_count++;
+        }
+        v->island[i] = root_id[root];
+    }
+}
+
+
+// Compares current with every active rectangle whose top edge is at most
+// bottom and whose bottom edge is at least top
+static void sweep_query(struct sweep *sweep, size_t root, size_t current,
+                        int64_t top, int64_t bottom)
+{
+    while (root != SWEEP_NIL && sweep->nodes[root].bottom >= top) {
+        struct wlay_sweep_node *node = &sweep->nodes[root];
+        sweep_query(sweep, node->left, current, top, bottom);
+        const struct wlay_rect *r = &sweep->rects[root];
+        if (r->y > bottom) {
+            return;
+        }
+        if ((int64_t)r->y + r->h >= top) {
+            wlay_validate_pair(sweep->v, sweep->rects, root, current, sweep->gap_tolerance);
+        }
+        root = node->right;
+    }
+}
+
+
+void wlay_validation_init(struct wlay_validation *v)
+{
+    *v = (struct wlay_validation){0};
+}
+
+
+void wlay_validation_finish(struct wlay_validation *v)
+{
+    xfree(v->issues);
+    xfree(v->island);
+    xfree(v->order);
+    xfree(v->nodes);
+    xfree(v->retire);
+    xfree(v->parent);
+    xfree(v->island_size);
+    wlay_validation_init(v);
+}
+
+
+void wlay_validate(struct wlay_validation *v,
+                   const struct wlay_rect *rects, size_t count,
+                   int32_t gap_tolerance)
+{
+    wlay_validation_reserve(v, count);
+    v->issue_count = 0;
+    v->overlap_count = 0;
+    v->gap_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        v->order[i] = i;
+        v->parent[i] = i;
+    }
+    qsort_r(v->order, count, sizeof(*v->order), compare_left_edge, (void *)rects);
+
+    struct sweep sweep = {
+        .v = v,
+        .rects = rects,
+        .nodes = v->nodes,
+        .root = SWEEP_NIL,
+        .gap_tolerance = gap_tolerance,
+    };
+    for (size_t i = 0; i < count; i++) {
+        size_t current = v->order[i];
+        const struct wlay_rect *r = &rects[current];
+
+        // Retire everything that ends (with tolerance) left of the sweep line
+        while (sweep.retire_count > 0 &&
+                sweep_right_edge(&sweep, v->retire[0]) + gap_tolerance < r->x) {
+            sweep.root = sweep_erase(&sweep, sweep.root, v->retire[0]);
+            sweep_heap_pop(&sweep);
+        }
+
+        sweep_query(&sweep, sweep.root, current, (int64_t)r->y - gap_tolerance,
+                    (int64_t)r->y + r->h + gap_tolerance);
+        sweep_insert(&sweep, current);
+        sweep_heap_push(&sweep, current);
+    }
+
+    wlay_validate_islands(v, count);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < v->issue_count; i++) {
+        struct wlay_issue *issue = &v->issues[i];
+        if (issue->type == WLAY_ISSUE_GAP &&
+                v->island[issue->a] == v->island[issue->b]) {
+            v->gap_count--;
+            continue;
+        }
+        v->issues[kept++] = *issue;
+    }
+    v->issue_count = kept;
+}
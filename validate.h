@@ -0,0 +1,62 @@
+#ifndef WLAY_VALIDATE_H
+#define WLAY_VALIDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct wlay_sweep_node;
+
+struct wlay_rect {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+};
+
+enum wlay_issue_type {
+    // Two outputs cover the same area
+    WLAY_ISSUE_OVERLAP,
+    // Two outputs almost touch, the cursor can not cross the sliver between
+    WLAY_ISSUE_GAP,
+};
+
+struct wlay_issue {
+    enum wlay_issue_type type;
+    // Indices into the validated rectangle array
+    size_t a;
+    size_t b;
+    // Intersection for overlaps, the uncovered strip for gaps
+    struct wlay_rect area;
+};
+
+struct wlay_validation {
+    struct wlay_issue *issues;
+    size_t issue_count;
+    size_t overlap_count;
+    size_t gap_count;
+
+    // Island (edge-connected component) index of every rectangle, the
+    // largest island is always 0
+    int *island;
+    int island_count;
+
+    // Scratch space, kept around so that validating every frame does not
+    // allocate once the layout stops growing
+    size_t capacity;
+    size_t issue_capacity;
+    size_t *order;
+    // The rectangles crossing the sweep line, ordered by y and by their
+    // right edge
+    struct wlay_sweep_node *nodes;
+    size_t *retire;
+    size_t *parent;
+    size_t *island_size;
+};
+
+void wlay_validation_init(struct wlay_validation *v);
+void wlay_validation_finish(struct wlay_validation *v);
+void wlay_validate(struct wlay_validation *v,
+                   const struct wlay_rect *rects, size_t count,
+                   int32_t gap_tolerance);
+
+#endif
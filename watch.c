@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#define WLAY_MEM_TAG WLAY_MEM_CONTROL
+#include "util.h"
+#include "wlay.h"
+#include "export.h"
+#include "json.h"
+#include "watch.h"
+
+// Output not yet taken by the consumer. Lines that do not fit are dropped
+// and the next line that fits reports how many, its changes are relative
+// to the last line that was written.
+#define WATCH_MAX_PENDING (256 * 1024)
+
+enum watch_field {
+    WATCH_DESCRIPTION,
+    WATCH_MAKE,
+    WATCH_MODEL,
+    WATCH_SERIAL_NUMBER,
+    WATCH_ENABLED,
+    WATCH_MODE,
+    WATCH_X,
+    WATCH_Y,
+    WATCH_TRANSFORM,
+    WATCH_SCALE,
+    WATCH_ADAPTIVE_SYNC,
+    WATCH_MODES,
+    WATCH_FIELD_COUNT,
+};
+
+static const char *watch_field_names[WATCH_FIELD_COUNT] = {
+    [WATCH_DESCRIPTION] = "description",
+    [WATCH_MAKE] = "make",
+    [WATCH_MODEL] = "model",
+    [WATCH_SERIAL_NUMBER] = "serial_number",
+    [WATCH_ENABLED] = "enabled",
+    [WATCH_MODE] = "mode",
+    [WATCH_X] = "x",
+    [WATCH_Y] = "y",
+    [WATCH_TRANSFORM] = "transform",
+    [WATCH_SCALE] = "scale",
+    [WATCH_ADAPTIVE_SYNC] = "adaptive_sync",
+    [WATCH_MODES] = "modes",
+};
+
+// A head as it was written out, every field as its JSON value so that
+// comparing and printing them is the same for all of them
+struct watch_head {
+    char *name;
+    char *fields[WATCH_FIELD_COUNT];
+};
+
+struct watch_state {
+    struct watch_head *heads;
+    size_t count;
+};
+
+struct wlay_watch {
+    struct wlay_state *wlay;
+    struct watch_state last;
+    struct wlay_buffer out;
+    struct wlay_buffer line;
+    struct wlay_buffer value;
+    uint64_t dropped;
+    bool closed;
+    int stdout_flags;
+};
+
+
+static void watch_format(struct wlay_buffer *value, struct wlay_head *head,
+                         enum watch_field field)
+{
+    value->size = 0;
+    switch (field) {
+    case WATCH_DESCRIPTION:
+        wlay_json_string(value, head->description);
+        break;
+    case WATCH_MAKE:
+        wlay_json_string(value, head->make);
+        break;
+    case WATCH_MODEL:
+        wlay_json_string(value, head->model);
+        break;
+    case WATCH_SERIAL_NUMBER:
+        wlay_json_string(value, head->serial_number);
+        break;
+    case WATCH_ENABLED:
+        wlay_buffer_printf(value, "%s", head->enabled ? "true" : "false");
+        break;
+    case WATCH_MODE:
+        if (head->current_mode != NULL) {
+            wlay_buffer_printf(value, "\"%dx%d@%.3f\"", head->current_mode->width,
+                               head->current_mode->height,
+                               head->current_mode->refresh_rate / 1000.0);
+        } else {
+            wlay_buffer_printf(value, "null");
+        }
+        break;
+    case WATCH_X:
+        wlay_buffer_printf(value, "%d", head->x);
+        break;
+    case WATCH_Y:
+        wlay_buffer_printf(value, "%d", head->y);
+        break;
+    case WATCH_TRANSFORM:
+        wlay_buffer_printf(value, "\"%s\"", wlay_output_transform_names[head->transform]);
+        break;
+    case WATCH_SCALE:
+        wlay_buffer_printf(value, "%.3f", wl_fixed_to_double(head->scale));
+        break;
+    case WATCH_ADAPTIVE_SYNC:
+        if (head->adaptive_sync_supported) {
+            wlay_buffer_printf(value, "%s", head->adaptive_sync ? "true" : "false");
+        } else {
+            wlay_buffer_printf(value, "null");
+        }
+        break;
+    case WATCH_MODES:
+        wlay_buffer_printf(value, "%d", wl_list_length(&head->modes));
+        break;
+    default:
+        break;
+    }
+    wlay_buffer_append(value, "", 1);
+}
+
+
+static void watch_state_finish(struct watch_state *state)
+{
+    for (size_t i = 0; i < state->count; i++) {
+        xfree(state->heads[i].name);
+        for (int f = 0; f < WATCH_FIELD_COUNT; f++) {
+            xfree(state->heads[i].fields[f]);
+        }
+    }
+    xfree(state->heads);
+    memset(state, 0, sizeof(*state));
+}
+
+
+static void watch_state_capture(struct wlay_watch *watch, struct watch_state *state)
+{
+    struct wlay_state *wlay = watch->wlay;
+    state->count = 0;
+    state->heads = xmalloc(wl_list_length(&wlay->wl.heads) * sizeof(*state->heads) + 1);
+    struct wlay_head *head;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        struct watch_head *h = &state->heads[state->count++];
+        h->name = xstrdup(head->name ? head->name : "");
+        for (int f = 0; f < WATCH_FIELD_COUNT; f++) {
+            watch_format(&watch->value, head, f);
+            h->fields[f] = xstrdup(watch->value.data);
+        }
+    }
+}
+
+
+static struct watch_head *watch_state_find(struct watch_state *state, const char *name)
+{
+    for (size_t i = 0; i < state->count; i++) {
+        if (!strcmp(state->heads[i].name, name)) {
+            return &state->heads[i];
+        }
+    }
+    return NULL;
+}
+
+
+static void watch_change(struct wlay_buffer *line, bool *first, const char *name,
+                         const char *change)
+{
+    wlay_buffer_append(line, *first ? "{\"head\":" : ",{\"head\":", *first ? 8 : 9);
+    *first = false;
+    wlay_json_string(line, name);
+    wlay_buffer_printf(line, ",\"change\":\"%s\"", change);
+}
+
+
+static void watch_diff(struct wlay_buffer *line, struct watch_state *old,
+                       struct watch_state *new)
+{
+    bool first = true;
+    for (size_t i = 0; i < new->count; i++) {
+        struct watch_head *n = &new->heads[i];
+        struct watch_head *o = watch_state_find(old, n->name);
+        if (o == NULL) {
+            watch_change(line, &first, n->name, "added");
+            wlay_buffer_append(line, "}", 1);
+            continue;
+        }
+        for (int f = 0; f < WATCH_FIELD_COUNT; f++) {
+            if (strcmp(o->fields[f], n->fields[f])) {
+                watch_change(line, &first, n->name, "modified");
+                wlay_buffer_printf(line, ",\"field\":\"%s\",\"old\":%s,\"new\":%s}",
+                                   watch_field_names[f], o->fields[f], n->fields[f]);
+            }
+        }
+    }
+    for (size_t i = 0; i < old->count; i++) {
+        if (watch_state_find(new, old->heads[i].name) == NULL) {
+            watch_change(line, &first, old->heads[i].name, "removed");
+            wlay_buffer_append(line, "}", 1);
+        }
+    }
+}
+
+
+static void watch_flush(struct wlay_watch *watch)
+{
+    while (!watch->closed && watch->out.size > 0) {
+        ssize_t n = write(STDOUT_FILENO, watch->out.data, watch->out.size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                watch->closed = true;
+            }
+            return;
+        }
+        wlay_buffer_consume(&watch->out, n);
+    }
+}
+
+
+void wlay_watch_done(struct wlay_watch *watch, uint32_t serial)
+{
+    if (watch == NULL) {
+        return;
+    }
+    struct watch_state state;
+    watch_state_capture(watch, &state);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct wlay_buffer *line = &watch->line;
+    line->size = 0;
+    wlay_buffer_printf(line, "{\"serial\":%u,\"time\":%lld.%06ld,",
+                       serial, (long long)now.tv_sec, now.tv_nsec / 1000);
+    if (watch->dropped) {
+        wlay_buffer_printf(line, "\"dropped\":%llu,", (unsigned long long)watch->dropped);
+    }
+    wlay_buffer_append(line, "\"changes\":[", 11);
+    watch_diff(line, &watch->last, &state);
+    wlay_buffer_append(line, "],\"heads\":", 10);
+    wlay_json_heads(line, watch->wlay);
+    wlay_buffer_append(line, "}\n", 2);
+
+    if (watch->out.size + line->size > WATCH_MAX_PENDING) {
+        watch->dropped++;
+        watch_state_finish(&state);
+        return;
+    }
+    wlay_buffer_append(&watch->out, line->data, line->size);
+    watch->dropped = 0;
+    watch_state_finish(&watch->last);
+    watch->last = state;
+    watch_flush(watch);
+}
+
+
+struct wlay_watch *wlay_watch_create(struct wlay_state *wlay)
+{
+    struct wlay_watch *watch = xmalloc(sizeof(*watch));
+    watch->wlay = wlay;
+    // A consumer that went away ends the watch instead of killing wlay
+    signal(SIGPIPE, SIG_IGN);
+    watch->stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    fcntl(STDOUT_FILENO, F_SETFL, watch->stdout_flags | O_NONBLOCK);
+    return watch;
+}
+
+
+void wlay_watch_destroy(struct wlay_watch *watch)
+{
+    // Whatever is still pending, a line cut short would be unparseable
+    fcntl(STDOUT_FILENO, F_SETFL, watch->stdout_flags);
+    watch_flush(watch);
+    watch_state_finish(&watch->last);
+    wlay_buffer_finish(&watch->out);
+    wlay_buffer_finish(&watch->line);
+    wlay_buffer_finish(&watch->value);
+    xfree(watch);
+}
+
+
+int wlay_watch_run(struct wlay_watch *watch)
+{
+    struct wl_display *display = watch->wlay->wl.display;
+    while (!watch->closed) {
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+        struct pollfd fds[] = {
+            { .fd = wl_display_get_fd(display), .events = POLLIN },
+            { .fd = STDOUT_FILENO, .events = watch->out.size ? POLLOUT : 0 },
+        };
+        if (poll(fds, ARRAY_SIZE(fds), -1) < 0) {
+            wl_display_cancel_read(display);
+            if (errno == EINTR) {
+                continue;
+            }
+            return EXIT_FAILURE;
+        }
+        if (fds[0].revents) {
+            if (wl_display_read_events(display) < 0) {
+                log_info("Wayland connection lost");
+                return EXIT_FAILURE;
+            }
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (wl_display_dispatch_pending(display) < 0) {
+            log_info("Wayland connection lost");
+            return EXIT_FAILURE;
+        }
+        if (fds[1].revents & (POLLERR | POLLHUP)) {
+            watch->closed = true;
+        }
+        watch_flush(watch);
+    }
+    return EXIT_SUCCESS;
+}
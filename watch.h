@@ -0,0 +1,18 @@
+#ifndef WLAY_WATCH_H
+#define WLAY_WATCH_H
+
+#include <stdint.h>
+
+struct wlay_state;
+struct wlay_watch;
+
+// Headless mode printing a JSON line to stdout for every done event: the
+// heads as they are after it and what changed since the last line
+struct wlay_watch *wlay_watch_create(struct wlay_state *wlay);
+void wlay_watch_destroy(struct wlay_watch *watch);
+// Called for every done event, watch may be NULL
+void wlay_watch_done(struct wlay_watch *watch, uint32_t serial);
+// Runs until the compositor or the consumer goes away, returns the exit code
+int wlay_watch_run(struct wlay_watch *watch);
+
+#endif
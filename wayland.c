@@ -0,0 +1,802 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#define WLAY_MEM_TAG WLAY_MEM_MODEL
+#include "util.h"
+#include "wlay.h"
+#include "snapshot.h"
+
+// Highest zwlr_output_manager_v1 version wlay knows about
+#define WLAY_OUTPUT_MANAGER_VERSION 4u
+
+static void handle_mode_size(void *data,
+                             struct zwlr_output_mode_v1 *wlr_mode,
+		             int32_t width, int32_t height)
+{
+    struct wlay_mode *mode = data;
+    wlay_trace_record(mode->head->wlay->trace, WLAY_TRACE_MODE_SIZE, mode->trace_id,
+                      width, height);
+    mode->width = width;
+    mode->height = height;
+    wlay_model_changed(mode->head->wlay);
+}
+
+
+static void handle_mode_refresh(void *data,
+	                        struct zwlr_output_mode_v1 *wlr_mode,
+                                int32_t refresh)
+{
+    struct wlay_mode *mode = data;
+    wlay_trace_record(mode->head->wlay->trace, WLAY_TRACE_MODE_REFRESH, mode->trace_id,
+                      refresh);
+    mode->refresh_rate = refresh;
+    wlay_model_changed(mode->head->wlay);
+}
+
+
+static void handle_mode_preferred(void *data,
+		                  struct zwlr_output_mode_v1 *wlr_mode)
+{
+    struct wlay_mode *mode = data;
+    wlay_trace_record(mode->head->wlay->trace, WLAY_TRACE_MODE_PREFERRED, mode->trace_id);
+    mode->preferred = true;
+    wlay_model_changed(mode->head->wlay);
+}
+
+
+static void destroy_mode(struct wlay_mode *mode)
+{
+    struct wlay_state *wlay = mode->head->wlay;
+    if (mode->head->current_mode == mode) {
+        mode->head->current_mode = NULL;
+    }
+    wlay_model_changed(wlay);
+    wl_list_remove(&mode->link);
+    if (!wlay->replaying) {
+        if (wlay->wl.output_manager_version >= ZWLR_OUTPUT_MODE_V1_RELEASE_SINCE_VERSION) {
+            zwlr_output_mode_v1_release(mode->wlr);
+        } else {
+            zwlr_output_mode_v1_destroy(mode->wlr);
+        }
+    }
+    xfree(mode);
+}
+
+
+static void handle_mode_finished(void *data,
+                                 struct zwlr_output_mode_v1 *wlr_mode)
+{
+    struct wlay_mode *mode = data;
+    wlay_trace_record(mode->head->wlay->trace, WLAY_TRACE_MODE_FINISHED, mode->trace_id);
+    destroy_mode(mode);
+}
+
+
+static const struct zwlr_output_mode_v1_listener wlr_output_mode_listener = {
+	.size = handle_mode_size,
+	.refresh = handle_mode_refresh,
+	.preferred = handle_mode_preferred,
+	.finished = handle_mode_finished,
+};
+
+
+static void handle_head_name(void *data,
+                             struct zwlr_output_head_v1 *wlr_head,
+                             const char *name)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_NAME, head->trace_id, name);
+    xfree(head->name);
+    head->name = xstrdup(name);
+    head->wlay->head_generation++;
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_description(void *data,
+                                    struct zwlr_output_head_v1 *wlr_head,
+                                    const char *description)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_DESCRIPTION, head->trace_id,
+                      description);
+    xfree(head->description);
+    head->description = xstrdup(description);
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_physical_size(void *data,
+		                      struct zwlr_output_head_v1 *wlr_head,
+                                      int32_t width, int32_t height)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_PHYSICAL_SIZE, head->trace_id,
+                      width, height);
+    head->physical_width = width;
+    head->physical_height = height;
+}
+
+
+static void handle_head_mode(void *data,
+		             struct zwlr_output_head_v1 *wlr_head,
+		             struct zwlr_output_mode_v1 *wlr_mode)
+{
+    struct wlay_head *head = data;
+    struct wlay_state *wlay = head->wlay;
+
+    struct wlay_mode *mode = xmalloc(sizeof(*mode));
+
+    mode->head = head;
+    mode->wlr = wlr_mode;
+    mode->trace_id = ++wlay->next_object_id;
+    wlay_trace_record(wlay->trace, WLAY_TRACE_HEAD_MODE, head->trace_id, mode->trace_id);
+    wl_list_insert(&head->modes, &mode->link);
+    if (!wlay->replaying) {
+        zwlr_output_mode_v1_add_listener(wlr_mode, &wlr_output_mode_listener, mode);
+    }
+    wlay_model_changed(wlay);
+}
+
+
+static void handle_head_enabled(void *data,
+		                struct zwlr_output_head_v1 *wlr_head,
+                                int32_t enabled)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_ENABLED, head->trace_id, enabled);
+    head->enabled = !!enabled;
+    if (!head->enabled) {
+        head->current_mode = NULL;
+    }
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_current_mode(void *data,
+		                     struct zwlr_output_head_v1 *wlr_head,
+		                     struct zwlr_output_mode_v1 *wlr_mode)
+{
+    struct wlay_head *head = data;
+    struct wlay_mode *mode;
+    wl_list_for_each(mode, &head->modes, link) {
+        if (mode->wlr == wlr_mode) {
+            wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_CURRENT_MODE,
+                              head->trace_id, mode->trace_id);
+            head->current_mode = mode;
+            return;
+        }
+    }
+    // WTF?
+    head->current_mode = NULL;
+    log_info("Unknown mode");
+}
+
+
+static void handle_head_position(void *data,
+		                 struct zwlr_output_head_v1 *wlr_head,
+                                 int32_t x, int32_t y)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_POSITION, head->trace_id, x, y);
+    head->x = x;
+    head->y = y;
+}
+
+
+static void handle_head_transform(void *data,
+		                  struct zwlr_output_head_v1 *wlr_head,
+                                  int32_t transform)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_TRANSFORM, head->trace_id,
+                      transform);
+    head->transform = transform;
+}
+
+
+static void handle_head_scale(void *data,
+		              struct zwlr_output_head_v1 *wlr_head, wl_fixed_t scale)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_SCALE, head->trace_id, scale);
+    head->scale = scale;
+}
+
+
+static void destroy_head(struct wlay_head *head)
+{
+    if (head->wlay->drag_head == head) {
+        head->wlay->drag_head = NULL;
+    }
+    if (head->wlay->focused == head) {
+        head->wlay->focused = NULL;
+    }
+    head->wlay->head_generation++;
+    wlay_model_changed(head->wlay);
+    wl_list_remove(&head->link);
+    if (!head->wlay->replaying) {
+        if (head->wlay->wl.output_manager_version >=
+                ZWLR_OUTPUT_HEAD_V1_RELEASE_SINCE_VERSION) {
+            zwlr_output_head_v1_release(head->wlr);
+        } else {
+            zwlr_output_head_v1_destroy(head->wlr);
+        }
+    }
+    xfree(head->name);
+    xfree(head->description);
+    xfree(head->make);
+    xfree(head->model);
+    xfree(head->serial_number);
+    xfree(head->mode_labels);
+    xfree(head->mode_list);
+    wlay_mode_index_finish(&head->mode_index);
+    wlay_snapshot_head_unref(head->snapshot);
+    xfree(head);
+}
+
+
+static void handle_head_finished(void *data,
+		                 struct zwlr_output_head_v1 *wlr_head)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_FINISHED, head->trace_id);
+    destroy_head(head);
+}
+
+
+static void handle_head_make(void *data,
+                             struct zwlr_output_head_v1 *wlr_head,
+                             const char *make)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_MAKE, head->trace_id, make);
+    xfree(head->make);
+    head->make = xstrdup(make);
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_model(void *data,
+                              struct zwlr_output_head_v1 *wlr_head,
+                              const char *model)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_MODEL, head->trace_id, model);
+    xfree(head->model);
+    head->model = xstrdup(model);
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_serial_number(void *data,
+                                      struct zwlr_output_head_v1 *wlr_head,
+                                      const char *serial_number)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_SERIAL_NUMBER, head->trace_id,
+                      serial_number);
+    xfree(head->serial_number);
+    head->serial_number = xstrdup(serial_number);
+    wlay_model_changed(head->wlay);
+}
+
+
+static void handle_head_adaptive_sync(void *data,
+                                      struct zwlr_output_head_v1 *wlr_head,
+                                      uint32_t state)
+{
+    struct wlay_head *head = data;
+    wlay_trace_record(head->wlay->trace, WLAY_TRACE_HEAD_ADAPTIVE_SYNC, head->trace_id,
+                      state);
+    head->adaptive_sync_supported = true;
+    head->adaptive_sync = state == ZWLR_OUTPUT_HEAD_V1_ADAPTIVE_SYNC_STATE_ENABLED;
+}
+
+
+static const struct zwlr_output_head_v1_listener wlr_head_listener = {
+	.name = handle_head_name,
+	.description = handle_head_description,
+	.physical_size = handle_head_physical_size,
+	.mode = handle_head_mode,
+	.enabled = handle_head_enabled,
+	.current_mode = handle_head_current_mode,
+	.position = handle_head_position,
+	.transform = handle_head_transform,
+	.scale = handle_head_scale,
+	.finished = handle_head_finished,
+	.make = handle_head_make,
+	.model = handle_head_model,
+	.serial_number = handle_head_serial_number,
+	.adaptive_sync = handle_head_adaptive_sync,
+};
+
+
+static void handle_wlr_output_manager_head(void *data,
+                                           struct zwlr_output_manager_v1 *manager,
+                                           struct zwlr_output_head_v1 *wlr_head)
+{
+    struct wlay_state *wlay = data;
+    struct wlay_head *head = xmalloc(sizeof(struct wlay_head));
+    head->wlay = wlay;
+    head->wlr = wlr_head;
+    head->trace_id = ++wlay->next_object_id;
+    wlay_trace_record(wlay->trace, WLAY_TRACE_MANAGER_HEAD, 0, head->trace_id);
+    wl_list_init(&head->modes);
+    wl_list_insert(&wlay->wl.heads, &head->link);
+    if (!wlay->replaying) {
+        zwlr_output_head_v1_add_listener(wlr_head, &wlr_head_listener, head);
+    }
+    wlay->head_generation++;
+    wlay_model_changed(wlay);
+}
+
+
+static void handle_wlr_output_manager_done(void *data,
+                                           struct zwlr_output_manager_v1 *manager,
+                                           uint32_t serial)
+{
+    struct wlay_state *wlay = data;
+    wlay_trace_record(wlay->trace, WLAY_TRACE_MANAGER_DONE, 0, serial);
+    // Flushed per batch, so that a trace of a crash is complete up to it
+    wlay_trace_flush(wlay->trace);
+    wlay->serial = serial;
+    wlay_model_changed(wlay);
+    wlay_snapshot_update(wlay);
+    if (wlay->hooks != NULL && wlay->hooks->done != NULL) {
+        wlay->hooks->done(wlay, serial);
+    }
+}
+
+
+static void handle_wlr_output_manager_finished(void *data,
+                                               struct zwlr_output_manager_v1 *manager)
+{
+    struct wlay_state *wlay = data;
+    wlay_trace_record(wlay->trace, WLAY_TRACE_MANAGER_FINISHED, 0);
+}
+
+
+static const struct zwlr_output_manager_v1_listener wlr_output_manager_listener = {
+    .head = handle_wlr_output_manager_head,
+    .done = handle_wlr_output_manager_done,
+    .finished = handle_wlr_output_manager_finished,
+};
+
+
+static void handle_wl_event(void *data, struct wl_registry *registry,
+                            uint32_t name, const char *interface, uint32_t version)
+{
+    struct wlay_state *wlay = data;
+    if (!strcmp(interface, zwlr_output_manager_v1_interface.name)) {
+        // Newer versions only add events and requests, so take whatever
+        // both sides support
+        wlay->wl.output_manager_version = min(version, WLAY_OUTPUT_MANAGER_VERSION);
+        wlay->wl.output_manager = wl_registry_bind(
+            registry, name, &zwlr_output_manager_v1_interface,
+            wlay->wl.output_manager_version
+        );
+        zwlr_output_manager_v1_add_listener(
+            wlay->wl.output_manager, &wlr_output_manager_listener, wlay
+        );
+    } else if (!strcmp(interface, wl_shm_interface.name)) {
+        wlay->wl.shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if (wlay->hooks != NULL && wlay->hooks->global != NULL) {
+        wlay->hooks->global(wlay, registry, name, interface, version);
+    }
+}
+
+
+static void handle_wl_event_remove(void *data, struct wl_registry *registry,
+                                   uint32_t name)
+{
+    struct wlay_state *wlay = data;
+    if (wlay->hooks != NULL && wlay->hooks->global_remove != NULL) {
+        wlay->hooks->global_remove(wlay, name);
+    }
+    // TODO: At this point we should handle output removal
+    log_info("Removing!");
+}
+
+
+static const struct wl_registry_listener registry_listener = {
+    .global = handle_wl_event,
+    .global_remove = handle_wl_event_remove,
+};
+
+
+bool wlay_wayland_connect(struct wlay_state *wlay, const char *name)
+{
+    wl_list_init(&wlay->wl.heads);
+    wlay->wl.display = wl_display_connect(name);
+    if (wlay->wl.display == NULL) {
+        log_info("Wayland connection to %s failed", name ? name : "the default display");
+        return false;
+    }
+
+    wlay->wl.registry = wl_display_get_registry(wlay->wl.display);
+    wl_registry_add_listener(wlay->wl.registry, &registry_listener, wlay);
+    wl_display_dispatch(wlay->wl.display);
+    wl_display_roundtrip(wlay->wl.display);
+
+    if (wlay->wl.output_manager == NULL) {
+        log_info("Compositor does not support wlr-output-management-unstable-v1");
+        wlay_wayland_disconnect(wlay);
+        return false;
+    }
+    return true;
+}
+
+
+// Frees the model without recording it, the compositor did not remove
+// the heads
+static void destroy_heads(struct wlay_state *wlay)
+{
+    struct wlay_head *head, *tmp_head;
+    wl_list_for_each_safe(head, tmp_head, &wlay->wl.heads, link) {
+        struct wlay_mode *mode, *tmp_mode;
+        wl_list_for_each_safe(mode, tmp_mode, &head->modes, link) {
+            destroy_mode(mode);
+        }
+        destroy_head(head);
+    }
+}
+
+
+void wlay_wayland_disconnect(struct wlay_state *wlay)
+{
+    destroy_heads(wlay);
+    wlay_snapshot_unref(wlay->snapshot);
+    wlay->snapshot = NULL;
+    if (wlay->wl.output_manager) {
+        zwlr_output_manager_v1_destroy(wlay->wl.output_manager);
+        wlay->wl.output_manager = NULL;
+    }
+    if (wlay->wl.shm) {
+        wl_shm_destroy(wlay->wl.shm);
+        wlay->wl.shm = NULL;
+    }
+    wl_registry_destroy(wlay->wl.registry);
+    wl_display_disconnect(wlay->wl.display);
+}
+
+
+void wlay_wayland_poll(struct wlay_state *wlay)
+{
+    struct wl_display *display = wlay->wl.display;
+    while (wl_display_prepare_read(display) != 0) {
+        wl_display_dispatch_pending(display);
+    }
+    wl_display_flush(display);
+    struct pollfd pfd = { .fd = wl_display_get_fd(display), .events = POLLIN };
+    if (poll(&pfd, 1, 0) > 0) {
+        wl_display_read_events(display);
+    } else {
+        wl_display_cancel_read(display);
+    }
+    wl_display_dispatch_pending(display);
+}
+
+
+struct zwlr_output_configuration_v1 *wlay_create_configuration(struct wlay_state *wlay)
+{
+    struct zwlr_output_configuration_v1 *config =
+        zwlr_output_manager_v1_create_configuration(wlay->wl.output_manager, wlay->serial);
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (!head->enabled) {
+            zwlr_output_configuration_v1_disable_head(config, head->wlr);
+            continue;
+        }
+        struct zwlr_output_configuration_head_v1 *cfg_head =
+            zwlr_output_configuration_v1_enable_head(config, head->wlr);
+        if (head->custom_mode.enabled && head->custom_mode.valid) {
+            zwlr_output_configuration_head_v1_set_custom_mode(
+                cfg_head, head->custom_mode.timing.hdisplay,
+                head->custom_mode.timing.vdisplay, head->custom_mode.timing.refresh_rate
+            );
+        } else {
+            zwlr_output_configuration_head_v1_set_mode(cfg_head, head->current_mode->wlr);
+        }
+        zwlr_output_configuration_head_v1_set_position(
+            cfg_head, head->x, head->y
+        );
+        zwlr_output_configuration_head_v1_set_transform(
+            cfg_head, head->transform
+        );
+        zwlr_output_configuration_head_v1_set_scale(
+            cfg_head, head->scale
+        );
+        if (head->adaptive_sync_supported &&
+                wlay->wl.output_manager_version >=
+                ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_SET_ADAPTIVE_SYNC_SINCE_VERSION) {
+            zwlr_output_configuration_head_v1_set_adaptive_sync(
+                cfg_head, head->adaptive_sync ?
+                    ZWLR_OUTPUT_HEAD_V1_ADAPTIVE_SYNC_STATE_ENABLED :
+                    ZWLR_OUTPUT_HEAD_V1_ADAPTIVE_SYNC_STATE_DISABLED
+            );
+        }
+    }
+    return config;
+}
+
+
+static void handle_configuration_result(void *data,
+                                        struct zwlr_output_configuration_v1 *config,
+                                        const char *result)
+{
+    struct wlay_state *wlay = data;
+    log_info("Configuration %s", result);
+    if (wlay->hooks != NULL && wlay->hooks->result != NULL) {
+        wlay->hooks->result(wlay, result);
+    }
+    zwlr_output_configuration_v1_destroy(config);
+}
+
+
+static void handle_configuration_succeeded(void *data,
+                                           struct zwlr_output_configuration_v1 *config)
+{
+    handle_configuration_result(data, config, "succeeded");
+}
+
+
+static void handle_configuration_failed(void *data,
+                                        struct zwlr_output_configuration_v1 *config)
+{
+    handle_configuration_result(data, config, "failed");
+}
+
+
+static void handle_configuration_cancelled(void *data,
+                                           struct zwlr_output_configuration_v1 *config)
+{
+    handle_configuration_result(data, config, "cancelled");
+}
+
+
+static const struct zwlr_output_configuration_v1_listener configuration_listener = {
+    .succeeded = handle_configuration_succeeded,
+    .failed = handle_configuration_failed,
+    .cancelled = handle_configuration_cancelled,
+};
+
+
+void wlay_push_settings(struct wlay_state *wlay)
+{
+    // The compositor would need a mode for it, fail like it would
+    struct wlay_head *head;
+    wl_list_for_each(head, &wlay->wl.heads, link) {
+        if (head->enabled && head->current_mode == NULL &&
+                !(head->custom_mode.enabled && head->custom_mode.valid)) {
+            log_info("%s is enabled without a mode, not sending the config", head->name);
+            if (wlay->hooks != NULL && wlay->hooks->result != NULL) {
+                wlay->hooks->result(wlay, "failed");
+            }
+            return;
+        }
+    }
+    log_info("Sending config");
+    struct zwlr_output_configuration_v1 *config = wlay_create_configuration(wlay);
+    zwlr_output_configuration_v1_add_listener(config, &configuration_listener, wlay);
+    zwlr_output_configuration_v1_apply(config);
+}
+
+
+// Opaque stand-ins for the protocol objects while replaying, they are only
+// ever compared, never dereferenced
+#define REPLAY_PROXY(id) ((void *)(uintptr_t)(id))
+
+
+static void *replay_lookup(void **objects, size_t count, uint32_t id)
+{
+    if (id >= count || objects[id] == NULL) {
+        fail("Trace references unknown object %u", id);
+    }
+    return objects[id];
+}
+
+
+static void replay_sleep_until(double deadline)
+{
+    double remaining = deadline - monotonic_time();
+    if (remaining > 0) {
+        struct timespec ts = {
+            .tv_sec = remaining,
+            .tv_nsec = (remaining - (long)remaining) * 1e9,
+        };
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+void wlay_replay(struct wlay_state *wlay, const char *path, bool realtime, unsigned count)
+{
+    struct wlay_trace *trace = wlay_trace_open(path);
+    wlay->replaying = true;
+    wl_list_init(&wlay->wl.heads);
+
+    void **objects = NULL;
+    size_t object_count = 0;
+    uint64_t events = 0;
+    uint64_t batches = 0;
+    double start = monotonic_time();
+
+    for (unsigned pass = 0; pass < count; pass++) {
+        if (pass > 0) {
+            destroy_heads(wlay);
+            wlay_trace_rewind(trace);
+        }
+        memset(objects, 0, object_count * sizeof(*objects));
+        double pass_start = monotonic_time();
+
+        struct wlay_trace_record record;
+        while (wlay_trace_next(trace, &record)) {
+            if (realtime) {
+                replay_sleep_until(pass_start + record.time / 1e6);
+            }
+            // Objects created by this event
+            uint32_t new_id = 0;
+            if (record.event == WLAY_TRACE_MANAGER_HEAD ||
+                    record.event == WLAY_TRACE_HEAD_MODE) {
+                new_id = record.args[0].u;
+                if (new_id == 0) {
+                    fail("Trace creates object 0");
+                }
+                if (new_id >= object_count) {
+                    size_t old_count = object_count;
+                    object_count = new_id + 1 > 2 * object_count ? new_id + 1 : 2 * object_count;
+                    objects = xrealloc(objects, object_count * sizeof(*objects));
+                    memset(objects + old_count, 0,
+                           (object_count - old_count) * sizeof(*objects));
+                }
+            }
+
+            struct wlay_head *head = NULL;
+            struct wlay_mode *mode = NULL;
+            switch (record.event) {
+            case WLAY_TRACE_MANAGER_HEAD:
+                handle_wlr_output_manager_head(wlay, NULL, REPLAY_PROXY(new_id));
+                // New heads are inserted at the front of the list
+                objects[new_id] = wl_container_of(wlay->wl.heads.next, head, link);
+                break;
+            case WLAY_TRACE_MANAGER_DONE:
+                handle_wlr_output_manager_done(wlay, NULL, record.args[0].u);
+                batches++;
+                break;
+            case WLAY_TRACE_MANAGER_FINISHED:
+                handle_wlr_output_manager_finished(wlay, NULL);
+                break;
+            case WLAY_TRACE_HEAD_NAME:
+            case WLAY_TRACE_HEAD_DESCRIPTION:
+            case WLAY_TRACE_HEAD_PHYSICAL_SIZE:
+            case WLAY_TRACE_HEAD_MODE:
+            case WLAY_TRACE_HEAD_ENABLED:
+            case WLAY_TRACE_HEAD_CURRENT_MODE:
+            case WLAY_TRACE_HEAD_POSITION:
+            case WLAY_TRACE_HEAD_TRANSFORM:
+            case WLAY_TRACE_HEAD_SCALE:
+            case WLAY_TRACE_HEAD_FINISHED:
+            case WLAY_TRACE_HEAD_MAKE:
+            case WLAY_TRACE_HEAD_MODEL:
+            case WLAY_TRACE_HEAD_SERIAL_NUMBER:
+            case WLAY_TRACE_HEAD_ADAPTIVE_SYNC:
+                head = replay_lookup(objects, object_count, record.object);
+                break;
+            default:
+                mode = replay_lookup(objects, object_count, record.object);
+                break;
+            }
+
+            switch (record.event) {
+            case WLAY_TRACE_HEAD_NAME:
+                handle_head_name(head, head->wlr, record.args[0].s);
+                break;
+            case WLAY_TRACE_HEAD_DESCRIPTION:
+                handle_head_description(head, head->wlr, record.args[0].s);
+                break;
+            case WLAY_TRACE_HEAD_PHYSICAL_SIZE:
+                handle_head_physical_size(head, head->wlr,
+                                          record.args[0].i, record.args[1].i);
+                break;
+            case WLAY_TRACE_HEAD_MODE:
+                handle_head_mode(head, head->wlr, REPLAY_PROXY(new_id));
+                // New modes are inserted at the front of the list
+                objects[new_id] = wl_container_of(head->modes.next, mode, link);
+                break;
+            case WLAY_TRACE_HEAD_ENABLED:
+                handle_head_enabled(head, head->wlr, record.args[0].i);
+                break;
+            case WLAY_TRACE_HEAD_CURRENT_MODE:
+                mode = replay_lookup(objects, object_count, record.args[0].u);
+                handle_head_current_mode(head, head->wlr, mode->wlr);
+                break;
+            case WLAY_TRACE_HEAD_POSITION:
+                handle_head_position(head, head->wlr, record.args[0].i, record.args[1].i);
+                break;
+            case WLAY_TRACE_HEAD_TRANSFORM:
+                handle_head_transform(head, head->wlr, record.args[0].i);
+                break;
+            case WLAY_TRACE_HEAD_SCALE:
+                handle_head_scale(head, head->wlr, record.args[0].i);
+                break;
+            case WLAY_TRACE_HEAD_FINISHED:
+                handle_head_finished(head, head->wlr);
+                objects[record.object] = NULL;
+                break;
+            case WLAY_TRACE_HEAD_MAKE:
+                handle_head_make(head, head->wlr, record.args[0].s);
+                break;
+            case WLAY_TRACE_HEAD_MODEL:
+                handle_head_model(head, head->wlr, record.args[0].s);
+                break;
+            case WLAY_TRACE_HEAD_SERIAL_NUMBER:
+                handle_head_serial_number(head, head->wlr, record.args[0].s);
+                break;
+            case WLAY_TRACE_HEAD_ADAPTIVE_SYNC:
+                handle_head_adaptive_sync(head, head->wlr, record.args[0].u);
+                break;
+            case WLAY_TRACE_MODE_SIZE:
+                handle_mode_size(mode, mode->wlr, record.args[0].i, record.args[1].i);
+                break;
+            case WLAY_TRACE_MODE_REFRESH:
+                handle_mode_refresh(mode, mode->wlr, record.args[0].i);
+                break;
+            case WLAY_TRACE_MODE_PREFERRED:
+                handle_mode_preferred(mode, mode->wlr);
+                break;
+            case WLAY_TRACE_MODE_FINISHED:
+                handle_mode_finished(mode, mode->wlr);
+                objects[record.object] = NULL;
+                break;
+            default:
+                break;
+            }
+            events++;
+        }
+    }
+    double elapsed = monotonic_time() - start;
+
+    log_info("Replayed %llu events in %llu batches, %u pass%s, %.3f ms",
+             (unsigned long long)events, (unsigned long long)batches,
+             count, count == 1 ? "" : "es", elapsed * 1e3);
+    if (events && !realtime) {
+        log_info("%.0f events/s, %.1f ns/event", events / elapsed, elapsed * 1e9 / events);
+    }
+
+    // The model as the last pass left it
+    struct wlay_head *head;
+    wl_list_for_each_reverse(head, &wlay->wl.heads, link) {
+        struct wlay_mode *mode;
+        int modes = 0;
+        wl_list_for_each(mode, &head->modes, link) {
+            modes++;
+        }
+        if (head->enabled && head->current_mode != NULL) {
+            log_info("%s: %dx%d@%.3f at %d,%d, transform %d, scale %.2f, %d modes",
+                     head->name ? head->name : "(unnamed)",
+                     head->current_mode->width, head->current_mode->height,
+                     head->current_mode->refresh_rate / 1000.0, head->x, head->y,
+                     head->transform, wl_fixed_to_double(head->scale), modes);
+        } else {
+            log_info("%s: disabled, %d modes",
+                     head->name ? head->name : "(unnamed)", modes);
+        }
+    }
+    log_info("Final serial %u", wlay->serial);
+
+    destroy_heads(wlay);
+    wlay_snapshot_unref(wlay->snapshot);
+    wlay->snapshot = NULL;
+    xfree(objects);
+    wlay_trace_close(trace);
+}
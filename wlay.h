@@ -0,0 +1,258 @@
+#ifndef WLAY_H
+#define WLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <wayland-client.h>
+
+#include "wayland-wlr-output-management-client-protocol.h"
+
+#include "trace.h"
+#include "cvt.h"
+#include "modes.h"
+
+// Most frames the GPU may be behind with --render-ahead
+#define WLAY_MAX_RENDER_AHEAD 8
+
+struct wlay_state;
+struct wlay_gui;
+struct wlay_backend;
+struct wlay_ipc;
+struct wlay_watch;
+struct wlay_thumbnails;
+struct wlay_modeset_bench;
+struct wlay_journal;
+struct wlay_profiles;
+struct wlay_snapshot;
+struct wlay_snapshot_head;
+struct nk_context;
+struct nk_image;
+
+enum wlay_config_type {
+    WLAY_CONFIG_SWAY,
+    WLAY_CONFIG_WLRRANDR,
+    WLAY_CONFIG_KANSHI,
+    // The layout alone, not the heads array of the control socket
+    WLAY_CONFIG_JSON,
+    // wlr-randr as a script with every name quoted for sh
+    WLAY_CONFIG_WLRRANDR_SH,
+    WLAY_CONFIG_TYPE_COUNT,
+};
+
+// How front ends follow the model, every hook may be NULL
+struct wlay_hooks {
+    // After every done event, once the model is complete
+    void (*done)(struct wlay_state *wlay, uint32_t serial);
+    // The verdict on wlay_push_settings()
+    void (*result)(struct wlay_state *wlay, const char *result);
+    // Globals the model does not bind itself
+    void (*global)(struct wlay_state *wlay, struct wl_registry *registry, uint32_t name,
+                   const char *interface, uint32_t version);
+    void (*global_remove)(struct wlay_state *wlay, uint32_t name);
+};
+
+struct wlay_state {
+    /* Wayland state */
+    struct {
+        struct wl_display *display;
+        struct wl_registry *registry;
+        struct wl_shm *shm;
+        struct wl_list heads;
+        struct zwlr_output_manager_v1 *output_manager;
+        uint32_t output_manager_version;
+    } wl;
+
+    // Bumped whenever the head/mode model changes in a way that affects
+    // what the GUI displays, see wlay_gui_refresh()
+    uint64_t generation;
+    // Bumped whenever a head comes, goes or gets its name
+    uint64_t head_generation;
+    // Immutable copy of the model, updated at every done event and
+    // whenever someone needs one, see wlay_snapshot_update()
+    struct wlay_snapshot *snapshot;
+
+    // Output management events are recorded into trace when it is set.
+    // While replaying a trace there are no protocol objects behind the
+    // model, see wlay_replay().
+    struct wlay_trace *trace;
+    bool replaying;
+    uint32_t next_object_id;
+
+    const struct wlay_hooks *hooks;
+    void *hooks_data;
+
+    // Control socket, NULL when disabled
+    struct wlay_ipc *ipc;
+    // Set in --watch mode, which has no GUI
+    struct wlay_watch *watch;
+    // Set in --modeset-bench mode, which has no GUI either
+    struct wlay_modeset_bench *modeset_bench;
+    // Live output contents in the editor, NULL when disabled
+    struct wlay_thumbnails *thumbnails;
+    // Undo, redo and revert in the editor, NULL when disabled
+    struct wlay_journal *journal;
+    // Saved layouts, reloaded whenever they change on disk. NULL without
+    // inotify.
+    struct wlay_profiles *profiles;
+
+    /* Rendering backend/nuklear state */
+    const struct wlay_backend *backend;
+    struct nk_context *nk;
+    // How the GL backend presents frames. With late_input the cursor is
+    // read again right before a frame is built while dragging and the
+    // latency of every drag is logged. The GPU may be up to render_ahead
+    // frames behind, -1 leaves that to the driver.
+    struct {
+        int swap_interval;
+        int render_ahead;
+        bool late_input;
+    } present;
+
+    // The head the editor drags and the one it has focused, the model
+    // forgets them when the head goes away
+    struct wlay_head *drag_head;
+    struct wlay_head *focused;
+    // Editor state, see gui.h. NULL until wlay_gui_init().
+    struct wlay_gui *gui;
+    bool should_apply;
+    // How heads that are enabled without a mode get one
+    struct wlay_mode_policy mode_policy;
+
+    uint32_t serial;
+};
+
+struct wlay_mode;
+
+struct wlay_head {
+    char *name;
+    char *description;
+    // Version 2 and later, NULL when the compositor does not know them
+    char *make;
+    char *model;
+    char *serial_number;
+
+    struct wlay_mode *current_mode;
+
+    int32_t x;
+    int32_t y;
+    int32_t physical_width;
+    int32_t physical_height;
+    bool enabled;
+    int32_t transform;
+    wl_fixed_t scale;
+    // Version 4 and later, the compositor reports the state of every head
+    // that it can be set for
+    bool adaptive_sync_supported;
+    bool adaptive_sync;
+
+    // A mode the compositor does not advertise, used instead of
+    // current_mode while enabled. The timing is recomputed whenever the
+    // parameters change.
+    struct {
+        bool enabled;
+        int width;
+        int height;
+        float refresh;
+        enum wlay_cvt_type type;
+        struct wlay_cvt_timing timing;
+        bool valid;
+        char label[96];
+    } custom_mode;
+
+    int32_t w;
+    int32_t h;
+
+    bool focused;
+    // Keep the position when auto-arranging
+    bool pinned;
+    // Validation results, see wlay_gui_validate()
+    bool overlapping;
+    bool detached;
+
+    // Display data, see wlay_gui_refresh()
+    char header[128];
+    // How sway and kanshi identify the output regardless of the connector,
+    // empty without make and model
+    char identifier[192];
+    float name_width;
+    // Latest capture of the output, NULL until there is one, see
+    // wlay_thumbnails_update()
+    const struct nk_image *thumbnail;
+    // In the order of the mode index
+    const char **mode_labels;
+    struct wlay_mode **mode_list;
+    int mode_count;
+    int mode_capacity;
+    // See wlay_head_mode_index()
+    struct wlay_mode_index mode_index;
+
+    // Last version of the head in a snapshot
+    struct wlay_snapshot_head *snapshot;
+
+    struct wlay_state *wlay;
+    uint32_t trace_id;
+    struct zwlr_output_head_v1 *wlr;
+    struct wl_list link;
+    struct wl_list modes;
+};
+
+
+struct wlay_mode {
+    int32_t width;
+    int32_t height;
+    int32_t refresh_rate;
+    bool preferred;
+
+    // Display data, see wlay_gui_refresh()
+    char label[32];
+
+    struct wlay_head *head;
+    uint32_t trace_id;
+    struct zwlr_output_mode_v1 *wlr;
+    struct wl_list link;
+};
+
+// Size of the mode the head is set to, false if there is none
+static inline bool wlay_head_mode_size(struct wlay_head *head, int32_t *width, int32_t *height)
+{
+    if (head->custom_mode.enabled && head->custom_mode.valid) {
+        *width = head->custom_mode.timing.hdisplay;
+        *height = head->custom_mode.timing.vdisplay;
+        return true;
+    }
+    if (head->current_mode == NULL) {
+        return false;
+    }
+    *width = head->current_mode->width;
+    *height = head->current_mode->height;
+    return true;
+}
+
+// Connects to the named display (NULL for the default one) and collects
+// its heads, false if it has no output management
+bool wlay_wayland_connect(struct wlay_state *wlay, const char *name);
+void wlay_wayland_disconnect(struct wlay_state *wlay);
+
+// A configuration of every head as the model has it, for the caller to
+// test or apply
+struct zwlr_output_configuration_v1 *wlay_create_configuration(struct wlay_state *wlay);
+// Applies the model, the result is logged and passed to the result hook.
+// A head enabled without a mode fails right away.
+void wlay_push_settings(struct wlay_state *wlay);
+// Reads and dispatches whatever the compositor sent without blocking, the
+// backend may not share our connection
+void wlay_wayland_poll(struct wlay_state *wlay);
+
+// Feeds a recorded trace through the same handlers as the live protocol,
+// without a compositor or a GUI. Meant for reproducing bug reports and for
+// profiling the model updates.
+void wlay_replay(struct wlay_state *wlay, const char *path, bool realtime, unsigned count);
+
+// Invalidates everything the GUI caches about the head/mode model
+static inline void wlay_model_changed(struct wlay_state *wlay)
+{
+    wlay->generation++;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef WLAY_NUKLEAR_H
+#define WLAY_NUKLEAR_H
+
+// nuklear configuration, has to be the same in every translation unit.
+// The implementation itself is compiled into nuklear.c.
+#define NK_INCLUDE_FIXED_TYPES
+#define NK_INCLUDE_STANDARD_IO
+#define NK_INCLUDE_STANDARD_VARARGS
+#define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+#define NK_INCLUDE_FONT_BAKING
+#define NK_INCLUDE_DEFAULT_FONT
+#define NK_KEYSTATE_BASED_INPUT
+#include "nuklear.h"
+
+// Instead of the default allocator, which is not compiled in: nuklear's
+// memory is counted like xmalloc()'s, under the wlay_mem_tag tag
+struct nk_allocator *wlay_nk_allocator(int tag);
+
+#endif